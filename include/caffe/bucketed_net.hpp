@@ -0,0 +1,82 @@
+#ifndef CAFFE_BUCKETED_NET_HPP_
+#define CAFFE_BUCKETED_NET_HPP_
+
+#include <string>
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/net.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+/**
+ * @brief Runs a net on inputs of varying shape, such as batches of clips of
+ *        varying length, without reshaping it.
+ *
+ * The inputs are zero-padded to the smallest of a few canonical shapes, the
+ * buckets, usually differing in their number of items and of frames. Each
+ * bucket has a Net of its own, reshaped once, with its own blobs and
+ * workspaces, all sharing the params of the first one (see the weights_net
+ * of Net): switching buckets costs neither allocations nor layer Reshapes.
+ * The padding wasted by each bucket is counted.
+ */
+template <typename Dtype>
+class BucketedNet {
+ public:
+  /**
+   * @param param a net with one input blob.
+   * @param bucket_shapes the shapes the input is padded to.
+   * @param trained_filename the weights to copy into the net, if not empty.
+   */
+  BucketedNet(const NetParameter& param,
+      const vector<vector<int> >& bucket_shapes,
+      const string& trained_filename = "");
+
+  /// @brief The smallest bucket that shape fits, or -1 if none does.
+  int Bucket(const vector<int>& shape) const;
+  /**
+   * @brief Runs the net of the bucket of input on input, padded with zeros.
+   *
+   * The outputs have the shape of the bucket outputs, whatever of them
+   * depends on padding is to be ignored.
+   */
+  const vector<Blob<Dtype>*>& Forward(const Blob<Dtype>& input,
+      int* bucket = NULL, Dtype* loss = NULL);
+
+  inline int num_buckets() const { return nets_.size(); }
+  inline const vector<int>& bucket_shape(int bucket) const {
+    return bucket_shapes_[bucket];
+  }
+  /// @brief The net of a bucket; that of bucket 0 holds the params.
+  inline Net<Dtype>* net(int bucket) const { return nets_[bucket].get(); }
+
+  /// @brief The inputs run by a bucket, and the values they held and padded.
+  struct Stats {
+    Stats() : num_forwards(0), num_values(0), num_padding(0) {}
+    size_t num_forwards;
+    size_t num_values;
+    size_t num_padding;
+    /// The share of the values run that were padding.
+    inline float padding_waste() const {
+      return num_forwards ?
+          static_cast<float>(num_padding) / (num_values + num_padding) : 0;
+    }
+  };
+  inline const Stats& stats(int bucket) const { return stats_[bucket]; }
+  void ClearStats();
+  /// @brief Logs the stats of each bucket.
+  void LogStats() const;
+
+ protected:
+  vector<vector<int> > bucket_shapes_;
+  vector<shared_ptr<Net<Dtype> > > nets_;
+  vector<Stats> stats_;
+
+DISABLE_COPY_AND_ASSIGN(BucketedNet);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_BUCKETED_NET_HPP_
@@ -5,11 +5,14 @@
 #define CAFFE_CAFFE_HPP_
 
 #include "caffe/blob.hpp"
+#include "caffe/bucketed_net.hpp"
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
+#include "caffe/inference_engine.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/layer_factory.hpp"
 #include "caffe/net.hpp"
+#include "caffe/net_profiler.hpp"
 #include "caffe/parallel.hpp"
 #include "caffe/proto/caffe.pb.h"
 #include "caffe/solver.hpp"
@@ -30,13 +30,33 @@ class DataTransformer {
    * transform_param block to the data.
    *
    * @param datum
-   *    Datum containing the data to be transformed.
+   *    Datum containing the data to be transformed. A video clip Datum
+   *    (with a length or encoded frames) is cropped in time and space and
+   *    mirrored the same way for all of its frames.
    * @param transformed_blob
    *    This is destination blob. It can be part of top blob's data if
-   *    set_cpu_data() is used. See data_layer.cpp for an example.
+   *    set_cpu_data() is used. See data_layer.cpp for an example. It must be
+   *    5-D (1 x channels x length x height x width) for a video clip.
    */
   void Transform(const Datum& datum, Blob<Dtype>* transformed_blob);
 
+  /**
+   * @brief Same as Transform(datum, transformed_blob), drawing the random
+   *    crop and mirroring from rng instead of the transformer's own
+   *    generator. Calls with different generators may run concurrently.
+   */
+  void Transform(const Datum& datum, Blob<Dtype>* transformed_blob,
+                 Caffe::RNG* rng);
+
+  /**
+   * @brief Same as Transform(datum, transformed_blob, rng), with the
+   *    contents of the data field read from data rather than from datum,
+   *    e.g. straight from a memory-mapped database record. See
+   *    ParseDatumWithoutData() in io.hpp.
+   */
+  void Transform(const Datum& datum, const char* data, size_t data_size,
+                 Blob<Dtype>* transformed_blob, Caffe::RNG* rng);
+
   /**
    * @brief Applies the transformation defined in the data layer's
    * transform_param block to a vector of Datum.
@@ -75,6 +95,12 @@ class DataTransformer {
    *    set_cpu_data() is used. See image_data_layer.cpp for an example.
    */
   void Transform(const cv::Mat& cv_img, Blob<Dtype>* transformed_blob);
+  /**
+   * @brief Same as Transform(cv_img, transformed_blob), drawing the random
+   *    crop and mirroring from rng instead of the transformer's own generator.
+   */
+  void Transform(const cv::Mat& cv_img, Blob<Dtype>* transformed_blob,
+                 Caffe::RNG* rng);
 #endif  // USE_OPENCV
 
   /**
@@ -137,8 +163,17 @@ class DataTransformer {
    *    A uniformly random integer value from ({0, 1, ..., n-1}).
    */
   virtual int Rand(int n);
+  int Rand(int n, Caffe::RNG* rng);
+
+  // The mean_value of channel c; a single mean_value applies to all channels.
+  inline Dtype mean_value(int c) const {
+    return mean_values_[mean_values_.size() == 1 ? 0 : c];
+  }
 
-  void Transform(const Datum& datum, Dtype* transformed_data);
+  void Transform(const Datum& datum, const char* data, size_t data_size,
+                 Dtype* transformed_data, Caffe::RNG* rng);
+  void TransformClip(const Datum& datum, const char* data, size_t data_size,
+                     Blob<Dtype>* transformed_blob, Caffe::RNG* rng);
   // Tranformation parameters
   TransformationParameter param_;
 
@@ -0,0 +1,79 @@
+#ifndef CAFFE_INFERENCE_ENGINE_HPP_
+#define CAFFE_INFERENCE_ENGINE_HPP_
+
+#include <string>
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/internal_thread.hpp"
+#include "caffe/net.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+/**
+ * @brief Serves a net to requests coming from any number of threads.
+ *
+ * Requests are run by execution contexts, each a thread with a Net of its
+ * own activations and workspaces, all sharing the params of the first one
+ * (see the weights_net of Net). An idle context takes the oldest request and
+ * batches it with the pending requests of the same item shape, up to
+ * max_batch_size items, waiting for more until max_delay_us microseconds
+ * after the oldest request arrived. A context reshapes its net only when the
+ * shape of its batch changes.
+ */
+template <typename Dtype>
+class InferenceEngine {
+ public:
+  /**
+   * @param param a net with one input blob, taking a batch of items along
+   *        its first axis.
+   * @param trained_filename the weights to copy into the net, if not empty.
+   */
+  InferenceEngine(const NetParameter& param, const string& trained_filename,
+      int num_contexts, int max_batch_size, int max_delay_us);
+  ~InferenceEngine();
+
+  /**
+   * @brief Runs the net on the items of input, along its first axis, and
+   *        returns their part of each output blob of the net.
+   *
+   * Blocks until done. Output blobs whose first axis is not the batch (such
+   * as a loss) are returned whole.
+   */
+  void Infer(const Blob<Dtype>& input,
+      vector<shared_ptr<Blob<Dtype> > >* outputs);
+
+  /// @brief The net holding the params shared by the contexts.
+  inline const Net<Dtype>& net() const { return *weights_net_; }
+  /// @brief The number of batches, and of items in them, run so far.
+  int num_batches() const;
+  int num_items() const;
+
+ protected:
+  /**
+   Move synchronization fields out instead of including boost/thread.hpp
+   to avoid a boost/NVCC issues (#1009, #1010) on OSX.
+   */
+  class sync;
+  struct Request;
+  template <typename T> friend class InferenceContext;
+
+  // Waits for the next batch of requests; false once the engine stops.
+  bool NextBatch(vector<Request*>* batch);
+  // Runs a batch on net and hands the results to its requests.
+  void RunBatch(const vector<Request*>& batch, Net<Dtype>* net);
+
+  const int max_batch_size_;
+  const int max_delay_us_;
+  shared_ptr<Net<Dtype> > weights_net_;
+  vector<shared_ptr<InternalThread> > contexts_;
+  shared_ptr<sync> sync_;
+
+DISABLE_COPY_AND_ASSIGN(InferenceEngine);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_INFERENCE_ENGINE_HPP_
@@ -157,6 +157,9 @@ class Layer {
   vector<shared_ptr<Blob<Dtype> > >& blobs() {
     return blobs_;
   }
+  const vector<shared_ptr<Blob<Dtype> > >& blobs() const {
+    return blobs_;
+  }
 
   /**
    * @brief Returns the layer parameter.
@@ -276,7 +279,7 @@ class Layer {
    * You can safely ignore false values and always compute gradients
    * for all parameters, but possibly with wasteful computation.
    */
-  inline bool param_propagate_down(const int param_id) {
+  inline bool param_propagate_down(const int param_id) const {
     return (param_propagate_down_.size() > param_id) ?
         param_propagate_down_[param_id] : false;
   }
@@ -18,7 +18,8 @@ template <typename Dtype>
 class BaseConvolutionLayer : public Layer<Dtype> {
  public:
   explicit BaseConvolutionLayer(const LayerParameter& param)
-      : Layer<Dtype>(param) {}
+      : Layer<Dtype>(param), folded_(false), fold_relu_(false),
+        fold_negative_slope_(0) {}
   virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
   virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
@@ -28,19 +29,61 @@ class BaseConvolutionLayer : public Layer<Dtype> {
   virtual inline int MinTopBlobs() const { return 1; }
   virtual inline bool EqualNumBottomTopBlobs() const { return true; }
 
+  /// @brief The im2col buffer, or NULL if the layer does not use one. The
+  ///        Net memory planner points it into a workspace shared by layers.
+  virtual Blob<Dtype>* col_buffer() { return is_1x1_ ? NULL : &col_buffer_; }
+
+  /**
+   * @brief Makes Forward_cpu compute scale[c] * conv(x) + shift[c] for every
+   *        output channel c, followed by a ReLU with the given negative slope
+   *        if relu is set.
+   *
+   * The transform is folded into copies of the weights and bias, so it has
+   * to be folded again when the weights change. Net uses it to fold the
+   * inference BatchNorm, Scale and ReLU layers following a convolution.
+   */
+  void FoldAffine(const Dtype* scale, const Dtype* shift, bool relu,
+      Dtype negative_slope);
+  /// @brief Uses the transform folded into other, a layer with the same
+  ///        params, and the memory other keeps the folded weights in.
+  void ShareFoldedAffine(const BaseConvolutionLayer& other);
+
  protected:
   // Helper functions that abstract away the column buffer and gemm arguments.
-  // The last argument in forward_cpu_gemm is so that we can skip the im2col if
-  // we just called weight_cpu_gemm with the same input.
+  // The skip_im2col argument in forward_cpu_gemm is so that we can skip the
+  // im2col if we just called weight_cpu_gemm with the same input. The CPU
+  // helpers use col_buffer_ unless a thread's own col_buffer is passed in.
   void forward_cpu_gemm(const Dtype* input, const Dtype* weights,
-      Dtype* output, bool skip_im2col = false);
+      Dtype* output, bool skip_im2col = false, Dtype* col_buffer = NULL);
+  // Adds the bias, and applies the folded ReLU if any in the same pass.
   void forward_cpu_bias(Dtype* output, const Dtype* bias);
   void backward_cpu_gemm(const Dtype* input, const Dtype* weights,
-      Dtype* output);
+      Dtype* output, Dtype* col_buffer = NULL);
   void weight_cpu_gemm(const Dtype* input, const Dtype* output, Dtype*
-      weights);
+      weights, Dtype* col_buffer = NULL);
   void backward_cpu_bias(Dtype* bias, const Dtype* input);
 
+  // Buffers of the threads of the parallel CPU batch loop, resolved on the
+  // calling thread. Thread 0 uses col_buffer_ (NULL) and accumulates into
+  // param_diff itself; the other threads' gradient accumulators are zeroed.
+  vector<Dtype*> thread_col_buffers();
+  vector<Dtype*> thread_param_diffs(int param_id, Dtype* param_diff);
+  // Adds the gradients accumulated by threads 1.. into param_diffs[0].
+  void reduce_thread_param_diffs(int param_id,
+      const vector<Dtype*>& param_diffs);
+  /// @brief The weights and bias Forward_cpu uses, folded or the layer's own.
+  inline const Dtype* cpu_forward_weight() {
+    return folded_ ? folded_weight_.cpu_data() : this->blobs_[0]->cpu_data();
+  }
+  inline const Dtype* cpu_forward_bias() {
+    return folded_ ? folded_bias_.cpu_data() :
+        bias_term_ ? this->blobs_[1]->cpu_data() : NULL;
+  }
+  /// @brief The first batch item handled by a thread of the batch loop.
+  inline int batch_begin(int thread_id) const {
+    return num_ * thread_id / batch_threads_;
+  }
+
 #ifndef CPU_ONLY
   void forward_gpu_gemm(const Dtype* col_input, const Dtype* weights,
       Dtype* output, bool skip_im2col = false);
@@ -92,6 +135,23 @@ class BaseConvolutionLayer : public Layer<Dtype> {
   bool bias_term_;
   bool is_1x1_;
   bool force_nd_im2col_;
+  /// @brief CPU threads the batch may be split across, and how many are used
+  ///        for the current batch size.
+  int num_threads_;
+  int batch_threads_;
+  /// @brief Whether FoldAffine was called, the ReLU it folded if any, and
+  ///        the folded weights and bias.
+  bool folded_;
+  bool fold_relu_;
+  Dtype fold_negative_slope_;
+  Blob<Dtype> folded_weight_;
+  Blob<Dtype> folded_bias_;
+
+  int conv_out_channels_;
+  int conv_in_channels_;
+  int conv_out_spatial_dim_;
+  int kernel_dim_;
+  int output_offset_;
 
  private:
   // wrap im2col/col2im so we don't have to remember the (long) argument lists
@@ -158,15 +218,13 @@ class BaseConvolutionLayer : public Layer<Dtype> {
 
   int num_kernels_im2col_;
   int num_kernels_col2im_;
-  int conv_out_channels_;
-  int conv_in_channels_;
-  int conv_out_spatial_dim_;
-  int kernel_dim_;
   int col_offset_;
-  int output_offset_;
 
   Blob<Dtype> col_buffer_;
   Blob<Dtype> bias_multiplier_;
+  // Column buffers and parameter gradients of threads 1.. of the batch loop.
+  vector<shared_ptr<Blob<Dtype> > > thread_col_buffers_;
+  vector<vector<shared_ptr<Blob<Dtype> > > > thread_param_diffs_;
 };
 
 }  // namespace caffe
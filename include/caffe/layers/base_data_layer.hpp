@@ -1,6 +1,7 @@
 #ifndef CAFFE_DATA_LAYERS_HPP_
 #define CAFFE_DATA_LAYERS_HPP_
 
+#include <boost/function.hpp>
 #include <vector>
 
 #include "caffe/blob.hpp"
@@ -9,6 +10,7 @@
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
 #include "caffe/util/blocking_queue.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
@@ -46,7 +48,10 @@ class BaseDataLayer : public Layer<Dtype> {
 template <typename Dtype>
 class Batch {
  public:
+  Batch() : read_time_(0), transform_time_(0) {}
   Blob<Dtype> data_, label_;
+  // Milliseconds spent reading and transforming the batch while prefetching.
+  double read_time_, transform_time_;
 };
 
 template <typename Dtype>
@@ -65,16 +70,37 @@ class BasePrefetchingDataLayer :
   virtual void Forward_gpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
 
+  /// @brief Milliseconds the prefetch thread spent reading and transforming
+  ///        the batches forwarded so far.
+  double read_time() const { return read_time_; }
+  double transform_time() const { return transform_time_; }
+
  protected:
   virtual void InternalThreadEntry();
   virtual void load_batch(Batch<Dtype>* batch) = 0;
 
+  /**
+   * @brief Calls task(item_id, rng) for every item of a batch on the
+   *    data_param().decode_threads() threads, and returns once all are done.
+   *
+   * Every item gets its own random generator, seeded in item order from the
+   * calling thread's, so that the transformations of a batch do not depend
+   * on the number of threads.
+   */
+  void ForEachItem(int num_items,
+      const boost::function<void(int, Caffe::RNG*)>& task);
+
   vector<shared_ptr<Batch<Dtype> > > prefetch_;
   BlockingQueue<Batch<Dtype>*> prefetch_free_;
   BlockingQueue<Batch<Dtype>*> prefetch_full_;
   Batch<Dtype>* prefetch_current_;
 
   Blob<Dtype> transformed_data_;
+
+  shared_ptr<ThreadPool> decode_pool_;
+  vector<shared_ptr<Caffe::RNG> > item_rngs_;
+  double read_time_;
+  double transform_time_;
 };
 
 }  // namespace caffe
@@ -10,10 +10,11 @@
 namespace caffe {
 
 /*
- * @brief Reshapes the input Blob into an arbitrary-sized output Blob.
+ * @brief Folds the frames of a N x C x D x H x W clip blob into the batch,
+ *        producing a (N * D) x C x H x W image blob ordered clip by clip.
  *
- * Note: similarly to FlattenLayer, this layer does not change the input values
- * (see FlattenLayer, Blob::ShareData and Blob::ShareDiff).
+ * Unlike ReshapeLayer the values have to be moved: each H x W frame plane is
+ * copied to its place in the output.
  */
 template <typename Dtype>
 class Clip2ImgLayer : public Layer<Dtype> {
@@ -25,7 +26,7 @@ class Clip2ImgLayer : public Layer<Dtype> {
   virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
                        const vector<Blob<Dtype>*>& top);
 
-  virtual inline const char* type() const { return "Reshape"; }
+  virtual inline const char* type() const { return "Clip2Img"; }
   virtual inline int ExactNumBottomBlobs() const { return 1; }
   virtual inline int ExactNumTopBlobs() const { return 1; }
 
@@ -58,8 +58,11 @@ class ConvolutionLayer : public BaseConvolutionLayer<Dtype> {
    *  first group and input channels 3-4 and output channels 5-8 into the second
    *  group.
    *  - bias_term (\b optional, default true). Whether to have a bias.
-   *  - engine: convolution has CAFFE (matrix multiplication) and CUDNN (library
-   *    kernels + stream parallelism) engines.
+   *  - engine: convolution has CAFFE (matrix multiplication), CUDNN (library
+   *    kernels + stream parallelism), DIRECT (im2col-free CPU kernels for
+   *    2-D and 3-D convolution) and INT8 (quantized CPU inference) engines.
+   *  - num_threads (\b optional, default 1). The number of CPU threads the
+   *  batch is split across; 0 uses every hardware thread.
    */
   explicit ConvolutionLayer(const LayerParameter& param)
       : BaseConvolutionLayer<Dtype>(param) {}
@@ -77,6 +80,15 @@ class ConvolutionLayer : public BaseConvolutionLayer<Dtype> {
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
   virtual inline bool reverse_dimensions() { return false; }
   virtual void compute_output_shape();
+
+  // Process the batch items of one thread of the CPU batch loop.
+  void forward_cpu_thread(const Dtype* bottom_data, const Dtype* weight,
+      const Dtype* bias, Dtype* top_data, const vector<Dtype*>* col_buffers,
+      int thread_id);
+  void backward_cpu_thread(const Dtype* top_diff, const Dtype* bottom_data,
+      const Dtype* weight, Dtype* bottom_diff,
+      const vector<Dtype*>* col_buffers, const vector<Dtype*>* weight_diffs,
+      const vector<Dtype*>* bias_diffs, int thread_id);
 };
 
 }  // namespace caffe
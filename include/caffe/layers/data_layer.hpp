@@ -1,6 +1,7 @@
 #ifndef CAFFE_DATA_LAYER_HPP_
 #define CAFFE_DATA_LAYER_HPP_
 
+#include <string>
 #include <vector>
 
 #include "caffe/blob.hpp"
@@ -29,10 +30,18 @@ class DataLayer : public BasePrefetchingDataLayer<Dtype> {
   void Next();
   bool Skip();
   virtual void load_batch(Batch<Dtype>* batch);
+  // Parses and transforms item item_id of the batch being loaded.
+  void load_item(int item_id, Caffe::RNG* rng, Dtype* top_data,
+      Dtype* top_label);
 
   shared_ptr<db::DB> db_;
   shared_ptr<db::Cursor> cursor_;
   uint64_t offset_;
+  // The serialized items of the batch being loaded: views into the database
+  // when the cursor provides them, into copies in values_ otherwise.
+  vector<const char*> item_data_;
+  vector<size_t> item_sizes_;
+  vector<string> values_;
 };
 
 }  // namespace caffe
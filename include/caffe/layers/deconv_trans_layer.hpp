@@ -53,6 +53,10 @@ class DeconvTransLayer : public Layer<Dtype> {
 
   vector<int> stride_;
   int factor_;
+  // The strided copy from the bottom to the top (see caffe_cpu_strided_copy).
+  vector<int> shuffle_shape_;
+  vector<int> bottom_strides_;
+  vector<int> top_strides_;
 };
 
 }  // namespace caffe
@@ -0,0 +1,97 @@
+#ifndef CAFFE_DIRECT_CONV_LAYER_HPP_
+#define CAFFE_DIRECT_CONV_LAYER_HPP_
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/syncedmem.hpp"
+
+#include "caffe/layers/conv_layer.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Direct (im2col-free) CPU implementation of ConvolutionLayer for
+ *        2-D and 3-D inputs. Fallback to ConvolutionLayer for GPU mode and
+ *        for other numbers of spatial axes.
+ *
+ * The CAFFE engine expands every input into a column buffer that is
+ * kernel volume times larger than the input (27x for 3x3x3 kernels) before
+ * calling GEMM; for video clips this buffer traffic dominates the runtime.
+ * The DIRECT engine instead accumulates the convolution straight from the
+ * input into small output tiles. The filters are repacked so that output
+ * channels are innermost, which lets the compiler vectorize the inner loop
+ * over a block of output channels, and the output is walked in small D x H x W
+ * tiles so that the accumulators stay in L1 and the input rows a tile reads
+ * are reused across its rows instead of being reread for each of them. The
+ * column buffer of the base layer is never touched, hence never allocated.
+ */
+template <typename Dtype>
+class DirectConvolutionLayer : public ConvolutionLayer<Dtype> {
+ public:
+  explicit DirectConvolutionLayer(const LayerParameter& param)
+      : ConvolutionLayer<Dtype>(param), packed_version_(-1) {}
+  virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual Blob<Dtype>* col_buffer() {
+    return use_direct_ && Caffe::mode() == Caffe::CPU ? NULL
+        : ConvolutionLayer<Dtype>::col_buffer();
+  }
+
+ protected:
+  virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Backward_cpu(const vector<Blob<Dtype>*>& top,
+      const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
+
+  // Process the batch items of one thread of the CPU batch loop.
+  void forward_direct_thread(const Dtype* bottom_data,
+      const Dtype* packed_weight, const Dtype* bias, Dtype* top_data,
+      int thread_id);
+  void backward_direct_thread(const Dtype* top_diff, const Dtype* bottom_data,
+      const Dtype* packed_weight, Dtype* bottom_diff,
+      const vector<Dtype*>* packed_weight_diffs,
+      const vector<Dtype*>* weight_diffs, const vector<Dtype*>* bias_diffs,
+      int thread_id);
+
+  // Convolve a single batch item.
+  void direct_forward(const Dtype* input, const Dtype* packed_weight,
+      Dtype* output);
+  // Set input_diff and accumulate packed_weight_diff for a single batch item;
+  // either may be NULL.
+  void direct_backward(const Dtype* input, const Dtype* output_diff,
+      const Dtype* packed_weight, Dtype* input_diff, Dtype* packed_weight_diff);
+
+  // Reorder the filters from (out, in, kernel) to (group, in, kernel, out),
+  // out zero-padded to whole channel blocks, and add packed gradients back in
+  // the original layout.
+  void pack_weights(const Dtype* weight, Dtype* packed_weight);
+  // The packed forward weights, repacked only when they are stale.
+  const Dtype* packed_weight();
+  void unpack_add_weights(const Dtype* packed_weight, Dtype* weight);
+
+  /// @brief Whether the current input is handled by the direct kernels.
+  bool use_direct_;
+  /// @brief Geometry of the convolution with 2-D inputs padded to 3-D.
+  int in_dims_[3];
+  int out_dims_[3];
+  int kernel_dims_[3];
+  int stride_dims_[3];
+  int pad_dims_[3];
+  int dilation_dims_[3];
+
+  Blob<Dtype> packed_weight_;
+  /// @brief The memory of the weights last packed and its version then: the
+  ///        packed weights are stale once either changes, as after a solver
+  ///        update, when weights are copied in or shared, or on refolding.
+  shared_ptr<SyncedMemory> packed_memory_;
+  int64_t packed_version_;
+  // Packed weight gradient accumulators of the threads of the batch loop.
+  vector<shared_ptr<Blob<Dtype> > > packed_weight_diffs_;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_DIRECT_CONV_LAYER_HPP_
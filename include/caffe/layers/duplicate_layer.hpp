@@ -37,6 +37,10 @@ class DuplicateLayer : public Layer<Dtype> {
 
  private:
   int duplicates_;
+  // The strided copy from the bottom to the top (see caffe_cpu_strided_copy).
+  vector<int> shuffle_shape_;
+  vector<int> bottom_strides_;
+  vector<int> top_strides_;
 };
 
 }
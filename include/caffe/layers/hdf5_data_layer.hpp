@@ -7,20 +7,43 @@
 #include <vector>
 
 #include "caffe/blob.hpp"
+#include "caffe/internal_thread.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/blocking_queue.hpp"
 
 #include "caffe/layers/base_data_layer.hpp"
 
 namespace caffe {
 
+/**
+ * @brief Consecutive rows of an HDF5 file, read ahead by HDF5DataLayer.
+ */
+template <typename Dtype>
+class HDF5Chunk {
+ public:
+  inline int rows() const { return blobs_[0]->shape(0); }
+  /// @brief The rows of each top's dataset.
+  vector<shared_ptr<Blob<Dtype> > > blobs_;
+  /// @brief The order in which the rows are output, empty for file order.
+  vector<int> order_;
+};
+
 /**
  * @brief Provides data to the Net from HDF5 files.
  *
+ * A background thread streams the files in chunks of
+ * HDF5DataParameter.chunk_size rows, read as one hyperslab per dataset,
+ * and keeps HDF5DataParameter.prefetch chunks ready ahead of Forward. The
+ * memory use is bounded by the chunks rather than by the file size, and the
+ * next file is read while the current one is consumed. Shuffling permutes
+ * the files, the chunks of each file and the rows of each chunk, so reads
+ * stay sequential within a chunk.
+ *
  * TODO(dox): thorough documentation for Forward and proto params.
  */
 template <typename Dtype>
-class HDF5DataLayer : public Layer<Dtype> {
+class HDF5DataLayer : public Layer<Dtype>, public InternalThread {
  public:
   explicit HDF5DataLayer(const LayerParameter& param)
       : Layer<Dtype>(param), offset_() {}
@@ -47,15 +70,21 @@ class HDF5DataLayer : public Layer<Dtype> {
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {}
   virtual void Backward_gpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {}
+  // Copies the rows of a batch into top_data, one pointer per top.
+  void CopyBatch(const vector<Blob<Dtype>*>& top,
+      const vector<Dtype*>& top_data);
+
+  virtual void InternalThreadEntry();
+  // Reads filename chunk by chunk into chunk_full_, on the internal thread.
   virtual void LoadHDF5FileData(const char* filename);
 
   std::vector<std::string> hdf_filenames_;
   unsigned int num_files_;
-  unsigned int current_file_;
+  vector<shared_ptr<HDF5Chunk<Dtype> > > chunks_;
+  BlockingQueue<HDF5Chunk<Dtype>*> chunk_free_;
+  BlockingQueue<HDF5Chunk<Dtype>*> chunk_full_;
+  HDF5Chunk<Dtype>* current_chunk_;
   hsize_t current_row_;
-  std::vector<shared_ptr<Blob<Dtype> > > hdf_blobs_;
-  std::vector<unsigned int> data_permutation_;
-  std::vector<unsigned int> file_permutation_;
   uint64_t offset_;
 };
 
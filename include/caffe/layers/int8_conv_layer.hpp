@@ -0,0 +1,85 @@
+#ifndef CAFFE_INT8_CONV_LAYER_HPP_
+#define CAFFE_INT8_CONV_LAYER_HPP_
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/syncedmem.hpp"
+
+#include "caffe/layers/conv_layer.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Post-training quantized CPU inference for ConvolutionLayer, using
+ *        int8 GEMM with int32 accumulation. Fallback to ConvolutionLayer for
+ *        GPU mode; there is no backward pass.
+ *
+ * The filters are quantized by output channel from the weights the layer
+ * forwards with (folded ones included): at the first forward pass, and again
+ * when those are other weights (shared ones, say); changes made to them in
+ * place after that are not seen. Every input is quantized with the input
+ * range of the quantization_param recorded by tools/calibrate_int8, or with
+ * the range of the bottom if there is none, into a padded copy that the
+ * column buffer is gathered from, so that im2col moves bytes. The int32 sums
+ * are requantized to Dtype by output channel before the bias (and folded
+ * ReLU) are added.
+ */
+template <typename Dtype>
+class Int8ConvolutionLayer : public ConvolutionLayer<Dtype> {
+ public:
+  explicit Int8ConvolutionLayer(const LayerParameter& param)
+      : ConvolutionLayer<Dtype>(param), quantized_version_(-1) {}
+  virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+
+ protected:
+  virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Backward_cpu(const vector<Blob<Dtype>*>& top,
+      const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
+
+  // Process the batch items of one thread of the CPU batch loop.
+  void forward_int8_thread(const Dtype* bottom_data, const Dtype* bias,
+      Dtype input_scale, Dtype* top_data, int thread_id);
+  // Quantizes one input to the padded input of thread_id.
+  void quantize_input(const Dtype* input, Dtype input_scale, int thread_id);
+
+  // Quantizes the forward weights, if they changed since the last time.
+  void quantize_weights();
+
+  /// @brief The memory of the weights last quantized and its version then:
+  ///        the quantized weights are stale once either changes, as when
+  ///        trained weights are copied in or shared, or the layer refolded.
+  shared_ptr<SyncedMemory> quantized_memory_;
+  int64_t quantized_version_;
+  /// @brief The quantized filters, their sums and the value of their units.
+  shared_ptr<SyncedMemory> int8_weight_;
+  shared_ptr<SyncedMemory> int8_weight_sums_;
+  Blob<Dtype> weight_scales_;
+  /// @brief The scales of the output channels for the current input range.
+  Blob<Dtype> output_scales_;
+  /// @brief The quantized inputs, padded along the spatial axes, and column
+  ///        buffers of the threads of the batch loop.
+  vector<shared_ptr<SyncedMemory> > int8_inputs_;
+  vector<shared_ptr<SyncedMemory> > int8_cols_;
+  /// @brief The quantized inputs of the threads before padding, if any.
+  vector<shared_ptr<SyncedMemory> > int8_unpadded_inputs_;
+  /// @brief The size of a padded input and of the channels of a group.
+  int padded_input_dim_;
+  int padded_group_dim_;
+  /// @brief The offsets in the padded input of the rows of the input, of the
+  ///        first value of the window of each output, and of each value of
+  ///        a window from the first.
+  vector<int> input_row_offsets_;
+  vector<int> output_offsets_;
+  vector<int> kernel_offsets_;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_INT8_CONV_LAYER_HPP_
@@ -0,0 +1,60 @@
+#ifndef CAFFE_INT8_INNER_PRODUCT_LAYER_HPP_
+#define CAFFE_INT8_INNER_PRODUCT_LAYER_HPP_
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/syncedmem.hpp"
+
+#include "caffe/layers/inner_product_layer.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Post-training quantized CPU inference for InnerProductLayer, using
+ *        int8 GEMM with int32 accumulation. Fallback to InnerProductLayer for
+ *        GPU mode; there is no backward pass.
+ *
+ * The weights are quantized by output at the first forward pass, and again
+ * when the layer forwards with other weights (shared ones, say); changes made
+ * to them in place after that are not seen. The bottom is quantized with the
+ * input range of the quantization_param recorded by tools/calibrate_int8, or
+ * with its own range if there is none, and the int32 sums are requantized to
+ * Dtype by output before the bias is added.
+ */
+template <typename Dtype>
+class Int8InnerProductLayer : public InnerProductLayer<Dtype> {
+ public:
+  explicit Int8InnerProductLayer(const LayerParameter& param)
+      : InnerProductLayer<Dtype>(param), quantized_version_(-1) {}
+  virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+
+ protected:
+  virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Backward_cpu(const vector<Blob<Dtype>*>& top,
+      const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
+
+  /// @brief The memory of the weights last quantized and its version then:
+  ///        the quantized weights are stale once either changes, as when
+  ///        trained weights are copied in or shared, or the layer refolded.
+  shared_ptr<SyncedMemory> quantized_memory_;
+  int64_t quantized_version_;
+  /// @brief The quantized weights, their sums and the value of their units.
+  shared_ptr<SyncedMemory> int8_weight_;
+  shared_ptr<SyncedMemory> int8_weight_sums_;
+  Blob<Dtype> weight_scales_;
+  /// @brief The scales of the outputs for the current input range.
+  Blob<Dtype> output_scales_;
+  /// @brief The quantized bottom.
+  shared_ptr<SyncedMemory> int8_bottom_;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_INT8_INNER_PRODUCT_LAYER_HPP_
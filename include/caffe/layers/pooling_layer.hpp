@@ -44,6 +44,18 @@ class PoolingLayer : public Layer<Dtype> {
   virtual void Backward_gpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
 
+  // CPU pooling over one or three (D x H x W) spatial axes; the 2D case is
+  // handled directly in Forward_cpu/Backward_cpu.
+  void forward_cpu_nd(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  void backward_cpu_nd(const vector<Blob<Dtype>*>& top,
+      const vector<Blob<Dtype>*>& bottom);
+  template <typename MaskType>
+  void max_pool_volume_cpu(const Dtype* bottom_data, Dtype* top_data,
+      MaskType* mask);
+  void ave_pool_volume_cpu(const Dtype* bottom_data, Dtype* top_data);
+  void setup_nd_windows();
+
   std::vector<int> kernel_shape_;
   std::vector<int> stride_;
   std::vector<int> pad_;
@@ -55,6 +67,18 @@ class PoolingLayer : public Layer<Dtype> {
   bool global_pooling_;
   Blob<Dtype> rand_idx_;
   Blob<int> max_idx_;
+
+  /// @brief Spatial input/pooled shapes padded to three axes (D x H x W).
+  int nd_input_shape_[3];
+  int nd_pooled_shape_[3];
+  /// @brief Clipped window [start, end) of every pooled position, and its
+  ///        size including padding (for AVE), for each of the three axes.
+  std::vector<int> window_start_[3];
+  std::vector<int> window_end_[3];
+  std::vector<int> window_size_[3];
+  /// @brief Pooled positions along W whose window lies inside the input.
+  int interior_begin_;
+  int interior_end_;
 };
 
 }  // namespace caffe
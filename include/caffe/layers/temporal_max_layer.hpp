@@ -9,6 +9,13 @@
 
 namespace caffe {
 
+/**
+ * @brief Takes the maximum of a 5-D clip blob over its first (batch/time)
+ *        axis, producing a 1 x (C * D * H * W) blob.
+ *
+ * The index of the winning item is kept per output for the backward pass,
+ * which routes the gradient to it and zeroes every other input.
+ */
 template <typename Dtype>
 class TemporalMaxLayer : public Layer<Dtype> {
  public:
@@ -34,6 +41,14 @@ class TemporalMaxLayer : public Layer<Dtype> {
   virtual void Backward_gpu(const vector<Blob<Dtype>*>& top,
                             const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
 
+  // Process the outputs [begin, end) on one thread of the CPU loops.
+  void forward_cpu_range(const Dtype* bottom_data, Dtype* top_data,
+                         int* max_idx, int begin, int end);
+  void backward_cpu_range(const Dtype* top_diff, const int* max_idx,
+                          Dtype* bottom_diff, int begin, int end);
+
+  /// @brief Number of items the maximum is taken over.
+  int num_;
   Blob<int> max_idx_;
 };
 
@@ -32,6 +32,11 @@ class Transform2DLayer : public Layer<Dtype> {
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
   virtual void Backward_gpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
+
+  // The strided copy from the bottom to the top (see caffe_cpu_strided_copy).
+  vector<int> shuffle_shape_;
+  vector<int> bottom_strides_;
+  vector<int> top_strides_;
 };
 
 }  // namespace caffe
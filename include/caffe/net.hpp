@@ -11,9 +11,13 @@
 #include "caffe/common.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/syncedmem.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
+template <typename Dtype> class BaseConvolutionLayer;
+
 /**
  * @brief Connects Layer%s together into a directed acyclic graph (DAG)
  *        specified by a NetParameter.
@@ -23,9 +27,18 @@ namespace caffe {
 template <typename Dtype>
 class Net {
  public:
-  explicit Net(const NetParameter& param);
+  /**
+   * Given weights_net, the layers of the net use the param blobs of the
+   * layers of weights_net with the same names instead of allocating their
+   * own, so that any number of nets, each with its own activations, share
+   * one copy of the params. The params are then read-only: they are neither
+   * updated nor given gradients, and new weights are copied into
+   * weights_net, which must outlive the net.
+   */
+  explicit Net(const NetParameter& param, const Net* weights_net = NULL);
   explicit Net(const string& param_file, Phase phase,
-      const int level = 0, const vector<string>* stages = NULL);
+      const int level = 0, const vector<string>* stages = NULL,
+      const Net* weights_net = NULL);
   virtual ~Net() {}
 
   /// @brief Initialize a network with a NetParameter.
@@ -114,6 +127,21 @@ class Net {
   void CopyTrainedLayersFrom(const string trained_filename);
   void CopyTrainedLayersFromBinaryProto(const string trained_filename);
   void CopyTrainedLayersFromHDF5(const string trained_filename);
+  /**
+   * @brief Copies the pre-trained layers from a mapped weights file (see
+   *        MappedWeights) without reading it: the params of the net's type
+   *        point into the mapping, which their memory keeps alive, also for
+   *        the nets sharing them.
+   */
+  void CopyTrainedLayersFromMapped(const string trained_filename);
+  /**
+   * @brief Folds the current weights of the fold_batch_norm layers into the
+   *        convolutions they follow.
+   *
+   * Called by Init and after copying or sharing trained layers; call it
+   * again after changing those weights in any other way.
+   */
+  void FoldBatchNorm();
   /// @brief Writes the net to a proto.
   void ToProto(NetParameter* param, bool write_diff = false) const;
   /// @brief Writes the net to an HDF5 file.
@@ -170,6 +198,9 @@ class Net {
   inline const vector<bool>& layer_need_backward() const {
     return layer_need_backward_;
   }
+  /// @brief returns whether each layer is folded into a convolution, and
+  ///        skipped by the forward pass
+  inline const vector<bool>& layer_folded() const { return layer_folded_; }
   /// @brief returns the parameters
   inline const vector<shared_ptr<Blob<Dtype> > >& params() const {
     return params_;
@@ -216,6 +247,16 @@ class Net {
 
   void set_debug_info(const bool value) { debug_info_ = value; }
 
+  /**
+   * @brief The parallelism achieved by the branch threads in the last forward
+   *        and backward pass: the summed run time of the layers over the
+   *        elapsed time of the passes. 0 if the net runs serially.
+   */
+  inline double branch_parallelism() const {
+    const double elapsed = forward_elapsed_ + backward_elapsed_;
+    return elapsed ? (forward_busy_ + backward_busy_) / elapsed : 0;
+  }
+
   // Helpers for Init.
   /**
    * @brief Remove layers that the user specified should be excluded given the current
@@ -266,6 +307,49 @@ class Net {
   void AppendParam(const NetParameter& param, const int layer_id,
                    const int param_id);
 
+  /**
+   * @brief Pack the activations of an inference net into one arena.
+   *
+   * Blobs whose lifetimes (from the layer producing them to the last layer
+   * reading them) do not overlap are given overlapping memory, and all
+   * convolution layers share one im2col workspace. Only the net outputs
+   * keep their values after Forward; intermediate blobs may be overwritten.
+   */
+  void PlanMemory();
+
+  /**
+   * @brief Find the BatchNorm, Scale and ReLU layers fold_batch_norm folds:
+   *        a chain of them reading the top of a convolution, whose
+   *        intermediate tops nothing else reads. The convolution writes the
+   *        top of the chain instead.
+   */
+  void FindFoldBlocks();
+  /// @brief The convolution of weights_net folded like the block, if any.
+  const BaseConvolutionLayer<Dtype>* SharedFold(const vector<int>& block)
+      const;
+
+  /**
+   * @brief Find the layers each layer has to run after: the last layer
+   *        writing the memory of one of its bottoms or tops, the layers
+   *        reading the memory of one of its tops since then, and the last
+   *        layer using one of its (shared) params.
+   */
+  void FindLayerDependencies();
+  /**
+   * @brief Group layers [first, last] into waves of layers that do not
+   *        depend on each other, each running after the previous one. The
+   *        backward waves run the dependencies in reverse.
+   */
+  void GroupWaves(int first, int last, bool backward,
+      vector<vector<int> >* waves) const;
+  /// @brief The branch_threads versions of ForwardFromTo and BackwardFromTo.
+  Dtype ForwardWaves(int start, int end);
+  void BackwardWaves(int start, int end);
+  /// @brief Runs the layers of a wave concurrently on the branch threads.
+  void RunWave(const vector<int>& wave, bool forward);
+  void RunBranchTask(const vector<int>* wave, bool forward, int k);
+  void RunLayer(int layer_id, bool forward);
+
   /// @brief Helper for displaying debug info in Forward.
   void ForwardDebugInfo(const int layer_id);
   /// @brief Helper for displaying debug info in Backward.
@@ -330,6 +414,33 @@ class Net {
   size_t memory_used_;
   /// Whether to compute and display debug info for the net.
   bool debug_info_;
+  /// Whether PlanMemory packs the activations, and the memory it packs into.
+  bool optimize_memory_;
+  shared_ptr<SyncedMemory> activation_arena_;
+  shared_ptr<SyncedMemory> conv_workspace_;
+  /// The convolutions followed by the layers folded into them, and whether
+  /// each layer is folded into another and skipped.
+  vector<vector<int> > fold_blocks_;
+  vector<bool> layer_folded_;
+  /// The net whose params the net uses, if any.
+  const Net* weights_net_;
+  /// The threads running independent layers concurrently (branch_threads),
+  /// and the layers each layer depends on.
+  shared_ptr<ThreadPool> branch_pool_;
+  vector<vector<int> > layer_dependencies_;
+  /// The loss and run time (in microseconds) of each layer in the last pass,
+  /// and the seeds of the RNGs of the layers of the running wave.
+  vector<Dtype> layer_losses_;
+  vector<double> layer_times_;
+  vector<unsigned int> wave_seeds_;
+  /// The Caffe state of the thread running the net, given to the tasks.
+  int branch_solver_count_;
+  int branch_solver_rank_;
+  bool branch_multiprocess_;
+  /// Summed layer run time and elapsed time of the last forward and backward
+  /// pass on the branch threads.
+  double forward_busy_, forward_elapsed_;
+  double backward_busy_, backward_elapsed_;
   // Callbacks
   vector<Callback*> before_forward_;
   vector<Callback*> after_forward_;
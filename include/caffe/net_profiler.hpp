@@ -0,0 +1,130 @@
+#ifndef CAFFE_NET_PROFILER_HPP_
+#define CAFFE_NET_PROFILER_HPP_
+
+#include <stdint.h>
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include <string>
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/net.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Records the forward and backward passes of the layers of nets
+ *        through their callbacks, in training and serving alike: wall time,
+ *        bytes of the blobs read and written, estimated FLOPs and the
+ *        SyncedMemory allocations made.
+ *
+ * The counters of every layer are summed over the passes, and the first
+ * max_trace_events passes are also kept as the events of a Chrome trace
+ * (chrome://tracing, ui.perfetto.dev), one process per net. In GPU mode each
+ * pass is synchronized with the device. The layers of a wave of branches
+ * (see NetParameter.branch_threads) run together, so they share its span and
+ * allocations.
+ *
+ * The bytes are those of the blobs a pass goes through once: forward, the
+ * bottoms, params and tops; backward, the top data and diffs, the bottoms
+ * and params, and the diffs it computes. The FLOPs are those of the
+ * products of the Convolution, Deconvolution and InnerProduct layers, of any
+ * number of spatial axes, twice as many backward, none for the data layers
+ * and one per value for the others.
+ */
+template <typename Dtype>
+class NetProfiler {
+ public:
+  /// @brief The counters of a layer in one direction, summed over passes.
+  struct Counters {
+    Counters() : passes(0), microseconds(0), bytes_read(0), bytes_written(0),
+        flops(0), allocations(0), allocated_bytes(0) {}
+    void Add(const Counters& other);
+
+    int passes;
+    double microseconds;
+    double bytes_read;
+    double bytes_written;
+    double flops;
+    int64_t allocations;
+    int64_t allocated_bytes;
+  };
+
+  explicit NetProfiler(int max_trace_events = 100000);
+
+  /**
+   * @brief Records the passes of the layers of net, under name in the
+   *        summary and the trace. Nets cannot drop their callbacks: the
+   *        profiler must outlive the passes of net.
+   */
+  void Attach(Net<Dtype>* net, const string& name);
+
+  int num_nets() const { return nets_.size(); }
+  const Counters& forward(int net, int layer) const {
+    return nets_[net].forward[layer];
+  }
+  const Counters& backward(int net, int layer) const {
+    return nets_[net].backward[layer];
+  }
+
+  /// @brief Logs a table of the counters of the layers, per pass.
+  void LogSummary() const;
+  /// @brief Writes the passes recorded as a Chrome trace in JSON.
+  void WriteTrace(const string& filename) const;
+
+  /// @brief The FLOPs of a forward pass of layer.
+  static double ForwardFlops(const Layer<Dtype>& layer,
+      const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top);
+
+ private:
+  class Hook : public Net<Dtype>::Callback {
+   public:
+    Hook(NetProfiler* profiler, int net, bool backward, bool end)
+        : profiler_(profiler), net_(net), backward_(backward), end_(end) {}
+
+   protected:
+    virtual void run(int layer);
+
+    NetProfiler* profiler_;
+    int net_;
+    bool backward_;
+    bool end_;
+  };
+
+  struct NetRecord {
+    Net<Dtype>* net;
+    string name;
+    vector<Counters> forward;
+    vector<Counters> backward;
+    // The start of the current pass of each layer.
+    vector<double> begin_microseconds;
+    vector<int64_t> begin_allocations;
+    vector<int64_t> begin_allocated_bytes;
+  };
+
+  struct TraceEvent {
+    int net;
+    int layer;
+    bool backward;
+    double begin_microseconds;
+    Counters counters;
+  };
+
+  void Begin(int net, int layer);
+  void End(int net, int layer, bool backward);
+  // Microseconds since the profiler was made, once the device is done.
+  double Now() const;
+
+  int max_trace_events_;
+  boost::posix_time::ptime start_;
+  vector<NetRecord> nets_;
+  vector<shared_ptr<Hook> > hooks_;
+  vector<TraceEvent> events_;
+
+  DISABLE_COPY_AND_ASSIGN(NetProfiler);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_NET_PROFILER_HPP_
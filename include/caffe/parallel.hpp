@@ -2,8 +2,8 @@
 #define CAFFE_PARALLEL_HPP_
 
 #ifdef USE_NCCL
-
 #include <boost/thread.hpp>
+#endif
 
 #include <string>
 #include <vector>
@@ -16,7 +16,9 @@
 #include "caffe/solver.hpp"
 #include "caffe/syncedmem.hpp"
 #include "caffe/util/blocking_queue.hpp"
+#ifdef USE_NCCL
 #include "caffe/util/nccl.hpp"
+#endif
 
 namespace caffe {
 
@@ -48,6 +50,81 @@ class Params {
 DISABLE_COPY_AND_ASSIGN(Params);
 };
 
+// Params stored in host memory.
+template<typename Dtype>
+class CPUParams : public Params<Dtype> {
+ public:
+  explicit CPUParams(shared_ptr<Solver<Dtype> > root_solver);
+  virtual ~CPUParams();
+
+  void Configure(Solver<Dtype>* solver) const;
+
+ protected:
+  using Params<Dtype>::size_;
+  using Params<Dtype>::data_;
+  using Params<Dtype>::diff_;
+};
+
+/**
+ * @brief Data-parallel training on the cores of one machine.
+ *
+ * Each thread runs a Solver replica on its own share of the data, so the
+ * effective batch size is multiplied by the number of threads. Gradients of
+ * a replica live in one contiguous buffer and are averaged across replicas
+ * before every update: each thread sums and broadcasts its 1/N-th slice of
+ * the buffer (reduce-scatter then all-gather). With layer_wise_reduce, the
+ * last replica to finish the backward pass of a layer averages that layer's
+ * gradients while the others move on to the layers below.
+ *
+ * Replicas call into BLAS concurrently; the BLAS library itself should then
+ * be limited to one thread (e.g. OPENBLAS_NUM_THREADS=1).
+ */
+template<typename Dtype>
+class CPUParallel : public CPUParams<Dtype>,
+                    public Solver<Dtype>::Callback,
+                    public Net<Dtype>::Callback {
+ public:
+  explicit CPUParallel(shared_ptr<Solver<Dtype> > solver);
+  ~CPUParallel();
+
+  /**
+   * Trains solver on num_threads threads, restoring the replicas from the
+   * restore solver state if not NULL.
+   */
+  void Run(int num_threads, const char* restore);
+
+ protected:
+  /**
+   State shared by the replicas of one Run(), defined in parallel.cpp to
+   keep boost/thread.hpp out of this header.
+   */
+  class Group;
+  template <typename T> friend class CPUWorker;
+
+  // Adds this replica to group, as Caffe::solver_rank().
+  void Join(Group* group);
+  // Copies the weights of rank 0 to every replica.
+  void Broadcast();
+  // Averages diff_[offset, offset + count) across the replicas.
+  void AllReduce(size_t offset, size_t count);
+  void on_start() {}
+  void run(int layer);  // Net callback
+  void on_gradients_ready();
+
+  shared_ptr<Solver<Dtype> > solver_;
+  Group* group_;
+  // Whether gradients are reduced layer by layer during the backward pass.
+  bool layer_wise_;
+  // Offset and size of the gradients of each layer in diff_.
+  vector<size_t> layer_offsets_;
+  vector<size_t> layer_sizes_;
+  using Params<Dtype>::size_;
+  using Params<Dtype>::data_;
+  using Params<Dtype>::diff_;
+};
+
+#ifdef USE_NCCL
+
 // Params stored in GPU memory.
 template<typename Dtype>
 class GPUParams : public Params<Dtype> {
@@ -117,7 +194,8 @@ class NCCL : public GPUParams<Dtype>,
   using Params<Dtype>::diff_;
 };
 
+#endif  // USE_NCCL
+
 }  // namespace caffe
 
-#endif  // USE_NCCL
 #endif  // header
@@ -36,11 +36,45 @@ class SGDSolver : public Solver<Dtype> {
   virtual void SnapshotSolverStateToHDF5(const string& model_filename);
   virtual void RestoreSolverStateFromHDF5(const string& state_file);
   virtual void RestoreSolverStateFromBinaryProto(const string& state_file);
+
+  // Everything the fused update needs to know about one learnable param.
+  struct FusedParam {
+    Dtype* data;
+    Dtype* diff;
+    // The param's entries of history_, up to two per param.
+    Dtype* history[2];
+    Dtype rate;
+    Dtype normalization;
+    Dtype l1_decay;
+    Dtype l2_decay;
+  };
+  // Applies the update of every learnable param in one multi-threaded sweep
+  // (solver_param.fused_update), moving the params, their gradients and the
+  // history into contiguous buffers the first time.
+  void ApplyFusedUpdate(Dtype rate);
+  void FusedPreSolve();
+  void FusedUpdateRange(int begin, int end);
+  // Updates elements [begin, end) of a param as Normalize, Regularize,
+  // ComputeUpdateValue and Blob::Update do in turn, leaving the update value
+  // in the diff. Overridden by every solver with its own update rule.
+  virtual void ComputeFusedUpdate(const FusedParam& param, int begin, int end);
+  // The normalized and regularized gradient of element i of param.
+  inline Dtype FusedGradient(const FusedParam& param, int i) const {
+    const Dtype w = param.data[i];
+    return param.normalization * param.diff[i] + param.l2_decay * w +
+        param.l1_decay * ((Dtype(0) < w) - (w < Dtype(0)));
+  }
+
   // history maintains the historical momentum data.
   // update maintains update related data and is not needed in snapshots.
   // temp maintains other information that might be needed in computation
   //   of gradients/updates and is not needed in snapshots
   vector<shared_ptr<Blob<Dtype> > > history_, update_, temp_;
+  // Contiguous storage of the fused update and the offset of every param in
+  // it; history entry k of param i starts at k * count + offset[i].
+  Blob<Dtype> fused_data_, fused_diff_, fused_history_;
+  vector<int> fused_offsets_;
+  vector<FusedParam> fused_params_;
 
   DISABLE_COPY_AND_ASSIGN(SGDSolver);
 };
@@ -56,6 +90,8 @@ class NesterovSolver : public SGDSolver<Dtype> {
 
  protected:
   virtual void ComputeUpdateValue(int param_id, Dtype rate);
+  virtual void ComputeFusedUpdate(
+      const typename SGDSolver<Dtype>::FusedParam& param, int begin, int end);
 
   DISABLE_COPY_AND_ASSIGN(NesterovSolver);
 };
@@ -71,6 +107,8 @@ class AdaGradSolver : public SGDSolver<Dtype> {
 
  protected:
   virtual void ComputeUpdateValue(int param_id, Dtype rate);
+  virtual void ComputeFusedUpdate(
+      const typename SGDSolver<Dtype>::FusedParam& param, int begin, int end);
   void constructor_sanity_check() {
     CHECK_EQ(0, this->param_.momentum())
         << "Momentum cannot be used with AdaGrad.";
@@ -91,6 +129,8 @@ class RMSPropSolver : public SGDSolver<Dtype> {
 
  protected:
   virtual void ComputeUpdateValue(int param_id, Dtype rate);
+  virtual void ComputeFusedUpdate(
+      const typename SGDSolver<Dtype>::FusedParam& param, int begin, int end);
   void constructor_sanity_check() {
     CHECK_EQ(0, this->param_.momentum())
         << "Momentum cannot be used with RMSProp.";
@@ -115,6 +155,8 @@ class AdaDeltaSolver : public SGDSolver<Dtype> {
  protected:
   void AdaDeltaPreSolve();
   virtual void ComputeUpdateValue(int param_id, Dtype rate);
+  virtual void ComputeFusedUpdate(
+      const typename SGDSolver<Dtype>::FusedParam& param, int begin, int end);
 
   DISABLE_COPY_AND_ASSIGN(AdaDeltaSolver);
 };
@@ -139,6 +181,8 @@ class AdamSolver : public SGDSolver<Dtype> {
  protected:
   void AdamPreSolve();
   virtual void ComputeUpdateValue(int param_id, Dtype rate);
+  virtual void ComputeFusedUpdate(
+      const typename SGDSolver<Dtype>::FusedParam& param, int begin, int end);
 
   DISABLE_COPY_AND_ASSIGN(AdamSolver);
 };
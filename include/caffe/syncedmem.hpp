@@ -1,6 +1,8 @@
 #ifndef CAFFE_SYNCEDMEM_HPP_
 #define CAFFE_SYNCEDMEM_HPP_
 
+#include <stdint.h>
+
 #include <cstdlib>
 
 #ifdef USE_MKL
@@ -61,6 +63,9 @@ class SyncedMemory {
   ~SyncedMemory();
   const void* cpu_data();
   void set_cpu_data(void* data);
+  /// @brief Points at data that owner keeps alive, as long as the memory
+  ///        uses it.
+  void set_cpu_data(void* data, const shared_ptr<void>& owner);
   const void* gpu_data();
   void set_gpu_data(void* data);
   void* mutable_cpu_data();
@@ -68,6 +73,14 @@ class SyncedMemory {
   enum SyncedHead { UNINITIALIZED, HEAD_AT_CPU, HEAD_AT_GPU, SYNCED };
   SyncedHead head() { return head_; }
   size_t size() { return size_; }
+  /// @brief Counts the calls that may have changed the data: mutable_*_data
+  ///        and set_*_data. Caches of values derived from the data compare
+  ///        it to find them stale.
+  int64_t version() const { return version_; }
+
+  /// @brief The number and bytes of the host and device allocations made by
+  ///        all SyncedMemory so far, for profiling.
+  static void allocations(int64_t* count, int64_t* bytes);
 
 #ifndef CPU_ONLY
   void async_gpu_push(const cudaStream_t& stream);
@@ -83,9 +96,11 @@ class SyncedMemory {
   size_t size_;
   SyncedHead head_;
   bool own_cpu_data_;
+  shared_ptr<void> cpu_data_owner_;
   bool cpu_malloc_use_cuda_;
   bool own_gpu_data_;
   int device_;
+  int64_t version_;
 
   DISABLE_COPY_AND_ASSIGN(SyncedMemory);
 };  // class SyncedMemory
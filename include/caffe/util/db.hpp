@@ -18,6 +18,13 @@ class Cursor {
   virtual void Next() = 0;
   virtual string key() = 0;
   virtual string value() = 0;
+  /**
+   * @brief Points data and size at the current value without copying it.
+   *    The view stays valid until the cursor is destroyed, even after the
+   *    cursor moves. Backends that cannot provide such a view return false,
+   *    and value() has to be used instead.
+   */
+  virtual bool value_view(const char** data, size_t* size) { return false; }
   virtual bool valid() = 0;
 
   DISABLE_COPY_AND_ASSIGN(Cursor);
@@ -34,6 +34,13 @@ class LMDBCursor : public Cursor {
     return string(static_cast<const char*>(mdb_value_.mv_data),
         mdb_value_.mv_size);
   }
+  // The pages of the read-only transaction of the cursor stay mapped until
+  // the transaction ends with the cursor.
+  virtual bool value_view(const char** data, size_t* size) {
+    *data = static_cast<const char*>(mdb_value_.mv_data);
+    *size = mdb_value_.mv_size;
+    return true;
+  }
   virtual bool valid() { return valid_; }
 
  private:
@@ -126,6 +126,14 @@ inline bool ReadImageToDatum(const string& filename, const int label,
   return ReadImageToDatum(filename, label, 0, 0, true, encoding, datum);
 }
 
+/**
+ * @brief Parses a serialized Datum, except for the contents of its data
+ *    field which are not copied: data and data_size are pointed at them
+ *    within serialized instead (NULL and 0 if there are none).
+ */
+bool ParseDatumWithoutData(const char* serialized, size_t size,
+    Datum* datum, const char** data, size_t* data_size);
+
 bool DecodeDatumNative(Datum* datum);
 bool DecodeDatum(Datum* datum, bool is_color);
 
@@ -141,9 +149,15 @@ cv::Mat ReadImageToCVMat(const string& filename,
 
 cv::Mat ReadImageToCVMat(const string& filename);
 
+cv::Mat DecodeBufferToCVMatNative(const char* data, size_t size);
+cv::Mat DecodeBufferToCVMat(const char* data, size_t size, bool is_color);
+
 cv::Mat DecodeDatumToCVMatNative(const Datum& datum);
 cv::Mat DecodeDatumToCVMat(const Datum& datum, bool is_color);
 
+cv::Mat DecodeDatumFrameToCVMatNative(const Datum& datum, int frame);
+cv::Mat DecodeDatumFrameToCVMat(const Datum& datum, int frame, bool is_color);
+
 void CVMatToDatum(const cv::Mat& cv_img, Datum* datum);
 #endif  // USE_OPENCV
 
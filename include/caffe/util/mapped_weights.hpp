@@ -0,0 +1,97 @@
+#ifndef CAFFE_UTIL_MAPPED_WEIGHTS_HPP_
+#define CAFFE_UTIL_MAPPED_WEIGHTS_HPP_
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+/**
+ * The mapped weights format stores the params of a net as raw arrays that
+ * can be used in place once the file is mapped into memory: a header, the
+ * arrays, each starting at a multiple of kMappedWeightsAlignment bytes, and
+ * an index naming them. Numbers are stored in the byte order of the host
+ * writing the file.
+ */
+const size_t kMappedWeightsAlignment = 64;
+
+/// @brief A param stored in a mapped weights file.
+struct MappedTensor {
+  string layer_name;
+  int param_id;
+  bool is_double;
+  vector<int> shape;
+  /// The values, within the mapping.
+  const void* data;
+
+  inline int count() const {
+    int count = 1;
+    for (int i = 0; i < shape.size(); ++i) { count *= shape[i]; }
+    return count;
+  }
+};
+
+/**
+ * @brief Maps a mapped weights file into memory, privately: writes to the
+ *        arrays are not carried to the file, nor seen by other processes.
+ *
+ * The pages are only read from the file when they are first used, and the
+ * processes mapping the same file share them until they write to them.
+ */
+class MappedWeights {
+ public:
+  explicit MappedWeights(const string& filename);
+  ~MappedWeights();
+
+  inline const vector<MappedTensor>& tensors() const { return tensors_; }
+
+  /// @brief Whether filename starts like a mapped weights file.
+  static bool IsMappedWeightsFile(const string& filename);
+
+ protected:
+  void* map_;
+  size_t size_;
+  vector<MappedTensor> tensors_;
+
+DISABLE_COPY_AND_ASSIGN(MappedWeights);
+};
+
+/// @brief Writes a mapped weights file one param at a time.
+class MappedWeightsWriter {
+ public:
+  explicit MappedWeightsWriter(const string& filename);
+  ~MappedWeightsWriter();
+
+  void Add(const string& layer_name, int param_id, const vector<int>& shape,
+      const float* data);
+  void Add(const string& layer_name, int param_id, const vector<int>& shape,
+      const double* data);
+  template <typename Dtype>
+  void Add(const string& layer_name, int param_id, const Blob<Dtype>& blob) {
+    Add(layer_name, param_id, blob.shape(), blob.cpu_data());
+  }
+  /// @brief Writes the index and the header; called by the destructor.
+  void Close();
+
+ protected:
+  void AddTensor(const string& layer_name, int param_id,
+      const vector<int>& shape, bool is_double, const void* data,
+      size_t size);
+  void Write(const void* data, size_t size);
+
+  string filename_;
+  FILE* file_;
+  size_t offset_;
+  int num_tensors_;
+  string index_;
+
+DISABLE_COPY_AND_ASSIGN(MappedWeightsWriter);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_MAPPED_WEIGHTS_HPP_
@@ -145,6 +145,24 @@ DEFINE_CAFFE_CPU_UNARY_FUNC(fabs, y[i] = std::fabs(x[i]))
 template <typename Dtype>
 void caffe_cpu_scale(const int n, const Dtype alpha, const Dtype *x, Dtype* y);
 
+// Copies the N-D array of the given shape, read from src with src_strides,
+// to dst with dst_strides, the last axis innermost. Axes contiguous in both
+// arrays are merged into rows copied at once, and large arrays are split by
+// rows across the global ThreadPool. A stride may be 0 to broadcast.
+template <typename Dtype>
+void caffe_cpu_strided_copy(const vector<int>& shape,
+    const vector<int>& src_strides, const Dtype* src,
+    const vector<int>& dst_strides, Dtype* dst);
+
+// Permutes the axes of the N-D array src of the given shape into dst, whose
+// axis i is the axis order[i] of src. Axes that stay next to each other are
+// merged; when the innermost axis stays innermost this is a strided copy of
+// rows, otherwise the two innermost axes are transposed tile by tile so that
+// both arrays are walked through the cache a line at a time.
+template <typename Dtype>
+void caffe_cpu_permute(const vector<int>& shape, const vector<int>& order,
+    const Dtype* src, Dtype* dst);
+
 #ifndef CPU_ONLY  // GPU
 
 // Decaf gpu gemm provides an interface that is almost the same as the cpu
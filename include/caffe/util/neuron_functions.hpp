@@ -0,0 +1,84 @@
+#ifndef CAFFE_UTIL_NEURON_FUNCTIONS_H_
+#define CAFFE_UTIL_NEURON_FUNCTIONS_H_
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+// The element-wise kernels of the neuron layers on the CPU.
+//
+// Arrays large enough to pay for it are split across the global ThreadPool.
+// Float arrays are processed by AVX-512 or AVX2 code when the build targets
+// them (e.g. with -march=native), computing exp, log, tanh and the sigmoid
+// by polynomial approximations within kNeuronApproxTolerance of the exact
+// values, relative to their magnitude. Otherwise, and for doubles, the
+// kernels loop over the values with the functions of the standard library.
+// Outputs may alias inputs.
+
+/// @brief The relative error bound of the approximations of the SIMD code.
+const float kNeuronApproxTolerance = 1e-6;
+
+/// @brief Whether float kernels run on SIMD code in this build.
+bool caffe_cpu_neuron_simd();
+
+// y = max(x, 0) + negative_slope * min(x, 0)
+template <typename Dtype>
+void caffe_cpu_relu(const int n, const Dtype* x, const Dtype negative_slope,
+    Dtype* y);
+template <typename Dtype>
+void caffe_cpu_relu_backward(const int n, const Dtype* x, const Dtype* dy,
+    const Dtype negative_slope, Dtype* dx);
+
+// y = 1 / (1 + exp(-x)); the backward pass takes y.
+template <typename Dtype>
+void caffe_cpu_sigmoid(const int n, const Dtype* x, Dtype* y);
+template <typename Dtype>
+void caffe_cpu_sigmoid_backward(const int n, const Dtype* y, const Dtype* dy,
+    Dtype* dx);
+
+// y = tanh(x); the backward pass takes y.
+template <typename Dtype>
+void caffe_cpu_tanh(const int n, const Dtype* x, Dtype* y);
+template <typename Dtype>
+void caffe_cpu_tanh_backward(const int n, const Dtype* y, const Dtype* dy,
+    Dtype* dx);
+
+// y = max(x, 0) + alpha * (exp(min(x, 0)) - 1)
+template <typename Dtype>
+void caffe_cpu_elu(const int n, const Dtype* x, const Dtype alpha, Dtype* y);
+template <typename Dtype>
+void caffe_cpu_elu_backward(const int n, const Dtype* x, const Dtype* y,
+    const Dtype* dy, const Dtype alpha, Dtype* dx);
+
+// s = sigmoid(beta * x), y = x * s
+template <typename Dtype>
+void caffe_cpu_swish(const int n, const Dtype* x, const Dtype beta, Dtype* s,
+    Dtype* y);
+template <typename Dtype>
+void caffe_cpu_swish_backward(const int n, const Dtype* y, const Dtype* s,
+    const Dtype* dy, const Dtype beta, Dtype* dx);
+
+// y = outer_scale * exp(inner_scale * x); the backward pass takes y.
+template <typename Dtype>
+void caffe_cpu_scaled_exp(const int n, const Dtype* x,
+    const Dtype inner_scale, const Dtype outer_scale, Dtype* y);
+template <typename Dtype>
+void caffe_cpu_scaled_exp_backward(const int n, const Dtype* y,
+    const Dtype* dy, const Dtype inner_scale, Dtype* dx);
+
+// y = log(1 + exp(x)), computed as max(x, 0) + log(1 + exp(-|x|)); the
+// backward pass clips x to threshold.
+template <typename Dtype>
+void caffe_cpu_bnll(const int n, const Dtype* x, Dtype* y);
+template <typename Dtype>
+void caffe_cpu_bnll_backward(const int n, const Dtype* x, const Dtype* dy,
+    const Dtype threshold, Dtype* dx);
+
+// y = x > threshold ? 1 : 0
+template <typename Dtype>
+void caffe_cpu_threshold(const int n, const Dtype* x, const Dtype threshold,
+    Dtype* y);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_NEURON_FUNCTIONS_H_
@@ -0,0 +1,97 @@
+#ifndef CAFFE_UTIL_QUANTIZATION_H_
+#define CAFFE_UTIL_QUANTIZATION_H_
+
+#include <stdint.h>
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+// Symmetric linear quantization for the INT8 inference engines on the CPU.
+//
+// Weights are quantized by row (output) to [-kInt8WeightMax, kInt8WeightMax]
+// with a scale of their own, and activations by matrix to
+// [-kInt8ActivationMax, kInt8ActivationMax], stored offset by 128 as
+// unsigned bytes. Weights use 7 bits so that the pairwise products of the
+// AVX2 and AVX-512 instructions (vpmaddubsw) cannot saturate their 16-bit
+// sums; the GEMM is then exact in every build.
+//
+// A quantized matrix of K values per row is stored in one of two layouts,
+// both padded to caffe_int8_padded_dim(K) values per row, with zeros
+// (weights) or quantized zeros (activations):
+//  - by rows, K innermost;
+//  - by panels of kInt8PanelRows rows, which hold the values of groups of
+//    four k for all the rows of the panel one after the other, so that the
+//    GEMM reads the products of a vector of rows with one load. The rows are
+//    padded to caffe_int8_panel_rows(rows).
+// caffe_int8_offset gives the index of a value in either.
+
+const int kInt8WeightMax = 63;
+const int kInt8ActivationMax = 127;
+/// @brief The largest K whose int32 sums cannot overflow.
+const int kInt8MaxDim = 0x7fffffff / (kInt8WeightMax * 255);
+const int kInt8PanelRows = 16;
+
+/// @brief The row length of quantized matrices with K values per row.
+inline int caffe_int8_padded_dim(const int k) { return (k + 3) / 4 * 4; }
+
+/// @brief The rows of a quantized matrix stored by panels.
+inline int caffe_int8_panel_rows(const int rows) {
+  return (rows + kInt8PanelRows - 1) / kInt8PanelRows * kInt8PanelRows;
+}
+
+/// @brief The index of value k of row r of a quantized matrix with padded
+///        row length ld.
+inline int caffe_int8_offset(const int r, const int k, const int ld,
+    const bool panels) {
+  if (!panels) {
+    return r * ld + k;
+  }
+  return r / kInt8PanelRows * kInt8PanelRows * ld + k / 4 * kInt8PanelRows * 4
+      + r % kInt8PanelRows * 4 + k % 4;
+}
+
+/// @brief The instruction set the int8 GEMM runs on in this build.
+const char* caffe_cpu_int8_gemm_isa();
+
+// Returns max(|x[i]|).
+template <typename Dtype>
+Dtype caffe_cpu_absmax(const int n, const Dtype* x);
+
+// Quantizes the rows x cols matrix w (cols x rows if trans_w) by row to q,
+// by panels or by rows, and sets scales[r] to the value of a unit of row r
+// and sums[r] to the sum of its quantized values.
+template <typename Dtype>
+void caffe_cpu_quantize_weights(const int rows, const int cols,
+    const Dtype* w, const bool trans_w, const bool panels, int8_t* q,
+    Dtype* scales, int32_t* sums);
+
+// Quantizes the rows x cols matrix x (cols x rows if trans_x) to q, by
+// panels or by rows, with the given value of a unit: q = 128 +
+// round(x / scale), saturated to the activation range.
+template <typename Dtype>
+void caffe_cpu_quantize_activations(const int rows, const int cols,
+    const Dtype* x, const bool trans_x, const Dtype scale, const bool panels,
+    uint8_t* q);
+
+// Stores the rows x cols matrix q[r][k] = x[row_offsets[r] + col_offsets[k]]
+// of activations quantized in x to q by panels: the im2col of a quantized,
+// padded convolution input, say.
+void caffe_cpu_gather_activations(const int rows, const int cols,
+    const uint8_t* x, const int* row_offsets, const int* col_offsets,
+    uint8_t* q);
+
+// Computes c[m][n] = scales[m] * sum_k a[m][k] * (b[n][k] - 128) + bias[m]
+// (c[n][m] if trans_c) for the quantized M x K weights a, whose row sums are
+// a_sums, and the quantized N x K activations b, accumulating in int32. The
+// operand along the rows of c is stored by panels: b, or a if trans_c; the
+// other by rows. The bias may be NULL. Large products are split across the
+// global ThreadPool.
+template <typename Dtype>
+void caffe_cpu_gemm_int8(const int M, const int N, const int K,
+    const int8_t* a, const int32_t* a_sums, const uint8_t* b,
+    const Dtype* scales, const Dtype* bias, const bool trans_c, Dtype* c);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_QUANTIZATION_H_
@@ -0,0 +1,59 @@
+#ifndef CAFFE_UTIL_THREAD_POOL_HPP_
+#define CAFFE_UTIL_THREAD_POOL_HPP_
+
+#include <boost/function.hpp>
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+/**
+ * @brief A fixed set of worker threads for data-parallel CPU kernels.
+ *
+ * Run() splits a job into independent tasks that are executed by the
+ * workers and by the calling thread, and returns once all of them are done.
+ * Jobs submitted concurrently from several threads share the workers, and a
+ * task may itself call Run() without deadlocking. Tasks run on plain worker
+ * threads: they must not rely on Caffe's thread-local state (mode, RNG).
+ */
+class ThreadPool {
+ public:
+  /// @param num_threads number of threads taking part in a job, including
+  ///        the calling one.
+  explicit ThreadPool(int num_threads);
+  ~ThreadPool();
+
+  /// @brief Calls task(i) for every i in [0, num_tasks).
+  void Run(int num_tasks, const boost::function<void(int)>& task);
+  /// @brief Splits [0, count) into contiguous ranges of at least min_range
+  ///        items, one per thread at most, and calls task(begin, end) on each.
+  void RunRange(int count, int min_range,
+      const boost::function<void(int, int)>& task);
+
+  inline int num_threads() const { return num_threads_; }
+
+  /// @brief The process-wide pool, sized to the hardware concurrency.
+  static ThreadPool& Global();
+  /// @brief Resolves a thread count knob: 0 means every hardware thread.
+  static int NumThreads(int requested);
+
+ protected:
+  /**
+   Move synchronization fields out instead of including boost/thread.hpp
+   to avoid a boost/NVCC issues (#1009, #1010) on OSX. Also fails on
+   Linux CUDA 7.0.18.
+   */
+  class sync;
+  struct Job;
+
+  void WorkerEntry();
+
+  int num_threads_;
+  shared_ptr<sync> sync_;
+
+DISABLE_COPY_AND_ASSIGN(ThreadPool);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_THREAD_POOL_HPP_
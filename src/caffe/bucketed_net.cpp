@@ -0,0 +1,112 @@
+#include <string>
+#include <vector>
+
+#include "caffe/bucketed_net.hpp"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+
+// Copies src, of shape src_shape from axis on, into dst, of shape dst_shape,
+// at the start of each axis.
+template <typename Dtype>
+static void CopyPadded(const vector<int>& src_shape,
+    const vector<int>& dst_shape, int axis, const Dtype* src, Dtype* dst) {
+  if (axis == src_shape.size() - 1) {
+    caffe_copy(src_shape[axis], src, dst);
+    return;
+  }
+  int src_stride = 1;
+  int dst_stride = 1;
+  for (int i = axis + 1; i < src_shape.size(); ++i) {
+    src_stride *= src_shape[i];
+    dst_stride *= dst_shape[i];
+  }
+  for (int i = 0; i < src_shape[axis]; ++i) {
+    CopyPadded(src_shape, dst_shape, axis + 1, src + i * src_stride,
+        dst + i * dst_stride);
+  }
+}
+
+template <typename Dtype>
+BucketedNet<Dtype>::BucketedNet(const NetParameter& param,
+    const vector<vector<int> >& bucket_shapes, const string& trained_filename)
+    : bucket_shapes_(bucket_shapes), stats_(bucket_shapes.size()) {
+  CHECK_GT(bucket_shapes.size(), 0) << "A bucketed net needs buckets.";
+  for (int b = 0; b < bucket_shapes.size(); ++b) {
+    nets_.push_back(shared_ptr<Net<Dtype> >(b == 0 ? new Net<Dtype>(param) :
+        new Net<Dtype>(param, nets_[0].get())));
+    Net<Dtype>* net = nets_.back().get();
+    CHECK_EQ(net->num_inputs(), 1)
+        << "Bucketed nets take their inputs through one input blob.";
+    if (b == 0 && !trained_filename.empty()) {
+      // Before the other nets share, and possibly fold, the params.
+      net->CopyTrainedLayersFrom(trained_filename);
+    }
+    net->input_blobs()[0]->Reshape(bucket_shapes[b]);
+    net->Reshape();
+  }
+}
+
+template <typename Dtype>
+int BucketedNet<Dtype>::Bucket(const vector<int>& shape) const {
+  int bucket = -1;
+  for (int b = 0; b < bucket_shapes_.size(); ++b) {
+    const vector<int>& bucket_shape = bucket_shapes_[b];
+    bool fits = shape.size() == bucket_shape.size();
+    for (int i = 0; fits && i < shape.size(); ++i) {
+      fits = shape[i] <= bucket_shape[i];
+    }
+    if (fits && (bucket < 0 || nets_[b]->input_blobs()[0]->count() <
+        nets_[bucket]->input_blobs()[0]->count())) {
+      bucket = b;
+    }
+  }
+  return bucket;
+}
+
+template <typename Dtype>
+const vector<Blob<Dtype>*>& BucketedNet<Dtype>::Forward(
+    const Blob<Dtype>& input, int* bucket, Dtype* loss) {
+  const int b = Bucket(input.shape());
+  CHECK_GE(b, 0) << "No bucket fits an input of shape "
+      << input.shape_string();
+  Net<Dtype>* net = nets_[b].get();
+  Blob<Dtype>* net_input = net->input_blobs()[0];
+  if (input.count() == net_input->count()) {
+    caffe_copy(input.count(), input.cpu_data(),
+        net_input->mutable_cpu_data());
+  } else {
+    caffe_set(net_input->count(), Dtype(0), net_input->mutable_cpu_data());
+    if (input.count() > 0) {
+      CopyPadded(input.shape(), net_input->shape(), 0, input.cpu_data(),
+          net_input->mutable_cpu_data());
+    }
+  }
+  Stats& stats = stats_[b];
+  ++stats.num_forwards;
+  stats.num_values += input.count();
+  stats.num_padding += net_input->count() - input.count();
+  if (bucket) {
+    *bucket = b;
+  }
+  return net->Forward(loss);
+}
+
+template <typename Dtype>
+void BucketedNet<Dtype>::ClearStats() {
+  stats_.assign(stats_.size(), Stats());
+}
+
+template <typename Dtype>
+void BucketedNet<Dtype>::LogStats() const {
+  for (int b = 0; b < nets_.size(); ++b) {
+    LOG(INFO) << "Bucket " << b << " ("
+        << nets_[b]->input_blobs()[0]->shape_string() << "): "
+        << stats_[b].num_forwards << " forwards, "
+        << stats_[b].padding_waste() * 100 << "% padding";
+  }
+}
+
+INSTANTIATE_CLASS(BucketedNet);
+
+}  // namespace caffe
@@ -12,6 +12,46 @@
 
 namespace caffe {
 
+// A video clip Datum holds several frames, raw or encoded one by one.
+static bool IsClip(const Datum& datum) {
+  return datum.length() > 0 || datum.frames_size() > 0;
+}
+
+#ifdef USE_OPENCV
+// Decodes one frame of an encoded clip, honoring force_color and force_gray.
+static cv::Mat DecodeClipFrame(const Datum& datum, int frame,
+    const TransformationParameter& param) {
+  CHECK(!(param.force_color() && param.force_gray()))
+      << "cannot set both force_color and force_gray";
+  cv::Mat cv_img;
+  if (param.force_color() || param.force_gray()) {
+    cv_img = DecodeDatumFrameToCVMat(datum, frame, param.force_color());
+  } else {
+    cv_img = DecodeDatumFrameToCVMatNative(datum, frame);
+  }
+  CHECK(cv_img.data) << "Could not decode frame " << frame;
+  CHECK(cv_img.depth() == CV_8U) << "Image data type must be unsigned byte";
+  return cv_img;
+}
+#endif  // USE_OPENCV
+
+// Transforms width elements of one frame row read every src_step elements
+// from src: subtracts the mean (the row of mean if given, mean_value
+// otherwise), scales, and writes them to dst, reversed if mirror is set.
+template <typename Dtype, typename SrcType>
+static void TransformClipRow(const SrcType* src, int src_step,
+    const Dtype* mean, Dtype mean_value, Dtype scale, bool mirror, int width,
+    Dtype* dst) {
+  const int dst_step = mirror ? -1 : 1;
+  if (mirror) {
+    dst += width - 1;
+  }
+  for (int w = 0; w < width; ++w, src += src_step, dst += dst_step) {
+    const Dtype pixel = static_cast<Dtype>(*src);
+    *dst = (pixel - (mean ? mean[w] : mean_value)) * scale;
+  }
+}
+
 template<typename Dtype>
 DataTransformer<Dtype>::DataTransformer(const TransformationParameter& param,
     Phase phase)
@@ -26,7 +66,16 @@ DataTransformer<Dtype>::DataTransformer(const TransformationParameter& param,
     }
     BlobProto blob_proto;
     ReadProtoFromBinaryFileOrDie(mean_file.c_str(), &blob_proto);
-    data_mean_.FromProto(blob_proto);
+    if (blob_proto.has_shape() && blob_proto.shape().dim_size() == 1) {
+      // A mean per channel, as written by compute_image_mean
+      // -channel_mean_file: subtracted like mean_value, without a mean image.
+      CHECK_EQ(blob_proto.data_size(), blob_proto.shape().dim(0));
+      for (int c = 0; c < blob_proto.data_size(); ++c) {
+        mean_values_.push_back(blob_proto.data(c));
+      }
+    } else {
+      data_mean_.FromProto(blob_proto);
+    }
   }
   // check if we want to use mean_value
   if (param_.mean_value_size() > 0) {
@@ -40,39 +89,33 @@ DataTransformer<Dtype>::DataTransformer(const TransformationParameter& param,
 
 template<typename Dtype>
 void DataTransformer<Dtype>::Transform(const Datum& datum,
-                                       Dtype* transformed_data) {
-  const string& data = datum.data();
+    const char* data, size_t data_size, Dtype* transformed_data,
+    Caffe::RNG* rng) {
   const int datum_channels = datum.channels();
   const int datum_height = datum.height();
   const int datum_width = datum.width();
 
   const int crop_size = param_.crop_size();
   const Dtype scale = param_.scale();
-  const bool do_mirror = param_.mirror() && Rand(2);
-  const bool has_mean_file = param_.has_mean_file();
-  const bool has_uint8 = data.size() > 0;
+  const bool do_mirror = param_.mirror() && Rand(2, rng);
+  const bool has_mean_file = data_mean_.count() > 0;
+  const bool has_uint8 = data_size > 0;
   const bool has_mean_values = mean_values_.size() > 0;
 
   CHECK_GT(datum_channels, 0);
   CHECK_GE(datum_height, crop_size);
   CHECK_GE(datum_width, crop_size);
 
-  Dtype* mean = NULL;
+  const Dtype* mean = NULL;
   if (has_mean_file) {
     CHECK_EQ(datum_channels, data_mean_.channels());
     CHECK_EQ(datum_height, data_mean_.height());
     CHECK_EQ(datum_width, data_mean_.width());
-    mean = data_mean_.mutable_cpu_data();
+    mean = data_mean_.cpu_data();
   }
   if (has_mean_values) {
     CHECK(mean_values_.size() == 1 || mean_values_.size() == datum_channels) <<
      "Specify either 1 mean_value or as many as channels: " << datum_channels;
-    if (datum_channels > 1 && mean_values_.size() == 1) {
-      // Replicate the mean_value for simplicity
-      for (int c = 1; c < datum_channels; ++c) {
-        mean_values_.push_back(mean_values_[0]);
-      }
-    }
   }
 
   int height = datum_height;
@@ -85,8 +128,8 @@ void DataTransformer<Dtype>::Transform(const Datum& datum,
     width = crop_size;
     // We only do random crop when we do training.
     if (phase_ == TRAIN) {
-      h_off = Rand(datum_height - crop_size + 1);
-      w_off = Rand(datum_width - crop_size + 1);
+      h_off = Rand(datum_height - crop_size + 1, rng);
+      w_off = Rand(datum_width - crop_size + 1, rng);
     } else {
       h_off = (datum_height - crop_size) / 2;
       w_off = (datum_width - crop_size) / 2;
@@ -116,7 +159,7 @@ void DataTransformer<Dtype>::Transform(const Datum& datum,
         } else {
           if (has_mean_values) {
             transformed_data[top_index] =
-              (datum_element - mean_values_[c]) * scale;
+              (datum_element - mean_value(c)) * scale;
           } else {
             transformed_data[top_index] = datum_element * scale;
           }
@@ -127,9 +170,185 @@ void DataTransformer<Dtype>::Transform(const Datum& datum,
 }
 
 
+template<typename Dtype>
+void DataTransformer<Dtype>::TransformClip(const Datum& datum,
+    const char* data, size_t data_size, Blob<Dtype>* transformed_blob,
+    Caffe::RNG* rng) {
+  const bool encoded = datum.encoded();
+  const int datum_length = encoded ? datum.frames_size() : datum.length();
+  if (encoded && datum.length() > 0) {
+    CHECK_EQ(datum.length(), datum_length)
+        << "Clip length does not match its number of encoded frames";
+  }
+  const int crop_size = param_.crop_size();
+  const int crop_length = param_.crop_length();
+  const Dtype scale = param_.scale();
+  const bool has_mean_file = data_mean_.count() > 0;
+  const bool has_mean_values = mean_values_.size() > 0;
+
+  CHECK_GT(datum_length, 0);
+  CHECK_GE(datum_length, crop_length);
+
+  // The same mirror and crop apply to every frame of the clip.
+  const bool do_mirror = param_.mirror() && Rand(2, rng);
+  const int length = crop_length ? crop_length : datum_length;
+  int t_off = 0;
+  if (crop_length) {
+    // We only do random crop when we do training.
+    if (phase_ == TRAIN) {
+      t_off = Rand(datum_length - crop_length + 1, rng);
+    } else {
+      t_off = (datum_length - crop_length) / 2;
+    }
+  }
+
+  int datum_channels = datum.channels();
+  int datum_height = datum.height();
+  int datum_width = datum.width();
+#ifdef USE_OPENCV
+  // Only the frames kept by the temporal crop are decoded.
+  vector<cv::Mat> cv_frames;
+#endif  // USE_OPENCV
+  if (encoded) {
+#ifdef USE_OPENCV
+    cv_frames.resize(length);
+    for (int t = 0; t < length; ++t) {
+      cv_frames[t] = DecodeClipFrame(datum, t_off + t, param_);
+    }
+    datum_channels = cv_frames[0].channels();
+    datum_height = cv_frames[0].rows;
+    datum_width = cv_frames[0].cols;
+    for (int t = 1; t < length; ++t) {
+      CHECK(cv_frames[t].channels() == datum_channels &&
+            cv_frames[t].rows == datum_height &&
+            cv_frames[t].cols == datum_width)
+          << "All frames of a clip must have the same size";
+    }
+#else
+    LOG(FATAL) << "Encoded datum requires OpenCV; compile with USE_OPENCV.";
+#endif  // USE_OPENCV
+  } else if (param_.force_color() || param_.force_gray()) {
+    LOG(ERROR) << "force_color and force_gray only for encoded datum";
+  }
+  const bool has_uint8 = data_size > 0;
+  if (!encoded) {
+    const int datum_size =
+        datum_channels * datum_length * datum_height * datum_width;
+    if (has_uint8) {
+      CHECK_EQ(data_size, datum_size) << "Clip data does not match its shape";
+    } else {
+      CHECK_EQ(datum.float_data_size(), datum_size)
+          << "Clip data does not match its shape";
+    }
+  }
+
+  CHECK_GT(datum_channels, 0);
+  CHECK_GE(datum_height, crop_size);
+  CHECK_GE(datum_width, crop_size);
+
+  int height = datum_height;
+  int width = datum_width;
+  int h_off = 0;
+  int w_off = 0;
+  if (crop_size) {
+    height = crop_size;
+    width = crop_size;
+    if (phase_ == TRAIN) {
+      h_off = Rand(datum_height - crop_size + 1, rng);
+      w_off = Rand(datum_width - crop_size + 1, rng);
+    } else {
+      h_off = (datum_height - crop_size) / 2;
+      w_off = (datum_width - crop_size) / 2;
+    }
+  }
+
+  // Check dimensions.
+  CHECK_EQ(transformed_blob->num_axes(), 5)
+      << "A clip is transformed into a 5-D blob";
+  CHECK_GE(transformed_blob->shape(0), 1);
+  CHECK_EQ(transformed_blob->shape(1), datum_channels);
+  CHECK_EQ(transformed_blob->shape(2), length);
+  CHECK_EQ(transformed_blob->shape(3), height);
+  CHECK_EQ(transformed_blob->shape(4), width);
+
+  // The mean file holds either one frame, subtracted from every frame, or a
+  // whole clip.
+  const Dtype* mean = NULL;
+  bool clip_mean = false;
+  if (has_mean_file) {
+    CHECK(data_mean_.num_axes() == 4 || data_mean_.num_axes() == 5)
+        << "The mean of a clip must be 4-D or 5-D";
+    clip_mean = data_mean_.num_axes() == 5;
+    CHECK_EQ(datum_channels, data_mean_.shape(1));
+    if (clip_mean) {
+      CHECK_EQ(datum_length, data_mean_.shape(2));
+    }
+    CHECK_EQ(datum_height, data_mean_.shape(-2));
+    CHECK_EQ(datum_width, data_mean_.shape(-1));
+    mean = data_mean_.cpu_data();
+  }
+  if (has_mean_values) {
+    CHECK(mean_values_.size() == 1 || mean_values_.size() == datum_channels) <<
+     "Specify either 1 mean_value or as many as channels: " << datum_channels;
+  }
+
+  Dtype* transformed_data = transformed_blob->mutable_cpu_data();
+  for (int c = 0; c < datum_channels; ++c) {
+    const Dtype channel_mean = has_mean_values ? mean_value(c) : Dtype(0);
+    for (int t = 0; t < length; ++t) {
+      const int frame = t_off + t;
+      for (int h = 0; h < height; ++h) {
+        Dtype* top_row =
+            transformed_data + ((c * length + t) * height + h) * width;
+        const Dtype* mean_row = NULL;
+        if (mean) {
+          const int mean_frame = clip_mean ? c * datum_length + frame : c;
+          mean_row = mean + (mean_frame * datum_height + h_off + h) *
+              datum_width + w_off;
+        }
+        if (encoded) {
+#ifdef USE_OPENCV
+          const uchar* ptr = cv_frames[t].ptr<uchar>(h_off + h) +
+              w_off * datum_channels + c;
+          TransformClipRow(ptr, datum_channels, mean_row, channel_mean, scale,
+              do_mirror, width, top_row);
+#endif  // USE_OPENCV
+        } else {
+          const int data_index = ((c * datum_length + frame) * datum_height +
+              h_off + h) * datum_width + w_off;
+          if (has_uint8) {
+            TransformClipRow(
+                reinterpret_cast<const uint8_t*>(data) + data_index, 1,
+                mean_row, channel_mean, scale, do_mirror, width, top_row);
+          } else {
+            TransformClipRow(datum.float_data().data() + data_index, 1,
+                mean_row, channel_mean, scale, do_mirror, width, top_row);
+          }
+        }
+      }
+    }
+  }
+}
+
 template<typename Dtype>
 void DataTransformer<Dtype>::Transform(const Datum& datum,
                                        Blob<Dtype>* transformed_blob) {
+  Transform(datum, transformed_blob, rng_.get());
+}
+
+template<typename Dtype>
+void DataTransformer<Dtype>::Transform(const Datum& datum,
+    Blob<Dtype>* transformed_blob, Caffe::RNG* rng) {
+  const string& data = datum.data();
+  Transform(datum, data.data(), data.size(), transformed_blob, rng);
+}
+
+template<typename Dtype>
+void DataTransformer<Dtype>::Transform(const Datum& datum, const char* data,
+    size_t data_size, Blob<Dtype>* transformed_blob, Caffe::RNG* rng) {
+  if (IsClip(datum)) {
+    return TransformClip(datum, data, data_size, transformed_blob, rng);
+  }
   // If datum is encoded, decode and transform the cv::image.
   if (datum.encoded()) {
 #ifdef USE_OPENCV
@@ -138,12 +357,12 @@ void DataTransformer<Dtype>::Transform(const Datum& datum,
     cv::Mat cv_img;
     if (param_.force_color() || param_.force_gray()) {
     // If force_color then decode in color otherwise decode in gray.
-      cv_img = DecodeDatumToCVMat(datum, param_.force_color());
+      cv_img = DecodeBufferToCVMat(data, data_size, param_.force_color());
     } else {
-      cv_img = DecodeDatumToCVMatNative(datum);
+      cv_img = DecodeBufferToCVMatNative(data, data_size);
     }
     // Transform the cv::image into blob.
-    return Transform(cv_img, transformed_blob);
+    return Transform(cv_img, transformed_blob, rng);
 #else
     LOG(FATAL) << "Encoded datum requires OpenCV; compile with USE_OPENCV.";
 #endif  // USE_OPENCV
@@ -178,24 +397,23 @@ void DataTransformer<Dtype>::Transform(const Datum& datum,
   }
 
   Dtype* transformed_data = transformed_blob->mutable_cpu_data();
-  Transform(datum, transformed_data);
+  Transform(datum, data, data_size, transformed_data, rng);
 }
 
 template<typename Dtype>
 void DataTransformer<Dtype>::Transform(const vector<Datum> & datum_vector,
                                        Blob<Dtype>* transformed_blob) {
   const int datum_num = datum_vector.size();
-  const int num = transformed_blob->num();
-  const int channels = transformed_blob->channels();
-  const int height = transformed_blob->height();
-  const int width = transformed_blob->width();
+  const int num = transformed_blob->shape(0);
 
   CHECK_GT(datum_num, 0) << "There is no datum to add";
   CHECK_LE(datum_num, num) <<
     "The size of datum_vector must be no greater than transformed_blob->num()";
-  Blob<Dtype> uni_blob(1, channels, height, width);
+  vector<int> uni_shape = transformed_blob->shape();
+  uni_shape[0] = 1;
+  Blob<Dtype> uni_blob(uni_shape);
   for (int item_id = 0; item_id < datum_num; ++item_id) {
-    int offset = transformed_blob->offset(item_id);
+    int offset = transformed_blob->offset(vector<int>(1, item_id));
     uni_blob.set_cpu_data(transformed_blob->mutable_cpu_data() + offset);
     Transform(datum_vector[item_id], &uni_blob);
   }
@@ -225,6 +443,12 @@ void DataTransformer<Dtype>::Transform(const vector<cv::Mat> & mat_vector,
 template<typename Dtype>
 void DataTransformer<Dtype>::Transform(const cv::Mat& cv_img,
                                        Blob<Dtype>* transformed_blob) {
+  Transform(cv_img, transformed_blob, rng_.get());
+}
+
+template<typename Dtype>
+void DataTransformer<Dtype>::Transform(const cv::Mat& cv_img,
+    Blob<Dtype>* transformed_blob, Caffe::RNG* rng) {
   const int crop_size = param_.crop_size();
   const int img_channels = cv_img.channels();
   const int img_height = cv_img.rows;
@@ -244,30 +468,24 @@ void DataTransformer<Dtype>::Transform(const cv::Mat& cv_img,
   CHECK(cv_img.depth() == CV_8U) << "Image data type must be unsigned byte";
 
   const Dtype scale = param_.scale();
-  const bool do_mirror = param_.mirror() && Rand(2);
-  const bool has_mean_file = param_.has_mean_file();
+  const bool do_mirror = param_.mirror() && Rand(2, rng);
+  const bool has_mean_file = data_mean_.count() > 0;
   const bool has_mean_values = mean_values_.size() > 0;
 
   CHECK_GT(img_channels, 0);
   CHECK_GE(img_height, crop_size);
   CHECK_GE(img_width, crop_size);
 
-  Dtype* mean = NULL;
+  const Dtype* mean = NULL;
   if (has_mean_file) {
     CHECK_EQ(img_channels, data_mean_.channels());
     CHECK_EQ(img_height, data_mean_.height());
     CHECK_EQ(img_width, data_mean_.width());
-    mean = data_mean_.mutable_cpu_data();
+    mean = data_mean_.cpu_data();
   }
   if (has_mean_values) {
     CHECK(mean_values_.size() == 1 || mean_values_.size() == img_channels) <<
      "Specify either 1 mean_value or as many as channels: " << img_channels;
-    if (img_channels > 1 && mean_values_.size() == 1) {
-      // Replicate the mean_value for simplicity
-      for (int c = 1; c < img_channels; ++c) {
-        mean_values_.push_back(mean_values_[0]);
-      }
-    }
   }
 
   int h_off = 0;
@@ -278,8 +496,8 @@ void DataTransformer<Dtype>::Transform(const cv::Mat& cv_img,
     CHECK_EQ(crop_size, width);
     // We only do random crop when we do training.
     if (phase_ == TRAIN) {
-      h_off = Rand(img_height - crop_size + 1);
-      w_off = Rand(img_width - crop_size + 1);
+      h_off = Rand(img_height - crop_size + 1, rng);
+      w_off = Rand(img_width - crop_size + 1, rng);
     } else {
       h_off = (img_height - crop_size) / 2;
       w_off = (img_width - crop_size) / 2;
@@ -314,7 +532,7 @@ void DataTransformer<Dtype>::Transform(const cv::Mat& cv_img,
         } else {
           if (has_mean_values) {
             transformed_data[top_index] =
-              (pixel - mean_values_[c]) * scale;
+              (pixel - mean_value(c)) * scale;
           } else {
             transformed_data[top_index] = pixel * scale;
           }
@@ -359,7 +577,7 @@ void DataTransformer<Dtype>::Transform(Blob<Dtype>* input_blob,
 
   const Dtype scale = param_.scale();
   const bool do_mirror = param_.mirror() && Rand(2);
-  const bool has_mean_file = param_.has_mean_file();
+  const bool has_mean_file = data_mean_.count() > 0;
   const bool has_mean_values = mean_values_.size() > 0;
 
   int h_off = 0;
@@ -440,6 +658,39 @@ void DataTransformer<Dtype>::Transform(Blob<Dtype>* input_blob,
 
 template<typename Dtype>
 vector<int> DataTransformer<Dtype>::InferBlobShape(const Datum& datum) {
+  const int crop_size = param_.crop_size();
+  if (IsClip(datum)) {
+    const int crop_length = param_.crop_length();
+    int datum_channels = datum.channels();
+    int datum_height = datum.height();
+    int datum_width = datum.width();
+    int datum_length = datum.length();
+    if (datum.encoded()) {
+#ifdef USE_OPENCV
+      // All the frames of a clip have the size of the first one.
+      cv::Mat cv_img = DecodeClipFrame(datum, 0, param_);
+      datum_channels = cv_img.channels();
+      datum_height = cv_img.rows;
+      datum_width = cv_img.cols;
+      datum_length = datum.frames_size();
+#else
+      LOG(FATAL) << "Encoded datum requires OpenCV; compile with USE_OPENCV.";
+#endif  // USE_OPENCV
+    }
+    // Check dimensions.
+    CHECK_GT(datum_channels, 0);
+    CHECK_GE(datum_length, crop_length);
+    CHECK_GE(datum_height, crop_size);
+    CHECK_GE(datum_width, crop_size);
+    // Build BlobShape.
+    vector<int> shape(5);
+    shape[0] = 1;
+    shape[1] = datum_channels;
+    shape[2] = (crop_length)? crop_length: datum_length;
+    shape[3] = (crop_size)? crop_size: datum_height;
+    shape[4] = (crop_size)? crop_size: datum_width;
+    return shape;
+  }
   if (datum.encoded()) {
 #ifdef USE_OPENCV
     CHECK(!(param_.force_color() && param_.force_gray()))
@@ -457,7 +708,6 @@ vector<int> DataTransformer<Dtype>::InferBlobShape(const Datum& datum) {
     LOG(FATAL) << "Encoded datum requires OpenCV; compile with USE_OPENCV.";
 #endif  // USE_OPENCV
   }
-  const int crop_size = param_.crop_size();
   const int datum_channels = datum.channels();
   const int datum_height = datum.height();
   const int datum_width = datum.width();
@@ -522,7 +772,7 @@ vector<int> DataTransformer<Dtype>::InferBlobShape(
 template <typename Dtype>
 void DataTransformer<Dtype>::InitRand() {
   const bool needs_rand = param_.mirror() ||
-      (phase_ == TRAIN && param_.crop_size());
+      (phase_ == TRAIN && (param_.crop_size() || param_.crop_length()));
   if (needs_rand) {
     const unsigned int rng_seed = caffe_rng_rand();
     rng_.reset(new Caffe::RNG(rng_seed));
@@ -533,11 +783,16 @@ void DataTransformer<Dtype>::InitRand() {
 
 template <typename Dtype>
 int DataTransformer<Dtype>::Rand(int n) {
-  CHECK(rng_);
+  return Rand(n, rng_.get());
+}
+
+template <typename Dtype>
+int DataTransformer<Dtype>::Rand(int n, Caffe::RNG* rng) {
+  CHECK(rng);
   CHECK_GT(n, 0);
-  caffe::rng_t* rng =
-      static_cast<caffe::rng_t*>(rng_->generator());
-  return ((*rng)() % n);
+  caffe::rng_t* generator =
+      static_cast<caffe::rng_t*>(rng->generator());
+  return ((*generator)() % n);
 }
 
 INSTANTIATE_CLASS(DataTransformer);
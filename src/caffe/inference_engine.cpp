@@ -0,0 +1,253 @@
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/thread.hpp>
+#include <algorithm>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "caffe/inference_engine.hpp"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+struct InferenceEngine<Dtype>::Request {
+  const Blob<Dtype>* input;
+  vector<shared_ptr<Blob<Dtype> > >* outputs;
+  boost::posix_time::ptime arrival;
+  // Guarded by sync::mutex_.
+  bool done;
+
+  inline int num_items() const { return input->shape(0); }
+  // Whether the items of the request can be batched with those of other.
+  inline bool compatible(const Request& other) const {
+    return input->num_axes() == other.input->num_axes() &&
+        std::equal(input->shape().begin() + 1, input->shape().end(),
+            other.input->shape().begin() + 1);
+  }
+};
+
+template <typename Dtype>
+class InferenceEngine<Dtype>::sync {
+ public:
+  sync() : stop_(false), pending_(0), num_batches_(0), num_items_(0) {}
+  boost::mutex mutex_;
+  boost::condition_variable request_ready_;
+  boost::condition_variable request_done_;
+  std::deque<Request*> requests_;
+  bool stop_;
+  // The calls of Infer not returned yet, queued or running.
+  int pending_;
+  int num_batches_;
+  int num_items_;
+};
+
+// An execution context: runs the batches of an engine on a net of its own.
+template <typename Dtype>
+class InferenceContext : public InternalThread {
+ public:
+  InferenceContext(InferenceEngine<Dtype>* engine,
+      shared_ptr<Net<Dtype> > net)
+      : engine_(engine), net_(net) {}
+  virtual ~InferenceContext() { StopInternalThread(); }
+
+ protected:
+  void InternalThreadEntry() {
+    vector<typename InferenceEngine<Dtype>::Request*> batch;
+    try {
+      while (!must_stop() && engine_->NextBatch(&batch)) {
+        engine_->RunBatch(batch, net_.get());
+      }
+    } catch (boost::thread_interrupted&) {
+      // Interrupted exception is expected on shutdown
+    }
+  }
+
+  InferenceEngine<Dtype>* engine_;
+  shared_ptr<Net<Dtype> > net_;
+};
+
+template <typename Dtype>
+InferenceEngine<Dtype>::InferenceEngine(const NetParameter& param,
+    const string& trained_filename, int num_contexts, int max_batch_size,
+    int max_delay_us)
+    : max_batch_size_(max_batch_size), max_delay_us_(max_delay_us),
+      sync_(new sync()) {
+  CHECK_GT(num_contexts, 0);
+  CHECK_GT(max_batch_size, 0);
+  CHECK_GE(max_delay_us, 0);
+  weights_net_.reset(new Net<Dtype>(param));
+  CHECK_EQ(weights_net_->num_inputs(), 1)
+      << "Served nets take their items through one input blob.";
+  if (!trained_filename.empty()) {
+    weights_net_->CopyTrainedLayersFrom(trained_filename);
+  }
+#ifndef CPU_ONLY
+  // The contexts would otherwise copy the shared params to the device
+  // concurrently, on their first batches.
+  if (Caffe::mode() == Caffe::GPU) {
+    const vector<shared_ptr<Blob<Dtype> > >& params =
+        weights_net_->params();
+    for (int i = 0; i < params.size(); ++i) {
+      params[i]->gpu_data();
+    }
+  }
+#endif
+  for (int i = 0; i < num_contexts; ++i) {
+    shared_ptr<Net<Dtype> > net(i == 0 ? weights_net_ :
+        shared_ptr<Net<Dtype> >(new Net<Dtype>(param, weights_net_.get())));
+    contexts_.push_back(shared_ptr<InternalThread>(
+        new InferenceContext<Dtype>(this, net)));
+    contexts_.back()->StartInternalThread();
+  }
+}
+
+template <typename Dtype>
+InferenceEngine<Dtype>::~InferenceEngine() {
+  {
+    // The requests queued are still served, without waiting for more.
+    boost::mutex::scoped_lock lock(sync_->mutex_);
+    sync_->stop_ = true;
+    sync_->request_ready_.notify_all();
+    while (sync_->pending_ > 0) {
+      sync_->request_done_.wait(lock);
+    }
+  }
+  // The contexts release their nets before the weights net.
+  contexts_.clear();
+}
+
+template <typename Dtype>
+void InferenceEngine<Dtype>::Infer(const Blob<Dtype>& input,
+    vector<shared_ptr<Blob<Dtype> > >* outputs) {
+  CHECK(input.num_axes() > 0 && input.shape(0) > 0)
+      << "Requests have items along their first axis.";
+  Request request;
+  request.input = &input;
+  request.outputs = outputs;
+  // In UTC, as the deadlines of timed_wait.
+  request.arrival = boost::posix_time::microsec_clock::universal_time();
+  request.done = false;
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  CHECK(!sync_->stop_) << "The inference engine is stopping.";
+  sync_->requests_.push_back(&request);
+  ++sync_->pending_;
+  sync_->request_ready_.notify_all();
+  while (!request.done) {
+    sync_->request_done_.wait(lock);
+  }
+  --sync_->pending_;
+  if (sync_->stop_) {
+    // The destructor waits for the last request.
+    sync_->request_done_.notify_all();
+  }
+}
+
+template <typename Dtype>
+bool InferenceEngine<Dtype>::NextBatch(vector<Request*>* batch) {
+  batch->clear();
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  std::deque<Request*>& requests = sync_->requests_;
+  while (requests.empty() && !sync_->stop_) {
+    sync_->request_ready_.wait(lock);
+  }
+  if (requests.empty()) {
+    return false;
+  }
+  batch->push_back(requests.front());
+  requests.pop_front();
+  int num_items = batch->front()->num_items();
+  const boost::posix_time::ptime deadline = batch->front()->arrival +
+      boost::posix_time::microseconds(max_delay_us_);
+  for (;;) {
+    for (typename std::deque<Request*>::iterator it = requests.begin();
+         it != requests.end() && num_items < max_batch_size_;) {
+      if ((*it)->compatible(*batch->front()) &&
+          num_items + (*it)->num_items() <= max_batch_size_) {
+        num_items += (*it)->num_items();
+        batch->push_back(*it);
+        it = requests.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    if (num_items >= max_batch_size_ || sync_->stop_ ||
+        !sync_->request_ready_.timed_wait(lock, deadline)) {
+      break;
+    }
+  }
+  return true;
+}
+
+template <typename Dtype>
+void InferenceEngine<Dtype>::RunBatch(const vector<Request*>& batch,
+    Net<Dtype>* net) {
+  int num_items = 0;
+  for (int i = 0; i < batch.size(); ++i) {
+    num_items += batch[i]->num_items();
+  }
+  Blob<Dtype>* input = net->input_blobs()[0];
+  vector<int> shape = batch[0]->input->shape();
+  shape[0] = num_items;
+  if (input->shape() != shape) {
+    input->Reshape(shape);
+    net->Reshape();
+  }
+  Dtype* input_data = input->mutable_cpu_data();
+  for (int i = 0; i < batch.size(); ++i) {
+    caffe_copy(batch[i]->input->count(), batch[i]->input->cpu_data(),
+        input_data);
+    input_data += batch[i]->input->count();
+  }
+  net->Forward();
+  const vector<Blob<Dtype>*>& net_outputs = net->output_blobs();
+  for (int k = 0; k < net_outputs.size(); ++k) {
+    const Blob<Dtype>* output = net_outputs[k];
+    const bool batched = output->num_axes() > 0 &&
+        output->shape(0) == num_items;
+    const Dtype* output_data = output->cpu_data();
+    for (int i = 0; i < batch.size(); ++i) {
+      vector<shared_ptr<Blob<Dtype> > >* outputs = batch[i]->outputs;
+      if (k == 0) {
+        outputs->resize(net_outputs.size());
+      }
+      if (!(*outputs)[k]) {
+        (*outputs)[k].reset(new Blob<Dtype>());
+      }
+      Blob<Dtype>* request_output = (*outputs)[k].get();
+      vector<int> request_shape = output->shape();
+      if (batched) {
+        request_shape[0] = batch[i]->num_items();
+      }
+      request_output->Reshape(request_shape);
+      caffe_copy(request_output->count(), output_data,
+          request_output->mutable_cpu_data());
+      if (batched) {
+        output_data += request_output->count();
+      }
+    }
+  }
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  for (int i = 0; i < batch.size(); ++i) {
+    batch[i]->done = true;
+  }
+  ++sync_->num_batches_;
+  sync_->num_items_ += num_items;
+  sync_->request_done_.notify_all();
+}
+
+template <typename Dtype>
+int InferenceEngine<Dtype>::num_batches() const {
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  return sync_->num_batches_;
+}
+
+template <typename Dtype>
+int InferenceEngine<Dtype>::num_items() const {
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  return sync_->num_items_;
+}
+
+INSTANTIATE_CLASS(InferenceEngine);
+
+}  // namespace caffe
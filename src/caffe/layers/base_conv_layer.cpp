@@ -5,6 +5,7 @@
 #include "caffe/layers/base_conv_layer.hpp"
 #include "caffe/util/im2col.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
@@ -14,6 +15,7 @@ void BaseConvolutionLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
   // Configure the kernel size, padding, stride, and inputs.
   ConvolutionParameter conv_param = this->layer_param_.convolution_param();
   force_nd_im2col_ = conv_param.force_nd_im2col();
+  num_threads_ = ThreadPool::NumThreads(conv_param.num_threads());
   channel_axis_ = bottom[0]->CanonicalAxisIndex(conv_param.axis());
   const int first_spatial_axis = channel_axis_ + 1;
   const int num_axes = bottom[0]->num_axes();
@@ -240,6 +242,24 @@ void BaseConvolutionLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
     }
   }
   col_buffer_.Reshape(col_buffer_shape_);
+  // Every extra thread of the parallel CPU batch loop gets its own column
+  // buffer and parameter gradients; memory is only allocated on first use.
+  batch_threads_ = std::max(std::min(num_threads_, num_), 1);
+  thread_col_buffers_.resize(batch_threads_ - 1);
+  thread_param_diffs_.resize(batch_threads_ - 1);
+  for (int t = 0; t < batch_threads_ - 1; ++t) {
+    if (!thread_col_buffers_[t]) {
+      thread_col_buffers_[t].reset(new Blob<Dtype>());
+    }
+    thread_col_buffers_[t]->Reshape(col_buffer_shape_);
+    thread_param_diffs_[t].resize(this->blobs_.size());
+    for (int i = 0; i < this->blobs_.size(); ++i) {
+      if (!thread_param_diffs_[t][i]) {
+        thread_param_diffs_[t][i].reset(new Blob<Dtype>());
+      }
+      thread_param_diffs_[t][i]->ReshapeLike(*this->blobs_[i]);
+    }
+  }
   bottom_dim_ = bottom[0]->count(channel_axis_);
   top_dim_ = top[0]->count(channel_axis_);
   num_kernels_im2col_ = conv_in_channels_ * conv_out_spatial_dim_;
@@ -256,13 +276,20 @@ void BaseConvolutionLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
 
 template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::forward_cpu_gemm(const Dtype* input,
-    const Dtype* weights, Dtype* output, bool skip_im2col) {
+    const Dtype* weights, Dtype* output, bool skip_im2col, Dtype* col_buffer) {
   const Dtype* col_buff = input;
   if (!is_1x1_) {
-    if (!skip_im2col) {
-      conv_im2col_cpu(input, col_buffer_.mutable_cpu_data());
+    if (col_buffer) {
+      if (!skip_im2col) {
+        conv_im2col_cpu(input, col_buffer);
+      }
+      col_buff = col_buffer;
+    } else {
+      if (!skip_im2col) {
+        conv_im2col_cpu(input, col_buffer_.mutable_cpu_data());
+      }
+      col_buff = col_buffer_.cpu_data();
     }
-    col_buff = col_buffer_.cpu_data();
   }
   for (int g = 0; g < group_; ++g) {
     caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, conv_out_channels_ /
@@ -275,17 +302,72 @@ void BaseConvolutionLayer<Dtype>::forward_cpu_gemm(const Dtype* input,
 template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::forward_cpu_bias(Dtype* output,
     const Dtype* bias) {
+  if (folded_) {
+    // The folded bias exists without a bias term, and bias_multiplier_ may
+    // not; add it while the output is in cache for the ReLU.
+    for (int c = 0; c < num_output_; ++c) {
+      Dtype* output_channel = output + c * out_spatial_dim_;
+      const Dtype channel_bias = bias[c];
+      if (!fold_relu_) {
+        caffe_add_scalar(out_spatial_dim_, channel_bias, output_channel);
+        continue;
+      }
+      for (int i = 0; i < out_spatial_dim_; ++i) {
+        const Dtype value = output_channel[i] + channel_bias;
+        output_channel[i] = value > 0 ? value : value * fold_negative_slope_;
+      }
+    }
+    return;
+  }
   caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, num_output_,
       out_spatial_dim_, 1, (Dtype)1., bias, bias_multiplier_.cpu_data(),
       (Dtype)1., output);
 }
 
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::FoldAffine(const Dtype* scale,
+    const Dtype* shift, bool relu, Dtype negative_slope) {
+  CHECK(!reverse_dimensions()) << "Only convolutions can be folded.";
+  folded_ = true;
+  fold_relu_ = relu;
+  fold_negative_slope_ = negative_slope;
+  // The weights of each output channel are contiguous.
+  folded_weight_.ReshapeLike(*this->blobs_[0]);
+  folded_bias_.Reshape(vector<int>(1, num_output_));
+  const int weight_dim = this->blobs_[0]->count() / num_output_;
+  const Dtype* weight = this->blobs_[0]->cpu_data();
+  const Dtype* bias = bias_term_ ? this->blobs_[1]->cpu_data() : NULL;
+  Dtype* folded_weight = folded_weight_.mutable_cpu_data();
+  Dtype* folded_bias = folded_bias_.mutable_cpu_data();
+  for (int c = 0; c < num_output_; ++c) {
+    caffe_cpu_scale(weight_dim, scale[c], weight + c * weight_dim,
+        folded_weight + c * weight_dim);
+    folded_bias[c] = (bias ? scale[c] * bias[c] : Dtype(0)) + shift[c];
+  }
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::ShareFoldedAffine(
+    const BaseConvolutionLayer& other) {
+  CHECK(other.folded_) << "Layer " << other.layer_param().name()
+      << " is not folded.";
+  folded_ = true;
+  fold_relu_ = other.fold_relu_;
+  fold_negative_slope_ = other.fold_negative_slope_;
+  folded_weight_.ReshapeLike(other.folded_weight_);
+  folded_weight_.ShareData(other.folded_weight_);
+  folded_bias_.ReshapeLike(other.folded_bias_);
+  folded_bias_.ShareData(other.folded_bias_);
+}
+
 template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::backward_cpu_gemm(const Dtype* output,
-    const Dtype* weights, Dtype* input) {
-  Dtype* col_buff = col_buffer_.mutable_cpu_data();
+    const Dtype* weights, Dtype* input, Dtype* col_buffer) {
+  Dtype* col_buff = col_buffer;
   if (is_1x1_) {
     col_buff = input;
+  } else if (!col_buff) {
+    col_buff = col_buffer_.mutable_cpu_data();
   }
   for (int g = 0; g < group_; ++g) {
     caffe_cpu_gemm<Dtype>(CblasTrans, CblasNoTrans, kernel_dim_,
@@ -300,11 +382,16 @@ void BaseConvolutionLayer<Dtype>::backward_cpu_gemm(const Dtype* output,
 
 template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::weight_cpu_gemm(const Dtype* input,
-    const Dtype* output, Dtype* weights) {
+    const Dtype* output, Dtype* weights, Dtype* col_buffer) {
   const Dtype* col_buff = input;
   if (!is_1x1_) {
-    conv_im2col_cpu(input, col_buffer_.mutable_cpu_data());
-    col_buff = col_buffer_.cpu_data();
+    if (col_buffer) {
+      conv_im2col_cpu(input, col_buffer);
+      col_buff = col_buffer;
+    } else {
+      conv_im2col_cpu(input, col_buffer_.mutable_cpu_data());
+      col_buff = col_buffer_.cpu_data();
+    }
   }
   for (int g = 0; g < group_; ++g) {
     caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, conv_out_channels_ / group_,
@@ -321,6 +408,38 @@ void BaseConvolutionLayer<Dtype>::backward_cpu_bias(Dtype* bias,
       input, bias_multiplier_.cpu_data(), 1., bias);
 }
 
+template <typename Dtype>
+vector<Dtype*> BaseConvolutionLayer<Dtype>::thread_col_buffers() {
+  vector<Dtype*> col_buffers(batch_threads_, NULL);
+  if (!is_1x1_) {
+    for (int t = 1; t < batch_threads_; ++t) {
+      col_buffers[t] = thread_col_buffers_[t - 1]->mutable_cpu_data();
+    }
+  }
+  return col_buffers;
+}
+
+template <typename Dtype>
+vector<Dtype*> BaseConvolutionLayer<Dtype>::thread_param_diffs(int param_id,
+    Dtype* param_diff) {
+  vector<Dtype*> param_diffs(batch_threads_, param_diff);
+  for (int t = 1; t < batch_threads_; ++t) {
+    Blob<Dtype>* diff = thread_param_diffs_[t - 1][param_id].get();
+    param_diffs[t] = diff->mutable_cpu_data();
+    caffe_set(diff->count(), Dtype(0), param_diffs[t]);
+  }
+  return param_diffs;
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::reduce_thread_param_diffs(int param_id,
+    const vector<Dtype*>& param_diffs) {
+  const int count = this->blobs_[param_id]->count();
+  for (int t = 1; t < batch_threads_; ++t) {
+    caffe_axpy(count, Dtype(1), param_diffs[t], param_diffs[0]);
+  }
+}
+
 #ifndef CPU_ONLY
 
 template <typename Dtype>
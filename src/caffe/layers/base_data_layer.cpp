@@ -1,3 +1,4 @@
+#include <boost/bind.hpp>
 #include <boost/thread.hpp>
 #include <vector>
 
@@ -8,6 +9,7 @@
 #include "caffe/layers/base_data_layer.hpp"
 #include "caffe/proto/caffe.pb.h"
 #include "caffe/util/blocking_queue.hpp"
+#include "caffe/util/math_functions.hpp"
 
 namespace caffe {
 
@@ -37,7 +39,10 @@ BasePrefetchingDataLayer<Dtype>::BasePrefetchingDataLayer(
     const LayerParameter& param)
     : BaseDataLayer<Dtype>(param),
       prefetch_(param.data_param().prefetch()),
-      prefetch_free_(), prefetch_full_(), prefetch_current_() {
+      prefetch_free_(), prefetch_full_(), prefetch_current_(),
+      decode_pool_(new ThreadPool(
+          ThreadPool::NumThreads(param.data_param().decode_threads()))),
+      read_time_(0), transform_time_(0) {
   for (int i = 0; i < prefetch_.size(); ++i) {
     prefetch_[i].reset(new Batch<Dtype>());
     prefetch_free_.push(prefetch_[i].get());
@@ -109,6 +114,22 @@ void BasePrefetchingDataLayer<Dtype>::InternalThreadEntry() {
 #endif
 }
 
+// Runs the task of one item with the generator of that item.
+static void RunItem(const boost::function<void(int, Caffe::RNG*)>* task,
+    const vector<shared_ptr<Caffe::RNG> >* item_rngs, int item_id) {
+  (*task)(item_id, (*item_rngs)[item_id].get());
+}
+
+template <typename Dtype>
+void BasePrefetchingDataLayer<Dtype>::ForEachItem(int num_items,
+    const boost::function<void(int, Caffe::RNG*)>& task) {
+  item_rngs_.resize(num_items);
+  for (int i = 0; i < num_items; ++i) {
+    item_rngs_[i].reset(new Caffe::RNG(caffe_rng_rand()));
+  }
+  decode_pool_->Run(num_items, boost::bind(&RunItem, &task, &item_rngs_, _1));
+}
+
 template <typename Dtype>
 void BasePrefetchingDataLayer<Dtype>::Forward_cpu(
     const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
@@ -116,6 +137,8 @@ void BasePrefetchingDataLayer<Dtype>::Forward_cpu(
     prefetch_free_.push(prefetch_current_);
   }
   prefetch_current_ = prefetch_full_.pop("Waiting for data");
+  read_time_ += prefetch_current_->read_time_;
+  transform_time_ += prefetch_current_->transform_time_;
   // Reshape to loaded data.
   top[0]->ReshapeLike(prefetch_current_->data_);
   top[0]->set_cpu_data(prefetch_current_->data_.mutable_cpu_data());
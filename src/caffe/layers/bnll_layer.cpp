@@ -2,6 +2,7 @@
 #include <vector>
 
 #include "caffe/layers/bnll_layer.hpp"
+#include "caffe/util/neuron_functions.hpp"
 
 namespace caffe {
 
@@ -13,11 +14,7 @@ void BNLLLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
   const int count = bottom[0]->count();
-  for (int i = 0; i < count; ++i) {
-    top_data[i] = bottom_data[i] > 0 ?
-        bottom_data[i] + log(1. + exp(-bottom_data[i])) :
-        log(1. + exp(bottom_data[i]));
-  }
+  caffe_cpu_bnll(count, bottom_data, top_data);
 }
 
 template <typename Dtype>
@@ -29,11 +26,8 @@ void BNLLLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     const Dtype* top_diff = top[0]->cpu_diff();
     Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
     const int count = bottom[0]->count();
-    Dtype expval;
-    for (int i = 0; i < count; ++i) {
-      expval = exp(std::min(bottom_data[i], Dtype(kBNLL_THRESHOLD)));
-      bottom_diff[i] = top_diff[i] * expval / (expval + 1.);
-    }
+    caffe_cpu_bnll_backward(count, bottom_data, top_diff,
+        Dtype(kBNLL_THRESHOLD), bottom_diff);
   }
 }
 
@@ -1,9 +1,14 @@
 #include <vector>
 
 #include "caffe/layers/clip2img_layer.hpp"
+#include "caffe/util/math_functions.hpp"
 
 namespace caffe {
 
+// The image blob is the clip blob with its channel and depth axes swapped,
+// N x D x C x H x W, with the first two axes merged.
+static const int kClip2ImgOrder[] = {0, 2, 1, 3, 4};
+
 template <typename Dtype>
 void Clip2ImgLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
                                       const vector<Blob<Dtype>*>& top) {
@@ -23,14 +28,25 @@ void Clip2ImgLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
 template <typename Dtype>
 void Clip2ImgLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
                                        const vector<Blob<Dtype>*>& top) {
-  NOT_IMPLEMENTED;
+  caffe_cpu_permute(bottom_axes_,
+      vector<int>(kClip2ImgOrder, kClip2ImgOrder + 5),
+      bottom[0]->cpu_data(), top[0]->mutable_cpu_data());
 }
 
 template <typename Dtype>
 void Clip2ImgLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
                                         const vector<bool>& propagate_down,
                                         const vector<Blob<Dtype>*>& bottom) {
-  NOT_IMPLEMENTED;
+  if (!propagate_down[0]) {
+    return;
+  }
+  vector<int> image_axes(5);
+  for (int i = 0; i < 5; ++i) {
+    image_axes[i] = bottom_axes_[kClip2ImgOrder[i]];
+  }
+  caffe_cpu_permute(image_axes,
+      vector<int>(kClip2ImgOrder, kClip2ImgOrder + 5),
+      top[0]->cpu_diff(), bottom[0]->mutable_cpu_diff());
 }
 
 #ifdef CPU_ONLY
@@ -1,6 +1,8 @@
+#include <boost/bind.hpp>
 #include <vector>
 
 #include "caffe/layers/conv_layer.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
@@ -24,17 +26,33 @@ void ConvolutionLayer<Dtype>::compute_output_shape() {
 template <typename Dtype>
 void ConvolutionLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
-  const Dtype* weight = this->blobs_[0]->cpu_data();
+  const Dtype* weight = this->cpu_forward_weight();
+  const Dtype* bias = this->cpu_forward_bias();
+  const vector<Dtype*> col_buffers = this->thread_col_buffers();
   for (int i = 0; i < bottom.size(); ++i) {
     const Dtype* bottom_data = bottom[i]->cpu_data();
     Dtype* top_data = top[i]->mutable_cpu_data();
-    for (int n = 0; n < this->num_; ++n) {
-      this->forward_cpu_gemm(bottom_data + n * this->bottom_dim_, weight,
-          top_data + n * this->top_dim_);
-      if (this->bias_term_) {
-        const Dtype* bias = this->blobs_[1]->cpu_data();
-        this->forward_cpu_bias(top_data + n * this->top_dim_, bias);
-      }
+    if (this->batch_threads_ > 1) {
+      ThreadPool::Global().Run(this->batch_threads_,
+          boost::bind(&ConvolutionLayer<Dtype>::forward_cpu_thread, this,
+              bottom_data, weight, bias, top_data, &col_buffers, _1));
+    } else {
+      forward_cpu_thread(bottom_data, weight, bias, top_data, &col_buffers, 0);
+    }
+  }
+}
+
+template <typename Dtype>
+void ConvolutionLayer<Dtype>::forward_cpu_thread(const Dtype* bottom_data,
+      const Dtype* weight, const Dtype* bias, Dtype* top_data,
+      const vector<Dtype*>* col_buffers, int thread_id) {
+  Dtype* col_buffer = (*col_buffers)[thread_id];
+  const int batch_end = this->batch_begin(thread_id + 1);
+  for (int n = this->batch_begin(thread_id); n < batch_end; ++n) {
+    this->forward_cpu_gemm(bottom_data + n * this->bottom_dim_, weight,
+        top_data + n * this->top_dim_, false, col_buffer);
+    if (bias) {
+      this->forward_cpu_bias(top_data + n * this->top_dim_, bias);
     }
   }
 }
@@ -42,31 +60,70 @@ void ConvolutionLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
 template <typename Dtype>
 void ConvolutionLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
+  CHECK(!this->folded_) << "Cannot backpropagate a folded convolution.";
   const Dtype* weight = this->blobs_[0]->cpu_data();
-  Dtype* weight_diff = this->blobs_[0]->mutable_cpu_diff();
+  const vector<Dtype*> col_buffers = this->thread_col_buffers();
+  // Each thread accumulates parameter gradients privately; they are summed
+  // into the parameter diffs once the whole batch is done.
+  vector<Dtype*> weight_diffs(this->batch_threads_, NULL);
+  vector<Dtype*> bias_diffs(this->batch_threads_, NULL);
   for (int i = 0; i < top.size(); ++i) {
     const Dtype* top_diff = top[i]->cpu_diff();
     const Dtype* bottom_data = bottom[i]->cpu_data();
-    Dtype* bottom_diff = bottom[i]->mutable_cpu_diff();
-    // Bias gradient, if necessary.
+    Dtype* bottom_diff = propagate_down[i] ? bottom[i]->mutable_cpu_diff()
+        : NULL;
+    if (this->param_propagate_down_[0]) {
+      weight_diffs = this->thread_param_diffs(0,
+          this->blobs_[0]->mutable_cpu_diff());
+    }
     if (this->bias_term_ && this->param_propagate_down_[1]) {
-      Dtype* bias_diff = this->blobs_[1]->mutable_cpu_diff();
-      for (int n = 0; n < this->num_; ++n) {
-        this->backward_cpu_bias(bias_diff, top_diff + n * this->top_dim_);
-      }
+      bias_diffs = this->thread_param_diffs(1,
+          this->blobs_[1]->mutable_cpu_diff());
+    }
+    if (this->batch_threads_ > 1) {
+      ThreadPool::Global().Run(this->batch_threads_,
+          boost::bind(&ConvolutionLayer<Dtype>::backward_cpu_thread, this,
+              top_diff, bottom_data, weight, bottom_diff, &col_buffers,
+              &weight_diffs, &bias_diffs, _1));
+    } else {
+      backward_cpu_thread(top_diff, bottom_data, weight, bottom_diff,
+          &col_buffers, &weight_diffs, &bias_diffs, 0);
     }
-    if (this->param_propagate_down_[0] || propagate_down[i]) {
-      for (int n = 0; n < this->num_; ++n) {
-        // gradient w.r.t. weight. Note that we will accumulate diffs.
-        if (this->param_propagate_down_[0]) {
-          this->weight_cpu_gemm(bottom_data + n * this->bottom_dim_,
-              top_diff + n * this->top_dim_, weight_diff);
-        }
-        // gradient w.r.t. bottom data, if necessary.
-        if (propagate_down[i]) {
-          this->backward_cpu_gemm(top_diff + n * this->top_dim_, weight,
-              bottom_diff + n * this->bottom_dim_);
-        }
+    if (weight_diffs[0]) {
+      this->reduce_thread_param_diffs(0, weight_diffs);
+    }
+    if (bias_diffs[0]) {
+      this->reduce_thread_param_diffs(1, bias_diffs);
+    }
+  }
+}
+
+template <typename Dtype>
+void ConvolutionLayer<Dtype>::backward_cpu_thread(const Dtype* top_diff,
+      const Dtype* bottom_data, const Dtype* weight, Dtype* bottom_diff,
+      const vector<Dtype*>* col_buffers, const vector<Dtype*>* weight_diffs,
+      const vector<Dtype*>* bias_diffs, int thread_id) {
+  Dtype* col_buffer = (*col_buffers)[thread_id];
+  Dtype* weight_diff = (*weight_diffs)[thread_id];
+  Dtype* bias_diff = (*bias_diffs)[thread_id];
+  const int batch_end = this->batch_begin(thread_id + 1);
+  // Bias gradient, if necessary.
+  if (bias_diff) {
+    for (int n = this->batch_begin(thread_id); n < batch_end; ++n) {
+      this->backward_cpu_bias(bias_diff, top_diff + n * this->top_dim_);
+    }
+  }
+  if (weight_diff || bottom_diff) {
+    for (int n = this->batch_begin(thread_id); n < batch_end; ++n) {
+      // gradient w.r.t. weight. Note that we will accumulate diffs.
+      if (weight_diff) {
+        this->weight_cpu_gemm(bottom_data + n * this->bottom_dim_,
+            top_diff + n * this->top_dim_, weight_diff, col_buffer);
+      }
+      // gradient w.r.t. bottom data, if necessary.
+      if (bottom_diff) {
+        this->backward_cpu_gemm(top_diff + n * this->top_dim_, weight,
+            bottom_diff + n * this->bottom_dim_, col_buffer);
       }
     }
   }
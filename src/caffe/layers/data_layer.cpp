@@ -1,13 +1,16 @@
+#include <boost/bind.hpp>
 #ifdef USE_OPENCV
 #include <opencv2/core/core.hpp>
 #endif  // USE_OPENCV
 #include <stdint.h>
 
+#include <string>
 #include <vector>
 
 #include "caffe/data_transformer.hpp"
 #include "caffe/layers/data_layer.hpp"
 #include "caffe/util/benchmark.hpp"
+#include "caffe/util/io.hpp"
 
 namespace caffe {
 
@@ -43,9 +46,7 @@ void DataLayer<Dtype>::DataLayerSetUp(const vector<Blob<Dtype>*>& bottom,
     this->prefetch_[i]->data_.Reshape(top_shape);
   }
   LOG_IF(INFO, Caffe::root_solver())
-      << "output data size: " << top[0]->num() << ","
-      << top[0]->channels() << "," << top[0]->height() << ","
-      << top[0]->width();
+      << "output data size: " << top[0]->shape_string();
   // label
   if (this->output_labels_) {
     vector<int> label_shape(1, batch_size);
@@ -80,54 +81,70 @@ void DataLayer<Dtype>::Next() {
 // This function is called on prefetch thread
 template<typename Dtype>
 void DataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
-  CPUTimer batch_timer;
-  batch_timer.Start();
-  double read_time = 0;
-  double trans_time = 0;
   CPUTimer timer;
   CHECK(batch->data_.count());
   CHECK(this->transformed_data_.count());
   const int batch_size = this->layer_param_.data_param().batch_size();
 
-  Datum datum;
+  // Read the items in order, then parse and transform them in parallel.
+  timer.Start();
+  item_data_.resize(batch_size);
+  item_sizes_.resize(batch_size);
+  values_.resize(batch_size);
   for (int item_id = 0; item_id < batch_size; ++item_id) {
-    timer.Start();
     while (Skip()) {
       Next();
     }
-    datum.ParseFromString(cursor_->value());
-    read_time += timer.MicroSeconds();
-
-    if (item_id == 0) {
-      // Reshape according to the first datum of each batch
-      // on single input batches allows for inputs of varying dimension.
-      // Use data_transformer to infer the expected blob shape from datum.
-      vector<int> top_shape = this->data_transformer_->InferBlobShape(datum);
-      this->transformed_data_.Reshape(top_shape);
-      // Reshape batch according to the batch_size.
-      top_shape[0] = batch_size;
-      batch->data_.Reshape(top_shape);
+    if (!cursor_->value_view(&item_data_[item_id], &item_sizes_[item_id])) {
+      values_[item_id] = cursor_->value();
+      item_data_[item_id] = values_[item_id].data();
+      item_sizes_[item_id] = values_[item_id].size();
     }
-
-    // Apply data transformations (mirror, scale, crop...)
-    timer.Start();
-    int offset = batch->data_.offset(item_id);
-    Dtype* top_data = batch->data_.mutable_cpu_data();
-    this->transformed_data_.set_cpu_data(top_data + offset);
-    this->data_transformer_->Transform(datum, &(this->transformed_data_));
-    // Copy label.
-    if (this->output_labels_) {
-      Dtype* top_label = batch->label_.mutable_cpu_data();
-      top_label[item_id] = datum.label();
-    }
-    trans_time += timer.MicroSeconds();
     Next();
   }
-  timer.Stop();
-  batch_timer.Stop();
-  DLOG(INFO) << "Prefetch batch: " << batch_timer.MilliSeconds() << " ms.";
-  DLOG(INFO) << "     Read time: " << read_time / 1000 << " ms.";
-  DLOG(INFO) << "Transform time: " << trans_time / 1000 << " ms.";
+  batch->read_time_ = timer.MicroSeconds() / 1000;
+
+  timer.Start();
+  // Reshape according to the first datum of each batch
+  // on single input batches allows for inputs of varying dimension.
+  Datum datum;
+  CHECK(datum.ParseFromArray(item_data_[0], item_sizes_[0]));
+  // Use data_transformer to infer the expected blob shape from datum.
+  vector<int> top_shape = this->data_transformer_->InferBlobShape(datum);
+  this->transformed_data_.Reshape(top_shape);
+  // Reshape batch according to the batch_size.
+  top_shape[0] = batch_size;
+  batch->data_.Reshape(top_shape);
+  Dtype* top_data = batch->data_.mutable_cpu_data();
+  Dtype* top_label = NULL;
+  if (this->output_labels_) {
+    top_label = batch->label_.mutable_cpu_data();
+  }
+  this->ForEachItem(batch_size, boost::bind(&DataLayer<Dtype>::load_item,
+      this, _1, _2, top_data, top_label));
+  batch->transform_time_ = timer.MicroSeconds() / 1000;
+}
+
+// This function is called on the decode threads
+template<typename Dtype>
+void DataLayer<Dtype>::load_item(int item_id, Caffe::RNG* rng,
+    Dtype* top_data, Dtype* top_label) {
+  // Leave the pixels in place and transform them from there.
+  Datum datum;
+  const char* data;
+  size_t data_size;
+  CHECK(ParseDatumWithoutData(item_data_[item_id], item_sizes_[item_id],
+      &datum, &data, &data_size)) << "Could not parse datum";
+  // Apply data transformations (mirror, scale, crop...)
+  Blob<Dtype> transformed_item(this->transformed_data_.shape());
+  transformed_item.set_cpu_data(
+      top_data + item_id * transformed_item.count());
+  this->data_transformer_->Transform(datum, data, data_size,
+      &transformed_item, rng);
+  // Copy label.
+  if (top_label) {
+    top_label[item_id] = datum.label();
+  }
 }
 
 INSTANTIATE_CLASS(DataLayer);
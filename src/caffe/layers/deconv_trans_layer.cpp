@@ -1,6 +1,7 @@
 #include <vector>
 
 #include "caffe/layers/deconv_trans_layer.hpp"
+#include "caffe/util/math_functions.hpp"
 
 namespace caffe {
 
@@ -29,71 +30,38 @@ void DeconvTransLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   out_shape.push_back(bottom[0]->shape(3) * stride_[1]);  // Height.
   out_shape.push_back(bottom[0]->shape(4) * stride_[2]);  // Width.
   top[0]->Reshape(out_shape);
+  // Depth to space: channel c * factor + (k * stride_h + j) * stride_w + i
+  // at (d, h, w) of the bottom moves to channel c at
+  // (d * stride_d + k, h * stride_h + j, w * stride_w + i) of the top. Walk
+  // them by n, c, d, k, h, j, i, w, reading bottom rows.
+  const int spatial = bottom[0]->count(2);
+  const int axes[] = {bottom[0]->shape(0), out_shape[1], bottom[0]->shape(2),
+      stride_[0], bottom[0]->shape(3), stride_[1], stride_[2],
+      bottom[0]->shape(4)};
+  const int bottom_strides[] = {bottom[0]->count(1), factor_ * spatial,
+      bottom[0]->count(3), stride_[1] * stride_[2] * spatial,
+      bottom[0]->shape(4), stride_[2] * spatial, spatial, 1};
+  const int top_strides[] = {top[0]->count(1), top[0]->count(2),
+      stride_[0] * top[0]->count(3), top[0]->count(3),
+      stride_[1] * top[0]->count(4), top[0]->count(4), 1, stride_[2]};
+  shuffle_shape_.assign(axes, axes + 8);
+  bottom_strides_.assign(bottom_strides, bottom_strides + 8);
+  top_strides_.assign(top_strides, top_strides + 8);
 }
 
 template<typename Dtype>
 void DeconvTransLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
                                           const vector<Blob<Dtype>*>& top) {
-  const Dtype* bottom_data = bottom[0]->cpu_data();
-  Dtype* top_data = top[0]->mutable_cpu_data();
-  for (int index = 0; index < bottom[0]->num(); ++index) {
-    int num = index;
-    const int w = num % bottom[0]->shape(4);
-    num = num / bottom[0]->shape(4);
-    const int h = num % bottom[0]->shape(3);
-    num = num / bottom[0]->shape(3);
-    const int d = num % bottom[0]->shape(2);
-    num = num / bottom[0]->shape(2);
-    const int c = num % bottom[0]->shape(1);
-    num = num / bottom[0]->shape(1);
-
-    int pos = c % factor_;
-    int i = pos % stride_[2];
-    pos = pos / stride_[2];
-    int j = pos % stride_[1];
-    pos = pos / stride_[1];
-    int k = pos % stride_[0];
-    int out_c = c / factor_;
-
-    const int out_index = num * top[0]->count(1) + out_c * top[0]->count(2)
-        + (d * stride_[0] + k) * top[0]->count(3)
-        + (h * stride_[1] + j) * top[0]->count(4)
-        + w * stride_[2] + i;
-    top_data[out_index] = bottom_data[index];
-  }
+  caffe_cpu_strided_copy(shuffle_shape_, bottom_strides_,
+      bottom[0]->cpu_data(), top_strides_, top[0]->mutable_cpu_data());
 }
 
 template<typename Dtype>
 void DeconvTransLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
                                            const vector<bool>& propagate_down,
                                            const vector<Blob<Dtype>*>& bottom) {
-  Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
-  const Dtype* top_diff = top[0]->cpu_diff();
-  for (int index = 0; index < bottom[0]->num(); ++index) {
-    int num = index;
-    const int w = num % bottom[0]->shape(4);
-    num = num / bottom[0]->shape(4);
-    const int h = num % bottom[0]->shape(3);
-    num = num / bottom[0]->shape(3);
-    const int d = num % bottom[0]->shape(2);
-    num = num / bottom[0]->shape(2);
-    const int c = num % bottom[0]->shape(1);
-    num = num / bottom[0]->shape(1);
-
-    int pos = c % factor_;
-    int i = pos % stride_[2];
-    pos = pos / stride_[2];
-    int j = pos % stride_[1];
-    pos = pos / stride_[1];
-    int k = pos % stride_[0];
-    int out_c = c / factor_;
-
-    const int out_index = num * top[0]->count(1) + out_c * top[0]->count(2)
-        + (d * stride_[0] + k) * top[0]->count(3)
-        + (h * stride_[1] + j) * top[0]->count(4)
-        + w * stride_[2] + i;
-    bottom_diff[index] = top_diff[out_index];
-  }
+  caffe_cpu_strided_copy(shuffle_shape_, top_strides_, top[0]->cpu_diff(),
+      bottom_strides_, bottom[0]->mutable_cpu_diff());
 }
 
 #ifdef CPU_ONLY
@@ -0,0 +1,476 @@
+#include <boost/bind.hpp>
+#include <algorithm>
+#include <vector>
+
+#include "caffe/layers/direct_conv_layer.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+namespace caffe {
+
+// Output channels accumulated together, and the output depth, rows and
+// columns of a tile. The accumulators of a tile (8 KB of floats) stay in L1,
+// and for 3x3x3 kernels a tile reads a 4 x 4 x 18 block of each input
+// channel, whose rows are shared by the output rows of the tile instead of
+// being reread for each of them. 32 channels also keeps GCC from unrolling
+// the channel loop completely and vectorizing the column loop instead.
+static const int kBlockChannels = 32;
+static const int kTileDepth = 2;
+static const int kTileHeight = 2;
+static const int kTileWidth = 16;
+
+// Output channels of a group rounded up to whole blocks. The packed filters
+// are zero-padded to this width so that the inner loops always run over
+// kBlockChannels, a trip count the compiler vectorizes even at -O2.
+static inline int packed_channels(int out_channels) {
+  return (out_channels + kBlockChannels - 1) / kBlockChannels
+      * kBlockChannels;
+}
+
+// The range [begin, end) of output columns whose input column
+// o * stride - pad + offset lies inside [0, width).
+static inline void valid_columns(int offset, int stride, int pad, int width,
+    int out_width, int* begin, int* end) {
+  const int lo = pad - offset;
+  *begin = lo <= 0 ? 0 : (lo + stride - 1) / stride;
+  const int hi = width - 1 + pad - offset;
+  *end = hi < 0 ? 0 : std::min(out_width, hi / stride + 1);
+}
+
+template <typename Dtype>
+void DirectConvolutionLayer<Dtype>::Reshape(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  ConvolutionLayer<Dtype>::Reshape(bottom, top);
+  const int num_axes = this->num_spatial_axes_;
+  use_direct_ = num_axes == 2 || num_axes == 3;
+  if (!use_direct_) {
+    return;
+  }
+  const int* kernel_shape_data = this->kernel_shape_.cpu_data();
+  const int* stride_data = this->stride_.cpu_data();
+  const int* pad_data = this->pad_.cpu_data();
+  const int* dilation_data = this->dilation_.cpu_data();
+  for (int i = 0; i < 3; ++i) {
+    const int axis = i - (3 - num_axes);
+    if (axis < 0) {
+      in_dims_[i] = out_dims_[i] = kernel_dims_[i] = 1;
+      stride_dims_[i] = dilation_dims_[i] = 1;
+      pad_dims_[i] = 0;
+    } else {
+      in_dims_[i] = this->input_shape(axis + 1);
+      out_dims_[i] = this->output_shape_[axis];
+      kernel_dims_[i] = kernel_shape_data[axis];
+      stride_dims_[i] = stride_data[axis];
+      pad_dims_[i] = pad_data[axis];
+      dilation_dims_[i] = dilation_data[axis];
+    }
+  }
+  vector<int> packed_shape(3);
+  packed_shape[0] = this->group_;
+  packed_shape[1] = this->blobs_[0]->count(1);
+  packed_shape[2] = packed_channels(this->num_output_ / this->group_);
+  if (packed_weight_.shape() != packed_shape) {
+    packed_weight_.Reshape(packed_shape);
+    packed_memory_.reset();
+  }
+  packed_weight_diffs_.resize(this->batch_threads_);
+  for (int t = 0; t < this->batch_threads_; ++t) {
+    if (!packed_weight_diffs_[t]) {
+      packed_weight_diffs_[t].reset(new Blob<Dtype>());
+    }
+    packed_weight_diffs_[t]->Reshape(packed_shape);
+  }
+}
+
+template <typename Dtype>
+void DirectConvolutionLayer<Dtype>::pack_weights(const Dtype* weight,
+    Dtype* packed_weight) {
+  const int in_channels = this->channels_ / this->group_;
+  const int out_channels = this->num_output_ / this->group_;
+  const int kernel_dim = this->blobs_[0]->count(2);
+  const int packed_out = packed_channels(out_channels);
+  caffe_set(packed_weight_.count(), Dtype(0), packed_weight);
+  for (int g = 0; g < this->group_; ++g) {
+    for (int m = 0; m < out_channels; ++m) {
+      const Dtype* w = weight + (g * out_channels + m) * in_channels
+          * kernel_dim;
+      Dtype* p = packed_weight + g * in_channels * kernel_dim * packed_out
+          + m;
+      for (int ck = 0; ck < in_channels * kernel_dim; ++ck) {
+        p[ck * packed_out] = w[ck];
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+const Dtype* DirectConvolutionLayer<Dtype>::packed_weight() {
+  const shared_ptr<SyncedMemory>& memory = this->folded_ ?
+      this->folded_weight_.data() : this->blobs_[0]->data();
+  if (memory != packed_memory_ || memory->version() != packed_version_) {
+    pack_weights(this->cpu_forward_weight(),
+        packed_weight_.mutable_cpu_data());
+    packed_memory_ = memory;
+    packed_version_ = memory->version();
+  }
+  return packed_weight_.cpu_data();
+}
+
+template <typename Dtype>
+void DirectConvolutionLayer<Dtype>::unpack_add_weights(
+    const Dtype* packed_weight, Dtype* weight) {
+  const int in_channels = this->channels_ / this->group_;
+  const int out_channels = this->num_output_ / this->group_;
+  const int kernel_dim = this->blobs_[0]->count(2);
+  const int packed_out = packed_channels(out_channels);
+  for (int g = 0; g < this->group_; ++g) {
+    for (int m = 0; m < out_channels; ++m) {
+      Dtype* w = weight + (g * out_channels + m) * in_channels * kernel_dim;
+      const Dtype* p = packed_weight
+          + g * in_channels * kernel_dim * packed_out + m;
+      for (int ck = 0; ck < in_channels * kernel_dim; ++ck) {
+        w[ck] += p[ck * packed_out];
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+void DirectConvolutionLayer<Dtype>::direct_forward(const Dtype* input,
+    const Dtype* packed_weight, Dtype* output) {
+  const int in_channels = this->channels_ / this->group_;
+  const int out_channels = this->num_output_ / this->group_;
+  const int kernel_dim = kernel_dims_[0] * kernel_dims_[1] * kernel_dims_[2];
+  const int packed_out = packed_channels(out_channels);
+  const int in_width = in_dims_[2];
+  const int out_width = out_dims_[2];
+  const int in_slice = in_dims_[0] * in_dims_[1] * in_width;
+  const int out_slice = out_dims_[0] * out_dims_[1] * out_width;
+  Dtype acc[kTileDepth * kTileHeight * kTileWidth * kBlockChannels];
+  // The output columns of the current tile valid for each kw.
+  vector<int> col_begin(kernel_dims_[2]), col_end(kernel_dims_[2]);
+  for (int g = 0; g < this->group_; ++g) {
+    const Dtype* group_input = input + g * in_channels * in_slice;
+    const Dtype* group_weight = packed_weight
+        + g * in_channels * kernel_dim * packed_out;
+    Dtype* group_output = output + g * out_channels * out_slice;
+    for (int od0 = 0; od0 < out_dims_[0]; od0 += kTileDepth) {
+      const int od1 = std::min(od0 + kTileDepth, out_dims_[0]);
+      for (int oh0 = 0; oh0 < out_dims_[1]; oh0 += kTileHeight) {
+        const int oh1 = std::min(oh0 + kTileHeight, out_dims_[1]);
+        for (int ow0 = 0; ow0 < out_width; ow0 += kTileWidth) {
+          const int ow1 = std::min(ow0 + kTileWidth, out_width);
+          for (int kw = 0; kw < kernel_dims_[2]; ++kw) {
+            valid_columns(kw * dilation_dims_[2], stride_dims_[2],
+                pad_dims_[2], in_width, out_width, &col_begin[kw],
+                &col_end[kw]);
+            col_begin[kw] = std::max(col_begin[kw], ow0);
+            col_end[kw] = std::min(col_end[kw], ow1);
+          }
+          for (int m0 = 0; m0 < out_channels; m0 += kBlockChannels) {
+            const int mb = std::min(kBlockChannels, out_channels - m0);
+            // The accumulators of one output row of the tile.
+            const int row_size = (ow1 - ow0) * kBlockChannels;
+            std::fill(acc, acc + (od1 - od0) * (oh1 - oh0) * row_size,
+                Dtype(0));
+            for (int c = 0; c < in_channels; ++c) {
+              const Dtype* channel_input = group_input + c * in_slice;
+              const Dtype* channel_weight = group_weight
+                  + c * kernel_dim * packed_out + m0;
+              for (int od = od0; od < od1; ++od) {
+                for (int kd = 0; kd < kernel_dims_[0]; ++kd) {
+                  const int id = od * stride_dims_[0] - pad_dims_[0]
+                      + kd * dilation_dims_[0];
+                  if (id < 0 || id >= in_dims_[0]) { continue; }
+                  for (int oh = oh0; oh < oh1; ++oh) {
+                    Dtype* row_acc = acc
+                        + ((od - od0) * (oh1 - oh0) + oh - oh0) * row_size;
+                    for (int kh = 0; kh < kernel_dims_[1]; ++kh) {
+                      const int ih = oh * stride_dims_[1] - pad_dims_[1]
+                          + kh * dilation_dims_[1];
+                      if (ih < 0 || ih >= in_dims_[1]) { continue; }
+                      const Dtype* in_row = channel_input
+                          + (id * in_dims_[1] + ih) * in_width;
+                      for (int kw = 0; kw < kernel_dims_[2]; ++kw) {
+                        const int offset = kw * dilation_dims_[2];
+                        const int begin = col_begin[kw];
+                        const int end = col_end[kw];
+                        const Dtype* kernel_weight = channel_weight + ((kd
+                            * kernel_dims_[1] + kh) * kernel_dims_[2] + kw)
+                            * packed_out;
+                        // A local copy, which cannot alias the accumulators.
+                        Dtype w[kBlockChannels];
+                        std::copy(kernel_weight,
+                            kernel_weight + kBlockChannels, w);
+                        const Dtype* x = in_row - pad_dims_[2] + offset;
+                        for (int ow = begin; ow < end; ++ow) {
+                          const Dtype xi = x[ow * stride_dims_[2]];
+                          Dtype* a = row_acc + (ow - ow0) * kBlockChannels;
+                          for (int m = 0; m < kBlockChannels; ++m) {
+                            a[m] += xi * w[m];
+                          }
+                        }
+                      }
+                    }
+                  }
+                }
+              }
+            }
+            for (int od = od0; od < od1; ++od) {
+              for (int oh = oh0; oh < oh1; ++oh) {
+                const int out_row = (od * out_dims_[1] + oh) * out_width;
+                const Dtype* row_acc = acc
+                    + ((od - od0) * (oh1 - oh0) + oh - oh0) * row_size;
+                for (int m = 0; m < mb; ++m) {
+                  Dtype* out = group_output + (m0 + m) * out_slice + out_row;
+                  for (int ow = ow0; ow < ow1; ++ow) {
+                    out[ow] = row_acc[(ow - ow0) * kBlockChannels + m];
+                  }
+                }
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+void DirectConvolutionLayer<Dtype>::direct_backward(const Dtype* input,
+    const Dtype* output_diff, const Dtype* packed_weight, Dtype* input_diff,
+    Dtype* packed_weight_diff) {
+  const int in_channels = this->channels_ / this->group_;
+  const int out_channels = this->num_output_ / this->group_;
+  const int kernel_dim = kernel_dims_[0] * kernel_dims_[1] * kernel_dims_[2];
+  const int packed_out = packed_channels(out_channels);
+  const int in_width = in_dims_[2];
+  const int out_width = out_dims_[2];
+  const int in_slice = in_dims_[0] * in_dims_[1] * in_width;
+  const int out_slice = out_dims_[0] * out_dims_[1] * out_width;
+  if (input_diff) {
+    caffe_set(this->bottom_dim_, Dtype(0), input_diff);
+  }
+  // A tile of the output diff, transposed so that channels are innermost.
+  Dtype tile[kTileDepth * kTileHeight * kTileWidth * kBlockChannels];
+  // The output columns of the current tile valid for each kw.
+  vector<int> col_begin(kernel_dims_[2]), col_end(kernel_dims_[2]);
+  for (int g = 0; g < this->group_; ++g) {
+    const int group_in = g * in_channels * in_slice;
+    const int group_weight = g * in_channels * kernel_dim * packed_out;
+    const Dtype* group_output_diff = output_diff
+        + g * out_channels * out_slice;
+    for (int od0 = 0; od0 < out_dims_[0]; od0 += kTileDepth) {
+      const int od1 = std::min(od0 + kTileDepth, out_dims_[0]);
+      for (int oh0 = 0; oh0 < out_dims_[1]; oh0 += kTileHeight) {
+        const int oh1 = std::min(oh0 + kTileHeight, out_dims_[1]);
+        for (int ow0 = 0; ow0 < out_width; ow0 += kTileWidth) {
+          const int ow1 = std::min(ow0 + kTileWidth, out_width);
+          for (int kw = 0; kw < kernel_dims_[2]; ++kw) {
+            valid_columns(kw * dilation_dims_[2], stride_dims_[2],
+                pad_dims_[2], in_width, out_width, &col_begin[kw],
+                &col_end[kw]);
+            col_begin[kw] = std::max(col_begin[kw], ow0);
+            col_end[kw] = std::min(col_end[kw], ow1);
+          }
+          for (int m0 = 0; m0 < out_channels; m0 += kBlockChannels) {
+            const int mb = std::min(kBlockChannels, out_channels - m0);
+            const int row_size = (ow1 - ow0) * kBlockChannels;
+            if (mb < kBlockChannels) {
+              std::fill(tile, tile + (od1 - od0) * (oh1 - oh0) * row_size,
+                  Dtype(0));
+            }
+            for (int od = od0; od < od1; ++od) {
+              for (int oh = oh0; oh < oh1; ++oh) {
+                const int out_row = (od * out_dims_[1] + oh) * out_width;
+                Dtype* row_tile = tile
+                    + ((od - od0) * (oh1 - oh0) + oh - oh0) * row_size;
+                for (int m = 0; m < mb; ++m) {
+                  const Dtype* diff = group_output_diff
+                      + (m0 + m) * out_slice + out_row;
+                  for (int ow = ow0; ow < ow1; ++ow) {
+                    row_tile[(ow - ow0) * kBlockChannels + m] = diff[ow];
+                  }
+                }
+              }
+            }
+            for (int c = 0; c < in_channels; ++c) {
+              for (int od = od0; od < od1; ++od) {
+                for (int kd = 0; kd < kernel_dims_[0]; ++kd) {
+                  const int id = od * stride_dims_[0] - pad_dims_[0]
+                      + kd * dilation_dims_[0];
+                  if (id < 0 || id >= in_dims_[0]) { continue; }
+                  for (int oh = oh0; oh < oh1; ++oh) {
+                    const Dtype* row_tile = tile
+                        + ((od - od0) * (oh1 - oh0) + oh - oh0) * row_size;
+                    for (int kh = 0; kh < kernel_dims_[1]; ++kh) {
+                      const int ih = oh * stride_dims_[1] - pad_dims_[1]
+                          + kh * dilation_dims_[1];
+                      if (ih < 0 || ih >= in_dims_[1]) { continue; }
+                      const int in_row = group_in + c * in_slice
+                          + (id * in_dims_[1] + ih) * in_width;
+                      for (int kw = 0; kw < kernel_dims_[2]; ++kw) {
+                        const int offset = kw * dilation_dims_[2];
+                        const int begin = col_begin[kw];
+                        const int end = col_end[kw];
+                        const int k = (kd * kernel_dims_[1] + kh)
+                            * kernel_dims_[2] + kw;
+                        const int w_offset = group_weight
+                            + (c * kernel_dim + k) * packed_out + m0;
+                        const int iw0 = in_row - pad_dims_[2] + offset;
+                        if (input_diff) {
+                          const Dtype* w = packed_weight + w_offset;
+                          for (int ow = begin; ow < end; ++ow) {
+                            const Dtype* t = row_tile
+                                + (ow - ow0) * kBlockChannels;
+                            Dtype sum = 0;
+                            for (int m = 0; m < kBlockChannels; ++m) {
+                              sum += w[m] * t[m];
+                            }
+                            input_diff[iw0 + ow * stride_dims_[2]] += sum;
+                          }
+                        }
+                        if (packed_weight_diff) {
+                          Dtype w_diff[kBlockChannels] = {0};
+                          for (int ow = begin; ow < end; ++ow) {
+                            const Dtype x = input[iw0 + ow * stride_dims_[2]];
+                            const Dtype* t = row_tile
+                                + (ow - ow0) * kBlockChannels;
+                            for (int m = 0; m < kBlockChannels; ++m) {
+                              w_diff[m] += x * t[m];
+                            }
+                          }
+                          Dtype* diff = packed_weight_diff + w_offset;
+                          for (int m = 0; m < kBlockChannels; ++m) {
+                            diff[m] += w_diff[m];
+                          }
+                        }
+                      }
+                    }
+                  }
+                }
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+void DirectConvolutionLayer<Dtype>::Forward_cpu(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  if (!use_direct_) {
+    ConvolutionLayer<Dtype>::Forward_cpu(bottom, top);
+    return;
+  }
+  const Dtype* packed_weight = this->packed_weight();
+  const Dtype* bias = this->cpu_forward_bias();
+  for (int i = 0; i < bottom.size(); ++i) {
+    const Dtype* bottom_data = bottom[i]->cpu_data();
+    Dtype* top_data = top[i]->mutable_cpu_data();
+    if (this->batch_threads_ > 1) {
+      ThreadPool::Global().Run(this->batch_threads_,
+          boost::bind(&DirectConvolutionLayer<Dtype>::forward_direct_thread,
+              this, bottom_data, packed_weight, bias, top_data, _1));
+    } else {
+      forward_direct_thread(bottom_data, packed_weight, bias, top_data, 0);
+    }
+  }
+}
+
+template <typename Dtype>
+void DirectConvolutionLayer<Dtype>::forward_direct_thread(
+    const Dtype* bottom_data, const Dtype* packed_weight, const Dtype* bias,
+    Dtype* top_data, int thread_id) {
+  const int batch_end = this->batch_begin(thread_id + 1);
+  for (int n = this->batch_begin(thread_id); n < batch_end; ++n) {
+    direct_forward(bottom_data + n * this->bottom_dim_, packed_weight,
+        top_data + n * this->top_dim_);
+    if (bias) {
+      this->forward_cpu_bias(top_data + n * this->top_dim_, bias);
+    }
+  }
+}
+
+template <typename Dtype>
+void DirectConvolutionLayer<Dtype>::Backward_cpu(
+    const vector<Blob<Dtype>*>& top, const vector<bool>& propagate_down,
+    const vector<Blob<Dtype>*>& bottom) {
+  if (!use_direct_) {
+    ConvolutionLayer<Dtype>::Backward_cpu(top, propagate_down, bottom);
+    return;
+  }
+  CHECK(!this->folded_) << "Cannot backpropagate a folded convolution.";
+  const Dtype* packed_weight = this->packed_weight();
+  vector<Dtype*> weight_diffs(this->batch_threads_, NULL);
+  vector<Dtype*> bias_diffs(this->batch_threads_, NULL);
+  vector<Dtype*> packed_weight_diffs(this->batch_threads_, NULL);
+  for (int i = 0; i < top.size(); ++i) {
+    const Dtype* top_diff = top[i]->cpu_diff();
+    const Dtype* bottom_data = bottom[i]->cpu_data();
+    Dtype* bottom_diff = propagate_down[i] ? bottom[i]->mutable_cpu_diff()
+        : NULL;
+    if (this->param_propagate_down_[0]) {
+      weight_diffs = this->thread_param_diffs(0,
+          this->blobs_[0]->mutable_cpu_diff());
+      for (int t = 0; t < this->batch_threads_; ++t) {
+        packed_weight_diffs[t] = packed_weight_diffs_[t]->mutable_cpu_data();
+        caffe_set(packed_weight_diffs_[t]->count(), Dtype(0),
+            packed_weight_diffs[t]);
+      }
+    }
+    if (this->bias_term_ && this->param_propagate_down_[1]) {
+      bias_diffs = this->thread_param_diffs(1,
+          this->blobs_[1]->mutable_cpu_diff());
+    }
+    if (this->batch_threads_ > 1) {
+      ThreadPool::Global().Run(this->batch_threads_,
+          boost::bind(&DirectConvolutionLayer<Dtype>::backward_direct_thread,
+              this, top_diff, bottom_data, packed_weight, bottom_diff,
+              &packed_weight_diffs, &weight_diffs, &bias_diffs, _1));
+    } else {
+      backward_direct_thread(top_diff, bottom_data, packed_weight,
+          bottom_diff, &packed_weight_diffs, &weight_diffs, &bias_diffs, 0);
+    }
+    if (weight_diffs[0]) {
+      this->reduce_thread_param_diffs(0, weight_diffs);
+    }
+    if (bias_diffs[0]) {
+      this->reduce_thread_param_diffs(1, bias_diffs);
+    }
+  }
+}
+
+template <typename Dtype>
+void DirectConvolutionLayer<Dtype>::backward_direct_thread(
+    const Dtype* top_diff, const Dtype* bottom_data,
+    const Dtype* packed_weight, Dtype* bottom_diff,
+    const vector<Dtype*>* packed_weight_diffs,
+    const vector<Dtype*>* weight_diffs, const vector<Dtype*>* bias_diffs,
+    int thread_id) {
+  Dtype* packed_weight_diff = (*packed_weight_diffs)[thread_id];
+  Dtype* bias_diff = (*bias_diffs)[thread_id];
+  const int batch_end = this->batch_begin(thread_id + 1);
+  if (bias_diff) {
+    for (int n = this->batch_begin(thread_id); n < batch_end; ++n) {
+      this->backward_cpu_bias(bias_diff, top_diff + n * this->top_dim_);
+    }
+  }
+  if (packed_weight_diff || bottom_diff) {
+    for (int n = this->batch_begin(thread_id); n < batch_end; ++n) {
+      direct_backward(bottom_data + n * this->bottom_dim_,
+          top_diff + n * this->top_dim_, packed_weight,
+          bottom_diff ? bottom_diff + n * this->bottom_dim_ : NULL,
+          packed_weight_diff);
+    }
+  }
+  if (packed_weight_diff) {
+    unpack_add_weights(packed_weight_diff, (*weight_diffs)[thread_id]);
+  }
+}
+
+INSTANTIATE_CLASS(DirectConvolutionLayer);
+
+}  // namespace caffe
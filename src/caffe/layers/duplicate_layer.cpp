@@ -1,6 +1,7 @@
 #include <vector>
 
 #include "caffe/layers/duplicate_layer.hpp"
+#include "caffe/util/math_functions.hpp"
 
 namespace caffe {
 
@@ -21,51 +22,39 @@ void DuplicateLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   out_shape.push_back(bottom[0]->shape(2));  // Depth.
   out_shape.push_back(bottom[0]->shape(3));  // Height.
   top[0]->Reshape(out_shape);
+  // Each item of the bottom is copied to duplicates_ items in a row.
+  const int axes[] = {bottom[0]->shape(0), duplicates_, bottom[0]->count(1)};
+  const int bottom_strides[] = {bottom[0]->count(1), 0, 1};
+  const int top_strides[] = {duplicates_ * top[0]->count(1),
+      top[0]->count(1), 1};
+  shuffle_shape_.assign(axes, axes + 3);
+  bottom_strides_.assign(bottom_strides, bottom_strides + 3);
+  top_strides_.assign(top_strides, top_strides + 3);
 }
 
 template<typename Dtype>
 void DuplicateLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
                                           const vector<Blob<Dtype>*>& top) {
-  const Dtype* bottom_data = bottom[0]->cpu_data();
-  Dtype* top_data = top[0]->mutable_cpu_data();
-  for (int index = 0; index < bottom[0]->count(); ++index) {
-    int num = index;
-    const int w = num % bottom[0]->shape(3);
-    num = num / bottom[0]->shape(3);
-    const int h = num % bottom[0]->shape(2);
-    num = num / bottom[0]->shape(2);
-    const int c = num % bottom[0]->shape(1);
-    num = num / bottom[0]->shape(1);
-
-    for (int i = 0; i < duplicates_; ++i) {
-      const int out_index = (num * duplicates_ + i) * top[0]->count(1)
-           + c * top[0]->count(2) + h * top[0]->count(3) + w;
-      top_data[out_index] = bottom_data[index];
-    }
-  }
+  caffe_cpu_strided_copy(shuffle_shape_, bottom_strides_,
+      bottom[0]->cpu_data(), top_strides_, top[0]->mutable_cpu_data());
 }
 
 template<typename Dtype>
 void DuplicateLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
                                            const vector<bool>& propagate_down,
                                            const vector<Blob<Dtype>*>& bottom) {
+  // Sum the duplicates of each item, one row at a time.
   Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
   const Dtype* top_diff = top[0]->cpu_diff();
-  for (int index = 0; index < bottom[0]->count(); ++index) {
-    int num = index;
-    const int w = num % bottom[0]->shape(3);
-    num = num / bottom[0]->shape(3);
-    const int h = num % bottom[0]->shape(2);
-    num = num / bottom[0]->shape(2);
-    const int c = num % bottom[0]->shape(1);
-    num = num / bottom[0]->shape(1);
-
-    bottom_diff[index] = 0;
-    for (int i = 0; i < duplicates_; ++i) {
-      const int out_index = (num * duplicates_ + i) * top[0]->count(1)
-          + c * top[0]->count(2) + h * top[0]->count(3) + w;
-      bottom_diff[index] += top_diff[out_index];
+  const int dim = bottom[0]->count(1);
+  for (int n = 0; n < bottom[0]->shape(0); ++n) {
+    caffe_copy(dim, top_diff, bottom_diff);
+    top_diff += dim;
+    for (int i = 1; i < duplicates_; ++i) {
+      caffe_axpy(dim, Dtype(1), top_diff, bottom_diff);
+      top_diff += dim;
     }
+    bottom_diff += dim;
   }
 }
 
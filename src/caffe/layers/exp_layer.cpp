@@ -2,6 +2,7 @@
 
 #include "caffe/layers/exp_layer.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/neuron_functions.hpp"
 
 namespace caffe {
 
@@ -33,15 +34,8 @@ void ExpLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   const int count = bottom[0]->count();
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
-  if (inner_scale_ == Dtype(1)) {
-    caffe_exp(count, bottom_data, top_data);
-  } else {
-    caffe_cpu_scale(count, inner_scale_, bottom_data, top_data);
-    caffe_exp(count, top_data, top_data);
-  }
-  if (outer_scale_ != Dtype(1)) {
-    caffe_scal(count, outer_scale_, top_data);
-  }
+  caffe_cpu_scaled_exp(count, bottom_data, inner_scale_, outer_scale_,
+      top_data);
 }
 
 template <typename Dtype>
@@ -52,10 +46,8 @@ void ExpLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
   const Dtype* top_data = top[0]->cpu_data();
   const Dtype* top_diff = top[0]->cpu_diff();
   Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
-  caffe_mul(count, top_data, top_diff, bottom_diff);
-  if (inner_scale_ != Dtype(1)) {
-    caffe_scal(count, inner_scale_, bottom_diff);
-  }
+  caffe_cpu_scaled_exp_backward(count, top_data, top_diff, inner_scale_,
+      bottom_diff);
 }
 
 #ifdef CPU_ONLY
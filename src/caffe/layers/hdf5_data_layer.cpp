@@ -1,11 +1,5 @@
-/*
-TODO:
-- load file in a separate thread ("prefetch")
-- can be smarter about the memcpy call instead of doing it row-by-row
-  :: use util functions caffe_copy, and Blob->offset()
-  :: don't forget to update hdf5_daa_layer.cu accordingly
-- add ability to shuffle filenames if flag is set
-*/
+#include <boost/thread.hpp>
+#include <algorithm>
 #include <fstream>  // NOLINT(readability/streams)
 #include <string>
 #include <vector>
@@ -16,13 +10,16 @@ TODO:
 
 #include "caffe/layers/hdf5_data_layer.hpp"
 #include "caffe/util/hdf5.hpp"
+#include "caffe/util/rng.hpp"
 
 namespace caffe {
 
 template <typename Dtype>
-HDF5DataLayer<Dtype>::~HDF5DataLayer<Dtype>() { }
+HDF5DataLayer<Dtype>::~HDF5DataLayer<Dtype>() {
+  this->StopInternalThread();
+}
 
-// Load data and label from HDF5 filename into the class property blobs.
+// Load data and label from HDF5 filename into chunks of rows.
 template <typename Dtype>
 void HDF5DataLayer<Dtype>::LoadHDF5FileData(const char* filename) {
   DLOG(INFO) << "Loading HDF5 file: " << filename;
@@ -31,41 +28,84 @@ void HDF5DataLayer<Dtype>::LoadHDF5FileData(const char* filename) {
     LOG(FATAL) << "Failed opening HDF5 file: " << filename;
   }
 
+  const HDF5DataParameter& param = this->layer_param_.hdf5_data_param();
   int top_size = this->layer_param_.top_size();
-  hdf_blobs_.resize(top_size);
-
   const int MIN_DATA_DIM = 1;
   const int MAX_DATA_DIM = INT_MAX;
 
+  // Only the shapes are read here; no memory is allocated for them.
+  int num = 0;
   for (int i = 0; i < top_size; ++i) {
-    hdf_blobs_[i] = shared_ptr<Blob<Dtype> >(new Blob<Dtype>());
-    // Allow reshape here, as we are loading data not params
-    hdf5_load_nd_dataset(file_id, this->layer_param_.top(i).c_str(),
-        MIN_DATA_DIM, MAX_DATA_DIM, hdf_blobs_[i].get(), true);
+    Blob<Dtype> dataset_shape;
+    hdf5_load_nd_dataset_helper(file_id, this->layer_param_.top(i).c_str(),
+        MIN_DATA_DIM, MAX_DATA_DIM, &dataset_shape, true);
+    if (i == 0) {
+      num = dataset_shape.shape(0);
+    } else {
+      CHECK_EQ(dataset_shape.shape(0), num);
+    }
+  }
+  CHECK_GT(num, 0) << "No rows in HDF5 file: " << filename;
+
+  const int chunk_size = param.chunk_size() > 0 ?
+      std::min<int>(param.chunk_size(), num) : num;
+  vector<int> chunk_begins;
+  for (int begin = 0; begin < num; begin += chunk_size) {
+    chunk_begins.push_back(begin);
+  }
+  if (param.shuffle()) {
+    shuffle(chunk_begins.begin(), chunk_begins.end());
+  }
+
+  try {
+    for (int c = 0; c < chunk_begins.size(); ++c) {
+      HDF5Chunk<Dtype>* chunk = chunk_free_.pop();
+      const int rows = std::min(chunk_size, num - chunk_begins[c]);
+      for (int i = 0; i < top_size; ++i) {
+        hdf5_load_nd_dataset_rows(file_id, this->layer_param_.top(i).c_str(),
+            MIN_DATA_DIM, MAX_DATA_DIM, chunk_begins[c], rows,
+            chunk->blobs_[i].get());
+      }
+      chunk->order_.clear();
+      if (param.shuffle()) {
+        for (int i = 0; i < rows; ++i) {
+          chunk->order_.push_back(i);
+        }
+        shuffle(chunk->order_.begin(), chunk->order_.end());
+      }
+      chunk_full_.push(chunk);
+    }
+  } catch (boost::thread_interrupted&) {
+    H5Fclose(file_id);
+    throw;
   }
 
   herr_t status = H5Fclose(file_id);
   CHECK_GE(status, 0) << "Failed to close HDF5 file: " << filename;
+  DLOG(INFO) << "Successfully loaded " << num << " rows in "
+             << chunk_begins.size() << " chunks";
+}
 
-  // MinTopBlobs==1 guarantees at least one top blob
-  CHECK_GE(hdf_blobs_[0]->num_axes(), 1) << "Input must have at least 1 axis.";
-  const int num = hdf_blobs_[0]->shape(0);
-  for (int i = 1; i < top_size; ++i) {
-    CHECK_EQ(hdf_blobs_[i]->shape(0), num);
-  }
+template <typename Dtype>
+void HDF5DataLayer<Dtype>::InternalThreadEntry() {
+  vector<unsigned int> file_permutation(num_files_);
   // Default to identity permutation.
-  data_permutation_.clear();
-  data_permutation_.resize(hdf_blobs_[0]->shape(0));
-  for (int i = 0; i < hdf_blobs_[0]->shape(0); i++)
-    data_permutation_[i] = i;
-
-  // Shuffle if needed.
-  if (this->layer_param_.hdf5_data_param().shuffle()) {
-    std::random_shuffle(data_permutation_.begin(), data_permutation_.end());
-    DLOG(INFO) << "Successfully loaded " << hdf_blobs_[0]->shape(0)
-               << " rows (shuffled)";
-  } else {
-    DLOG(INFO) << "Successfully loaded " << hdf_blobs_[0]->shape(0) << " rows";
+  for (int i = 0; i < num_files_; i++) {
+    file_permutation[i] = i;
+  }
+  try {
+    while (!must_stop()) {
+      // Shuffle if needed.
+      if (this->layer_param_.hdf5_data_param().shuffle()) {
+        shuffle(file_permutation.begin(), file_permutation.end());
+      }
+      for (int i = 0; i < num_files_; ++i) {
+        LoadHDF5FileData(hdf_filenames_[file_permutation[i]].c_str());
+      }
+      DLOG(INFO) << "Looping around to first file.";
+    }
+  } catch (boost::thread_interrupted&) {
+    // Interrupted exception is expected on shutdown
   }
 }
 
@@ -90,37 +130,37 @@ void HDF5DataLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
   }
   source_file.close();
   num_files_ = hdf_filenames_.size();
-  current_file_ = 0;
   LOG(INFO) << "Number of HDF5 files: " << num_files_;
   CHECK_GE(num_files_, 1) << "Must have at least 1 HDF5 filename listed in "
     << source;
 
-  file_permutation_.clear();
-  file_permutation_.resize(num_files_);
-  // Default to identity permutation.
-  for (int i = 0; i < num_files_; i++) {
-    file_permutation_[i] = i;
-  }
-
-  // Shuffle if needed.
-  if (this->layer_param_.hdf5_data_param().shuffle()) {
-    std::random_shuffle(file_permutation_.begin(), file_permutation_.end());
+  // Start streaming the files and wait for the first chunk. A repeated
+  // SetUp starts over from the first file.
+  this->StopInternalThread();
+  HDF5Chunk<Dtype>* chunk;
+  while (chunk_free_.try_pop(&chunk)) {}
+  while (chunk_full_.try_pop(&chunk)) {}
+  const int top_size = this->layer_param_.top_size();
+  const int prefetch = this->layer_param_.hdf5_data_param().prefetch();
+  CHECK_GE(prefetch, 1) << "At least one chunk must be in memory.";
+  chunks_.resize(prefetch);
+  for (int i = 0; i < prefetch; ++i) {
+    chunks_[i].reset(new HDF5Chunk<Dtype>());
+    for (int j = 0; j < top_size; ++j) {
+      chunks_[i]->blobs_.push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>()));
+    }
+    chunk_free_.push(chunks_[i].get());
   }
-
-  // Load the first HDF5 file and initialize the line counter.
-  LoadHDF5FileData(hdf_filenames_[file_permutation_[current_file_]].c_str());
+  StartInternalThread();
+  current_chunk_ = chunk_full_.pop();
   current_row_ = 0;
 
   // Reshape blobs.
   const int batch_size = this->layer_param_.hdf5_data_param().batch_size();
-  const int top_size = this->layer_param_.top_size();
   vector<int> top_shape;
   for (int i = 0; i < top_size; ++i) {
-    top_shape.resize(hdf_blobs_[i]->num_axes());
+    top_shape = current_chunk_->blobs_[i]->shape();
     top_shape[0] = batch_size;
-    for (int j = 1; j < top_shape.size(); ++j) {
-      top_shape[j] = hdf_blobs_[i]->shape(j);
-    }
     top[i]->Reshape(top_shape);
   }
 }
@@ -137,43 +177,51 @@ bool HDF5DataLayer<Dtype>::Skip() {
 
 template<typename Dtype>
 void HDF5DataLayer<Dtype>::Next() {
-  if (++current_row_ == hdf_blobs_[0]->shape(0)) {
-    if (num_files_ > 1) {
-      ++current_file_;
-      if (current_file_ == num_files_) {
-        current_file_ = 0;
-        if (this->layer_param_.hdf5_data_param().shuffle()) {
-          std::random_shuffle(file_permutation_.begin(),
-                              file_permutation_.end());
-        }
-        DLOG(INFO) << "Looping around to first file.";
-      }
-      LoadHDF5FileData(
-        hdf_filenames_[file_permutation_[current_file_]].c_str());
-    }
+  if (++current_row_ == current_chunk_->rows()) {
+    chunk_free_.push(current_chunk_);
+    current_chunk_ = chunk_full_.pop("Waiting for HDF5 data");
     current_row_ = 0;
-    if (this->layer_param_.hdf5_data_param().shuffle())
-      std::random_shuffle(data_permutation_.begin(), data_permutation_.end());
   }
   offset_++;
 }
 
 template <typename Dtype>
-void HDF5DataLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
-      const vector<Blob<Dtype>*>& top) {
+void HDF5DataLayer<Dtype>::CopyBatch(const vector<Blob<Dtype>*>& top,
+      const vector<Dtype*>& top_data) {
   const int batch_size = this->layer_param_.hdf5_data_param().batch_size();
-  for (int i = 0; i < batch_size; ++i) {
+  const bool skipping = Caffe::solver_count() > 1 &&
+                        this->layer_param_.phase() != TEST;
+  for (int i = 0; i < batch_size; ) {
     while (Skip()) {
       Next();
     }
+    // Rows kept in file order are copied up to the end of the chunk at once.
+    const bool in_order = current_chunk_->order_.empty();
+    const int rows = in_order && !skipping ? std::min<int>(batch_size - i,
+        current_chunk_->rows() - current_row_) : 1;
+    const int row = in_order ? current_row_
+                             : current_chunk_->order_[current_row_];
     for (int j = 0; j < this->layer_param_.top_size(); ++j) {
       int data_dim = top[j]->count() / top[j]->shape(0);
-      caffe_copy(data_dim,
-          &hdf_blobs_[j]->cpu_data()[data_permutation_[current_row_]
-            * data_dim], &top[j]->mutable_cpu_data()[i * data_dim]);
+      caffe_copy(rows * data_dim,
+          &current_chunk_->blobs_[j]->cpu_data()[row * data_dim],
+          &top_data[j][i * data_dim]);
     }
-    Next();
+    for (int k = 0; k < rows; ++k) {
+      Next();
+    }
+    i += rows;
+  }
+}
+
+template <typename Dtype>
+void HDF5DataLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top) {
+  vector<Dtype*> top_data(this->layer_param_.top_size());
+  for (int j = 0; j < top_data.size(); ++j) {
+    top_data[j] = top[j]->mutable_cpu_data();
   }
+  CopyBatch(top, top_data);
 }
 
 #ifdef CPU_ONLY
@@ -0,0 +1,226 @@
+#include <boost/bind.hpp>
+#include <cstring>
+#include <vector>
+
+#include "caffe/layers/int8_conv_layer.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/quantization.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+namespace caffe {
+
+// Makes memory hold at least size bytes.
+static void Reserve(shared_ptr<SyncedMemory>* memory, size_t size) {
+  if (!*memory || (*memory)->size() < size) {
+    memory->reset(new SyncedMemory(size));
+  }
+}
+
+template <typename Dtype>
+void Int8ConvolutionLayer<Dtype>::LayerSetUp(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  ConvolutionLayer<Dtype>::LayerSetUp(bottom, top);
+  quantized_memory_.reset();
+  weight_scales_.Reshape(vector<int>(1, this->num_output_));
+  output_scales_.Reshape(vector<int>(1, this->num_output_));
+  int8_weight_.reset(new SyncedMemory(
+      this->num_output_ * caffe_int8_padded_dim(this->kernel_dim_)));
+  int8_weight_sums_.reset(
+      new SyncedMemory(this->num_output_ * sizeof(int32_t)));
+}
+
+// Sets offsets to the offsets of the points of a grid of the given shape, in
+// row-major order, that are the given steps apart along each axis.
+static void GridOffsets(const vector<int>& shape, const vector<int>& steps,
+    vector<int>* offsets) {
+  offsets->assign(1, 0);
+  for (int i = 0; i < shape.size(); ++i) {
+    vector<int> outer;
+    outer.swap(*offsets);
+    offsets->reserve(outer.size() * shape[i]);
+    for (int j = 0; j < outer.size(); ++j) {
+      for (int t = 0; t < shape[i]; ++t) {
+        offsets->push_back(outer[j] + t * steps[i]);
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+void Int8ConvolutionLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
+    const vector<Blob<Dtype>*>& top) {
+  ConvolutionLayer<Dtype>::Reshape(bottom, top);
+  const int num_axes = this->num_spatial_axes_;
+  const int* input_shape = this->conv_input_shape_.cpu_data();
+  const int* kernel_shape = this->kernel_shape_.cpu_data();
+  const int* stride = this->stride_.cpu_data();
+  const int* pad = this->pad_.cpu_data();
+  const int* dilation = this->dilation_.cpu_data();
+  // The steps of the axes of the padded input, channels first.
+  vector<int> padded_steps(num_axes + 1, 1);
+  for (int i = num_axes - 1; i >= 0; --i) {
+    padded_steps[i] = padded_steps[i + 1] * (input_shape[i + 1] + 2 * pad[i]);
+  }
+  const int group_channels = this->conv_in_channels_ / this->group_;
+  padded_input_dim_ = this->conv_in_channels_ * padded_steps[0];
+  padded_group_dim_ = group_channels * padded_steps[0];
+  vector<int> shape, steps;
+  for (int i = 0; i < num_axes; ++i) {
+    shape.push_back(this->output_shape_[i]);
+    steps.push_back(stride[i] * padded_steps[i + 1]);
+  }
+  GridOffsets(shape, steps, &output_offsets_);
+  shape.assign(1, group_channels);
+  steps.assign(1, padded_steps[0]);
+  for (int i = 0; i < num_axes; ++i) {
+    shape.push_back(kernel_shape[i]);
+    steps.push_back(dilation[i] * padded_steps[i + 1]);
+  }
+  GridOffsets(shape, steps, &kernel_offsets_);
+  shape.assign(1, this->conv_in_channels_);
+  steps.assign(1, padded_steps[0]);
+  int first = 0;
+  for (int i = 0; i < num_axes; ++i) {
+    first += pad[i] * padded_steps[i + 1];
+    if (i + 1 < num_axes) {
+      shape.push_back(input_shape[i + 1]);
+      steps.push_back(padded_steps[i + 1]);
+    }
+  }
+  GridOffsets(shape, steps, &input_row_offsets_);
+  for (int r = 0; r < input_row_offsets_.size(); ++r) {
+    input_row_offsets_[r] += first;
+  }
+
+  const int ld = caffe_int8_padded_dim(this->kernel_dim_);
+  const bool padded = padded_input_dim_ != this->bottom_dim_;
+  int8_inputs_.resize(this->batch_threads_);
+  int8_cols_.resize(this->batch_threads_);
+  int8_unpadded_inputs_.resize(padded ? this->batch_threads_ : 0);
+  for (int t = 0; t < this->batch_threads_; ++t) {
+    Reserve(&int8_inputs_[t], caffe_int8_padded_dim(padded_input_dim_));
+    Reserve(&int8_cols_[t],
+        caffe_int8_panel_rows(this->conv_out_spatial_dim_) * ld);
+    if (padded) {
+      Reserve(&int8_unpadded_inputs_[t],
+          caffe_int8_padded_dim(this->bottom_dim_));
+    }
+  }
+}
+
+template <typename Dtype>
+void Int8ConvolutionLayer<Dtype>::quantize_weights() {
+  const shared_ptr<SyncedMemory>& memory = this->folded_ ?
+      this->folded_weight_.data() : this->blobs_[0]->data();
+  if (memory == quantized_memory_ &&
+      memory->version() == quantized_version_) {
+    return;
+  }
+  caffe_cpu_quantize_weights(this->num_output_, this->kernel_dim_,
+      this->cpu_forward_weight(), false, false,
+      static_cast<int8_t*>(int8_weight_->mutable_cpu_data()),
+      weight_scales_.mutable_cpu_data(),
+      static_cast<int32_t*>(int8_weight_sums_->mutable_cpu_data()));
+  quantized_memory_ = memory;
+  quantized_version_ = memory->version();
+}
+
+template <typename Dtype>
+void Int8ConvolutionLayer<Dtype>::Forward_cpu(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  quantize_weights();
+  const Dtype* bias = this->cpu_forward_bias();
+  const QuantizationParameter& quantization_param =
+      this->layer_param_.quantization_param();
+  for (int i = 0; i < bottom.size(); ++i) {
+    const Dtype* bottom_data = bottom[i]->cpu_data();
+    Dtype* top_data = top[i]->mutable_cpu_data();
+    const Dtype input_range = quantization_param.has_input_range() ?
+        Dtype(quantization_param.input_range()) :
+        caffe_cpu_absmax(bottom[i]->count(), bottom_data);
+    const Dtype input_scale = input_range / kInt8ActivationMax;
+    caffe_cpu_scale(this->num_output_, input_scale,
+        weight_scales_.cpu_data(), output_scales_.mutable_cpu_data());
+    if (this->batch_threads_ > 1) {
+      ThreadPool::Global().Run(this->batch_threads_,
+          boost::bind(&Int8ConvolutionLayer<Dtype>::forward_int8_thread, this,
+              bottom_data, bias, input_scale, top_data, _1));
+    } else {
+      forward_int8_thread(bottom_data, bias, input_scale, top_data, 0);
+    }
+  }
+}
+
+template <typename Dtype>
+void Int8ConvolutionLayer<Dtype>::quantize_input(const Dtype* input,
+    Dtype input_scale, int thread_id) {
+  uint8_t* int8_input =
+      static_cast<uint8_t*>(int8_inputs_[thread_id]->mutable_cpu_data());
+  if (int8_unpadded_inputs_.empty()) {
+    caffe_cpu_quantize_activations(1, this->bottom_dim_, input, false,
+        input_scale, false, int8_input);
+    return;
+  }
+  uint8_t* unpadded = static_cast<uint8_t*>(
+      int8_unpadded_inputs_[thread_id]->mutable_cpu_data());
+  caffe_cpu_quantize_activations(1, this->bottom_dim_, input, false,
+      input_scale, false, unpadded);
+  const int row_dim = this->conv_input_shape_.cpu_data()[
+      this->num_spatial_axes_];
+  for (int r = 0; r < input_row_offsets_.size(); ++r) {
+    memcpy(int8_input + input_row_offsets_[r], unpadded + r * row_dim,
+        row_dim);
+  }
+}
+
+template <typename Dtype>
+void Int8ConvolutionLayer<Dtype>::forward_int8_thread(
+    const Dtype* bottom_data, const Dtype* bias, Dtype input_scale,
+    Dtype* top_data, int thread_id) {
+  uint8_t* int8_input =
+      static_cast<uint8_t*>(int8_inputs_[thread_id]->mutable_cpu_data());
+  uint8_t* int8_col =
+      static_cast<uint8_t*>(int8_cols_[thread_id]->mutable_cpu_data());
+  if (!int8_unpadded_inputs_.empty()) {
+    // The padding is left alone by quantize_input.
+    memset(int8_input, 128, padded_input_dim_);
+  }
+  const int8_t* int8_weight =
+      static_cast<const int8_t*>(int8_weight_->cpu_data());
+  const int32_t* int8_weight_sums =
+      static_cast<const int32_t*>(int8_weight_sums_->cpu_data());
+  const int out_channels = this->conv_out_channels_ / this->group_;
+  const int ld = caffe_int8_padded_dim(this->kernel_dim_);
+  const Dtype* output_scales = output_scales_.cpu_data();
+  const int batch_end = this->batch_begin(thread_id + 1);
+  for (int n = this->batch_begin(thread_id); n < batch_end; ++n) {
+    Dtype* output = top_data + n * this->top_dim_;
+    quantize_input(bottom_data + n * this->bottom_dim_, input_scale,
+        thread_id);
+    for (int g = 0; g < this->group_; ++g) {
+      caffe_cpu_gather_activations(this->conv_out_spatial_dim_,
+          this->kernel_dim_, int8_input + padded_group_dim_ * g,
+          &output_offsets_[0], &kernel_offsets_[0], int8_col);
+      caffe_cpu_gemm_int8(out_channels, this->conv_out_spatial_dim_,
+          this->kernel_dim_, int8_weight + out_channels * ld * g,
+          int8_weight_sums + out_channels * g, int8_col,
+          output_scales + out_channels * g, static_cast<Dtype*>(NULL), false,
+          output + this->output_offset_ * g);
+    }
+    if (bias) {
+      this->forward_cpu_bias(output, bias);
+    }
+  }
+}
+
+template <typename Dtype>
+void Int8ConvolutionLayer<Dtype>::Backward_cpu(
+    const vector<Blob<Dtype>*>& top, const vector<bool>& propagate_down,
+    const vector<Blob<Dtype>*>& bottom) {
+  LOG(FATAL) << "The INT8 engine of layer " << this->layer_param_.name()
+      << " is for inference only.";
+}
+
+INSTANTIATE_CLASS(Int8ConvolutionLayer);
+
+}  // namespace caffe
@@ -0,0 +1,80 @@
+#include <vector>
+
+#include "caffe/layers/int8_inner_product_layer.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/quantization.hpp"
+
+namespace caffe {
+
+// Makes memory hold at least size bytes.
+static void Reserve(shared_ptr<SyncedMemory>* memory, size_t size) {
+  if (!*memory || (*memory)->size() < size) {
+    memory->reset(new SyncedMemory(size));
+  }
+}
+
+template <typename Dtype>
+void Int8InnerProductLayer<Dtype>::LayerSetUp(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  InnerProductLayer<Dtype>::LayerSetUp(bottom, top);
+  quantized_memory_.reset();
+  int8_weight_.reset(new SyncedMemory(
+      caffe_int8_panel_rows(this->N_) * caffe_int8_padded_dim(this->K_)));
+  int8_weight_sums_.reset(new SyncedMemory(this->N_ * sizeof(int32_t)));
+  weight_scales_.Reshape(vector<int>(1, this->N_));
+  output_scales_.Reshape(vector<int>(1, this->N_));
+}
+
+template <typename Dtype>
+void Int8InnerProductLayer<Dtype>::Reshape(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  InnerProductLayer<Dtype>::Reshape(bottom, top);
+  Reserve(&int8_bottom_, this->M_ * caffe_int8_padded_dim(this->K_));
+}
+
+template <typename Dtype>
+void Int8InnerProductLayer<Dtype>::Forward_cpu(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  const shared_ptr<SyncedMemory>& memory = this->blobs_[0]->data();
+  if (memory != quantized_memory_ ||
+      memory->version() != quantized_version_) {
+    caffe_cpu_quantize_weights(this->N_, this->K_,
+        this->blobs_[0]->cpu_data(), this->transpose_, true,
+        static_cast<int8_t*>(int8_weight_->mutable_cpu_data()),
+        weight_scales_.mutable_cpu_data(),
+        static_cast<int32_t*>(int8_weight_sums_->mutable_cpu_data()));
+    quantized_memory_ = memory;
+    quantized_version_ = memory->version();
+  }
+  const Dtype* bottom_data = bottom[0]->cpu_data();
+  const QuantizationParameter& quantization_param =
+      this->layer_param_.quantization_param();
+  const Dtype input_range = quantization_param.has_input_range() ?
+      Dtype(quantization_param.input_range()) :
+      caffe_cpu_absmax(bottom[0]->count(), bottom_data);
+  const Dtype input_scale = input_range / kInt8ActivationMax;
+  caffe_cpu_scale(this->N_, input_scale, weight_scales_.cpu_data(),
+      output_scales_.mutable_cpu_data());
+  uint8_t* int8_bottom =
+      static_cast<uint8_t*>(int8_bottom_->mutable_cpu_data());
+  caffe_cpu_quantize_activations(this->M_, this->K_, bottom_data, false,
+      input_scale, false, int8_bottom);
+  caffe_cpu_gemm_int8(this->N_, this->M_, this->K_,
+      static_cast<const int8_t*>(int8_weight_->cpu_data()),
+      static_cast<const int32_t*>(int8_weight_sums_->cpu_data()),
+      int8_bottom, output_scales_.cpu_data(),
+      this->bias_term_ ? this->blobs_[1]->cpu_data() : NULL, true,
+      top[0]->mutable_cpu_data());
+}
+
+template <typename Dtype>
+void Int8InnerProductLayer<Dtype>::Backward_cpu(
+    const vector<Blob<Dtype>*>& top, const vector<bool>& propagate_down,
+    const vector<Blob<Dtype>*>& bottom) {
+  LOG(FATAL) << "The INT8 engine of layer " << this->layer_param_.name()
+      << " is for inference only.";
+}
+
+INSTANTIATE_CLASS(Int8InnerProductLayer);
+
+}  // namespace caffe
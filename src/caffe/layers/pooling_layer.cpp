@@ -156,6 +156,268 @@ void PoolingLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
       PoolingParameter_PoolMethod_STOCHASTIC) {
     rand_idx_.Reshape(pooled_shape_);
   }
+  if (num_spatial_axes_ == 1 || num_spatial_axes_ == 3) {
+    setup_nd_windows();
+  }
+}
+
+template <typename Dtype>
+void PoolingLayer<Dtype>::setup_nd_windows() {
+  // Pad the spatial axes on the left to D x H x W with unit windows.
+  const int num_padded_axes = 3 - num_spatial_axes_;
+  for (int i = 0; i < 3; ++i) {
+    const int axis = i - num_padded_axes;
+    const bool padded = axis < 0;
+    const int input_dim = padded ? 1 : input_shape_[axis + 2];
+    const int pooled_dim = padded ? 1 : pooled_shape_[axis + 2];
+    const int kernel = padded ? 1 : kernel_shape_[axis];
+    const int stride = padded ? 1 : stride_[axis];
+    const int pad = padded ? 0 : pad_[axis];
+    nd_input_shape_[i] = input_dim;
+    nd_pooled_shape_[i] = pooled_dim;
+    window_start_[i].resize(pooled_dim);
+    window_end_[i].resize(pooled_dim);
+    window_size_[i].resize(pooled_dim);
+    for (int p = 0; p < pooled_dim; ++p) {
+      const int start = p * stride - pad;
+      window_start_[i][p] = max(start, 0);
+      window_end_[i][p] = min(start + kernel, input_dim);
+      window_size_[i][p] = min(start + kernel, input_dim + pad) - start;
+    }
+  }
+  // The unclipped windows along W form one contiguous range of positions.
+  const int kernel_w = kernel_shape_[num_spatial_axes_ - 1];
+  interior_begin_ = nd_pooled_shape_[2];
+  interior_end_ = 0;
+  for (int pw = 0; pw < nd_pooled_shape_[2]; ++pw) {
+    if (window_end_[2][pw] - window_start_[2][pw] == kernel_w) {
+      interior_begin_ = min(interior_begin_, pw);
+      interior_end_ = pw + 1;
+    }
+  }
+  if (interior_end_ == 0) {
+    interior_begin_ = 0;
+  }
+}
+
+// Pools a single D x H x W volume. Positions with clipped windows are pooled
+// one at a time; the interior positions along W are swept once per kernel
+// tap so that the compare-and-select vectorizes across pooled positions.
+// Either way each output visits its window in (d, h, w) order, so ties are
+// resolved exactly as in the 2D and GPU kernels.
+template <typename Dtype>
+template <typename MaskType>
+void PoolingLayer<Dtype>::max_pool_volume_cpu(const Dtype* bottom_data,
+    Dtype* top_data, MaskType* mask) {
+  const int height = nd_input_shape_[1];
+  const int width = nd_input_shape_[2];
+  const int pooled_height = nd_pooled_shape_[1];
+  const int pooled_width = nd_pooled_shape_[2];
+  const int kernel_w = kernel_shape_[num_spatial_axes_ - 1];
+  const int stride_w = stride_[num_spatial_axes_ - 1];
+  const int pad_w = pad_[num_spatial_axes_ - 1];
+  const int* wstart = window_start_[2].data();
+  const int* wend = window_end_[2].data();
+  const int border_begin[2] = { 0, interior_end_ };
+  const int border_end[2] = { interior_begin_, pooled_width };
+  for (int pd = 0; pd < nd_pooled_shape_[0]; ++pd) {
+    for (int ph = 0; ph < pooled_height; ++ph) {
+      const int pool_row = (pd * pooled_height + ph) * pooled_width;
+      Dtype* top_row = top_data + pool_row;
+      MaskType* mask_row = mask + pool_row;
+      for (int pw = 0; pw < pooled_width; ++pw) {
+        top_row[pw] = -FLT_MAX;
+        mask_row[pw] = -1;
+      }
+      for (int d = window_start_[0][pd]; d < window_end_[0][pd]; ++d) {
+        for (int h = window_start_[1][ph]; h < window_end_[1][ph]; ++h) {
+          const int row = (d * height + h) * width;
+          const Dtype* bottom_row = bottom_data + row;
+          for (int b = 0; b < 2; ++b) {
+            for (int pw = border_begin[b]; pw < border_end[b]; ++pw) {
+              for (int w = wstart[pw]; w < wend[pw]; ++w) {
+                if (bottom_row[w] > top_row[pw]) {
+                  top_row[pw] = bottom_row[w];
+                  mask_row[pw] = row + w;
+                }
+              }
+            }
+          }
+          for (int kw = 0; kw < kernel_w; ++kw) {
+            const int offset = kw - pad_w;
+            for (int pw = interior_begin_; pw < interior_end_; ++pw) {
+              const int w = pw * stride_w + offset;
+              if (bottom_row[w] > top_row[pw]) {
+                top_row[pw] = bottom_row[w];
+                mask_row[pw] = row + w;
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+void PoolingLayer<Dtype>::ave_pool_volume_cpu(const Dtype* bottom_data,
+    Dtype* top_data) {
+  const int height = nd_input_shape_[1];
+  const int width = nd_input_shape_[2];
+  const int pooled_height = nd_pooled_shape_[1];
+  const int pooled_width = nd_pooled_shape_[2];
+  const int kernel_w = kernel_shape_[num_spatial_axes_ - 1];
+  const int stride_w = stride_[num_spatial_axes_ - 1];
+  const int pad_w = pad_[num_spatial_axes_ - 1];
+  const int* wstart = window_start_[2].data();
+  const int* wend = window_end_[2].data();
+  const int border_begin[2] = { 0, interior_end_ };
+  const int border_end[2] = { interior_begin_, pooled_width };
+  for (int pd = 0; pd < nd_pooled_shape_[0]; ++pd) {
+    for (int ph = 0; ph < pooled_height; ++ph) {
+      Dtype* top_row = top_data + (pd * pooled_height + ph) * pooled_width;
+      for (int pw = 0; pw < pooled_width; ++pw) {
+        top_row[pw] = 0;
+      }
+      for (int d = window_start_[0][pd]; d < window_end_[0][pd]; ++d) {
+        for (int h = window_start_[1][ph]; h < window_end_[1][ph]; ++h) {
+          const Dtype* bottom_row = bottom_data + (d * height + h) * width;
+          for (int b = 0; b < 2; ++b) {
+            for (int pw = border_begin[b]; pw < border_end[b]; ++pw) {
+              for (int w = wstart[pw]; w < wend[pw]; ++w) {
+                top_row[pw] += bottom_row[w];
+              }
+            }
+          }
+          for (int kw = 0; kw < kernel_w; ++kw) {
+            const Dtype* bottom_tap = bottom_row + kw - pad_w;
+            for (int pw = interior_begin_; pw < interior_end_; ++pw) {
+              top_row[pw] += bottom_tap[pw * stride_w];
+            }
+          }
+        }
+      }
+      const int size_dh = window_size_[0][pd] * window_size_[1][ph];
+      for (int pw = 0; pw < pooled_width; ++pw) {
+        top_row[pw] /= size_dh * window_size_[2][pw];
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+void PoolingLayer<Dtype>::forward_cpu_nd(const vector<Blob<Dtype>*>& bottom,
+    const vector<Blob<Dtype>*>& top) {
+  CHECK(num_spatial_axes_ == 1 || num_spatial_axes_ == 3)
+      << "CPU pooling supports 1, 2 or 3 spatial axes.";
+  const Dtype* bottom_data = bottom[0]->cpu_data();
+  Dtype* top_data = top[0]->mutable_cpu_data();
+  const int num_volumes = bottom[0]->count(0, 2);
+  const int bottom_volume = bottom[0]->count(2);
+  const int top_volume = top[0]->count(2);
+  switch (this->layer_param_.pooling_param().pool()) {
+  case PoolingParameter_PoolMethod_MAX:
+    if (top.size() > 1) {
+      Dtype* top_mask = top[1]->mutable_cpu_data();
+      for (int i = 0; i < num_volumes; ++i) {
+        max_pool_volume_cpu(bottom_data + i * bottom_volume,
+            top_data + i * top_volume, top_mask + i * top_volume);
+      }
+    } else {
+      int* mask = max_idx_.mutable_cpu_data();
+      for (int i = 0; i < num_volumes; ++i) {
+        max_pool_volume_cpu(bottom_data + i * bottom_volume,
+            top_data + i * top_volume, mask + i * top_volume);
+      }
+    }
+    break;
+  case PoolingParameter_PoolMethod_AVE:
+    for (int i = 0; i < num_volumes; ++i) {
+      ave_pool_volume_cpu(bottom_data + i * bottom_volume,
+          top_data + i * top_volume);
+    }
+    break;
+  case PoolingParameter_PoolMethod_STOCHASTIC:
+    NOT_IMPLEMENTED;
+    break;
+  default:
+    LOG(FATAL) << "Unknown pooling method.";
+  }
+}
+
+template <typename Dtype>
+void PoolingLayer<Dtype>::backward_cpu_nd(const vector<Blob<Dtype>*>& top,
+    const vector<Blob<Dtype>*>& bottom) {
+  CHECK(num_spatial_axes_ == 1 || num_spatial_axes_ == 3)
+      << "CPU pooling supports 1, 2 or 3 spatial axes.";
+  const Dtype* top_diff = top[0]->cpu_diff();
+  Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
+  caffe_set(bottom[0]->count(), Dtype(0), bottom_diff);
+  const int num_volumes = bottom[0]->count(0, 2);
+  const int bottom_volume = bottom[0]->count(2);
+  const int top_volume = top[0]->count(2);
+  const bool use_top_mask = top.size() > 1;
+  const int* mask = NULL;  // suppress warnings about uninitialized variables
+  const Dtype* top_mask = NULL;
+  const int height = nd_input_shape_[1];
+  const int width = nd_input_shape_[2];
+  const int pooled_height = nd_pooled_shape_[1];
+  const int pooled_width = nd_pooled_shape_[2];
+  switch (this->layer_param_.pooling_param().pool()) {
+  case PoolingParameter_PoolMethod_MAX:
+    if (use_top_mask) {
+      top_mask = top[1]->cpu_data();
+    } else {
+      mask = max_idx_.cpu_data();
+    }
+    for (int i = 0; i < num_volumes; ++i) {
+      for (int index = 0; index < top_volume; ++index) {
+        const int bottom_index =
+            use_top_mask ? top_mask[index] : mask[index];
+        bottom_diff[bottom_index] += top_diff[index];
+      }
+      bottom_diff += bottom_volume;
+      top_diff += top_volume;
+      if (use_top_mask) {
+        top_mask += top_volume;
+      } else {
+        mask += top_volume;
+      }
+    }
+    break;
+  case PoolingParameter_PoolMethod_AVE:
+    for (int i = 0; i < num_volumes; ++i) {
+      for (int pd = 0; pd < nd_pooled_shape_[0]; ++pd) {
+        for (int ph = 0; ph < pooled_height; ++ph) {
+          const int size_dh = window_size_[0][pd] * window_size_[1][ph];
+          for (int pw = 0; pw < pooled_width; ++pw) {
+            const Dtype gradient =
+                top_diff[(pd * pooled_height + ph) * pooled_width + pw] /
+                (size_dh * window_size_[2][pw]);
+            const int wstart = window_start_[2][pw];
+            const int wend = window_end_[2][pw];
+            for (int d = window_start_[0][pd]; d < window_end_[0][pd]; ++d) {
+              for (int h = window_start_[1][ph]; h < window_end_[1][ph];
+                   ++h) {
+                Dtype* bottom_row = bottom_diff + (d * height + h) * width;
+                for (int w = wstart; w < wend; ++w) {
+                  bottom_row[w] += gradient;
+                }
+              }
+            }
+          }
+        }
+      }
+      bottom_diff += bottom_volume;
+      top_diff += top_volume;
+    }
+    break;
+  case PoolingParameter_PoolMethod_STOCHASTIC:
+    NOT_IMPLEMENTED;
+    break;
+  default:
+    LOG(FATAL) << "Unknown pooling method.";
+  }
 }
 
 // TODO(Yangqing): Is there a faster way to do pooling in the channel-first
@@ -163,6 +425,10 @@ void PoolingLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
 template <typename Dtype>
 void PoolingLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
                                       const vector<Blob<Dtype>*>& top) {
+  if (num_spatial_axes_ != 2) {
+    forward_cpu_nd(bottom, top);
+    return;
+  }
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
   const int top_count = top[0]->count();
@@ -278,6 +544,10 @@ void PoolingLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
   if (!propagate_down[0]) {
     return;
   }
+  if (num_spatial_axes_ != 2) {
+    backward_cpu_nd(top, bottom);
+    return;
+  }
   const Dtype* top_diff = top[0]->cpu_diff();
   Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
   // Different pooling methods. We explicitly do the switch outside the for
@@ -3,6 +3,7 @@
 
 #include "caffe/layers/swish_layer.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/neuron_functions.hpp"
 
 namespace caffe {
 
@@ -29,14 +30,11 @@ template <typename Dtype>
 void SwishLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
   const Dtype* bottom_data = bottom[0]->cpu_data();
-  Dtype* sigmoid_input_data = sigmoid_input_->mutable_cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
   const int count = bottom[0]->count();
   Dtype beta = this->layer_param_.swish_param().beta();
-  caffe_copy(count, bottom_data, sigmoid_input_data);
-  caffe_scal(count, beta, sigmoid_input_data);
-  sigmoid_layer_->Forward(sigmoid_bottom_vec_, sigmoid_top_vec_);
-  caffe_mul(count, bottom_data, sigmoid_output_->cpu_data(), top_data);
+  caffe_cpu_swish(count, bottom_data, beta,
+      sigmoid_output_->mutable_cpu_data(), top_data);
 }
 
 template <typename Dtype>
@@ -50,11 +48,8 @@ void SwishLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
     const int count = bottom[0]->count();
     Dtype beta = this->layer_param_.swish_param().beta();
-    for (int i = 0; i < count; ++i) {
-      const Dtype swish_x = top_data[i];
-      bottom_diff[i] = top_diff[i] * (beta * swish_x + sigmoid_output_data[i]
-          * (1. - beta * swish_x));
-    }
+    caffe_cpu_swish_backward(count, top_data, sigmoid_output_data, top_diff,
+        beta, bottom_diff);
   }
 }
 
@@ -1,9 +1,16 @@
+#include <boost/bind.hpp>
+#include <algorithm>
 #include <vector>
 
 #include "caffe/layers/temporal_max_layer.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
+// Outputs below which splitting the loops across threads does not pay off.
+static const int kMinOutputsPerThread = 4096;
+
 template <typename Dtype>
 void TemporalMaxLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
                                          const vector<Blob<Dtype>*>& top) {
@@ -20,19 +27,60 @@ void TemporalMaxLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   top_shape.push_back(bottom[0]->count(1));
   top[0]->Reshape(top_shape);
   max_idx_.Reshape(top_shape);
+  num_ = bottom[0]->shape(0);
 }
 
 template <typename Dtype>
 void TemporalMaxLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
                                           const vector<Blob<Dtype>*>& top) {
-  NOT_IMPLEMENTED;
+  ThreadPool::Global().RunRange(top[0]->count(), kMinOutputsPerThread,
+      boost::bind(&TemporalMaxLayer<Dtype>::forward_cpu_range, this,
+                  bottom[0]->cpu_data(), top[0]->mutable_cpu_data(),
+                  max_idx_.mutable_cpu_data(), _1, _2));
+}
+
+template <typename Dtype>
+void TemporalMaxLayer<Dtype>::forward_cpu_range(const Dtype* bottom_data,
+    Dtype* top_data, int* max_idx, int begin, int end) {
+  // Sweep the items one contiguous row at a time rather than walking down
+  // each output's column of items.
+  const int count = max_idx_.count();
+  caffe_copy(end - begin, bottom_data + begin, top_data + begin);
+  std::fill(max_idx + begin, max_idx + end, 0);
+  for (int n = 1; n < num_; ++n) {
+    const Dtype* bottom_row = bottom_data + n * count;
+    for (int i = begin; i < end; ++i) {
+      if (bottom_row[i] > top_data[i]) {
+        top_data[i] = bottom_row[i];
+        max_idx[i] = n;
+      }
+    }
+  }
 }
 
 template <typename Dtype>
 void TemporalMaxLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
                                            const vector<bool>& propagate_down,
                                            const vector<Blob<Dtype>*>& bottom) {
-  NOT_IMPLEMENTED;
+  if (!propagate_down[0]) {
+    return;
+  }
+  ThreadPool::Global().RunRange(top[0]->count(), kMinOutputsPerThread,
+      boost::bind(&TemporalMaxLayer<Dtype>::backward_cpu_range, this,
+                  top[0]->cpu_diff(), max_idx_.cpu_data(),
+                  bottom[0]->mutable_cpu_diff(), _1, _2));
+}
+
+template <typename Dtype>
+void TemporalMaxLayer<Dtype>::backward_cpu_range(const Dtype* top_diff,
+    const int* max_idx, Dtype* bottom_diff, int begin, int end) {
+  const int count = max_idx_.count();
+  for (int n = 0; n < num_; ++n) {
+    caffe_set(end - begin, Dtype(0), bottom_diff + n * count + begin);
+  }
+  for (int i = begin; i < end; ++i) {
+    bottom_diff[max_idx[i] * count + i] = top_diff[i];
+  }
 }
 
 #ifdef CPU_ONLY
@@ -1,6 +1,7 @@
 #include <vector>
 
 #include "caffe/layers/temporal_max_layer.hpp"
+#include "caffe/util/math_functions.hpp"
 
 namespace caffe {
 
@@ -44,7 +45,11 @@ template <typename Dtype>
 void TemporalMaxLayer<Dtype>::Backward_gpu(const vector<Blob<Dtype>*>& top,
                                            const vector<bool>& propagate_down,
                                            const vector<Blob<Dtype>*>& bottom) {
+  if (!propagate_down[0]) {
+    return;
+  }
   const int nthreads = bottom[0]->count(1);
+  caffe_gpu_set(bottom[0]->count(), Dtype(0), bottom[0]->mutable_gpu_diff());
   // NOLINT_NEXT_LINE(whitespace/operators)
   temporal_max_backward<Dtype><<<CAFFE_GET_BLOCKS(nthreads), CAFFE_CUDA_NUM_THREADS>>>(
       nthreads, bottom[0]->mutable_gpu_diff(), bottom[0]->shape(0), nthreads,
@@ -1,6 +1,7 @@
 #include <vector>
 
 #include "caffe/layers/transform2d_layer.hpp"
+#include "caffe/util/math_functions.hpp"
 
 namespace caffe {
 
@@ -13,66 +14,44 @@ void Transform2DLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
 template<typename Dtype>
 void Transform2DLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
                                       const vector<Blob<Dtype>*>& top) {
+  CHECK(bottom[0]->shape(2) % 2 == 0 && bottom[0]->shape(3) % 2 == 0)
+      << "Height and width must be even.";
   vector<int> out_shape;
   out_shape.push_back(bottom[0]->shape(0));  // Batch size.
   out_shape.push_back(bottom[0]->shape(1) * 4);  // channels.
   out_shape.push_back(bottom[0]->shape(2) / 2);  // height.
   out_shape.push_back(bottom[0]->shape(3) / 2);  // height.
   top[0]->Reshape(out_shape);
+  // Space to depth: the value at (n, c, 2 * h + i, 2 * w + j) of the bottom
+  // moves to (n, c + (2 * i + j) * channels, h, w) of the top. Walk them by
+  // n, c, h, i, j, w, reading each bottom row twice in a row and writing top
+  // rows.
+  const int channels = bottom[0]->shape(1);
+  const int height = out_shape[2];
+  const int width = out_shape[3];
+  const int axes[] = {bottom[0]->shape(0), channels, height, 2, 2, width};
+  const int bottom_strides[] = {bottom[0]->count(1), bottom[0]->count(2),
+      2 * bottom[0]->shape(3), bottom[0]->shape(3), 1, 2};
+  const int top_strides[] = {top[0]->count(1), top[0]->count(2), width,
+      2 * channels * top[0]->count(2), channels * top[0]->count(2), 1};
+  shuffle_shape_.assign(axes, axes + 6);
+  bottom_strides_.assign(bottom_strides, bottom_strides + 6);
+  top_strides_.assign(top_strides, top_strides + 6);
 }
 
 template<typename Dtype>
 void Transform2DLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
                                           const vector<Blob<Dtype>*>& top) {
-  const Dtype* bottom_data = bottom[0]->cpu_data();
-  Dtype* top_data = top[0]->mutable_cpu_data();
-  for (int index = 0; index < bottom[0]->count(); ++index) {
-    int num = index;
-    const int w = num % bottom[0]->shape(3);
-    num = num / bottom[0]->shape(3);
-    const int h = num % bottom[0]->shape(2);
-    num = num / bottom[0]->shape(2);
-    const int c = num % bottom[0]->shape(1);
-    num = num / bottom[0]->shape(1);
-
-    int i = h % 2;
-    int out_h = h / 2;
-    int j = w % 2;
-    int out_w = w / 2;
-    int out_c = c + (i * 2 + j) * bottom[0]->shape(1);
-
-    const int out_index = num * top[0]->count(1) + out_c * top[0]->count(2)
-        + out_h * top[0]->count(3) + out_w;
-    top_data[out_index] = bottom_data[index];
-  }
+  caffe_cpu_strided_copy(shuffle_shape_, bottom_strides_,
+      bottom[0]->cpu_data(), top_strides_, top[0]->mutable_cpu_data());
 }
 
 template<typename Dtype>
 void Transform2DLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
                                            const vector<bool>& propagate_down,
                                            const vector<Blob<Dtype>*>& bottom) {
-  Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
-  const Dtype* top_diff = top[0]->cpu_diff();
-  for (int index = 0; index < bottom[0]->count(); ++index) {
-    int num = index;
-    const int w = num % bottom[0]->shape(3);
-    num = num / bottom[0]->shape(3);
-    const int h = num % bottom[0]->shape(2);
-    num = num / bottom[0]->shape(2);
-    const int c = num % bottom[0]->shape(1);
-    num = num / bottom[0]->shape(1);
-
-    int i = h % 2;
-    int out_h = h / 2;
-    int j = w % 2;
-
-    int out_w = w / 2;
-    int out_c = c + (i * 2 + j) * bottom[0]->shape(1);
-
-    const int out_index = num * top[0]->count(1) + out_c * top[0]->count(2)
-        + out_h * top[0]->count(3) + out_w;
-    bottom_diff[index] = top_diff[out_index];
-  }
+  caffe_cpu_strided_copy(shuffle_shape_, top_strides_, top[0]->cpu_diff(),
+      bottom_strides_, bottom[0]->mutable_cpu_diff());
 }
 
 #ifdef CPU_ONLY
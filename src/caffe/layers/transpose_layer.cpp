@@ -1,12 +1,14 @@
 #include <vector>
 
 #include "caffe/layers/transpose_layer.hpp"
+#include "caffe/util/math_functions.hpp"
 
 namespace caffe {
 
 template<typename Dtype>
 void TransposeLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
                                        const vector<Blob<Dtype>*>& top) {
+  CHECK_EQ(bottom[0]->num_axes(), 5) << "Blob must be 5 dim.";
 }
 
 template<typename Dtype>
@@ -20,51 +22,29 @@ void TransposeLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   top[0]->Reshape(out_shape);
 }
 
+// The top is the bottom with its channel and depth axes swapped, N x D x C
+// x H x W, with the first two axes merged.
+static const int kTransposeOrder[] = {0, 2, 1, 3, 4};
+
 template<typename Dtype>
 void TransposeLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
                                         const vector<Blob<Dtype>*>& top) {
-  const Dtype* bottom_data = bottom[0]->cpu_data();
-  Dtype* top_data = top[0]->mutable_cpu_data();
-  for (int index = 0; index < bottom[0]->num(); ++index) {
-    int num = index;
-    const int w = num % bottom[0]->shape(4);
-    num = num / bottom[0]->shape(4);
-    const int h = num % bottom[0]->shape(3);
-    num = num / bottom[0]->shape(3);
-    const int d = num % bottom[0]->shape(2);
-    num = num / bottom[0]->shape(2);
-    const int c = num % bottom[0]->shape(1);
-    num = num / bottom[0]->shape(1);
-
-    const int out_index = (num * bottom[0]->shape(2) + d) * top[0]->count(1)
-        + c * top[0]->count(2)
-        + h * top[0]->count(3) + w;
-    top_data[out_index] = bottom_data[index];
-  }
+  caffe_cpu_permute(bottom[0]->shape(),
+      vector<int>(kTransposeOrder, kTransposeOrder + 5),
+      bottom[0]->cpu_data(), top[0]->mutable_cpu_data());
 }
 
 template<typename Dtype>
 void TransposeLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
                                          const vector<bool>& propagate_down,
                                          const vector<Blob<Dtype>*>& bottom) {
-  Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
-  const Dtype* top_diff = top[0]->cpu_diff();
-  for (int index = 0; index < bottom[0]->num(); ++index) {
-    int num = index;
-    const int w = num % bottom[0]->shape(4);
-    num = num / bottom[0]->shape(4);
-    const int h = num % bottom[0]->shape(3);
-    num = num / bottom[0]->shape(3);
-    const int d = num % bottom[0]->shape(2);
-    num = num / bottom[0]->shape(2);
-    const int c = num % bottom[0]->shape(1);
-    num = num / bottom[0]->shape(1);
-
-    const int out_index = (num * bottom[0]->shape(2) + d) * top[0]->count(1)
-        + c * top[0]->count(2)
-        + h * top[0]->count(3) + w;
-    bottom_diff[index] = top_diff[out_index];
+  vector<int> top_shape(5);
+  for (int i = 0; i < 5; ++i) {
+    top_shape[i] = bottom[0]->shape(kTransposeOrder[i]);
   }
+  caffe_cpu_permute(top_shape,
+      vector<int>(kTransposeOrder, kTransposeOrder + 5),
+      top[0]->cpu_diff(), bottom[0]->mutable_cpu_diff());
 }
 
 #ifdef CPU_ONLY
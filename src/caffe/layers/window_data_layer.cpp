@@ -228,8 +228,6 @@ template <typename Dtype>
 void WindowDataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
   // At each iteration, sample N windows where N*p are foreground (object)
   // windows and N*(1-p) are background (non-object) windows
-  CPUTimer batch_timer;
-  batch_timer.Start();
   double read_time = 0;
   double trans_time = 0;
   CPUTimer timer;
@@ -463,10 +461,8 @@ void WindowDataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
       item_id++;
     }
   }
-  batch_timer.Stop();
-  DLOG(INFO) << "Prefetch batch: " << batch_timer.MilliSeconds() << " ms.";
-  DLOG(INFO) << "     Read time: " << read_time / 1000 << " ms.";
-  DLOG(INFO) << "Transform time: " << trans_time / 1000 << " ms.";
+  batch->read_time_ = read_time / 1000;
+  batch->transform_time_ = trans_time / 1000;
 }
 
 INSTANTIATE_CLASS(WindowDataLayer);
@@ -1,3 +1,4 @@
+#include <boost/bind.hpp>
 #include <algorithm>
 #include <map>
 #include <set>
@@ -9,24 +10,30 @@
 
 #include "caffe/common.hpp"
 #include "caffe/layer.hpp"
+#include "caffe/layers/base_conv_layer.hpp"
+#include "caffe/layers/conv_layer.hpp"
 #include "caffe/net.hpp"
 #include "caffe/parallel.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/benchmark.hpp"
 #include "caffe/util/hdf5.hpp"
 #include "caffe/util/insert_splits.hpp"
+#include "caffe/util/mapped_weights.hpp"
 #include "caffe/util/math_functions.hpp"
 #include "caffe/util/upgrade_proto.hpp"
 
 namespace caffe {
 
 template <typename Dtype>
-Net<Dtype>::Net(const NetParameter& param) {
+Net<Dtype>::Net(const NetParameter& param, const Net* weights_net)
+    : weights_net_(weights_net) {
   Init(param);
 }
 
 template <typename Dtype>
 Net<Dtype>::Net(const string& param_file, Phase phase,
-    const int level, const vector<string>* stages) {
+    const int level, const vector<string>* stages, const Net* weights_net)
+    : weights_net_(weights_net) {
   NetParameter param;
   ReadNetParamsFromTextFileOrDie(param_file, &param);
   // Set phase, stages and level
@@ -117,8 +124,29 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
         AppendTop(param, layer_id, num_top, NULL, NULL);
       }
     }
+    // Layers given their params skip allocating and filling them.
+    const bool shares_weights = weights_net_ &&
+        weights_net_->has_layer(layer_param.name());
+    if (shares_weights) {
+      layer->blobs() = weights_net_->layer_by_name(layer_param.name())
+          ->blobs();
+    }
     // After this layer is connected, set it up.
     layers_[layer_id]->SetUp(bottom_vecs_[layer_id], top_vecs_[layer_id]);
+    if (shares_weights) {
+      // Layers holding their params elsewhere, like RecurrentLayer, replace
+      // them; share their memory instead.
+      const vector<shared_ptr<Blob<Dtype> > >& source_blobs =
+          weights_net_->layer_by_name(layer_param.name())->blobs();
+      vector<shared_ptr<Blob<Dtype> > >& target_blobs = layer->blobs();
+      CHECK_EQ(target_blobs.size(), source_blobs.size())
+          << "Incompatible number of blobs for layer " << layer_param.name();
+      for (int j = 0; j < target_blobs.size(); ++j) {
+        if (target_blobs[j] != source_blobs[j]) {
+          target_blobs[j]->ShareData(*source_blobs[j]);
+        }
+      }
+    }
     LOG_IF(INFO, Caffe::root_solver())
         << "Setting up " << layer_names_[layer_id];
     for (int top_id = 0; top_id < top_vecs_[layer_id].size(); ++top_id) {
@@ -251,10 +279,227 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
     layer_names_index_[layer_names_[layer_id]] = layer_id;
   }
   ShareWeights();
+  if (weights_net_) {
+    // The shared params are read-only.
+    for (int i = 0; i < layers_.size(); ++i) {
+      for (int j = 0; j < layers_[i]->blobs().size(); ++j) {
+        layers_[i]->set_param_propagate_down(j, false);
+      }
+    }
+    LOG_IF(INFO, Caffe::root_solver())
+        << "Sharing params with net " << weights_net_->name();
+  }
   debug_info_ = param.debug_info();
+  optimize_memory_ = param.optimize_memory() && phase_ == TEST;
+  LOG_IF(WARNING, param.optimize_memory() && !optimize_memory_)
+      << "optimize_memory is ignored outside the TEST phase.";
+  layer_folded_.assign(layers_.size(), false);
+  fold_blocks_.clear();
+  if (param.fold_batch_norm()) {
+    if (phase_ == TEST && Caffe::mode() == Caffe::CPU) {
+      FindFoldBlocks();
+    } else {
+      LOG(WARNING) << "fold_batch_norm is ignored outside TEST phase CPU nets.";
+    }
+  }
+  forward_busy_ = forward_elapsed_ = 0;
+  backward_busy_ = backward_elapsed_ = 0;
+  const int branch_threads = ThreadPool::NumThreads(param.branch_threads());
+  if (branch_threads > 1) {
+    // Planned blobs are reused in layer order, by layers that may now run
+    // at the same time.
+    LOG_IF(WARNING, optimize_memory_)
+        << "optimize_memory is ignored with branch_threads.";
+    optimize_memory_ = false;
+    branch_pool_.reset(new ThreadPool(branch_threads));
+    FindLayerDependencies();
+    layer_losses_.assign(layers_.size(), Dtype(0));
+    layer_times_.assign(layers_.size(), 0);
+    vector<vector<int> > waves;
+    if (layers_.size()) {
+      GroupWaves(0, layers_.size() - 1, false, &waves);
+    }
+    LOG_IF(INFO, Caffe::root_solver()) << "Running " << layers_.size()
+        << " layers in " << waves.size() << " waves on " << branch_threads
+        << " branch threads.";
+  }
+  if (optimize_memory_) {
+    PlanMemory();
+  }
+  FoldBatchNorm();
   LOG_IF(INFO, Caffe::root_solver()) << "Network initialization done.";
 }
 
+// Points mem at data on the device the net runs on.
+static void BindMemory(SyncedMemory* mem, void* cpu_or_gpu_data) {
+  if (Caffe::mode() == Caffe::GPU) {
+    mem->set_gpu_data(cpu_or_gpu_data);
+  } else {
+    mem->set_cpu_data(cpu_or_gpu_data);
+  }
+}
+
+template <typename Dtype>
+void Net<Dtype>::PlanMemory() {
+  // Offsets in the arena are kept aligned for vectorized kernels.
+  const size_t kAlignment = 64;
+  const int num_layers = layers_.size();
+  // The lifetime of each blob, from its first to its last layer.
+  vector<int> first_use(blobs_.size(), num_layers);
+  vector<int> last_use(blobs_.size(), -1);
+  for (int i = 0; i < num_layers; ++i) {
+    for (int j = 0; j < bottom_id_vecs_[i].size(); ++j) {
+      const int blob_id = bottom_id_vecs_[i][j];
+      first_use[blob_id] = std::min(first_use[blob_id], i);
+      last_use[blob_id] = std::max(last_use[blob_id], i);
+    }
+    for (int j = 0; j < top_id_vecs_[i].size(); ++j) {
+      const int blob_id = top_id_vecs_[i][j];
+      first_use[blob_id] = std::min(first_use[blob_id], i);
+      last_use[blob_id] = std::max(last_use[blob_id], i);
+    }
+  }
+  for (int i = 0; i < net_output_blob_indices_.size(); ++i) {
+    last_use[net_output_blob_indices_[i]] = num_layers;
+  }
+  // The tops of layers without bottoms (inputs, data layers) may be written
+  // once and read by every pass, so they keep their memory and contents.
+  vector<bool> is_source(blobs_.size(), false);
+  for (int i = 0; i < num_layers; ++i) {
+    if (bottom_id_vecs_[i].empty()) {
+      for (int j = 0; j < top_id_vecs_[i].size(); ++j) {
+        is_source[top_id_vecs_[i][j]] = true;
+        first_use[top_id_vecs_[i][j]] = -1;
+        last_use[top_id_vecs_[i][j]] = num_layers;
+      }
+    }
+  }
+  // Reshape makes its top share the memory of its bottom when reshaped,
+  // which the grouping below sees. Slice and Concat copy, but for a single
+  // top or bottom, which they share when reshaped too. Split and Flatten
+  // only share in Forward, so their tops are planned as the memory of their
+  // bottom.
+  vector<int> memory_owner(blobs_.size());
+  for (int blob_id = 0; blob_id < blobs_.size(); ++blob_id) {
+    memory_owner[blob_id] = blob_id;
+  }
+  for (int i = 0; i < num_layers; ++i) {
+    const string type = layers_[i]->type();
+    if (type == "Split" || type == "Flatten") {
+      const int bottom_id = memory_owner[bottom_id_vecs_[i][0]];
+      for (int j = 0; j < top_id_vecs_[i].size(); ++j) {
+        memory_owner[top_id_vecs_[i][j]] = bottom_id;
+      }
+    }
+  }
+  // Blobs already sharing their memory are planned as one.
+  vector<SyncedMemory*> memories;
+  vector<pair<int, int> > lifetimes;
+  vector<bool> keep_contents;
+  map<SyncedMemory*, int> memory_index;
+  for (int blob_id = 0; blob_id < blobs_.size(); ++blob_id) {
+    if (blobs_[blob_id]->count() == 0 || last_use[blob_id] < 0) {
+      continue;
+    }
+    SyncedMemory* mem = blobs_[memory_owner[blob_id]]->data().get();
+    if (!memory_index.count(mem)) {
+      memory_index[mem] = memories.size();
+      memories.push_back(mem);
+      lifetimes.push_back(make_pair(first_use[blob_id], last_use[blob_id]));
+      keep_contents.push_back(false);
+    }
+    const int index = memory_index[mem];
+    lifetimes[index].first = std::min(lifetimes[index].first,
+                                      first_use[blob_id]);
+    lifetimes[index].second = std::max(lifetimes[index].second,
+                                       last_use[blob_id]);
+    keep_contents[index] = keep_contents[index] || is_source[blob_id];
+  }
+  // Greedily place the largest memories first, each at the lowest offset
+  // that does not overlap a placed memory alive at the same time.
+  vector<pair<size_t, int> > by_size;
+  size_t naive_size = 0;
+  for (int i = 0; i < memories.size(); ++i) {
+    by_size.push_back(make_pair(memories[i]->size(), i));
+    naive_size += memories[i]->size();
+  }
+  std::sort(by_size.rbegin(), by_size.rend());
+  vector<size_t> offsets(memories.size());
+  vector<int> placed;
+  size_t arena_size = 0;
+  for (int i = 0; i < by_size.size(); ++i) {
+    const size_t size = by_size[i].first;
+    const int index = by_size[i].second;
+    vector<pair<size_t, size_t> > busy;
+    for (int j = 0; j < placed.size(); ++j) {
+      const int other = placed[j];
+      if (lifetimes[other].first <= lifetimes[index].second &&
+          lifetimes[index].first <= lifetimes[other].second) {
+        busy.push_back(make_pair(offsets[other],
+                                 offsets[other] + memories[other]->size()));
+      }
+    }
+    std::sort(busy.begin(), busy.end());
+    size_t offset = 0;
+    for (int j = 0; j < busy.size(); ++j) {
+      if (offset + size <= busy[j].first) {
+        break;
+      }
+      offset = std::max(offset, (busy[j].second + kAlignment - 1)
+                                / kAlignment * kAlignment);
+    }
+    offsets[index] = offset;
+    arena_size = std::max(arena_size, offset + size);
+    placed.push_back(index);
+  }
+  // Convolution layers run one at a time, so one im2col buffer serves all.
+  vector<SyncedMemory*> col_buffers;
+  size_t workspace_size = 0;
+  size_t naive_workspace_size = 0;
+  for (int i = 0; i < num_layers; ++i) {
+    BaseConvolutionLayer<Dtype>* conv_layer =
+        dynamic_cast<BaseConvolutionLayer<Dtype>*>(layers_[i].get());
+    Blob<Dtype>* col_buffer = conv_layer ? conv_layer->col_buffer() : NULL;
+    if (col_buffer && col_buffer->count() > 0) {
+      col_buffers.push_back(col_buffer->data().get());
+      workspace_size = std::max(workspace_size, col_buffers.back()->size());
+      naive_workspace_size += col_buffers.back()->size();
+    }
+  }
+  // Allocate the new memory before releasing the previous plan's.
+  shared_ptr<SyncedMemory> arena(new SyncedMemory(arena_size));
+  shared_ptr<SyncedMemory> workspace(new SyncedMemory(workspace_size));
+  const bool gpu = Caffe::mode() == Caffe::GPU;
+  if (arena_size > 0) {
+    char* base = static_cast<char*>(gpu ? arena->mutable_gpu_data()
+                                        : arena->mutable_cpu_data());
+    for (int i = 0; i < memories.size(); ++i) {
+      // Sources span the whole net, so no other memory shares their place.
+      if (keep_contents[i] &&
+          memories[i]->head() != SyncedMemory::UNINITIALIZED) {
+        caffe_copy(memories[i]->size() / sizeof(Dtype),
+            static_cast<const Dtype*>(gpu ? memories[i]->gpu_data()
+                                          : memories[i]->cpu_data()),
+            reinterpret_cast<Dtype*>(base + offsets[i]));
+      }
+      BindMemory(memories[i], base + offsets[i]);
+    }
+  }
+  if (workspace_size > 0) {
+    void* base = gpu ? workspace->mutable_gpu_data()
+                     : workspace->mutable_cpu_data();
+    for (int i = 0; i < col_buffers.size(); ++i) {
+      BindMemory(col_buffers[i], base);
+    }
+  }
+  activation_arena_ = arena;
+  conv_workspace_ = workspace;
+  LOG_IF(INFO, Caffe::root_solver())
+      << "Memory planner: activations use " << arena_size << " bytes instead "
+      << "of " << naive_size << ", im2col workspace uses " << workspace_size
+      << " bytes instead of " << naive_workspace_size;
+}
+
 template <typename Dtype>
 void Net<Dtype>::FilterNet(const NetParameter& param,
     NetParameter* param_filtered) {
@@ -512,16 +757,353 @@ void Net<Dtype>::AppendParam(const NetParameter& param, const int layer_id,
   }
 }
 
+template <typename Dtype>
+void Net<Dtype>::FindFoldBlocks() {
+  vector<int> num_readers(blobs_.size(), 0);
+  for (int i = 0; i < layers_.size(); ++i) {
+    for (int j = 0; j < bottom_id_vecs_[i].size(); ++j) {
+      ++num_readers[bottom_id_vecs_[i][j]];
+    }
+  }
+  vector<bool> is_output(blobs_.size(), false);
+  for (int i = 0; i < net_output_blob_indices_.size(); ++i) {
+    is_output[net_output_blob_indices_[i]] = true;
+  }
+  int num_folded = 0;
+  for (int i = 0; i < layers_.size(); ++i) {
+    if (!dynamic_cast<ConvolutionLayer<Dtype>*>(layers_[i].get()) ||
+        top_id_vecs_[i].size() != 1 || top_vecs_[i][0]->CanonicalAxisIndex(
+            layers_[i]->layer_param().convolution_param().axis()) != 1) {
+      continue;
+    }
+    const int channels = top_vecs_[i][0]->shape(1);
+    vector<int> block(1, i);
+    int top_id = top_id_vecs_[i][0];
+    int top_reads = 0;
+    bool relu = false;
+    for (int j = i + 1; j < layers_.size() && !relu; ++j) {
+      if (bottom_id_vecs_[j].size() != 1 || top_id_vecs_[j].size() != 1 ||
+          bottom_id_vecs_[j][0] != top_id) {
+        break;
+      }
+      const LayerParameter& layer_param = layers_[j]->layer_param();
+      const string type = layers_[j]->type();
+      const vector<shared_ptr<Blob<Dtype> > >& layer_blobs =
+          layers_[j]->blobs();
+      if (type == "BatchNorm") {
+        // Only the global statistics are an affine transform.
+        if (layer_param.batch_norm_param().has_use_global_stats() &&
+            !layer_param.batch_norm_param().use_global_stats()) {
+          break;
+        }
+      } else if (type == "Scale") {
+        if (layer_blobs.size() != 1 + layer_param.scale_param().bias_term() ||
+            layer_blobs[0]->shape() != vector<int>(1, channels) ||
+            top_vecs_[i][0]->CanonicalAxisIndex(
+                layer_param.scale_param().axis()) != 1) {
+          break;
+        }
+      } else if (type == "ReLU") {
+        relu = true;
+      } else {
+        break;
+      }
+      // A top the chain moves on from must not be read outside of it.
+      ++top_reads;
+      if (top_id_vecs_[j][0] != top_id) {
+        if (is_output[top_id] || num_readers[top_id] != top_reads) {
+          break;
+        }
+        top_id = top_id_vecs_[j][0];
+        top_reads = 0;
+      }
+      block.push_back(j);
+    }
+    if (block.size() == 1) { continue; }
+    for (int k = 1; k < block.size(); ++k) {
+      layer_folded_[block[k]] = true;
+    }
+    top_vecs_[i][0] = blobs_[top_id].get();
+    top_id_vecs_[i][0] = top_id;
+    fold_blocks_.push_back(block);
+    num_folded += block.size() - 1;
+  }
+  LOG_IF(INFO, Caffe::root_solver()) << "Folding " << num_folded
+      << " layers into " << fold_blocks_.size() << " convolutions.";
+}
+
+template <typename Dtype>
+void Net<Dtype>::FoldBatchNorm() {
+  for (int b = 0; b < fold_blocks_.size(); ++b) {
+    const vector<int>& block = fold_blocks_[b];
+    BaseConvolutionLayer<Dtype>* conv_layer =
+        static_cast<BaseConvolutionLayer<Dtype>*>(layers_[block[0]].get());
+    const BaseConvolutionLayer<Dtype>* shared_fold = SharedFold(block);
+    if (shared_fold) {
+      conv_layer->ShareFoldedAffine(*shared_fold);
+      continue;
+    }
+    const int channels = top_vecs_[block[0]][0]->shape(1);
+    // The chain computes scale[c] * x + shift[c] on each channel c of the
+    // convolution output x, followed by the ReLU if any.
+    vector<Dtype> scale(channels, Dtype(1));
+    vector<Dtype> shift(channels, Dtype(0));
+    bool relu = false;
+    Dtype negative_slope = 0;
+    for (int k = 1; k < block.size(); ++k) {
+      Layer<Dtype>* layer = layers_[block[k]].get();
+      const string type = layer->type();
+      if (type == "BatchNorm") {
+        const Dtype* mean = layer->blobs()[0]->cpu_data();
+        const Dtype* variance = layer->blobs()[1]->cpu_data();
+        const Dtype factor = layer->blobs()[2]->cpu_data()[0] == 0 ?
+            0 : 1 / layer->blobs()[2]->cpu_data()[0];
+        const Dtype eps = layer->layer_param().batch_norm_param().eps();
+        for (int c = 0; c < channels; ++c) {
+          const Dtype inv_std = 1 / std::sqrt(variance[c] * factor + eps);
+          scale[c] *= inv_std;
+          shift[c] = (shift[c] - mean[c] * factor) * inv_std;
+        }
+      } else if (type == "Scale") {
+        const Dtype* gamma = layer->blobs()[0]->cpu_data();
+        const Dtype* beta = layer->blobs().size() > 1 ?
+            layer->blobs()[1]->cpu_data() : NULL;
+        for (int c = 0; c < channels; ++c) {
+          scale[c] *= gamma[c];
+          shift[c] = shift[c] * gamma[c] + (beta ? beta[c] : Dtype(0));
+        }
+      } else {
+        relu = true;
+        negative_slope = layer->layer_param().relu_param().negative_slope();
+      }
+    }
+    conv_layer->FoldAffine(&scale[0], &shift[0], relu, negative_slope);
+  }
+}
+
+template <typename Dtype>
+const BaseConvolutionLayer<Dtype>* Net<Dtype>::SharedFold(
+    const vector<int>& block) const {
+  if (!weights_net_) { return NULL; }
+  const vector<vector<int> >& source_blocks = weights_net_->fold_blocks_;
+  for (int b = 0; b < source_blocks.size(); ++b) {
+    const vector<int>& source_block = source_blocks[b];
+    bool same = source_block.size() == block.size();
+    for (int k = 0; same && k < block.size(); ++k) {
+      same = weights_net_->layer_names_[source_block[k]] ==
+          layer_names_[block[k]];
+    }
+    if (same) {
+      return static_cast<const BaseConvolutionLayer<Dtype>*>(
+          weights_net_->layers_[source_block[0]].get());
+    }
+  }
+  return NULL;
+}
+
+// The memory a blob is read from or written to. Tops computed in place and
+// the tops of split layers share the memory of their bottom.
+template <typename Dtype>
+static const void* BlobMemory(const Blob<Dtype>* blob) {
+  return blob->count() ? static_cast<const void*>(blob->data().get()) : blob;
+}
+
+template <typename Dtype>
+void Net<Dtype>::FindLayerDependencies() {
+  map<const void*, int> last_writer;
+  map<const void*, vector<int> > readers;
+  map<const void*, int> last_param_user;
+  layer_dependencies_.assign(layers_.size(), vector<int>());
+  for (int i = 0; i < layers_.size(); ++i) {
+    set<int> dependencies;
+    for (int j = 0; j < bottom_vecs_[i].size(); ++j) {
+      const void* memory = BlobMemory(bottom_vecs_[i][j]);
+      if (last_writer.count(memory)) {
+        dependencies.insert(last_writer[memory]);
+      }
+      readers[memory].push_back(i);
+    }
+    for (int j = 0; j < top_vecs_[i].size(); ++j) {
+      const void* memory = BlobMemory(top_vecs_[i][j]);
+      if (last_writer.count(memory)) {
+        dependencies.insert(last_writer[memory]);
+      }
+      vector<int>& memory_readers = readers[memory];
+      dependencies.insert(memory_readers.begin(), memory_readers.end());
+      memory_readers.clear();
+      last_writer[memory] = i;
+    }
+    // Layers sharing a param accumulate into the same diff.
+    const vector<shared_ptr<Blob<Dtype> > >& layer_blobs = layers_[i]->blobs();
+    for (int j = 0; j < layer_blobs.size(); ++j) {
+      const void* memory = BlobMemory(layer_blobs[j].get());
+      if (last_param_user.count(memory)) {
+        dependencies.insert(last_param_user[memory]);
+      }
+      last_param_user[memory] = i;
+    }
+    dependencies.erase(i);
+    layer_dependencies_[i].assign(dependencies.begin(), dependencies.end());
+  }
+}
+
+template <typename Dtype>
+void Net<Dtype>::GroupWaves(int first, int last, bool backward,
+    vector<vector<int> >* waves) const {
+  waves->clear();
+  if (last < first) { return; }
+  // A layer runs in the wave after the last wave of the layers in range it
+  // depends on (forward) or that depend on it (backward).
+  vector<int> wave(last - first + 1, 0);
+  if (!backward) {
+    for (int i = first; i <= last; ++i) {
+      const vector<int>& dependencies = layer_dependencies_[i];
+      for (int j = 0; j < dependencies.size(); ++j) {
+        if (dependencies[j] >= first) {
+          wave[i - first] = std::max(wave[i - first],
+              wave[dependencies[j] - first] + 1);
+        }
+      }
+    }
+  } else {
+    for (int i = last; i >= first; --i) {
+      const vector<int>& dependencies = layer_dependencies_[i];
+      for (int j = 0; j < dependencies.size(); ++j) {
+        if (dependencies[j] >= first) {
+          wave[dependencies[j] - first] = std::max(
+              wave[dependencies[j] - first], wave[i - first] + 1);
+        }
+      }
+    }
+  }
+  for (int k = 0; k < wave.size(); ++k) {
+    const int i = backward ? last - k : first + k;
+    if (wave[i - first] >= waves->size()) {
+      waves->resize(wave[i - first] + 1);
+    }
+    (*waves)[wave[i - first]].push_back(i);
+  }
+}
+
+template <typename Dtype>
+void Net<Dtype>::RunLayer(int layer_id, bool forward) {
+  CPUTimer timer;
+  timer.Start();
+  if (forward) {
+    layer_losses_[layer_id] = layer_folded_[layer_id] ? Dtype(0) :
+        layers_[layer_id]->Forward(bottom_vecs_[layer_id], top_vecs_[layer_id]);
+  } else if (layer_need_backward_[layer_id]) {
+    layers_[layer_id]->Backward(top_vecs_[layer_id],
+        bottom_need_backward_[layer_id], bottom_vecs_[layer_id]);
+  }
+  layer_times_[layer_id] = timer.MicroSeconds();
+}
+
+template <typename Dtype>
+void Net<Dtype>::RunBranchTask(const vector<int>* wave, bool forward, int k) {
+  // Tasks may run on any thread of the pool: hand them the Caffe state of
+  // the net's thread, and an RNG seeded in layer order so that random layers
+  // do not depend on the schedule.
+  Caffe::set_mode(Caffe::CPU);
+  Caffe::set_solver_count(branch_solver_count_);
+  Caffe::set_solver_rank(branch_solver_rank_);
+  Caffe::set_multiprocess(branch_multiprocess_);
+  Caffe::set_random_seed(wave_seeds_[k]);
+  RunLayer((*wave)[k], forward);
+}
+
+template <typename Dtype>
+void Net<Dtype>::RunWave(const vector<int>& wave, bool forward) {
+  if (wave.size() == 1) {
+    RunLayer(wave[0], forward);
+    return;
+  }
+  wave_seeds_.resize(wave.size());
+  for (int k = 0; k < wave.size(); ++k) {
+    wave_seeds_[k] = caffe_rng_rand();
+  }
+  // This thread runs tasks too, which reseed its RNG.
+  const unsigned int seed = caffe_rng_rand();
+  branch_solver_count_ = Caffe::solver_count();
+  branch_solver_rank_ = Caffe::solver_rank();
+  branch_multiprocess_ = Caffe::multiprocess();
+  branch_pool_->Run(wave.size(), boost::bind(&Net<Dtype>::RunBranchTask,
+      this, &wave, forward, _1));
+  Caffe::set_random_seed(seed);
+}
+
+template <typename Dtype>
+Dtype Net<Dtype>::ForwardWaves(int start, int end) {
+  CPUTimer timer;
+  timer.Start();
+  vector<vector<int> > waves;
+  GroupWaves(start, end, false, &waves);
+  Dtype loss = 0;
+  forward_busy_ = 0;
+  for (int w = 0; w < waves.size(); ++w) {
+    const vector<int>& wave = waves[w];
+    for (int k = 0; k < wave.size(); ++k) {
+      for (int c = 0; c < before_forward_.size(); ++c) {
+        before_forward_[c]->run(wave[k]);
+      }
+    }
+    RunWave(wave, true);
+    for (int k = 0; k < wave.size(); ++k) {
+      loss += layer_losses_[wave[k]];
+      forward_busy_ += layer_times_[wave[k]];
+      if (debug_info_) { ForwardDebugInfo(wave[k]); }
+      for (int c = 0; c < after_forward_.size(); ++c) {
+        after_forward_[c]->run(wave[k]);
+      }
+    }
+  }
+  forward_elapsed_ = timer.MicroSeconds();
+  return loss;
+}
+
+template <typename Dtype>
+void Net<Dtype>::BackwardWaves(int start, int end) {
+  CPUTimer timer;
+  timer.Start();
+  vector<vector<int> > waves;
+  GroupWaves(end, start, true, &waves);
+  backward_busy_ = 0;
+  for (int w = 0; w < waves.size(); ++w) {
+    const vector<int>& wave = waves[w];
+    for (int k = 0; k < wave.size(); ++k) {
+      for (int c = 0; c < before_backward_.size(); ++c) {
+        before_backward_[c]->run(wave[k]);
+      }
+    }
+    RunWave(wave, false);
+    for (int k = 0; k < wave.size(); ++k) {
+      backward_busy_ += layer_times_[wave[k]];
+      if (debug_info_ && layer_need_backward_[wave[k]]) {
+        BackwardDebugInfo(wave[k]);
+      }
+      for (int c = 0; c < after_backward_.size(); ++c) {
+        after_backward_[c]->run(wave[k]);
+      }
+    }
+  }
+  backward_elapsed_ = timer.MicroSeconds();
+}
+
 template <typename Dtype>
 Dtype Net<Dtype>::ForwardFromTo(int start, int end) {
   CHECK_GE(start, 0);
   CHECK_LT(end, layers_.size());
+  if (branch_pool_ && Caffe::mode() == Caffe::CPU) {
+    return ForwardWaves(start, end);
+  }
   Dtype loss = 0;
   for (int i = start; i <= end; ++i) {
     for (int c = 0; c < before_forward_.size(); ++c) {
       before_forward_[c]->run(i);
     }
-    Dtype layer_loss = layers_[i]->Forward(bottom_vecs_[i], top_vecs_[i]);
+    // Folded layers are computed by the convolution they are folded into.
+    Dtype layer_loss = layer_folded_[i] ? Dtype(0) :
+        layers_[i]->Forward(bottom_vecs_[i], top_vecs_[i]);
     loss += layer_loss;
     if (debug_info_) { ForwardDebugInfo(i); }
     for (int c = 0; c < after_forward_.size(); ++c) {
@@ -567,6 +1149,10 @@ template <typename Dtype>
 void Net<Dtype>::BackwardFromTo(int start, int end) {
   CHECK_GE(end, 0);
   CHECK_LT(start, layers_.size());
+  if (branch_pool_ && Caffe::mode() == Caffe::CPU) {
+    BackwardWaves(start, end);
+    return;
+  }
   for (int i = start; i >= end; --i) {
     for (int c = 0; c < before_backward_.size(); ++c) {
       before_backward_[c]->run(i);
@@ -691,6 +1277,7 @@ void Net<Dtype>::ShareTrainedLayersWith(const Net* other) {
       target_blobs[j]->ShareData(*source_blob);
     }
   }
+  FoldBatchNorm();
 }
 
 template <typename Dtype>
@@ -725,7 +1312,12 @@ void Net<Dtype>::Backward() {
 template <typename Dtype>
 void Net<Dtype>::Reshape() {
   for (int i = 0; i < layers_.size(); ++i) {
-    layers_[i]->Reshape(bottom_vecs_[i], top_vecs_[i]);
+    if (!layer_folded_[i]) {
+      layers_[i]->Reshape(bottom_vecs_[i], top_vecs_[i]);
+    }
+  }
+  if (optimize_memory_) {
+    PlanMemory();
   }
 }
 
@@ -765,12 +1357,15 @@ void Net<Dtype>::CopyTrainedLayersFrom(const NetParameter& param) {
       target_blobs[j]->FromProto(source_layer.blobs(j), kReshape);
     }
   }
+  FoldBatchNorm();
 }
 
 template <typename Dtype>
 void Net<Dtype>::CopyTrainedLayersFrom(const string trained_filename) {
   if (H5Fis_hdf5(trained_filename.c_str())) {
     CopyTrainedLayersFromHDF5(trained_filename);
+  } else if (MappedWeights::IsMappedWeightsFile(trained_filename)) {
+    CopyTrainedLayersFromMapped(trained_filename);
   } else {
     CopyTrainedLayersFromBinaryProto(trained_filename);
   }
@@ -832,6 +1427,57 @@ void Net<Dtype>::CopyTrainedLayersFromHDF5(const string trained_filename) {
   }
   H5Gclose(data_hid);
   H5Fclose(file_hid);
+  FoldBatchNorm();
+}
+
+template <typename Dtype>
+void Net<Dtype>::CopyTrainedLayersFromMapped(const string trained_filename) {
+  shared_ptr<MappedWeights> weights(new MappedWeights(trained_filename));
+  const bool is_double = sizeof(Dtype) == sizeof(double);
+  for (int i = 0; i < weights->tensors().size(); ++i) {
+    const MappedTensor& tensor = weights->tensors()[i];
+    if (!layer_names_index_.count(tensor.layer_name)) {
+      LOG_IF(INFO, tensor.param_id == 0)
+          << "Ignoring source layer " << tensor.layer_name;
+      continue;
+    }
+    DLOG(INFO) << "Copying source layer " << tensor.layer_name;
+    const int target_layer_id = layer_names_index_[tensor.layer_name];
+    vector<shared_ptr<Blob<Dtype> > >& target_blobs =
+        layers_[target_layer_id]->blobs();
+    CHECK_LT(tensor.param_id, target_blobs.size())
+        << "Incompatible number of blobs for layer " << tensor.layer_name;
+    Blob<Dtype>* target_blob = target_blobs[tensor.param_id].get();
+    bool shape_equals = target_blob->shape() == tensor.shape;
+    if (!shape_equals && tensor.shape.size() == 4) {
+      // The num, channels, height and width of old models, which the
+      // converter keeps, match as in CopyTrainedLayersFrom.
+      BlobProto legacy;
+      legacy.set_num(tensor.shape[0]);
+      legacy.set_channels(tensor.shape[1]);
+      legacy.set_height(tensor.shape[2]);
+      legacy.set_width(tensor.shape[3]);
+      shape_equals = target_blob->ShapeEquals(legacy);
+    }
+    CHECK(shape_equals) << "Cannot copy param "
+        << tensor.param_id << " weights from layer '" << tensor.layer_name
+        << "'; shape mismatch.  Source param shape is "
+        << Blob<Dtype>(tensor.shape).shape_string()
+        << "; target param shape is " << target_blob->shape_string();
+    const int count = target_blob->count();
+    if (tensor.is_double == is_double && count > 0 &&
+        target_blob->data()->size() == count * sizeof(Dtype)) {
+      target_blob->data()->set_cpu_data(const_cast<void*>(tensor.data),
+          weights);
+    } else if (tensor.is_double) {
+      const double* data = static_cast<const double*>(tensor.data);
+      std::copy(data, data + count, target_blob->mutable_cpu_data());
+    } else {
+      const float* data = static_cast<const float*>(tensor.data);
+      std::copy(data, data + count, target_blob->mutable_cpu_data());
+    }
+  }
+  FoldBatchNorm();
 }
 
 template <typename Dtype>
@@ -905,6 +1551,7 @@ void Net<Dtype>::ToHDF5(const string& filename, bool write_diff) const {
 
 template <typename Dtype>
 void Net<Dtype>::Update() {
+  CHECK(!weights_net_) << "Cannot update params shared with another net.";
   for (int i = 0; i < learnable_params_.size(); ++i) {
     learnable_params_[i]->Update();
   }
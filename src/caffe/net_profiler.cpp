@@ -0,0 +1,278 @@
+#include <algorithm>
+#include <fstream>  // NOLINT(readability/streams)
+#include <iomanip>
+#include <string>
+#include <vector>
+
+#include "caffe/net_profiler.hpp"
+#include "caffe/syncedmem.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+void NetProfiler<Dtype>::Counters::Add(const Counters& other) {
+  passes += other.passes;
+  microseconds += other.microseconds;
+  bytes_read += other.bytes_read;
+  bytes_written += other.bytes_written;
+  flops += other.flops;
+  allocations += other.allocations;
+  allocated_bytes += other.allocated_bytes;
+}
+
+template <typename Dtype>
+void NetProfiler<Dtype>::Hook::run(int layer) {
+  if (end_) {
+    profiler_->End(net_, layer, backward_);
+  } else {
+    profiler_->Begin(net_, layer);
+  }
+}
+
+template <typename Dtype>
+NetProfiler<Dtype>::NetProfiler(int max_trace_events)
+    : max_trace_events_(max_trace_events),
+      start_(boost::posix_time::microsec_clock::local_time()) {}
+
+template <typename Dtype>
+void NetProfiler<Dtype>::Attach(Net<Dtype>* net, const string& name) {
+  const int index = nets_.size();
+  const int num_layers = net->layers().size();
+  nets_.push_back(NetRecord());
+  NetRecord& record = nets_.back();
+  record.net = net;
+  record.name = name;
+  record.forward.resize(num_layers);
+  record.backward.resize(num_layers);
+  record.begin_microseconds.resize(num_layers);
+  record.begin_allocations.resize(num_layers);
+  record.begin_allocated_bytes.resize(num_layers);
+  for (int k = 0; k < 4; ++k) {
+    hooks_.push_back(shared_ptr<Hook>(new Hook(this, index, k / 2, k % 2)));
+  }
+  net->add_before_forward(hooks_[4 * index].get());
+  net->add_after_forward(hooks_[4 * index + 1].get());
+  net->add_before_backward(hooks_[4 * index + 2].get());
+  net->add_after_backward(hooks_[4 * index + 3].get());
+}
+
+template <typename Dtype>
+double NetProfiler<Dtype>::Now() const {
+#ifndef CPU_ONLY
+  if (Caffe::mode() == Caffe::GPU) {
+    CUDA_CHECK(cudaDeviceSynchronize());
+  }
+#endif
+  return (boost::posix_time::microsec_clock::local_time() - start_)
+      .total_microseconds();
+}
+
+template <typename Dtype>
+void NetProfiler<Dtype>::Begin(int net, int layer) {
+  NetRecord& record = nets_[net];
+  SyncedMemory::allocations(&record.begin_allocations[layer],
+      &record.begin_allocated_bytes[layer]);
+  record.begin_microseconds[layer] = Now();
+}
+
+// The bytes of the data, and of the diffs if diff, of blobs.
+template <typename Dtype>
+static double Bytes(const vector<Blob<Dtype>*>& blobs, bool diff) {
+  double count = 0;
+  for (int i = 0; i < blobs.size(); ++i) {
+    count += blobs[i]->count();
+  }
+  return count * sizeof(Dtype) * (diff ? 2 : 1);
+}
+
+template <typename Dtype>
+static double Bytes(const vector<shared_ptr<Blob<Dtype> > >& blobs) {
+  double count = 0;
+  for (int i = 0; i < blobs.size(); ++i) {
+    count += blobs[i]->count();
+  }
+  return count * sizeof(Dtype);
+}
+
+// Whether the FLOPs of a layer of type are those of products with weights.
+static bool MultipliesWeights(const string& type) {
+  return type == "Convolution" || type == "Deconvolution" ||
+      type == "InnerProduct";
+}
+
+template <typename Dtype>
+double NetProfiler<Dtype>::ForwardFlops(const Layer<Dtype>& layer,
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  double bottom_count = 0, top_count = 0;
+  for (int i = 0; i < bottom.size(); ++i) {
+    bottom_count += bottom[i]->count();
+  }
+  for (int i = 0; i < top.size(); ++i) {
+    top_count += top[i]->count();
+  }
+  const string type = layer.type();
+  if (bottom.empty()) {
+    return 0;
+  }
+  if (!MultipliesWeights(type) || layer.blobs().empty()) {
+    return std::max(bottom_count, top_count);
+  }
+  if (type != "InnerProduct") {
+    // Each output (input of a deconvolution) meets the weights of a filter.
+    const Blob<Dtype>& weight = *layer.blobs()[0];
+    const double filter_dim = weight.count() / weight.shape(0);
+    const double products = type == "Convolution" ? top_count : bottom_count;
+    const bool bias_term = layer.layer_param().convolution_param().bias_term();
+    return 2 * products * filter_dim + (bias_term ? top_count : 0);
+  }
+  const int axis = bottom[0]->CanonicalAxisIndex(
+      layer.layer_param().inner_product_param().axis());
+  const bool bias_term = layer.layer_param().inner_product_param().bias_term();
+  return 2 * top_count * bottom[0]->count(axis) + (bias_term ? top_count : 0);
+}
+
+template <typename Dtype>
+void NetProfiler<Dtype>::End(int net, int layer, bool backward) {
+  const double end = Now();
+  NetRecord& record = nets_[net];
+  const Net<Dtype>& n = *record.net;
+  if (backward ? !n.layer_need_backward()[layer] :
+      n.layer_folded()[layer]) {
+    return;
+  }
+  const Layer<Dtype>& l = *n.layers()[layer];
+  const vector<Blob<Dtype>*>& bottom = n.bottom_vecs()[layer];
+  const vector<Blob<Dtype>*>& top = n.top_vecs()[layer];
+  Counters pass;
+  pass.passes = 1;
+  pass.microseconds = end - record.begin_microseconds[layer];
+  SyncedMemory::allocations(&pass.allocations, &pass.allocated_bytes);
+  pass.allocations -= record.begin_allocations[layer];
+  pass.allocated_bytes -= record.begin_allocated_bytes[layer];
+  pass.flops = ForwardFlops(l, bottom, top);
+  if (!backward) {
+    pass.bytes_read = Bytes(bottom, false) + Bytes(l.blobs());
+    pass.bytes_written = Bytes(top, false);
+    record.forward[layer].Add(pass);
+  } else {
+    pass.bytes_read = Bytes(top, true) + Bytes(bottom, false) +
+        Bytes(l.blobs());
+    for (int i = 0; i < bottom.size(); ++i) {
+      if (n.bottom_need_backward()[layer][i]) {
+        pass.bytes_written += bottom[i]->count() * sizeof(Dtype);
+      }
+    }
+    for (int i = 0; i < l.blobs().size(); ++i) {
+      if (l.param_propagate_down(i)) {
+        pass.bytes_written += l.blobs()[i]->count() * sizeof(Dtype);
+      }
+    }
+    if (MultipliesWeights(l.type())) {
+      // The gradients of the weights and of the bottom.
+      pass.flops *= 2;
+    }
+    record.backward[layer].Add(pass);
+  }
+  if (static_cast<int>(events_.size()) < max_trace_events_) {
+    TraceEvent event;
+    event.net = net;
+    event.layer = layer;
+    event.backward = backward;
+    event.begin_microseconds = record.begin_microseconds[layer];
+    event.counters = pass;
+    events_.push_back(event);
+  }
+}
+
+template <typename Dtype>
+void NetProfiler<Dtype>::LogSummary() const {
+  for (int i = 0; i < nets_.size(); ++i) {
+    const NetRecord& record = nets_[i];
+    const Net<Dtype>& net = *record.net;
+    LOG(INFO) << "Net " << record.name << " layers, per pass: ms, GFLOP, "
+        "MB read, MB written; then allocations over all passes";
+    Counters total[2];
+    for (int l = 0; l < net.layers().size(); ++l) {
+      for (int d = 0; d < 2; ++d) {
+        const Counters& c = d ? record.backward[l] : record.forward[l];
+        if (!c.passes) {
+          continue;
+        }
+        total[d].Add(c);
+        LOG(INFO) << std::setfill(' ') << std::setw(16)
+            << net.layer_names()[l] << std::setw(16)
+            << net.layers()[l]->type() << (d ? "  backward " : "  forward  ")
+            << std::fixed << std::setprecision(3)
+            << std::setw(10) << c.microseconds / 1e3 / c.passes
+            << std::setw(10) << c.flops / 1e9 / c.passes
+            << std::setw(10) << c.bytes_read / 1e6 / c.passes
+            << std::setw(10) << c.bytes_written / 1e6 / c.passes
+            << std::setw(8) << c.allocations;
+      }
+    }
+    for (int d = 0; d < 2; ++d) {
+      const Counters& c = total[d];
+      if (c.microseconds > 0) {
+        LOG(INFO) << "Net " << record.name << (d ? " backward" :
+            " forward") << ", all passes: " << c.microseconds / 1e3 << " ms, "
+            << c.flops / c.microseconds / 1e3 << " GFLOP/s, "
+            << (c.bytes_read + c.bytes_written) / c.microseconds / 1e3
+            << " GB/s, " << c.allocations << " allocations of "
+            << c.allocated_bytes / 1e6 << " MB";
+      }
+    }
+  }
+}
+
+// Returns s quoted as a JSON string.
+static string JsonString(const string& s) {
+  std::ostringstream json;
+  json << '"';
+  for (int i = 0; i < s.size(); ++i) {
+    const unsigned char c = s[i];
+    if (c == '"' || c == '\\') {
+      json << '\\' << c;
+    } else if (c < 0x20) {
+      json << "\\u" << std::hex << std::setw(4) << std::setfill('0')
+          << static_cast<int>(c) << std::dec;
+    } else {
+      json << c;
+    }
+  }
+  json << '"';
+  return json.str();
+}
+
+template <typename Dtype>
+void NetProfiler<Dtype>::WriteTrace(const string& filename) const {
+  std::ofstream out(filename.c_str());
+  CHECK(out) << "Failed to open " << filename;
+  out << std::fixed << std::setprecision(0);
+  out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+  for (int i = 0; i < nets_.size(); ++i) {
+    out << (i ? ",\n" : "\n") << "{\"name\": \"process_name\", \"ph\": \"M\", "
+        << "\"pid\": " << i << ", \"args\": {\"name\": "
+        << JsonString(nets_[i].name) << "}}";
+  }
+  for (int e = 0; e < events_.size(); ++e) {
+    const TraceEvent& event = events_[e];
+    const Net<Dtype>& net = *nets_[event.net].net;
+    const Counters& c = event.counters;
+    out << ",\n{\"name\": " << JsonString(net.layer_names()[event.layer])
+        << ", \"cat\": \"" << (event.backward ? "backward" : "forward")
+        << "\", \"ph\": \"X\", \"pid\": " << event.net << ", \"tid\": 0, "
+        << "\"ts\": " << event.begin_microseconds << ", \"dur\": "
+        << c.microseconds << ", \"args\": {\"type\": "
+        << JsonString(net.layers()[event.layer]->type()) << ", \"flops\": "
+        << c.flops << ", \"bytes_read\": " << c.bytes_read
+        << ", \"bytes_written\": " << c.bytes_written << ", \"allocations\": "
+        << c.allocations << ", \"allocated_bytes\": " << c.allocated_bytes
+        << "}}";
+  }
+  out << "\n]}\n";
+  CHECK(out) << "Failed to write " << filename;
+}
+
+INSTANTIATE_CLASS(NetProfiler);
+
+}  // namespace caffe
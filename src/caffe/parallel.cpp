@@ -1,6 +1,7 @@
 #ifdef USE_NCCL
-
 #include <cuda_runtime.h>
+#endif
+#include <boost/thread.hpp>
 #include <glog/logging.h>
 #include <stdio.h>
 #include <sstream>
@@ -72,6 +73,220 @@ Params<Dtype>::Params(shared_ptr<Solver<Dtype> > root_solver)
     diff_() {
 }
 
+template<typename Dtype>
+CPUParams<Dtype>::CPUParams(shared_ptr<Solver<Dtype> > root_solver)
+  : Params<Dtype>(root_solver) {
+  data_ = new Dtype[size_];
+  const vector<Blob<Dtype>*>& net =
+    root_solver->net()->learnable_params();
+  apply_buffers(net, data_, size_, copy);
+  diff_ = new Dtype[size_];
+  caffe_set(size_, Dtype(0), diff_);
+}
+
+template<typename Dtype>
+CPUParams<Dtype>::~CPUParams() {
+  delete [] data_;
+  delete [] diff_;
+}
+
+template<typename Dtype>
+void CPUParams<Dtype>::Configure(Solver<Dtype>* solver) const {
+  const vector<Blob<Dtype>*>& net =
+    solver->net()->learnable_params();
+  apply_buffers(net, data_, size_, replace_cpu);
+  apply_buffers(net, diff_, size_, replace_cpu_diff);
+}
+
+template<typename Dtype>
+class CPUParallel<Dtype>::Group {
+ public:
+  Group(int size, int num_layers)
+    : barrier(size), members(size), arrivals(num_layers) {
+  }
+  boost::barrier barrier;
+  vector<CPUParallel<Dtype>*> members;
+  // Number of replicas done with the backward pass of each layer in the
+  // current iteration, guarded by mutex.
+  boost::mutex mutex;
+  vector<int> arrivals;
+};
+
+template<typename Dtype>
+CPUParallel<Dtype>::CPUParallel(shared_ptr<Solver<Dtype> > solver)
+  : CPUParams<Dtype>(solver), solver_(solver), group_(),
+    // Accumulating several backward passes would reduce partial sums.
+    layer_wise_(solver->param().layer_wise_reduce() &&
+                solver->param().iter_size() == 1) {
+  this->Configure(solver.get());
+  const vector<shared_ptr<Layer<Dtype> > >& layers = solver->net()->layers();
+  if (layer_wise_) {
+    CHECK_EQ(solver->net()->params().size(),
+             solver->net()->learnable_params().size())
+      << "Layer-wise reduce is not supported for nets with shared weights.";
+    for (int i = 0; i < layers.size(); ++i) {
+      const vector<shared_ptr<Blob<Dtype> > >& blobs = layers[i]->blobs();
+      size_t size = 0;
+      for (int j = 0; j < blobs.size(); ++j) {
+        size += blobs[j]->count();
+      }
+      layer_offsets_.push_back(size ? blobs[0]->cpu_diff() - diff_ : 0);
+      layer_sizes_.push_back(size);
+    }
+  }
+}
+
+template<typename Dtype>
+CPUParallel<Dtype>::~CPUParallel() {
+}
+
+template<typename Dtype>
+void CPUParallel<Dtype>::Join(Group* group) {
+  group_ = group;
+  group_->members[Caffe::solver_rank()] = this;
+  solver_->add_callback(this);
+  if (layer_wise_) {
+    solver_->net()->add_after_backward(this);
+  }
+}
+
+template<typename Dtype>
+void CPUParallel<Dtype>::Broadcast() {
+  group_->barrier.wait();
+  if (Caffe::solver_rank() != 0) {
+    caffe_copy(size_, group_->members[0]->data_, data_);
+  }
+  group_->barrier.wait();
+}
+
+template<typename Dtype>
+void CPUParallel<Dtype>::AllReduce(size_t offset, size_t count) {
+  const vector<CPUParallel<Dtype>*>& members = group_->members;
+  // Summing in rank order gives every replica bitwise identical updates.
+  Dtype* sum = members[0]->diff_ + offset;
+  for (int i = 1; i < members.size(); ++i) {
+    caffe_axpy<Dtype>(count, Dtype(1), members[i]->diff_ + offset, sum);
+  }
+  caffe_scal<Dtype>(count, Dtype(1) / members.size(), sum);
+  for (int i = 1; i < members.size(); ++i) {
+    caffe_copy(count, sum, members[i]->diff_ + offset);
+  }
+}
+
+template<typename Dtype>
+void CPUParallel<Dtype>::run(int layer) {
+  if (layer_sizes_[layer] == 0) {
+    return;
+  }
+  bool last = false;
+  {
+    boost::lock_guard<boost::mutex> lock(group_->mutex);
+    if (++group_->arrivals[layer] == group_->members.size()) {
+      group_->arrivals[layer] = 0;
+      last = true;
+    }
+  }
+  if (last) {
+    AllReduce(layer_offsets_[layer], layer_sizes_[layer]);
+  }
+}
+
+template<typename Dtype>
+void CPUParallel<Dtype>::on_gradients_ready() {
+  if (layer_wise_) {
+    // Every layer was reduced by the last replica to reach it, before that
+    // replica got here.
+    group_->barrier.wait();
+  } else {
+    group_->barrier.wait();
+    const size_t num = group_->members.size();
+    const size_t rank = Caffe::solver_rank();
+    const size_t begin = size_ * rank / num;
+    const size_t end = size_ * (rank + 1) / num;
+    AllReduce(begin, end - begin);
+    group_->barrier.wait();
+  }
+}
+
+template<typename Dtype>
+class CPUWorker : public InternalThread {
+ public:
+  explicit CPUWorker(shared_ptr<Solver<Dtype> > rank0,
+                     typename CPUParallel<Dtype>::Group* group,
+                     const char* restore)
+    : rank0_(rank0), group_(group), restore_(restore) {
+  }
+  virtual ~CPUWorker() {}
+
+ protected:
+  void InternalThreadEntry() {
+    {
+      // Create solver and install callbacks
+      SolverParameter param(rank0_->param());
+      param.set_type(rank0_->type());
+      shared_ptr<Solver<Dtype> > s(
+          SolverRegistry<Dtype>::CreateSolver(param));
+      CHECK_EQ(s->type(), rank0_->type());
+      if (restore_) {
+        s->Restore(restore_);
+      }
+      CPUParallel<Dtype> parallel(s);
+      parallel.Join(group_);
+      // Wait for other threads
+      group_->barrier.wait();
+      // Broadcast rank 0 state
+      parallel.Broadcast();
+      // Solve
+      s->Step(param.max_iter() - s->iter());
+    }
+    // The replica is released before Run() interrupts this thread, as its
+    // data layers join threads of their own. The other replicas are done
+    // reading its gradients after the last update.
+    group_->barrier.wait();
+  }
+
+  shared_ptr<Solver<Dtype> > rank0_;
+  typename CPUParallel<Dtype>::Group* group_;
+  const char* restore_;
+};
+
+template<typename Dtype>
+void CPUParallel<Dtype>::Run(int num_threads, const char* restore) {
+  CHECK_EQ(Caffe::mode(), Caffe::CPU);
+  CHECK_EQ(Caffe::solver_count(), num_threads)
+    << "Set the solver count before creating the solver, so that data "
+    << "layers read their share of the data.";
+  Group group(num_threads, solver_->net()->layers().size());
+  // Create workers
+  vector<shared_ptr<CPUWorker<Dtype> > > workers(num_threads);
+  for (int i = 1; i < num_threads; ++i) {
+    Caffe::set_solver_rank(i);
+    CPUWorker<Dtype>* w = new CPUWorker<Dtype>(solver_, &group, restore);
+    w->StartInternalThread();
+    workers[i].reset(w);
+  }
+  Caffe::set_solver_rank(0);
+  Join(&group);
+  // Wait for workers
+  group.barrier.wait();
+  // Run first solver on current thread
+  Broadcast();
+  solver_->Solve();
+  group.barrier.wait();
+  // Wait for shutdown
+  for (int i = 1; i < num_threads; ++i) {
+    workers[i]->StopInternalThread();
+  }
+  group_ = NULL;
+}
+
+INSTANTIATE_CLASS(Params);
+INSTANTIATE_CLASS(CPUParams);
+INSTANTIATE_CLASS(CPUWorker);
+INSTANTIATE_CLASS(CPUParallel);
+
+#ifdef USE_NCCL
+
 template<typename Dtype>
 GPUParams<Dtype>::GPUParams(shared_ptr<Solver<Dtype> > root_solver, int device)
   : Params<Dtype>(root_solver) {
@@ -361,11 +576,10 @@ void NCCL<Dtype>::Run(const vector<int>& gpus, const char* restore) {
   }
 }
 
-INSTANTIATE_CLASS(Params);
 INSTANTIATE_CLASS(GPUParams);
 INSTANTIATE_CLASS(Worker);
 INSTANTIATE_CLASS(NCCL);
 
-}  // namespace caffe
-
 #endif  // USE_NCCL
+
+}  // namespace caffe
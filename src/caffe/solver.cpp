@@ -239,6 +239,8 @@ void Solver<Dtype>::Step(int iters) {
       LOG_IF(INFO, Caffe::root_solver()) << "Iteration " << iter_
           << " (" << per_s << " iter/s, " << lapse << "s/"
           << param_.display() << " iters), loss = " << smoothed_loss_;
+      LOG_IF(INFO, Caffe::root_solver() && net_->branch_parallelism())
+          << "    Branch parallelism: " << net_->branch_parallelism();
       iteration_timer_.Start();
       iterations_last_ = iter_;
       const vector<Blob<Dtype>*>& result = net_->output_blobs();
@@ -106,6 +106,29 @@ void AdaDeltaSolver<Dtype>::ComputeUpdateValue(int param_id, Dtype rate) {
   }
 }
 
+template <typename Dtype>
+void AdaDeltaSolver<Dtype>::ComputeFusedUpdate(
+    const typename SGDSolver<Dtype>::FusedParam& param, int begin, int end) {
+  const Dtype delta = this->param_.delta();
+  const Dtype momentum = this->param_.momentum();
+  Dtype* data = param.data;
+  Dtype* diff = param.diff;
+  Dtype* history = param.history[0];
+  Dtype* update_history = param.history[1];
+  for (int i = begin; i < end; ++i) {
+    const Dtype gradient = this->FusedGradient(param, i);
+    history[i] = (Dtype(1) - momentum) * gradient * gradient +
+        momentum * history[i];
+    // jointly compute the RMS of both for update and gradient history
+    const Dtype update = gradient *
+        std::sqrt((delta + update_history[i]) / (delta + history[i]));
+    update_history[i] = (Dtype(1) - momentum) * update * update +
+        momentum * update_history[i];
+    diff[i] = param.rate * update;
+    data[i] -= diff[i];
+  }
+}
+
 INSTANTIATE_CLASS(AdaDeltaSolver);
 REGISTER_SOLVER_CLASS(AdaDelta);
 
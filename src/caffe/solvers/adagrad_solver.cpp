@@ -63,6 +63,23 @@ void AdaGradSolver<Dtype>::ComputeUpdateValue(int param_id, Dtype rate) {
   }
 }
 
+template <typename Dtype>
+void AdaGradSolver<Dtype>::ComputeFusedUpdate(
+    const typename SGDSolver<Dtype>::FusedParam& param, int begin, int end) {
+  const Dtype delta = this->param_.delta();
+  Dtype* data = param.data;
+  Dtype* diff = param.diff;
+  Dtype* history = param.history[0];
+  for (int i = begin; i < end; ++i) {
+    const Dtype gradient = this->FusedGradient(param, i);
+    history[i] += gradient * gradient;
+    const Dtype update =
+        param.rate * (gradient / (std::sqrt(history[i]) + delta));
+    diff[i] = update;
+    data[i] -= update;
+  }
+}
+
 INSTANTIATE_CLASS(AdaGradSolver);
 REGISTER_SOLVER_CLASS(AdaGrad);
 
@@ -88,6 +88,31 @@ void AdamSolver<Dtype>::ComputeUpdateValue(int param_id, Dtype rate) {
   }
 }
 
+template <typename Dtype>
+void AdamSolver<Dtype>::ComputeFusedUpdate(
+    const typename SGDSolver<Dtype>::FusedParam& param, int begin, int end) {
+  const Dtype beta1 = this->param_.momentum();
+  const Dtype beta2 = this->param_.momentum2();
+  const Dtype eps_hat = this->param_.delta();
+  const int t = this->iter_ + 1;
+  const Dtype correction = std::sqrt(Dtype(1) - pow(beta2, t)) /
+      (Dtype(1.) - pow(beta1, t));
+  const Dtype corrected_rate = param.rate * correction;
+  Dtype* data = param.data;
+  Dtype* diff = param.diff;
+  Dtype* val_m = param.history[0];
+  Dtype* val_v = param.history[1];
+  for (int i = begin; i < end; ++i) {
+    const Dtype gradient = this->FusedGradient(param, i);
+    val_m[i] = (Dtype(1) - beta1) * gradient + beta1 * val_m[i];
+    val_v[i] = (Dtype(1) - beta2) * gradient * gradient + beta2 * val_v[i];
+    const Dtype update =
+        corrected_rate * (val_m[i] / (std::sqrt(val_v[i]) + eps_hat));
+    diff[i] = update;
+    data[i] -= update;
+  }
+}
+
 INSTANTIATE_CLASS(AdamSolver);
 REGISTER_SOLVER_CLASS(Adam);
 
@@ -55,6 +55,25 @@ void NesterovSolver<Dtype>::ComputeUpdateValue(int param_id, Dtype rate) {
   }
 }
 
+template <typename Dtype>
+void NesterovSolver<Dtype>::ComputeFusedUpdate(
+    const typename SGDSolver<Dtype>::FusedParam& param, int begin, int end) {
+  const Dtype momentum = this->param_.momentum();
+  Dtype* data = param.data;
+  Dtype* diff = param.diff;
+  Dtype* history = param.history[0];
+  for (int i = begin; i < end; ++i) {
+    // update history, then step back and over step
+    const Dtype history_prev = history[i];
+    history[i] = param.rate * this->FusedGradient(param, i) +
+        momentum * history_prev;
+    const Dtype update =
+        (Dtype(1) + momentum) * history[i] - momentum * history_prev;
+    diff[i] = update;
+    data[i] -= update;
+  }
+}
+
 INSTANTIATE_CLASS(NesterovSolver);
 REGISTER_SOLVER_CLASS(Nesterov);
 
@@ -64,6 +64,25 @@ void RMSPropSolver<Dtype>::ComputeUpdateValue(int param_id, Dtype rate) {
   }
 }
 
+template <typename Dtype>
+void RMSPropSolver<Dtype>::ComputeFusedUpdate(
+    const typename SGDSolver<Dtype>::FusedParam& param, int begin, int end) {
+  const Dtype delta = this->param_.delta();
+  const Dtype rms_decay = this->param_.rms_decay();
+  Dtype* data = param.data;
+  Dtype* diff = param.diff;
+  Dtype* history = param.history[0];
+  for (int i = begin; i < end; ++i) {
+    const Dtype gradient = this->FusedGradient(param, i);
+    history[i] = Dtype(1 - rms_decay) * gradient * gradient +
+        rms_decay * history[i];
+    const Dtype update =
+        param.rate * (gradient / (std::sqrt(history[i]) + delta));
+    diff[i] = update;
+    data[i] -= update;
+  }
+}
+
 INSTANTIATE_CLASS(RMSPropSolver);
 REGISTER_SOLVER_CLASS(RMSProp);
 
@@ -1,13 +1,19 @@
+#include <boost/bind.hpp>
+#include <algorithm>
 #include <string>
 #include <vector>
 
 #include "caffe/sgd_solvers.hpp"
 #include "caffe/util/hdf5.hpp"
 #include "caffe/util/io.hpp"
+#include "caffe/util/thread_pool.hpp"
 #include "caffe/util/upgrade_proto.hpp"
 
 namespace caffe {
 
+// Smallest number of elements worth a thread of the fused update.
+static const int kFusedUpdateMinRange = 16384;
+
 // Return the current learning rate. The currently implemented learning rate
 // policies are as follows:
 //    - fixed: always return base_lr.
@@ -113,6 +119,10 @@ void SGDSolver<Dtype>::ApplyUpdate() {
         << ", lr = " << rate;
   }
   ClipGradients();
+  if (this->param_.fused_update() && Caffe::mode() == Caffe::CPU) {
+    ApplyFusedUpdate(rate);
+    return;
+  }
   for (int param_id = 0; param_id < this->net_->learnable_params().size();
        ++param_id) {
     Normalize(param_id);
@@ -249,6 +259,122 @@ void SGDSolver<Dtype>::ComputeUpdateValue(int param_id, Dtype rate) {
   }
 }
 
+template <typename Dtype>
+void SGDSolver<Dtype>::FusedPreSolve() {
+  const vector<Blob<Dtype>*>& net_params = this->net_->learnable_params();
+  const int num_params = net_params.size();
+  CHECK_EQ(history_.size() % num_params, 0);
+  CHECK_LE(history_.size(), 2 * num_params)
+      << "The fused update supports up to two history blobs per param.";
+  fused_offsets_.assign(1, 0);
+  for (int i = 0; i < num_params; ++i) {
+    fused_offsets_.push_back(fused_offsets_.back() + net_params[i]->count());
+  }
+  const int count = fused_offsets_.back();
+  if (count == 0) { return; }
+  // Params that are already contiguous stay where they are: their buffers
+  // may be shared with other solvers, as in data-parallel training.
+  bool data_contiguous = true;
+  bool diff_contiguous = true;
+  for (int i = 0; i < num_params; ++i) {
+    data_contiguous &= net_params[i]->cpu_data() ==
+        net_params[0]->cpu_data() + fused_offsets_[i];
+    diff_contiguous &= net_params[i]->cpu_diff() ==
+        net_params[0]->cpu_diff() + fused_offsets_[i];
+  }
+  if (!data_contiguous) {
+    fused_data_.Reshape(vector<int>(1, count));
+    Dtype* fused_data = fused_data_.mutable_cpu_data();
+    for (int i = 0; i < num_params; ++i) {
+      Dtype* ptr = fused_data + fused_offsets_[i];
+      caffe_copy(net_params[i]->count(), net_params[i]->cpu_data(), ptr);
+      net_params[i]->data()->set_cpu_data(ptr);
+    }
+  }
+  if (!diff_contiguous) {
+    fused_diff_.Reshape(vector<int>(1, count));
+    Dtype* fused_diff = fused_diff_.mutable_cpu_data();
+    for (int i = 0; i < num_params; ++i) {
+      Dtype* ptr = fused_diff + fused_offsets_[i];
+      caffe_copy(net_params[i]->count(), net_params[i]->cpu_diff(), ptr);
+      net_params[i]->diff()->set_cpu_data(ptr);
+    }
+  }
+  fused_history_.Reshape(vector<int>(1, history_.size() / num_params * count));
+  Dtype* fused_history = fused_history_.mutable_cpu_data();
+  for (int h = 0; h < history_.size(); ++h) {
+    Dtype* ptr = fused_history + h / num_params * count +
+        fused_offsets_[h % num_params];
+    caffe_copy(history_[h]->count(), history_[h]->cpu_data(), ptr);
+    history_[h]->data()->set_cpu_data(ptr);
+  }
+}
+
+template <typename Dtype>
+void SGDSolver<Dtype>::ApplyFusedUpdate(Dtype rate) {
+  const vector<Blob<Dtype>*>& net_params = this->net_->learnable_params();
+  const int num_params = net_params.size();
+  if (num_params == 0) { return; }
+  if (fused_offsets_.empty()) {
+    FusedPreSolve();
+  }
+  const vector<float>& net_params_lr = this->net_->params_lr();
+  const vector<float>& net_params_weight_decay =
+      this->net_->params_weight_decay();
+  const Dtype weight_decay = this->param_.weight_decay();
+  const string& regularization_type = this->param_.regularization_type();
+  const int num_history = history_.size() / num_params;
+  fused_params_.resize(num_params);
+  for (int i = 0; i < num_params; ++i) {
+    FusedParam& param = fused_params_[i];
+    param.data = net_params[i]->mutable_cpu_data();
+    param.diff = net_params[i]->mutable_cpu_diff();
+    for (int k = 0; k < 2; ++k) {
+      param.history[k] = k < num_history ?
+          history_[k * num_params + i]->mutable_cpu_data() : NULL;
+    }
+    param.rate = rate * net_params_lr[i];
+    param.normalization = Dtype(1) / this->param_.iter_size();
+    const Dtype local_decay = weight_decay * net_params_weight_decay[i];
+    if (local_decay && regularization_type != "L1" &&
+        regularization_type != "L2") {
+      LOG(FATAL) << "Unknown regularization type: " << regularization_type;
+    }
+    param.l1_decay = regularization_type == "L1" ? local_decay : Dtype(0);
+    param.l2_decay = regularization_type == "L2" ? local_decay : Dtype(0);
+  }
+  ThreadPool::Global().RunRange(fused_offsets_.back(), kFusedUpdateMinRange,
+      boost::bind(&SGDSolver<Dtype>::FusedUpdateRange, this, _1, _2));
+}
+
+template <typename Dtype>
+void SGDSolver<Dtype>::FusedUpdateRange(int begin, int end) {
+  // Update the part of every param that falls in [begin, end).
+  int i = std::upper_bound(fused_offsets_.begin(), fused_offsets_.end(),
+      begin) - fused_offsets_.begin() - 1;
+  for (; i < fused_params_.size() && fused_offsets_[i] < end; ++i) {
+    ComputeFusedUpdate(fused_params_[i],
+        std::max(begin, fused_offsets_[i]) - fused_offsets_[i],
+        std::min(end, fused_offsets_[i + 1]) - fused_offsets_[i]);
+  }
+}
+
+template <typename Dtype>
+void SGDSolver<Dtype>::ComputeFusedUpdate(const FusedParam& param, int begin,
+    int end) {
+  const Dtype momentum = this->param_.momentum();
+  Dtype* data = param.data;
+  Dtype* diff = param.diff;
+  Dtype* history = param.history[0];
+  for (int i = begin; i < end; ++i) {
+    const Dtype update =
+        param.rate * FusedGradient(param, i) + momentum * history[i];
+    history[i] = update;
+    diff[i] = update;
+    data[i] -= update;
+  }
+}
+
 template <typename Dtype>
 void SGDSolver<Dtype>::SnapshotSolverState(const string& model_filename) {
   switch (this->param_.snapshot_format()) {
@@ -0,0 +1,111 @@
+#include <string>
+#include <vector>
+
+#include "google/protobuf/text_format.h"
+#include "gtest/gtest.h"
+
+#include "caffe/bucketed_net.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename TypeParam>
+class BucketedNetTest : public MultiDeviceTest<TypeParam> {
+  typedef typename TypeParam::Dtype Dtype;
+
+ protected:
+  BucketedNetTest() {
+    // Clips of N x C x D x H x W, and a convolution seeing one frame.
+    const string proto =
+        "name: 'ClipNet' "
+        "state { phase: TEST } "
+        "layer { name: 'data' type: 'Input' top: 'data' "
+        "  input_param { shape { dim: 1 dim: 2 dim: 1 dim: 3 dim: 3 } } } "
+        "layer { name: 'conv' type: 'Convolution' bottom: 'data' top: 'conv' "
+        "  convolution_param { num_output: 3 kernel_size: 1 "
+        "    kernel_size: 2 kernel_size: 2 "
+        "    weight_filler { type: 'gaussian' std: 0.5 } "
+        "    bias_filler { type: 'gaussian' std: 0.5 } } } "
+        "layer { name: 'relu' type: 'ReLU' bottom: 'conv' top: 'conv' } ";
+    CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param_));
+  }
+
+  static vector<int> ClipShape(int num, int length) {
+    vector<int> shape(5, 3);
+    shape[0] = num;
+    shape[1] = 2;
+    shape[2] = length;
+    return shape;
+  }
+
+  NetParameter param_;
+};
+
+TYPED_TEST_CASE(BucketedNetTest, TestDtypesAndDevices);
+
+TYPED_TEST(BucketedNetTest, TestForward) {
+  typedef typename TypeParam::Dtype Dtype;
+  vector<vector<int> > bucket_shapes;
+  bucket_shapes.push_back(this->ClipShape(4, 8));
+  bucket_shapes.push_back(this->ClipShape(2, 4));
+  BucketedNet<Dtype> bucketed_net(this->param_, bucket_shapes);
+  EXPECT_EQ(1, bucketed_net.Bucket(this->ClipShape(2, 3)));
+  EXPECT_EQ(0, bucketed_net.Bucket(this->ClipShape(3, 3)));
+  EXPECT_EQ(0, bucketed_net.Bucket(this->ClipShape(1, 8)));
+  EXPECT_EQ(-1, bucketed_net.Bucket(this->ClipShape(1, 9)));
+  // The reference net runs each clip unpadded.
+  Net<Dtype> net(this->param_, bucketed_net.net(0));
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  const int nums[] = {2, 1, 3, 2};
+  const int lengths[] = {3, 4, 6, 4};
+  const Dtype* output_data[2] = {NULL, NULL};
+  for (int i = 0; i < 4; ++i) {
+    Blob<Dtype> input(this->ClipShape(nums[i], lengths[i]));
+    filler.Fill(&input);
+    int bucket;
+    const Blob<Dtype>* output = bucketed_net.Forward(input, &bucket)[0];
+    EXPECT_EQ(bucketed_net.Bucket(input.shape()), bucket);
+    // Each bucket keeps its blobs.
+    if (output_data[bucket]) {
+      EXPECT_EQ(output_data[bucket], output->cpu_data());
+    }
+    output_data[bucket] = output->cpu_data();
+    net.input_blobs()[0]->CopyFrom(input, false, true);
+    net.Reshape();
+    const Blob<Dtype>* expected = net.Forward()[0];
+    ASSERT_EQ(5, output->num_axes());
+    EXPECT_EQ(bucketed_net.bucket_shape(bucket)[0], output->shape(0));
+    EXPECT_EQ(bucketed_net.bucket_shape(bucket)[2], output->shape(2));
+    for (int n = 0; n < expected->shape(0); ++n) {
+      for (int c = 0; c < expected->shape(1); ++c) {
+        for (int d = 0; d < expected->shape(2); ++d) {
+          for (int h = 0; h < expected->shape(3); ++h) {
+            for (int w = 0; w < expected->shape(4); ++w) {
+              vector<int> index(5);
+              index[0] = n; index[1] = c; index[2] = d;
+              index[3] = h; index[4] = w;
+              EXPECT_NEAR(expected->data_at(index), output->data_at(index),
+                  1e-5);
+            }
+          }
+        }
+      }
+    }
+  }
+  const int kClipCount = 2 * 9;
+  EXPECT_EQ(1, bucketed_net.stats(0).num_forwards);
+  EXPECT_EQ(3 * 6 * kClipCount, bucketed_net.stats(0).num_values);
+  EXPECT_EQ((4 * 8 - 3 * 6) * kClipCount, bucketed_net.stats(0).num_padding);
+  EXPECT_EQ(3, bucketed_net.stats(1).num_forwards);
+  EXPECT_EQ((6 + 4 + 8) * kClipCount, bucketed_net.stats(1).num_values);
+  EXPECT_EQ((3 * 8 - 18) * kClipCount, bucketed_net.stats(1).num_padding);
+  EXPECT_NEAR(0.25, bucketed_net.stats(1).padding_waste(), 1e-6);
+  bucketed_net.ClearStats();
+  EXPECT_EQ(0, bucketed_net.stats(1).num_forwards);
+}
+
+}  // namespace caffe
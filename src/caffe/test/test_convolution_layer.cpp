@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <cmath>
 #include <vector>
 
 #include "gtest/gtest.h"
@@ -5,7 +7,10 @@
 #include "caffe/blob.hpp"
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
+#include "caffe/layer_factory.hpp"
 #include "caffe/layers/conv_layer.hpp"
+#include "caffe/layers/direct_conv_layer.hpp"
+#include "caffe/layers/int8_conv_layer.hpp"
 
 #ifdef USE_CUDNN
 #include "caffe/layers/cudnn_conv_layer.hpp"
@@ -706,6 +711,113 @@ TYPED_TEST(ConvolutionLayerTest, TestNDAgainst2D) {
   }
 }
 
+TYPED_TEST(ConvolutionLayerTest, TestMultiThreadedAgainstSerial) {
+  typedef typename TypeParam::Dtype Dtype;
+  vector<int> bottom_shape(5);
+  bottom_shape[0] = 5;
+  bottom_shape[1] = 3;
+  bottom_shape[2] = 4;
+  bottom_shape[3] = 6;
+  bottom_shape[4] = 5;
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  this->blob_bottom_vec_.push_back(this->blob_bottom_2_);
+  this->blob_top_vec_.push_back(this->blob_top_2_);
+  for (int i = 0; i < this->blob_bottom_vec_.size(); ++i) {
+    this->blob_bottom_vec_[i]->Reshape(bottom_shape);
+    filler.Fill(this->blob_bottom_vec_[i]);
+  }
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_pad(1);
+  convolution_param->set_num_output(4);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("gaussian");
+  vector<bool> propagate_down(2, true);
+  vector<shared_ptr<Blob<Dtype> > > tops(2), bottom_diffs(2);
+  vector<shared_ptr<Blob<Dtype> > > params;
+  for (int num_threads = 1; num_threads <= 3; num_threads += 2) {
+    Caffe::set_random_seed(1701);
+    convolution_param->set_num_threads(num_threads);
+    ConvolutionLayer<Dtype> layer(layer_param);
+    layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    for (int i = 0; i < this->blob_top_vec_.size(); ++i) {
+      caffe_copy(this->blob_top_vec_[i]->count(),
+          this->blob_top_vec_[i]->cpu_data(),
+          this->blob_top_vec_[i]->mutable_cpu_diff());
+    }
+    for (int i = 0; i < layer.blobs().size(); ++i) {
+      caffe_set(layer.blobs()[i]->count(), Dtype(0),
+          layer.blobs()[i]->mutable_cpu_diff());
+    }
+    layer.Backward(this->blob_top_vec_, propagate_down,
+        this->blob_bottom_vec_);
+    if (num_threads == 1) {
+      for (int i = 0; i < 2; ++i) {
+        tops[i].reset(new Blob<Dtype>());
+        tops[i]->CopyFrom(*this->blob_top_vec_[i], false, true);
+        bottom_diffs[i].reset(new Blob<Dtype>());
+        bottom_diffs[i]->CopyFrom(*this->blob_bottom_vec_[i], true, true);
+      }
+      for (int i = 0; i < layer.blobs().size(); ++i) {
+        params.push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>()));
+        params[i]->CopyFrom(*layer.blobs()[i], true, true);
+      }
+      continue;
+    }
+    // Every batch item goes through the same computation on its thread.
+    for (int i = 0; i < 2; ++i) {
+      for (int j = 0; j < tops[i]->count(); ++j) {
+        EXPECT_EQ(tops[i]->cpu_data()[j],
+            this->blob_top_vec_[i]->cpu_data()[j]);
+      }
+      for (int j = 0; j < bottom_diffs[i]->count(); ++j) {
+        EXPECT_EQ(bottom_diffs[i]->cpu_diff()[j],
+            this->blob_bottom_vec_[i]->cpu_diff()[j]);
+      }
+    }
+    // Parameter gradients are reduced in a different order.
+    for (int i = 0; i < params.size(); ++i) {
+      for (int j = 0; j < params[i]->count(); ++j) {
+        EXPECT_NEAR(params[i]->cpu_diff()[j], layer.blobs()[i]->cpu_diff()[j],
+            1e-4 * std::max(Dtype(1), std::fabs(params[i]->cpu_diff()[j])));
+      }
+    }
+  }
+}
+
+TYPED_TEST(ConvolutionLayerTest, TestGradient3DMultiThreaded) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  vector<int> bottom_shape(5);
+  bottom_shape[0] = 3;
+  bottom_shape[1] = this->blob_bottom_vec_[0]->shape(1);
+  bottom_shape[2] = 4;
+  bottom_shape[3] = this->blob_bottom_vec_[0]->shape(2);
+  bottom_shape[4] = this->blob_bottom_vec_[0]->shape(3);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  for (int i = 0; i < this->blob_bottom_vec_.size(); ++i) {
+    this->blob_bottom_vec_[i]->Reshape(bottom_shape);
+    filler.Fill(this->blob_bottom_vec_[i]);
+  }
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_stride(2);
+  convolution_param->set_num_output(2);
+  convolution_param->set_num_threads(2);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("gaussian");
+  ConvolutionLayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-2, 1e-3);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_);
+}
+
 TYPED_TEST(ConvolutionLayerTest, TestGradient) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter layer_param;
@@ -811,6 +923,208 @@ TYPED_TEST(ConvolutionLayerTest, TestGradientGroup) {
       this->blob_top_vec_);
 }
 
+template <typename Dtype>
+class DirectConvolutionLayerTest : public CPUDeviceTest<Dtype> {
+ protected:
+  DirectConvolutionLayerTest()
+      : blob_bottom_(new Blob<Dtype>()),
+        blob_top_(new Blob<Dtype>()) {}
+  virtual void SetUp() {
+    blob_bottom_vec_.push_back(blob_bottom_);
+    blob_top_vec_.push_back(blob_top_);
+  }
+
+  virtual ~DirectConvolutionLayerTest() {
+    delete blob_bottom_;
+    delete blob_top_;
+  }
+
+  // Runs forward and backward through layer with the given weights and top
+  // diff; returns the top data, bottom diff and parameter diffs. With
+  // forward_before_copy, the layer first runs with its own weights.
+  void Run(Layer<Dtype>* layer,
+      const vector<shared_ptr<Blob<Dtype> > >& params,
+      const Blob<Dtype>& top_diff, vector<shared_ptr<Blob<Dtype> > >* results,
+      bool forward_before_copy = false) {
+    layer->SetUp(blob_bottom_vec_, blob_top_vec_);
+    if (forward_before_copy) {
+      layer->Forward(blob_bottom_vec_, blob_top_vec_);
+    }
+    ASSERT_EQ(params.size(), layer->blobs().size());
+    for (int i = 0; i < params.size(); ++i) {
+      layer->blobs()[i]->CopyFrom(*params[i]);
+      caffe_set(layer->blobs()[i]->count(), Dtype(0),
+          layer->blobs()[i]->mutable_cpu_diff());
+    }
+    layer->Forward(blob_bottom_vec_, blob_top_vec_);
+    caffe_copy(top_diff.count(), top_diff.cpu_data(),
+        blob_top_->mutable_cpu_diff());
+    layer->Backward(blob_top_vec_, vector<bool>(1, true), blob_bottom_vec_);
+    results->clear();
+    results->push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>()));
+    results->back()->CopyFrom(*blob_top_, false, true);
+    results->push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>()));
+    results->back()->CopyFrom(*blob_bottom_, true, true);
+    for (int i = 0; i < params.size(); ++i) {
+      results->push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>()));
+      results->back()->CopyFrom(*layer->blobs()[i], true, true);
+    }
+  }
+
+  // Checks the DIRECT engine against the im2col reference.
+  void TestAgainstIm2col(const vector<int>& bottom_shape,
+      LayerParameter layer_param, bool forward_before_copy = false) {
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    blob_bottom_->Reshape(bottom_shape);
+    filler.Fill(blob_bottom_);
+    ConvolutionParameter* convolution_param =
+        layer_param.mutable_convolution_param();
+    convolution_param->mutable_weight_filler()->set_type("gaussian");
+    convolution_param->mutable_bias_filler()->set_type("gaussian");
+    convolution_param->set_engine(ConvolutionParameter_Engine_CAFFE);
+    ConvolutionLayer<Dtype> reference_layer(layer_param);
+    reference_layer.SetUp(blob_bottom_vec_, blob_top_vec_);
+    vector<shared_ptr<Blob<Dtype> > > params;
+    for (int i = 0; i < reference_layer.blobs().size(); ++i) {
+      params.push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>()));
+      params[i]->CopyFrom(*reference_layer.blobs()[i], false, true);
+    }
+    Blob<Dtype> top_diff;
+    top_diff.ReshapeLike(*blob_top_);
+    filler.Fill(&top_diff);
+    vector<shared_ptr<Blob<Dtype> > > expected, actual;
+    Run(&reference_layer, params, top_diff, &expected);
+    convolution_param->set_engine(ConvolutionParameter_Engine_DIRECT);
+    DirectConvolutionLayer<Dtype> layer(layer_param);
+    Run(&layer, params, top_diff, &actual, forward_before_copy);
+    ASSERT_EQ(expected.size(), actual.size());
+    for (int i = 0; i < expected.size(); ++i) {
+      const bool diff = i > 0;
+      const Dtype* expected_data = diff ? expected[i]->cpu_diff()
+          : expected[i]->cpu_data();
+      const Dtype* actual_data = diff ? actual[i]->cpu_diff()
+          : actual[i]->cpu_data();
+      ASSERT_EQ(expected[i]->shape(), actual[i]->shape());
+      for (int j = 0; j < expected[i]->count(); ++j) {
+        EXPECT_NEAR(expected_data[j], actual_data[j],
+            1e-4 * std::max(Dtype(1), std::fabs(expected_data[j])));
+      }
+    }
+  }
+
+  Blob<Dtype>* const blob_bottom_;
+  Blob<Dtype>* const blob_top_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+};
+
+TYPED_TEST_CASE(DirectConvolutionLayerTest, TestDtypes);
+
+TYPED_TEST(DirectConvolutionLayerTest, Test3DAgainstIm2col) {
+  vector<int> bottom_shape(5);
+  bottom_shape[0] = 2;
+  bottom_shape[1] = 3;
+  bottom_shape[2] = 5;
+  bottom_shape[3] = 7;
+  bottom_shape[4] = 6;
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_pad(1);
+  convolution_param->set_num_output(4);
+  this->TestAgainstIm2col(bottom_shape, layer_param);
+}
+
+TYPED_TEST(DirectConvolutionLayerTest, TestStridedDilatedGroupAgainstIm2col) {
+  vector<int> bottom_shape(5);
+  bottom_shape[0] = 3;
+  bottom_shape[1] = 4;
+  bottom_shape[2] = 6;
+  bottom_shape[3] = 9;
+  bottom_shape[4] = 70;
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_kernel_size(2);
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_stride(1);
+  convolution_param->add_stride(2);
+  convolution_param->add_stride(1);
+  convolution_param->add_pad(2);
+  convolution_param->add_pad(0);
+  convolution_param->add_pad(1);
+  convolution_param->add_dilation(2);
+  convolution_param->add_dilation(1);
+  convolution_param->add_dilation(1);
+  // More than one block of output channels per group, and several tiles.
+  convolution_param->set_num_output(72);
+  convolution_param->set_group(2);
+  convolution_param->set_num_threads(2);
+  this->TestAgainstIm2col(bottom_shape, layer_param);
+}
+
+TYPED_TEST(DirectConvolutionLayerTest, Test2DAgainstIm2col) {
+  vector<int> bottom_shape(4);
+  bottom_shape[0] = 2;
+  bottom_shape[1] = 3;
+  bottom_shape[2] = 9;
+  bottom_shape[3] = 8;
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_stride(2);
+  convolution_param->add_pad(1);
+  convolution_param->set_num_output(5);
+  this->TestAgainstIm2col(bottom_shape, layer_param);
+}
+
+TYPED_TEST(DirectConvolutionLayerTest, TestRepackCopiedWeights) {
+  vector<int> bottom_shape(5);
+  bottom_shape[0] = 2;
+  bottom_shape[1] = 3;
+  bottom_shape[2] = 5;
+  bottom_shape[3] = 7;
+  bottom_shape[4] = 6;
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_pad(1);
+  convolution_param->set_num_output(4);
+  this->TestAgainstIm2col(bottom_shape, layer_param, true);
+}
+
+TYPED_TEST(DirectConvolutionLayerTest, TestGradient3D) {
+  typedef TypeParam Dtype;
+  vector<int> bottom_shape(5);
+  bottom_shape[0] = 2;
+  bottom_shape[1] = 3;
+  bottom_shape[2] = 5;
+  bottom_shape[3] = 6;
+  bottom_shape[4] = 4;
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  this->blob_bottom_->Reshape(bottom_shape);
+  filler.Fill(this->blob_bottom_);
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_stride(2);
+  convolution_param->add_pad(1);
+  convolution_param->set_num_output(2);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("gaussian");
+  DirectConvolutionLayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-2, 1e-3);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_);
+}
+
 #ifdef USE_CUDNN
 
 template <typename Dtype>
@@ -1083,4 +1397,132 @@ TYPED_TEST(CuDNNConvolutionLayerTest, TestGradientGroupCuDNN) {
 
 #endif
 
+template <typename Dtype>
+class Int8ConvolutionLayerTest : public CPUDeviceTest<Dtype> {
+ protected:
+  Int8ConvolutionLayerTest()
+      : blob_bottom_(new Blob<Dtype>()),
+        blob_top_(new Blob<Dtype>()) {}
+  virtual void SetUp() {
+    blob_bottom_vec_.push_back(blob_bottom_);
+    blob_top_vec_.push_back(blob_top_);
+  }
+
+  virtual ~Int8ConvolutionLayerTest() {
+    delete blob_bottom_;
+    delete blob_top_;
+  }
+
+  // Checks that the INT8 engine stays within the quantization error of the
+  // CAFFE engine, with the same parameters. With forward_before_copy, the
+  // layer first runs with its own weights, which are then overwritten.
+  void TestAgainstFloat(const vector<int>& bottom_shape,
+      LayerParameter layer_param, bool forward_before_copy = false) {
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    blob_bottom_->Reshape(bottom_shape);
+    filler.Fill(blob_bottom_);
+    ConvolutionParameter* convolution_param =
+        layer_param.mutable_convolution_param();
+    convolution_param->mutable_weight_filler()->set_type("gaussian");
+    convolution_param->mutable_bias_filler()->set_type("gaussian");
+    convolution_param->set_engine(ConvolutionParameter_Engine_CAFFE);
+    ConvolutionLayer<Dtype> reference_layer(layer_param);
+    reference_layer.SetUp(blob_bottom_vec_, blob_top_vec_);
+    reference_layer.Forward(blob_bottom_vec_, blob_top_vec_);
+    Blob<Dtype> expected;
+    expected.CopyFrom(*blob_top_, false, true);
+    convolution_param->set_engine(ConvolutionParameter_Engine_INT8);
+    layer_param.set_type("Convolution");
+    shared_ptr<Layer<Dtype> > layer =
+        LayerRegistry<Dtype>::CreateLayer(layer_param);
+    ASSERT_TRUE(dynamic_cast<Int8ConvolutionLayer<Dtype>*>(layer.get()));
+    layer->SetUp(blob_bottom_vec_, blob_top_vec_);
+    if (forward_before_copy) {
+      layer->Forward(blob_bottom_vec_, blob_top_vec_);
+    }
+    for (int i = 0; i < layer->blobs().size(); ++i) {
+      layer->blobs()[i]->CopyFrom(*reference_layer.blobs()[i]);
+    }
+    layer->Forward(blob_bottom_vec_, blob_top_vec_);
+    ASSERT_EQ(expected.shape(), blob_top_->shape());
+    Blob<Dtype> error;
+    error.ReshapeLike(expected);
+    caffe_sub(expected.count(), blob_top_->cpu_data(), expected.cpu_data(),
+        error.mutable_cpu_data());
+    EXPECT_LT(std::sqrt(error.sumsq_data() / expected.sumsq_data()), 0.03);
+  }
+
+  Blob<Dtype>* const blob_bottom_;
+  Blob<Dtype>* const blob_top_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+};
+
+TYPED_TEST_CASE(Int8ConvolutionLayerTest, TestDtypes);
+
+TYPED_TEST(Int8ConvolutionLayerTest, Test2D) {
+  vector<int> bottom_shape(4);
+  bottom_shape[0] = 2;
+  bottom_shape[1] = 3;
+  bottom_shape[2] = 9;
+  bottom_shape[3] = 8;
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_stride(2);
+  convolution_param->add_pad(1);
+  convolution_param->set_num_output(5);
+  this->TestAgainstFloat(bottom_shape, layer_param);
+}
+
+TYPED_TEST(Int8ConvolutionLayerTest, Test3DGroupCalibrated) {
+  vector<int> bottom_shape(5);
+  bottom_shape[0] = 3;
+  bottom_shape[1] = 4;
+  bottom_shape[2] = 5;
+  bottom_shape[3] = 7;
+  bottom_shape[4] = 6;
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_pad(1);
+  convolution_param->set_num_output(18);
+  convolution_param->set_group(2);
+  convolution_param->set_num_threads(2);
+  layer_param.mutable_quantization_param()->set_input_range(3);
+  this->TestAgainstFloat(bottom_shape, layer_param);
+}
+
+TYPED_TEST(Int8ConvolutionLayerTest, Test1x1) {
+  vector<int> bottom_shape(4);
+  bottom_shape[0] = 2;
+  bottom_shape[1] = 16;
+  bottom_shape[2] = 5;
+  bottom_shape[3] = 6;
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(1);
+  convolution_param->set_num_output(8);
+  this->TestAgainstFloat(bottom_shape, layer_param);
+}
+
+TYPED_TEST(Int8ConvolutionLayerTest, TestWeightsUpdated) {
+  // The weights written in place are quantized again.
+  vector<int> bottom_shape(4);
+  bottom_shape[0] = 2;
+  bottom_shape[1] = 3;
+  bottom_shape[2] = 6;
+  bottom_shape[3] = 5;
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->set_num_output(4);
+  this->TestAgainstFloat(bottom_shape, layer_param, true);
+}
+
 }  // namespace caffe
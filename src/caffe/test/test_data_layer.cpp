@@ -362,6 +362,51 @@ class DataLayerTest : public MultiDeviceTest<TypeParam> {
     }
   }
 
+  void TestReadCropTrainThreads() {
+    LayerParameter param;
+    param.set_phase(TRAIN);
+    DataParameter* data_param = param.mutable_data_param();
+    data_param->set_batch_size(5);
+    data_param->set_source(filename_->c_str());
+    data_param->set_backend(backend_);
+
+    TransformationParameter* transform_param =
+        param.mutable_transform_param();
+    transform_param->set_crop_size(1);
+    transform_param->set_mirror(true);
+
+    // Get crop sequence with Caffe seed 1701, decoding serially.
+    Caffe::set_random_seed(seed_);
+    vector<vector<Dtype> > crop_sequence;
+    {
+      DataLayer<Dtype> layer1(param);
+      layer1.SetUp(blob_bottom_vec_, blob_top_vec_);
+      for (int iter = 0; iter < 3; ++iter) {
+        layer1.Forward(blob_bottom_vec_, blob_top_vec_);
+        crop_sequence.push_back(vector<Dtype>(blob_top_data_->cpu_data(),
+            blob_top_data_->cpu_data() + blob_top_data_->count()));
+      }
+    }  // destroy 1st data layer and unlock the db
+
+    // Check that decoding on several threads gives the same sequence.
+    data_param->set_decode_threads(3);
+    Caffe::set_random_seed(seed_);
+    DataLayer<Dtype> layer2(param);
+    layer2.SetUp(blob_bottom_vec_, blob_top_vec_);
+    for (int iter = 0; iter < 3; ++iter) {
+      layer2.Forward(blob_bottom_vec_, blob_top_vec_);
+      for (int i = 0; i < 5; ++i) {
+        EXPECT_EQ(i, blob_top_label_->cpu_data()[i]);
+      }
+      for (int j = 0; j < blob_top_data_->count(); ++j) {
+        EXPECT_EQ(crop_sequence[iter][j], blob_top_data_->cpu_data()[j])
+            << "debug: iter " << iter << " j " << j;
+      }
+    }
+    EXPECT_GE(layer2.read_time(), 0);
+    EXPECT_GT(layer2.transform_time(), 0);
+  }
+
   virtual ~DataLayerTest() { delete blob_top_data_; delete blob_top_label_; }
 
   DataParameter_DB backend_;
@@ -418,6 +463,14 @@ TYPED_TEST(DataLayerTest, TestReadCropTestLevelDB) {
   this->Fill(unique_pixels, DataParameter_DB_LEVELDB);
   this->TestReadCrop(TEST);
 }
+
+// Test that the sequence of random crops does not depend on the number of
+// decode threads.
+TYPED_TEST(DataLayerTest, TestReadCropTrainThreadsLevelDB) {
+  const bool unique_pixels = true;  // all images the same; pixels different
+  this->Fill(unique_pixels, DataParameter_DB_LEVELDB);
+  this->TestReadCropTrainThreads();
+}
 #endif  // USE_LEVELDB
 
 #ifdef USE_LMDB
@@ -464,6 +517,14 @@ TYPED_TEST(DataLayerTest, TestReadCropTestLMDB) {
   this->TestReadCrop(TEST);
 }
 
+// Test that the sequence of random crops does not depend on the number of
+// decode threads.
+TYPED_TEST(DataLayerTest, TestReadCropTrainThreadsLMDB) {
+  const bool unique_pixels = true;  // all images the same; pixels different
+  this->Fill(unique_pixels, DataParameter_DB_LMDB);
+  this->TestReadCropTrainThreads();
+}
+
 #endif  // USE_LMDB
 }  // namespace caffe
 #endif  // USE_OPENCV
@@ -1,4 +1,7 @@
 #ifdef USE_OPENCV
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+
 #include <string>
 #include <vector>
 
@@ -29,6 +32,66 @@ void FillDatum(const int label, const int channels, const int height,
   }
 }
 
+void FillClip(const int label, const int channels, const int length,
+  const int height, const int width, Datum * datum) {
+  datum->set_label(label);
+  datum->set_channels(channels);
+  datum->set_length(length);
+  datum->set_height(height);
+  datum->set_width(width);
+  int size = channels * length * height * width;
+  std::string* data = datum->mutable_data();
+  for (int j = 0; j < size; ++j) {
+    data->push_back(static_cast<uint8_t>(j));
+  }
+}
+
+// Finds the temporal and spatial offsets and mirroring that turn the raw
+// clip of FillClip into blob, returns the number of matching crops.
+template <typename Dtype>
+int FindClipCrop(const Datum& datum, const Blob<Dtype>& blob,
+    int* t_off, int* h_off, int* w_off, bool* mirror) {
+  const int channels = blob.shape(1);
+  const int length = blob.shape(2);
+  const int height = blob.shape(3);
+  const int width = blob.shape(4);
+  int num_matches = 0;
+  for (int m = 0; m < 2; ++m) {
+    for (int t0 = 0; t0 + length <= datum.length(); ++t0) {
+      for (int h0 = 0; h0 + height <= datum.height(); ++h0) {
+        for (int w0 = 0; w0 + width <= datum.width(); ++w0) {
+          bool match = true;
+          for (int c = 0; match && c < channels; ++c) {
+            for (int t = 0; match && t < length; ++t) {
+              for (int h = 0; match && h < height; ++h) {
+                for (int w = 0; match && w < width; ++w) {
+                  const int w_src = m ? w0 + width - 1 - w : w0 + w;
+                  const int index = ((c * datum.length() + t0 + t) *
+                      datum.height() + h0 + h) * datum.width() + w_src;
+                  vector<int> top_index(5, 0);
+                  top_index[1] = c;
+                  top_index[2] = t;
+                  top_index[3] = h;
+                  top_index[4] = w;
+                  match = blob.data_at(top_index) == index;
+                }
+              }
+            }
+          }
+          if (match) {
+            *t_off = t0;
+            *h_off = h0;
+            *w_off = w0;
+            *mirror = m;
+            ++num_matches;
+          }
+        }
+      }
+    }
+  }
+  return num_matches;
+}
+
 template <typename Dtype>
 class DataTransformTest : public ::testing::Test {
  protected:
@@ -340,5 +403,180 @@ TYPED_TEST(DataTransformTest, TestMeanFile) {
   }
 }
 
+TYPED_TEST(DataTransformTest, TestChannelMeanFile) {
+  TransformationParameter transform_param;
+  const bool unique_pixels = false;  // pixels are equal to label
+  const int label = 0;
+  const int channels = 3;
+  const int height = 4;
+  const int width = 5;
+
+  // A mean per channel, and their deviations which are not used.
+  string mean_file;
+  MakeTempFilename(&mean_file);
+  BlobProto blob_mean;
+  blob_mean.mutable_shape()->add_dim(channels);
+  for (int c = 0; c < channels; ++c) {
+    blob_mean.add_data(c);
+    blob_mean.add_diff(1);
+  }
+  WriteProtoToBinaryFile(blob_mean, mean_file);
+
+  transform_param.set_mean_file(mean_file);
+  Datum datum;
+  FillDatum(label, channels, height, width, unique_pixels, &datum);
+  Blob<TypeParam> blob(1, channels, height, width);
+  DataTransformer<TypeParam> transformer(transform_param, TEST);
+  transformer.InitRand();
+  transformer.Transform(datum, &blob);
+  for (int c = 0; c < channels; ++c) {
+    for (int j = 0; j < height * width; ++j) {
+      EXPECT_EQ(blob.cpu_data()[blob.offset(0, c) + j], label - c);
+    }
+  }
+}
+
+TYPED_TEST(DataTransformTest, TestClipCropTest) {
+  TransformationParameter transform_param;
+  const int channels = 2;
+  const int length = 6;
+  const int height = 5;
+  const int width = 4;
+  const int crop_length = 3;
+  const int crop_size = 3;
+
+  transform_param.set_crop_length(crop_length);
+  transform_param.set_crop_size(crop_size);
+  Datum datum;
+  FillClip(0, channels, length, height, width, &datum);
+  DataTransformer<TypeParam> transformer(transform_param, TEST);
+  transformer.InitRand();
+  vector<int> shape = transformer.InferBlobShape(datum);
+  ASSERT_EQ(shape.size(), 5);
+  EXPECT_EQ(shape[0], 1);
+  EXPECT_EQ(shape[1], channels);
+  EXPECT_EQ(shape[2], crop_length);
+  EXPECT_EQ(shape[3], crop_size);
+  EXPECT_EQ(shape[4], crop_size);
+  Blob<TypeParam> blob(shape);
+  transformer.Transform(datum, &blob);
+  // The crop is centered in time and space.
+  int t_off, h_off, w_off;
+  bool mirror;
+  EXPECT_EQ(FindClipCrop(datum, blob, &t_off, &h_off, &w_off, &mirror), 1);
+  EXPECT_EQ(t_off, 1);
+  EXPECT_EQ(h_off, 1);
+  EXPECT_EQ(w_off, 0);
+  EXPECT_FALSE(mirror);
+}
+
+TYPED_TEST(DataTransformTest, TestClipCropMirrorTrain) {
+  TransformationParameter transform_param;
+  const int channels = 2;
+  const int length = 6;
+  const int height = 5;
+  const int width = 4;
+  const int crop_length = 3;
+  const int crop_size = 3;
+
+  transform_param.set_crop_length(crop_length);
+  transform_param.set_crop_size(crop_size);
+  transform_param.set_mirror(true);
+  Datum datum;
+  FillClip(0, channels, length, height, width, &datum);
+  DataTransformer<TypeParam> transformer(transform_param, TRAIN);
+  Caffe::set_random_seed(this->seed_);
+  transformer.InitRand();
+  Blob<TypeParam> blob(transformer.InferBlobShape(datum));
+  // Every clip is one consistent crop of the input, and the temporal
+  // offset and mirroring vary between clips.
+  vector<bool> seen_t_off(length - crop_length + 1, false);
+  vector<bool> seen_mirror(2, false);
+  for (int iter = 0; iter < 4 * this->num_iter_; ++iter) {
+    transformer.Transform(datum, &blob);
+    int t_off, h_off, w_off;
+    bool mirror;
+    ASSERT_EQ(FindClipCrop(datum, blob, &t_off, &h_off, &w_off, &mirror), 1);
+    seen_t_off[t_off] = true;
+    seen_mirror[mirror] = true;
+  }
+  for (int t = 0; t < seen_t_off.size(); ++t) {
+    EXPECT_TRUE(seen_t_off[t]);
+  }
+  EXPECT_TRUE(seen_mirror[0]);
+  EXPECT_TRUE(seen_mirror[1]);
+}
+
+TYPED_TEST(DataTransformTest, TestClipMeanValues) {
+  TransformationParameter transform_param;
+  const int channels = 3;
+  const int length = 2;
+  const int height = 2;
+  const int width = 3;
+
+  transform_param.add_mean_value(0);
+  transform_param.add_mean_value(1);
+  transform_param.add_mean_value(2);
+  transform_param.set_scale(2);
+  Datum datum;
+  FillClip(0, channels, length, height, width, &datum);
+  DataTransformer<TypeParam> transformer(transform_param, TEST);
+  transformer.InitRand();
+  Blob<TypeParam> blob(transformer.InferBlobShape(datum));
+  transformer.Transform(datum, &blob);
+  const int frame_size = length * height * width;
+  for (int j = 0; j < blob.count(); ++j) {
+    EXPECT_EQ(blob.cpu_data()[j], (j - j / frame_size) * 2);
+  }
+}
+
+TYPED_TEST(DataTransformTest, TestClipEncoded) {
+  TransformationParameter transform_param;
+  const int channels = 3;
+  const int length = 5;
+  const int height = 6;
+  const int width = 5;
+
+  transform_param.set_crop_length(2);
+  transform_param.set_crop_size(4);
+  transform_param.set_mirror(true);
+  Datum datum;
+  FillClip(0, channels, length, height, width, &datum);
+  // Encode every frame of the clip on its own.
+  Datum encoded_datum;
+  encoded_datum.set_encoded(true);
+  for (int t = 0; t < length; ++t) {
+    cv::Mat frame(height, width, CV_8UC3);
+    for (int h = 0; h < height; ++h) {
+      for (int w = 0; w < width; ++w) {
+        for (int c = 0; c < channels; ++c) {
+          frame.ptr<uchar>(h)[w * channels + c] = datum.data()[
+              ((c * length + t) * height + h) * width + w];
+        }
+      }
+    }
+    vector<uchar> buffer;
+    cv::imencode(".png", frame, buffer);
+    encoded_datum.add_frames(string(buffer.begin(), buffer.end()));
+  }
+  DataTransformer<TypeParam> transformer(transform_param, TRAIN);
+  vector<int> shape = transformer.InferBlobShape(encoded_datum);
+  EXPECT_TRUE(shape == transformer.InferBlobShape(datum));
+  Blob<TypeParam> blob(shape);
+  Blob<TypeParam> encoded_blob(shape);
+  // The same random crops are drawn for the raw and the encoded clip.
+  for (int iter = 0; iter < this->num_iter_; ++iter) {
+    Caffe::set_random_seed(this->seed_ + iter);
+    transformer.InitRand();
+    transformer.Transform(datum, &blob);
+    Caffe::set_random_seed(this->seed_ + iter);
+    transformer.InitRand();
+    transformer.Transform(encoded_datum, &encoded_blob);
+    for (int j = 0; j < blob.count(); ++j) {
+      EXPECT_EQ(blob.cpu_data()[j], encoded_blob.cpu_data()[j]);
+    }
+  }
+}
+
 }  // namespace caffe
 #endif  // USE_OPENCV
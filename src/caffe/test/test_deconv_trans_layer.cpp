@@ -0,0 +1,106 @@
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/layers/deconv_trans_layer.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+#include "caffe/test/test_gradient_check_util.hpp"
+
+namespace caffe {
+
+template <typename TypeParam>
+class DeconvTransLayerTest : public MultiDeviceTest<TypeParam> {
+  typedef typename TypeParam::Dtype Dtype;
+
+ protected:
+  DeconvTransLayerTest()
+      : blob_bottom_(new Blob<Dtype>()),
+        blob_top_(new Blob<Dtype>()) {}
+  virtual void SetUp() {
+    Caffe::set_random_seed(1701);
+    vector<int> shape(5);
+    shape[0] = 2;
+    shape[1] = 2 * 12;
+    shape[2] = 2;
+    shape[3] = 3;
+    shape[4] = 2;
+    blob_bottom_->Reshape(shape);
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(this->blob_bottom_);
+    blob_bottom_vec_.push_back(blob_bottom_);
+    blob_top_vec_.push_back(blob_top_);
+  }
+  virtual ~DeconvTransLayerTest() { delete blob_bottom_; delete blob_top_; }
+
+  void SetStrides(LayerParameter* layer_param) {
+    DeconvTransParameter* param = layer_param->mutable_deconv_trans_param();
+    param->add_stride(1);
+    param->add_stride(3);
+    param->add_stride(4);
+  }
+
+  Blob<Dtype>* const blob_bottom_;
+  Blob<Dtype>* const blob_top_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+};
+
+TYPED_TEST_CASE(DeconvTransLayerTest, TestDtypesAndDevices);
+
+TYPED_TEST(DeconvTransLayerTest, TestSetup) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  this->SetStrides(&layer_param);
+  DeconvTransLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  ASSERT_EQ(this->blob_top_->num_axes(), 5);
+  EXPECT_EQ(this->blob_top_->shape(0), 2);
+  EXPECT_EQ(this->blob_top_->shape(1), 2);
+  EXPECT_EQ(this->blob_top_->shape(2), 2);
+  EXPECT_EQ(this->blob_top_->shape(3), 3 * 3);
+  EXPECT_EQ(this->blob_top_->shape(4), 2 * 4);
+}
+
+TYPED_TEST(DeconvTransLayerTest, TestForward) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  this->SetStrides(&layer_param);
+  DeconvTransLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  const Dtype* bottom_data = this->blob_bottom_->cpu_data();
+  const Dtype* top_data = this->blob_top_->cpu_data();
+  // Channel c of the bottom holds the offset (c % 12 / 4, c % 4) within the
+  // 3 x 4 patch of channel c / 12 of the top.
+  for (int index = 0; index < this->blob_bottom_->count(); ++index) {
+    const int w = index % 2;
+    const int h = index / 2 % 3;
+    const int d = index / 6 % 2;
+    const int c = index / 12 % 24;
+    const int n = index / 288;
+    vector<int> top_index(5);
+    top_index[0] = n;
+    top_index[1] = c / 12;
+    top_index[2] = d;
+    top_index[3] = h * 3 + c % 12 / 4;
+    top_index[4] = w * 4 + c % 4;
+    EXPECT_EQ(bottom_data[index], top_data[this->blob_top_->offset(top_index)]);
+  }
+}
+
+TYPED_TEST(DeconvTransLayerTest, TestGradient) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  this->SetStrides(&layer_param);
+  DeconvTransLayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-2, 1e-2);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_);
+}
+
+}  // namespace caffe
@@ -132,6 +132,87 @@ TYPED_TEST(HDF5DataLayerTest, TestRead) {
   }
 }
 
+TYPED_TEST(HDF5DataLayerTest, TestChunkedRead) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter param;
+  param.add_top("data");
+  param.add_top("label");
+  param.add_top("label2");
+
+  // Batches straddle chunks of 3 rows and the 10-row files.
+  HDF5DataParameter* hdf5_data_param = param.mutable_hdf5_data_param();
+  int batch_size = 4;
+  hdf5_data_param->set_batch_size(batch_size);
+  hdf5_data_param->set_chunk_size(3);
+  hdf5_data_param->set_prefetch(3);
+  hdf5_data_param->set_source(*(this->filename));
+  const int num_rows = 10;
+  const int data_size = 8 * 6 * 5;
+
+  HDF5DataLayer<Dtype> layer(param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  EXPECT_EQ(this->blob_top_data_->num(), batch_size);
+  for (int iter = 0; iter < 10; ++iter) {
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    for (int i = 0; i < batch_size; ++i) {
+      const int row = iter * batch_size + i;
+      const int file_offset = (row / num_rows) % 2 ? 2400 : 0;
+      EXPECT_EQ(1 + row % num_rows, this->blob_top_label_->cpu_data()[i]);
+      EXPECT_EQ(2 + row % num_rows, this->blob_top_label2_->cpu_data()[i]);
+      for (int k = 0; k < data_size; ++k) {
+        EXPECT_EQ(file_offset + (row % num_rows) * data_size + k,
+                  this->blob_top_data_->cpu_data()[i * data_size + k]);
+      }
+    }
+  }
+}
+
+TYPED_TEST(HDF5DataLayerTest, TestShuffleChunks) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter param;
+  param.add_top("data");
+  param.add_top("label");
+  param.add_top("label2");
+
+  HDF5DataParameter* hdf5_data_param = param.mutable_hdf5_data_param();
+  int batch_size = 5;
+  hdf5_data_param->set_batch_size(batch_size);
+  hdf5_data_param->set_chunk_size(3);
+  hdf5_data_param->set_shuffle(true);
+  hdf5_data_param->set_source(*(this->filename));
+  const int num_rows = 10;
+  const int data_size = 8 * 6 * 5;
+
+  HDF5DataLayer<Dtype> layer(param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  // Each epoch outputs every row of one file, then every row of the other.
+  for (int epoch = 0; epoch < 2; ++epoch) {
+    int file_offset = -1;
+    vector<int> seen(num_rows, 0);
+    for (int iter = 0; iter < 2 * num_rows / batch_size; ++iter) {
+      layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+      for (int i = 0; i < batch_size; ++i) {
+        const int row = this->blob_top_label_->cpu_data()[i] - 1;
+        ASSERT_GE(row, 0);
+        ASSERT_LT(row, num_rows);
+        ++seen[row];
+        EXPECT_EQ(row + 2, this->blob_top_label2_->cpu_data()[i]);
+        const int offset =
+            this->blob_top_data_->cpu_data()[i * data_size] - row * data_size;
+        if (iter * batch_size + i == num_rows) {
+          EXPECT_NE(file_offset, offset);
+        } else if (iter * batch_size + i != 0) {
+          EXPECT_EQ(file_offset, offset);
+        }
+        file_offset = offset;
+      }
+    }
+    for (int row = 0; row < num_rows; ++row) {
+      EXPECT_EQ(2, seen[row]);
+    }
+  }
+}
+
 TYPED_TEST(HDF5DataLayerTest, TestSkip) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter param;
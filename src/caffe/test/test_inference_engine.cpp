@@ -0,0 +1,146 @@
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include <stdlib.h>
+#include <time.h>
+#include <string>
+#include <vector>
+
+#include "google/protobuf/text_format.h"
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/inference_engine.hpp"
+#include "caffe/util/benchmark.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename TypeParam>
+class InferenceEngineTest : public MultiDeviceTest<TypeParam> {
+  typedef typename TypeParam::Dtype Dtype;
+
+ protected:
+  InferenceEngineTest() {
+    const string proto =
+        "name: 'ServedNet' "
+        "state { phase: TEST } "
+        "layer { name: 'data' type: 'Input' top: 'data' "
+        "  input_param { shape { dim: 1 dim: 2 dim: 3 } } } "
+        "layer { name: 'ip' type: 'InnerProduct' bottom: 'data' top: 'ip' "
+        "  inner_product_param { num_output: 4 "
+        "    weight_filler { type: 'gaussian' std: 0.5 } "
+        "    bias_filler { type: 'gaussian' std: 0.5 } } } "
+        "layer { name: 'prob' type: 'Softmax' bottom: 'ip' top: 'prob' } ";
+    CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param_));
+  }
+
+  // Sends num_requests requests of 1 to 3 items.
+  static void Client(InferenceEngine<Dtype>* engine, int client,
+      int num_requests, vector<shared_ptr<Blob<Dtype> > >* inputs,
+      vector<shared_ptr<Blob<Dtype> > >* outputs) {
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    for (int i = 0; i < num_requests; ++i) {
+      const int r = client * num_requests + i;
+      vector<int> shape(3, 2);
+      shape[0] = 1 + r % 3;
+      shape[2] = 3;
+      (*inputs)[r].reset(new Blob<Dtype>(shape));
+      filler.Fill((*inputs)[r].get());
+      vector<shared_ptr<Blob<Dtype> > > request_outputs;
+      engine->Infer(*(*inputs)[r], &request_outputs);
+      ASSERT_EQ(1, request_outputs.size());
+      (*outputs)[r] = request_outputs[0];
+    }
+  }
+
+  NetParameter param_;
+};
+
+TYPED_TEST_CASE(InferenceEngineTest, TestDtypesAndDevices);
+
+TYPED_TEST(InferenceEngineTest, TestConcurrentRequests) {
+  typedef typename TypeParam::Dtype Dtype;
+  const int kNumClients = 4;
+  const int kNumRequests = 6;
+  vector<shared_ptr<Blob<Dtype> > > inputs(kNumClients * kNumRequests);
+  vector<shared_ptr<Blob<Dtype> > > outputs(kNumClients * kNumRequests);
+  InferenceEngine<Dtype> engine(this->param_, "", 2, 5, 1000);
+  vector<shared_ptr<boost::thread> > clients;
+  for (int c = 0; c < kNumClients; ++c) {
+    clients.push_back(shared_ptr<boost::thread>(new boost::thread(
+        &InferenceEngineTest<TypeParam>::Client, &engine, c, kNumRequests,
+        &inputs, &outputs)));
+  }
+  for (int c = 0; c < kNumClients; ++c) {
+    clients[c]->join();
+  }
+  int num_items = 0;
+  Net<Dtype> net(this->param_, &engine.net());
+  for (int r = 0; r < inputs.size(); ++r) {
+    num_items += inputs[r]->shape(0);
+    net.input_blobs()[0]->CopyFrom(*inputs[r], false, true);
+    net.Reshape();
+    const Blob<Dtype>* expected = net.Forward()[0];
+    ASSERT_EQ(expected->shape(), outputs[r]->shape());
+    for (int j = 0; j < expected->count(); ++j) {
+      EXPECT_NEAR(expected->cpu_data()[j], outputs[r]->cpu_data()[j], 1e-5);
+    }
+  }
+  EXPECT_EQ(num_items, engine.num_items());
+  EXPECT_LE(engine.num_batches(), inputs.size());
+}
+
+TYPED_TEST(InferenceEngineTest, TestPartialBatchFlushed) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Nine hours east of UTC, where local deadlines would be hours late.
+  const char* tz = getenv("TZ");
+  const string saved_tz = tz ? tz : "";
+  setenv("TZ", "UTC-9", 1);
+  tzset();
+  const int kMaxDelayUs = 50000;
+  vector<shared_ptr<Blob<Dtype> > > inputs(1);
+  vector<shared_ptr<Blob<Dtype> > > outputs(1);
+  InferenceEngine<Dtype> engine(this->param_, "", 1, 100, kMaxDelayUs);
+  CPUTimer timer;
+  timer.Start();
+  InferenceEngineTest<TypeParam>::Client(&engine, 0, 1, &inputs, &outputs);
+  const float elapsed_ms = timer.MilliSeconds();
+  if (tz) {
+    setenv("TZ", saved_tz.c_str(), 1);
+  } else {
+    unsetenv("TZ");
+  }
+  tzset();
+  EXPECT_GE(elapsed_ms, kMaxDelayUs / 1000 * 0.9);
+  EXPECT_LT(elapsed_ms, 5000);
+  ASSERT_TRUE(outputs[0].get());
+  EXPECT_EQ(1, engine.num_batches());
+  EXPECT_EQ(1, engine.num_items());
+}
+
+TYPED_TEST(InferenceEngineTest, TestDestroyServesQueuedRequests) {
+  typedef typename TypeParam::Dtype Dtype;
+  const int kNumClients = 3;
+  vector<shared_ptr<Blob<Dtype> > > inputs(kNumClients);
+  vector<shared_ptr<Blob<Dtype> > > outputs(kNumClients);
+  // Batches of up to 100 items wait up to 100 s for more.
+  shared_ptr<InferenceEngine<Dtype> > engine(
+      new InferenceEngine<Dtype>(this->param_, "", 1, 100, 100000000));
+  vector<shared_ptr<boost::thread> > clients;
+  for (int c = 0; c < kNumClients; ++c) {
+    clients.push_back(shared_ptr<boost::thread>(new boost::thread(
+        &InferenceEngineTest<TypeParam>::Client, engine.get(), c, 1,
+        &inputs, &outputs)));
+  }
+  boost::this_thread::sleep(boost::posix_time::milliseconds(100));
+  engine.reset();
+  for (int c = 0; c < kNumClients; ++c) {
+    clients[c]->join();
+    EXPECT_TRUE(outputs[c].get());
+  }
+}
+
+}  // namespace caffe
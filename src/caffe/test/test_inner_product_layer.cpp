@@ -1,3 +1,4 @@
+#include <cmath>
 #include <vector>
 
 #include "gtest/gtest.h"
@@ -5,7 +6,9 @@
 #include "caffe/blob.hpp"
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
+#include "caffe/layer_factory.hpp"
 #include "caffe/layers/inner_product_layer.hpp"
+#include "caffe/layers/int8_inner_product_layer.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
 #include "caffe/test/test_gradient_check_util.hpp"
@@ -388,4 +391,90 @@ TYPED_TEST(InnerProductLayerTest, TestBackwardTranspose) {
   }
 }
 
+template <typename Dtype>
+class Int8InnerProductLayerTest : public CPUDeviceTest<Dtype> {
+ protected:
+  Int8InnerProductLayerTest()
+      : blob_bottom_(new Blob<Dtype>(7, 3, 4, 5)),
+        blob_top_(new Blob<Dtype>()) {
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(this->blob_bottom_);
+    blob_bottom_vec_.push_back(blob_bottom_);
+    blob_top_vec_.push_back(blob_top_);
+  }
+  virtual ~Int8InnerProductLayerTest() {
+    delete blob_bottom_;
+    delete blob_top_;
+  }
+
+  // Checks that the INT8 engine stays within the quantization error of the
+  // CAFFE engine, with the same parameters. With forward_before_copy, the
+  // layer first runs with its own weights, which are then overwritten.
+  void TestAgainstFloat(LayerParameter layer_param,
+      bool forward_before_copy = false) {
+    InnerProductParameter* inner_product_param =
+        layer_param.mutable_inner_product_param();
+    inner_product_param->set_num_output(37);
+    inner_product_param->mutable_weight_filler()->set_type("gaussian");
+    inner_product_param->mutable_bias_filler()->set_type("gaussian");
+    InnerProductLayer<Dtype> reference_layer(layer_param);
+    reference_layer.SetUp(blob_bottom_vec_, blob_top_vec_);
+    reference_layer.Forward(blob_bottom_vec_, blob_top_vec_);
+    Blob<Dtype> expected;
+    expected.CopyFrom(*blob_top_, false, true);
+    inner_product_param->set_engine(InnerProductParameter_Engine_INT8);
+    layer_param.set_type("InnerProduct");
+    shared_ptr<Layer<Dtype> > layer =
+        LayerRegistry<Dtype>::CreateLayer(layer_param);
+    ASSERT_TRUE(dynamic_cast<Int8InnerProductLayer<Dtype>*>(layer.get()));
+    layer->SetUp(blob_bottom_vec_, blob_top_vec_);
+    if (forward_before_copy) {
+      layer->Forward(blob_bottom_vec_, blob_top_vec_);
+    }
+    for (int i = 0; i < layer->blobs().size(); ++i) {
+      layer->blobs()[i]->CopyFrom(*reference_layer.blobs()[i]);
+    }
+    layer->Forward(blob_bottom_vec_, blob_top_vec_);
+    ASSERT_EQ(expected.shape(), blob_top_->shape());
+    Blob<Dtype> error;
+    error.ReshapeLike(expected);
+    caffe_sub(expected.count(), blob_top_->cpu_data(), expected.cpu_data(),
+        error.mutable_cpu_data());
+    EXPECT_LT(std::sqrt(error.sumsq_data() / expected.sumsq_data()), 0.03);
+  }
+
+  Blob<Dtype>* const blob_bottom_;
+  Blob<Dtype>* const blob_top_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+};
+
+TYPED_TEST_CASE(Int8InnerProductLayerTest, TestDtypes);
+
+TYPED_TEST(Int8InnerProductLayerTest, TestForward) {
+  LayerParameter layer_param;
+  this->TestAgainstFloat(layer_param);
+}
+
+TYPED_TEST(Int8InnerProductLayerTest, TestForwardTranspose) {
+  LayerParameter layer_param;
+  layer_param.mutable_inner_product_param()->set_transpose(true);
+  this->TestAgainstFloat(layer_param);
+}
+
+TYPED_TEST(Int8InnerProductLayerTest, TestForwardCalibrated) {
+  // A calibrated range a little below that of the bottom saturates a few
+  // values.
+  LayerParameter layer_param;
+  layer_param.mutable_quantization_param()->set_input_range(3);
+  this->TestAgainstFloat(layer_param);
+}
+
+TYPED_TEST(Int8InnerProductLayerTest, TestForwardWeightsUpdated) {
+  // The weights written in place are quantized again.
+  LayerParameter layer_param;
+  this->TestAgainstFloat(layer_param, true);
+}
+
 }  // namespace caffe
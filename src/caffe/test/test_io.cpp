@@ -420,5 +420,44 @@ TEST_F(IOTest, TestDecodeDatumToCVMatContentNative) {
   }
 }
 
+TEST_F(IOTest, TestParseDatumWithoutData) {
+  Datum datum;
+  datum.set_channels(2);
+  datum.set_height(3);
+  datum.set_width(4);
+  datum.set_label(7);
+  for (int i = 0; i < 24; ++i) {
+    datum.mutable_data()->push_back(static_cast<char>(i));
+  }
+  datum.add_float_data(0.5);
+  string serialized;
+  CHECK(datum.SerializeToString(&serialized));
+
+  Datum parsed;
+  const char* data;
+  size_t data_size;
+  EXPECT_TRUE(ParseDatumWithoutData(serialized.data(), serialized.size(),
+      &parsed, &data, &data_size));
+  // The data is left in place, everything else is parsed.
+  EXPECT_EQ(parsed.data().size(), 0);
+  EXPECT_EQ(data_size, datum.data().size());
+  EXPECT_GE(data, serialized.data());
+  EXPECT_LE(data + data_size, serialized.data() + serialized.size());
+  EXPECT_EQ(string(data, data_size), datum.data());
+  parsed.set_data(datum.data());
+  EXPECT_EQ(parsed.SerializeAsString(), serialized);
+
+  // A Datum without data, and a truncated one.
+  datum.clear_data();
+  CHECK(datum.SerializeToString(&serialized));
+  EXPECT_TRUE(ParseDatumWithoutData(serialized.data(), serialized.size(),
+      &parsed, &data, &data_size));
+  EXPECT_TRUE(data == NULL);
+  EXPECT_EQ(data_size, 0);
+  EXPECT_EQ(parsed.label(), 7);
+  EXPECT_FALSE(ParseDatumWithoutData(serialized.data(),
+      serialized.size() - 1, &parsed, &data, &data_size));
+}
+
 }  // namespace caffe
 #endif  // USE_OPENCV
@@ -119,6 +119,92 @@ TYPED_TEST(CPUMathFunctionsTest, TestCopy) {
   }
 }
 
+TYPED_TEST(CPUMathFunctionsTest, TestStridedCopy) {
+  // Copy the 11 x 17 x 19 x 23 bottom to a top laid out as 19 x 11 x 17 x 23
+  // (whole rows), then as 23 x 19 x 17 x 11 (single values).
+  const vector<int>& shape = this->blob_bottom_->shape();
+  vector<int> src_strides(4);
+  for (int a = 0; a < 4; ++a) {
+    src_strides[a] = this->blob_bottom_->count(a + 1);
+  }
+  const int rows_strides[] = {17 * 23, 23, 11 * 17 * 23, 1};
+  const int values_strides[] = {1, 11, 11 * 17, 11 * 17 * 19};
+  const int* dst_strides[] = {rows_strides, values_strides};
+  const TypeParam* bottom_data = this->blob_bottom_->cpu_data();
+  for (int t = 0; t < 2; ++t) {
+    TypeParam* top_data = this->blob_top_->mutable_cpu_data();
+    caffe_cpu_strided_copy(shape, src_strides, bottom_data,
+        vector<int>(dst_strides[t], dst_strides[t] + 4), top_data);
+    for (int n = 0; n < 11; ++n) {
+      for (int c = 0; c < 17; ++c) {
+        for (int h = 0; h < 19; ++h) {
+          for (int w = 0; w < 23; ++w) {
+            EXPECT_EQ(bottom_data[this->blob_bottom_->offset(n, c, h, w)],
+                top_data[n * dst_strides[t][0] + c * dst_strides[t][1] +
+                         h * dst_strides[t][2] + w * dst_strides[t][3]]);
+          }
+        }
+      }
+    }
+  }
+}
+
+TYPED_TEST(CPUMathFunctionsTest, TestStridedCopyBroadcast) {
+  // Repeat each row of 23 values of the first item 3 times.
+  vector<int> shape(3);
+  shape[0] = 17 * 19;
+  shape[1] = 3;
+  shape[2] = 23;
+  vector<int> src_strides(3);
+  src_strides[0] = 23;
+  src_strides[1] = 0;
+  src_strides[2] = 1;
+  vector<int> dst_strides(3);
+  dst_strides[0] = 3 * 23;
+  dst_strides[1] = 23;
+  dst_strides[2] = 1;
+  const TypeParam* bottom_data = this->blob_bottom_->cpu_data();
+  TypeParam* top_data = this->blob_top_->mutable_cpu_data();
+  caffe_cpu_strided_copy(shape, src_strides, bottom_data, dst_strides,
+      top_data);
+  for (int i = 0; i < 17 * 19; ++i) {
+    for (int j = 0; j < 3; ++j) {
+      for (int k = 0; k < 23; ++k) {
+        EXPECT_EQ(bottom_data[i * 23 + k], top_data[(i * 3 + j) * 23 + k]);
+      }
+    }
+  }
+}
+
+TYPED_TEST(CPUMathFunctionsTest, TestPermute) {
+  // Swapping the middle axes copies rows; moving the last axis transposes
+  // tiles, with ragged edges.
+  const int orders[][4] = {{0, 2, 1, 3}, {0, 3, 1, 2}, {2, 0, 3, 1},
+      {3, 2, 1, 0}};
+  const vector<int>& shape = this->blob_bottom_->shape();
+  const TypeParam* bottom_data = this->blob_bottom_->cpu_data();
+  for (int t = 0; t < sizeof(orders) / sizeof(orders[0]); ++t) {
+    const vector<int> order(orders[t], orders[t] + 4);
+    TypeParam* top_data = this->blob_top_->mutable_cpu_data();
+    caffe_cpu_permute(shape, order, bottom_data, top_data);
+    vector<int> index(4);
+    for (index[0] = 0; index[0] < 11; ++index[0]) {
+      for (index[1] = 0; index[1] < 17; ++index[1]) {
+        for (index[2] = 0; index[2] < 19; ++index[2]) {
+          for (index[3] = 0; index[3] < 23; ++index[3]) {
+            int top_offset = 0;
+            for (int i = 0; i < 4; ++i) {
+              top_offset = top_offset * shape[order[i]] + index[order[i]];
+            }
+            EXPECT_EQ(bottom_data[this->blob_bottom_->offset(index)],
+                top_data[top_offset]);
+          }
+        }
+      }
+    }
+  }
+}
+
 #ifndef CPU_ONLY
 
 template <typename Dtype>
@@ -10,6 +10,7 @@
 #include "caffe/filler.hpp"
 #include "caffe/net.hpp"
 #include "caffe/util/io.hpp"
+#include "caffe/util/mapped_weights.hpp"
 #include "caffe/util/math_functions.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
@@ -1342,6 +1343,112 @@ TYPED_TEST(NetTest, TestSharedWeightsResume) {
   }
 }
 
+TYPED_TEST(NetTest, TestCopyTrainedLayersFromMapped) {
+  typedef typename TypeParam::Dtype Dtype;
+  Caffe::set_random_seed(this->seed_);
+  this->InitDiffDataSharedWeightsNet();
+  this->net_->ForwardBackward();
+  this->net_->Update();
+  const vector<Blob<Dtype>*> params = this->net_->learnable_params();
+  vector<shared_ptr<Blob<Dtype> > > trained_params;
+  for (int i = 0; i < params.size(); ++i) {
+    trained_params.push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>()));
+    trained_params.back()->CopyFrom(*params[i], false, true);
+  }
+  string filename;
+  MakeTempFilename(&filename);
+  {
+    MappedWeightsWriter writer(filename);
+    const vector<shared_ptr<Layer<Dtype> > >& layers = this->net_->layers();
+    for (int i = 0; i < layers.size(); ++i) {
+      for (int j = 0; j < layers[i]->blobs().size(); ++j) {
+        writer.Add(this->net_->layer_names()[i], j, *layers[i]->blobs()[j]);
+      }
+    }
+  }
+  EXPECT_TRUE(MappedWeights::IsMappedWeightsFile(filename));
+
+  // Reinitialize the net and map the parameters in.
+  Caffe::set_random_seed(this->seed_);
+  this->InitDiffDataSharedWeightsNet();
+  this->net_->CopyTrainedLayersFrom(filename);
+  Blob<Dtype>* ip1_weights = this->net_->layers()[1]->blobs()[0].get();
+  Blob<Dtype>* ip2_weights = this->net_->layers()[2]->blobs()[0].get();
+  EXPECT_EQ(ip1_weights->cpu_data(), ip2_weights->cpu_data());
+  EXPECT_EQ(0, reinterpret_cast<uintptr_t>(ip1_weights->cpu_data())
+      % kMappedWeightsAlignment);
+  ASSERT_EQ(trained_params.size(), this->net_->learnable_params().size());
+  for (int i = 0; i < trained_params.size(); ++i) {
+    const Blob<Dtype>* param = this->net_->learnable_params()[i];
+    ASSERT_EQ(trained_params[i]->shape(), param->shape());
+    for (int j = 0; j < param->count(); ++j) {
+      EXPECT_EQ(trained_params[i]->cpu_data()[j], param->cpu_data()[j]);
+    }
+  }
+  // The mapping is private: updating the params leaves the file unchanged.
+  this->net_->ForwardBackward();
+  this->net_->Update();
+  MappedWeights weights(filename);
+  for (int i = 0; i < weights.tensors().size(); ++i) {
+    const MappedTensor& tensor = weights.tensors()[i];
+    EXPECT_EQ(sizeof(Dtype) == sizeof(double), tensor.is_double);
+    if (tensor.layer_name == "innerproduct1" && tensor.param_id == 0) {
+      const Dtype* data = static_cast<const Dtype*>(tensor.data);
+      for (int j = 0; j < tensor.count(); ++j) {
+        EXPECT_EQ(trained_params[0]->cpu_data()[j], data[j]);
+      }
+    }
+  }
+}
+
+TYPED_TEST(NetTest, TestMappedLegacyShapesOutliveNet) {
+  typedef typename TypeParam::Dtype Dtype;
+  Caffe::set_random_seed(this->seed_);
+  this->InitDiffDataSharedWeightsNet();
+  const vector<Blob<Dtype>*> params = this->net_->learnable_params();
+  vector<shared_ptr<Blob<Dtype> > > trained_params;
+  for (int i = 0; i < params.size(); ++i) {
+    trained_params.push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>()));
+    trained_params.back()->CopyFrom(*params[i], false, true);
+  }
+  string filename;
+  MakeTempFilename(&filename);
+  {
+    // The params with the num x channels x height x width shapes of old
+    // models.
+    MappedWeightsWriter writer(filename);
+    const vector<shared_ptr<Layer<Dtype> > >& layers = this->net_->layers();
+    for (int i = 0; i < layers.size(); ++i) {
+      for (int j = 0; j < layers[i]->blobs().size(); ++j) {
+        const Blob<Dtype>& blob = *layers[i]->blobs()[j];
+        vector<int> shape;
+        for (int k = -4; k < 0; ++k) {
+          shape.push_back(blob.LegacyShape(k));
+        }
+        writer.Add(this->net_->layer_names()[i], j, shape, blob.cpu_data());
+      }
+    }
+  }
+
+  // A net sharing the mapped params keeps using them once the net that
+  // mapped them is gone.
+  Caffe::set_random_seed(this->seed_ + 1);
+  this->InitDiffDataSharedWeightsNet();
+  this->net_->CopyTrainedLayersFrom(filename);
+  shared_ptr<Net<Dtype> > mapped_net = this->net_;
+  this->InitDiffDataSharedWeightsNet();
+  this->net_->ShareTrainedLayersWith(mapped_net.get());
+  mapped_net.reset();
+  ASSERT_EQ(trained_params.size(), this->net_->learnable_params().size());
+  for (int i = 0; i < trained_params.size(); ++i) {
+    const Blob<Dtype>* param = this->net_->learnable_params()[i];
+    ASSERT_EQ(trained_params[i]->shape(), param->shape());
+    for (int j = 0; j < param->count(); ++j) {
+      EXPECT_EQ(trained_params[i]->cpu_data()[j], param->cpu_data()[j]);
+    }
+  }
+}
+
 TYPED_TEST(NetTest, TestParamPropagateDown) {
   typedef typename TypeParam::Dtype Dtype;
   const bool kBiasTerm = true, kForceBackward = false;
@@ -2446,6 +2553,275 @@ TYPED_TEST(NetTest, TestReshape) {
   EXPECT_FALSE(same_spatial_shape);
 }
 
+TYPED_TEST(NetTest, TestOptimizeMemory) {
+  typedef typename TypeParam::Dtype Dtype;
+  const string proto =
+      "name: 'PlannedNet' "
+      "state { phase: TEST } "
+      "layer { name: 'data' type: 'Input' top: 'data' "
+      "  input_param { shape { dim: 2 dim: 3 dim: 7 dim: 6 } } } "
+      "layer { name: 'conv1' type: 'Convolution' bottom: 'data' top: 'conv1' "
+      "  convolution_param { num_output: 4 kernel_size: 3 pad: 1 "
+      "    weight_filler { type: 'gaussian' std: 0.1 } "
+      "    bias_filler { type: 'gaussian' std: 0.1 } } } "
+      "layer { name: 'relu1' type: 'ReLU' bottom: 'conv1' top: 'conv1' } "
+      "layer { name: 'conv2' type: 'Convolution' bottom: 'conv1' top: 'conv2' "
+      "  convolution_param { num_output: 4 kernel_size: 3 pad: 1 "
+      "    weight_filler { type: 'gaussian' std: 0.1 } } } "
+      "layer { name: 'conv3' type: 'Convolution' bottom: 'conv2' top: 'conv3' "
+      "  convolution_param { num_output: 4 kernel_size: 3 pad: 1 "
+      "    weight_filler { type: 'gaussian' std: 0.1 } } } "
+      "layer { name: 'conv4' type: 'Convolution' bottom: 'conv3' top: 'conv4' "
+      "  convolution_param { num_output: 4 kernel_size: 3 pad: 1 "
+      "    weight_filler { type: 'gaussian' std: 0.1 } } } "
+      "layer { name: 'flat' type: 'Flatten' bottom: 'conv4' top: 'flat' } "
+      "layer { name: 'ip' type: 'InnerProduct' bottom: 'flat' top: 'ip' "
+      "  inner_product_param { num_output: 5 "
+      "    weight_filler { type: 'gaussian' std: 0.1 } } } "
+      "layer { name: 'ip_conv1' type: 'InnerProduct' bottom: 'conv1' "
+      "  top: 'ip_conv1' inner_product_param { num_output: 3 "
+      "    weight_filler { type: 'gaussian' std: 0.1 } } } ";
+  NetParameter param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+  Net<Dtype> net(param);
+  param.set_optimize_memory(true);
+  Net<Dtype> planned_net(param);
+  planned_net.ShareTrainedLayersWith(&net);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  for (int reshape = 0; reshape < 2; ++reshape) {
+    if (reshape) {
+      net.blob_by_name("data")->Reshape(3, 3, 7, 6);
+      planned_net.blob_by_name("data")->Reshape(3, 3, 7, 6);
+      net.Reshape();
+      planned_net.Reshape();
+    }
+    filler.Fill(net.blob_by_name("data").get());
+    planned_net.blob_by_name("data")->CopyFrom(*net.blob_by_name("data"));
+    // The input is written once and must survive repeated passes.
+    for (int pass = 0; pass < 2; ++pass) {
+      net.Forward();
+      planned_net.Forward();
+      ASSERT_EQ(net.output_blobs().size(), planned_net.output_blobs().size());
+      for (int i = 0; i < net.output_blobs().size(); ++i) {
+        const Blob<Dtype>* expected = net.output_blobs()[i];
+        const Blob<Dtype>* actual = planned_net.output_blobs()[i];
+        ASSERT_EQ(expected->shape(), actual->shape());
+        for (int j = 0; j < expected->count(); ++j) {
+          EXPECT_NEAR(expected->cpu_data()[j], actual->cpu_data()[j], 1e-5);
+        }
+      }
+    }
+    if (Caffe::mode() == Caffe::CPU) {
+      // conv2 is dead once conv4 is written, but conv1 is read until the
+      // last layer.
+      EXPECT_EQ(planned_net.blob_by_name("conv2")->cpu_data(),
+                planned_net.blob_by_name("conv4")->cpu_data());
+      EXPECT_NE(planned_net.blob_by_name("conv1")->cpu_data(),
+                planned_net.blob_by_name("conv4")->cpu_data());
+      EXPECT_NE(planned_net.blob_by_name("conv1")->cpu_data(),
+                planned_net.blob_by_name("conv2")->cpu_data());
+    }
+  }
+}
+
+TYPED_TEST(NetTest, TestBranchThreads) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Two streams with an in-place ReLU each and a shared inner product.
+  const string proto =
+      "name: 'TwoStreamNet' "
+      "force_backward: true "
+      "layer { name: 'data' type: 'Input' top: 'data' top: 'label' "
+      "  input_param { shape { dim: 2 dim: 3 dim: 5 dim: 4 } "
+      "    shape { dim: 2 dim: 6 } } } "
+      "layer { name: 'conv_rgb' type: 'Convolution' bottom: 'data' "
+      "  top: 'conv_rgb' convolution_param { num_output: 4 kernel_size: 3 "
+      "    weight_filler { type: 'gaussian' std: 0.1 } "
+      "    bias_filler { type: 'gaussian' std: 0.1 } } } "
+      "layer { name: 'relu_rgb' type: 'ReLU' bottom: 'conv_rgb' "
+      "  top: 'conv_rgb' } "
+      "layer { name: 'ip_rgb' type: 'InnerProduct' bottom: 'conv_rgb' "
+      "  top: 'ip_rgb' param { name: 'ip_w' } param { name: 'ip_b' } "
+      "  inner_product_param { num_output: 3 "
+      "    weight_filler { type: 'gaussian' std: 0.1 } } } "
+      "layer { name: 'conv_flow' type: 'Convolution' bottom: 'data' "
+      "  top: 'conv_flow' convolution_param { num_output: 4 kernel_size: 3 "
+      "    weight_filler { type: 'gaussian' std: 0.1 } "
+      "    bias_filler { type: 'gaussian' std: 0.1 } } } "
+      "layer { name: 'relu_flow' type: 'ReLU' bottom: 'conv_flow' "
+      "  top: 'conv_flow' } "
+      "layer { name: 'ip_flow' type: 'InnerProduct' bottom: 'conv_flow' "
+      "  top: 'ip_flow' param { name: 'ip_w' } param { name: 'ip_b' } "
+      "  inner_product_param { num_output: 3 } } "
+      "layer { name: 'fuse' type: 'Concat' bottom: 'ip_rgb' "
+      "  bottom: 'ip_flow' top: 'fuse' } "
+      "layer { name: 'loss' type: 'EuclideanLoss' bottom: 'fuse' "
+      "  bottom: 'label' top: 'loss' } ";
+  NetParameter param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+  Net<Dtype> net(param);
+  param.set_branch_threads(3);
+  Net<Dtype> branch_net(param);
+  branch_net.ShareTrainedLayersWith(&net);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(net.blob_by_name("data").get());
+  filler.Fill(net.blob_by_name("label").get());
+  branch_net.blob_by_name("data")->CopyFrom(*net.blob_by_name("data"));
+  branch_net.blob_by_name("label")->CopyFrom(*net.blob_by_name("label"));
+  for (int pass = 0; pass < 2; ++pass) {
+    net.ClearParamDiffs();
+    branch_net.ClearParamDiffs();
+    const Dtype loss = net.ForwardBackward();
+    EXPECT_NEAR(loss, branch_net.ForwardBackward(), 1e-5);
+    const vector<Blob<Dtype>*>& params = net.learnable_params();
+    const vector<Blob<Dtype>*>& branch_params = branch_net.learnable_params();
+    ASSERT_EQ(params.size(), branch_params.size());
+    for (int i = 0; i < params.size(); ++i) {
+      for (int j = 0; j < params[i]->count(); ++j) {
+        EXPECT_NEAR(params[i]->cpu_diff()[j], branch_params[i]->cpu_diff()[j],
+            1e-5);
+      }
+    }
+    const Blob<Dtype>* data = net.blob_by_name("data").get();
+    const Blob<Dtype>* branch_data = branch_net.blob_by_name("data").get();
+    for (int j = 0; j < data->count(); ++j) {
+      EXPECT_NEAR(data->cpu_diff()[j], branch_data->cpu_diff()[j], 1e-5);
+    }
+  }
+  EXPECT_EQ(0, net.branch_parallelism());
+  if (Caffe::mode() == Caffe::CPU) {
+    EXPECT_GT(branch_net.branch_parallelism(), 0);
+  }
+}
+
+TYPED_TEST(NetTest, TestFoldBatchNorm) {
+  typedef typename TypeParam::Dtype Dtype;
+  // A chain with separate tops and a bias-free convolution, an in-place
+  // chain, and a BatchNorm using batch statistics, which is not folded.
+  const string proto =
+      "name: 'FoldedNet' "
+      "state { phase: TEST } "
+      "layer { name: 'data' type: 'Input' top: 'data' "
+      "  input_param { shape { dim: 2 dim: 3 dim: 4 dim: 5 dim: 4 } } } "
+      "layer { name: 'conv1' type: 'Convolution' bottom: 'data' top: 'conv1' "
+      "  convolution_param { num_output: 4 kernel_size: 3 pad: 1 "
+      "    bias_term: false weight_filler { type: 'gaussian' std: 0.1 } } } "
+      "layer { name: 'bn1' type: 'BatchNorm' bottom: 'conv1' top: 'bn1' } "
+      "layer { name: 'scale1' type: 'Scale' bottom: 'bn1' top: 'scale1' "
+      "  scale_param { bias_term: true } } "
+      "layer { name: 'relu1' type: 'ReLU' bottom: 'scale1' top: 'relu1' "
+      "  relu_param { negative_slope: 0.1 } } "
+      "layer { name: 'conv2' type: 'Convolution' bottom: 'relu1' top: 'conv2' "
+      "  convolution_param { num_output: 3 kernel_size: 1 "
+      "    weight_filler { type: 'gaussian' std: 0.1 } "
+      "    bias_filler { type: 'gaussian' std: 0.1 } } } "
+      "layer { name: 'bn2' type: 'BatchNorm' bottom: 'conv2' top: 'conv2' } "
+      "layer { name: 'relu2' type: 'ReLU' bottom: 'conv2' top: 'conv2' } "
+      "layer { name: 'conv3' type: 'Convolution' bottom: 'conv2' top: 'conv3' "
+      "  convolution_param { num_output: 3 kernel_size: 1 "
+      "    weight_filler { type: 'gaussian' std: 0.1 } } } "
+      "layer { name: 'bn3' type: 'BatchNorm' bottom: 'conv3' top: 'bn3' "
+      "  batch_norm_param { use_global_stats: false } } ";
+  NetParameter param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+  Net<Dtype> net(param);
+  param.set_fold_batch_norm(true);
+  Net<Dtype> folded_net(param);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler_param.set_min(0.5);
+  filler_param.set_max(2);
+  UniformFiller<Dtype> positive_filler(filler_param);
+  const vector<shared_ptr<Layer<Dtype> > >& layers = net.layers();
+  for (int i = 0; i < layers.size(); ++i) {
+    const string type = layers[i]->type();
+    if (type == "BatchNorm") {
+      // Mean, variance and moving average factor.
+      filler.Fill(layers[i]->blobs()[0].get());
+      positive_filler.Fill(layers[i]->blobs()[1].get());
+      layers[i]->blobs()[2]->mutable_cpu_data()[0] = 2;
+    } else if (type == "Scale") {
+      filler.Fill(layers[i]->blobs()[0].get());
+      filler.Fill(layers[i]->blobs()[1].get());
+    }
+  }
+  folded_net.ShareTrainedLayersWith(&net);
+  for (int reshape = 0; reshape < 2; ++reshape) {
+    if (reshape) {
+      net.blob_by_name("data")->Reshape(vector<int>(5, 3));
+      folded_net.blob_by_name("data")->Reshape(vector<int>(5, 3));
+      net.Reshape();
+      folded_net.Reshape();
+    }
+    filler.Fill(net.blob_by_name("data").get());
+    folded_net.blob_by_name("data")->CopyFrom(*net.blob_by_name("data"));
+    net.Forward();
+    folded_net.Forward();
+    ASSERT_EQ(net.output_blobs().size(), folded_net.output_blobs().size());
+    for (int i = 0; i < net.output_blobs().size(); ++i) {
+      const Blob<Dtype>* expected = net.output_blobs()[i];
+      const Blob<Dtype>* actual = folded_net.output_blobs()[i];
+      ASSERT_EQ(expected->shape(), actual->shape());
+      for (int j = 0; j < expected->count(); ++j) {
+        EXPECT_NEAR(expected->cpu_data()[j], actual->cpu_data()[j], 1e-4);
+      }
+    }
+    // The block tops are computed by the convolutions; the others are not.
+    const Blob<Dtype>* expected = net.blob_by_name("relu1").get();
+    const Blob<Dtype>* actual = folded_net.blob_by_name("relu1").get();
+    for (int j = 0; j < expected->count(); ++j) {
+      EXPECT_NEAR(expected->cpu_data()[j], actual->cpu_data()[j], 1e-4);
+    }
+  }
+}
+
+TYPED_TEST(NetTest, TestWeightsNet) {
+  typedef typename TypeParam::Dtype Dtype;
+  const string proto =
+      "name: 'SharedNet' "
+      "state { phase: TEST } "
+      "force_backward: true "
+      "layer { name: 'data' type: 'Input' top: 'data' "
+      "  input_param { shape { dim: 2 dim: 3 dim: 4 dim: 5 } } } "
+      "layer { name: 'conv' type: 'Convolution' bottom: 'data' top: 'conv' "
+      "  convolution_param { num_output: 4 kernel_size: 3 "
+      "    weight_filler { type: 'gaussian' std: 0.1 } "
+      "    bias_filler { type: 'gaussian' std: 0.1 } } } "
+      "layer { name: 'bn' type: 'BatchNorm' bottom: 'conv' top: 'conv' } "
+      "layer { name: 'relu' type: 'ReLU' bottom: 'conv' top: 'conv' } "
+      "layer { name: 'ip' type: 'InnerProduct' bottom: 'conv' top: 'ip' "
+      "  inner_product_param { num_output: 3 "
+      "    weight_filler { type: 'gaussian' std: 0.1 } } } ";
+  NetParameter param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+  param.set_fold_batch_norm(true);
+  Net<Dtype> weights_net(param);
+  Net<Dtype> net(param, &weights_net);
+  ASSERT_EQ(weights_net.params().size(), net.params().size());
+  for (int i = 0; i < net.params().size(); ++i) {
+    EXPECT_EQ(weights_net.params()[i], net.params()[i]);
+  }
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(weights_net.blob_by_name("data").get());
+  net.blob_by_name("data")->CopyFrom(*weights_net.blob_by_name("data"));
+  weights_net.Forward();
+  net.Forward();
+  const Blob<Dtype>* expected = weights_net.blob_by_name("ip").get();
+  const Blob<Dtype>* actual = net.blob_by_name("ip").get();
+  for (int j = 0; j < expected->count(); ++j) {
+    EXPECT_EQ(expected->cpu_data()[j], actual->cpu_data()[j]);
+  }
+  // Activations are private, and shared params get no gradients.
+  EXPECT_NE(expected->cpu_data(), actual->cpu_data());
+  for (int i = 0; i < net.layers().size(); ++i) {
+    for (int j = 0; j < net.layers()[i]->blobs().size(); ++j) {
+      EXPECT_FALSE(net.layers()[i]->param_propagate_down(j));
+    }
+  }
+}
+
 TYPED_TEST(NetTest, TestSkipPropagateDown) {
   // check bottom_need_backward if propagate_down is true
   this->InitSkipPropNet(false);
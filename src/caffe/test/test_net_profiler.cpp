@@ -0,0 +1,135 @@
+#include <fstream>  // NOLINT(readability/streams)
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "google/protobuf/text_format.h"
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/net.hpp"
+#include "caffe/net_profiler.hpp"
+#include "caffe/util/io.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename TypeParam>
+class NetProfilerTest : public MultiDeviceTest<TypeParam> {
+  typedef typename TypeParam::Dtype Dtype;
+
+ protected:
+  NetProfilerTest() {
+    // Clips of 2 x 3 x 4 x 5 x 5, a 3-D convolution to 2 x 4 x 2 x 3 x 3
+    // with a fixed bias, and an inner product to 2 x 3.
+    const string proto =
+        "name: 'ProfiledNet' "
+        "layer { name: 'data' type: 'DummyData' top: 'data' top: 'label' "
+        "  dummy_data_param { "
+        "    shape { dim: 2 dim: 3 dim: 4 dim: 5 dim: 5 } "
+        "    shape { dim: 2 } "
+        "    data_filler { type: 'gaussian' } "
+        "    data_filler { type: 'constant' } } } "
+        "layer { name: 'conv' type: 'Convolution' bottom: 'data' top: 'conv' "
+        "  param { lr_mult: 1 } param { lr_mult: 0 } "
+        "  convolution_param { num_output: 4 kernel_size: 3 "
+        "    weight_filler { type: 'gaussian' std: 0.1 } } } "
+        "layer { name: 'ip' type: 'InnerProduct' bottom: 'conv' top: 'ip' "
+        "  inner_product_param { num_output: 3 "
+        "    weight_filler { type: 'gaussian' std: 0.1 } } } "
+        "layer { name: 'loss' type: 'SoftmaxWithLoss' bottom: 'ip' "
+        "  bottom: 'label' top: 'loss' } ";
+    NetParameter param;
+    CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+    net_.reset(new Net<Dtype>(param));
+  }
+
+  shared_ptr<Net<Dtype> > net_;
+};
+
+TYPED_TEST_CASE(NetProfilerTest, TestDtypesAndDevices);
+
+TYPED_TEST(NetProfilerTest, TestCounters) {
+  typedef typename TypeParam::Dtype Dtype;
+  NetProfiler<Dtype> profiler;
+  profiler.Attach(this->net_.get(), "net");
+  for (int i = 0; i < 2; ++i) {
+    this->net_->Forward();
+    this->net_->Backward();
+  }
+  ASSERT_EQ(1, profiler.num_nets());
+  // Forward, 144 outputs of 3 x 27 products, plus the bias.
+  const double conv_flops = 2 * 144 * 81 + 144;
+  const typename NetProfiler<Dtype>::Counters& conv = profiler.forward(0, 1);
+  EXPECT_EQ(2, conv.passes);
+  EXPECT_GE(conv.microseconds, 0);
+  EXPECT_EQ(2 * conv_flops, conv.flops);
+  EXPECT_EQ(2 * (600 + 4 * 81 + 4) * sizeof(Dtype), conv.bytes_read);
+  EXPECT_EQ(2 * 144 * sizeof(Dtype), conv.bytes_written);
+  // Backward, the data and the bias do not need a diff.
+  const typename NetProfiler<Dtype>::Counters& conv_backward =
+      profiler.backward(0, 1);
+  EXPECT_EQ(2, conv_backward.passes);
+  EXPECT_EQ(4 * conv_flops, conv_backward.flops);
+  EXPECT_EQ(2 * (2 * 144 + 600 + 4 * 81 + 4) * sizeof(Dtype),
+      conv_backward.bytes_read);
+  EXPECT_EQ(2 * 4 * 81 * sizeof(Dtype), conv_backward.bytes_written);
+  // 6 outputs of 72 products, plus the bias.
+  EXPECT_EQ(2 * (2 * 6 * 72 + 6), profiler.forward(0, 2).flops);
+  // The data layer has no backward pass.
+  EXPECT_EQ(2, profiler.forward(0, 0).passes);
+  EXPECT_EQ(0, profiler.backward(0, 0).passes);
+}
+
+TYPED_TEST(NetProfilerTest, TestAllocations) {
+  typedef typename TypeParam::Dtype Dtype;
+  NetProfiler<Dtype> profiler;
+  profiler.Attach(this->net_.get(), "net");
+  int64_t first = 0;
+  for (int l = 0; l < this->net_->layers().size(); ++l) {
+    this->net_->ForwardFromTo(l, l);
+    first += profiler.forward(0, l).allocations;
+  }
+  // The tops are allocated by the first pass only.
+  EXPECT_GT(first, 0);
+  this->net_->Forward();
+  int64_t total = 0;
+  for (int l = 0; l < this->net_->layers().size(); ++l) {
+    total += profiler.forward(0, l).allocations;
+  }
+  EXPECT_EQ(first, total);
+}
+
+TYPED_TEST(NetProfilerTest, TestTrace) {
+  typedef typename TypeParam::Dtype Dtype;
+  NetProfiler<Dtype> profiler(6);
+  profiler.Attach(this->net_.get(), "net \"A\"");
+  this->net_->Forward();
+  this->net_->Backward();
+  string filename;
+  MakeTempFilename(&filename);
+  profiler.WriteTrace(filename);
+  std::ifstream in(filename.c_str());
+  std::stringstream trace;
+  trace << in.rdbuf();
+  const string json = trace.str();
+  EXPECT_NE(string::npos, json.find("\"traceEvents\": ["));
+  EXPECT_NE(string::npos, json.find("\"name\": \"net \\\"A\\\"\""));
+  EXPECT_NE(string::npos, json.find("{\"name\": \"conv\", \"cat\": "
+      "\"forward\", \"ph\": \"X\""));
+  EXPECT_NE(string::npos, json.find("\"type\": \"InnerProduct\""));
+  // The four forward passes, and the first two backward ones.
+  int events = 0;
+  for (size_t i = json.find("\"ph\": \"X\""); i != string::npos;
+      i = json.find("\"ph\": \"X\"", i + 1)) {
+    ++events;
+  }
+  EXPECT_EQ(6, events);
+  EXPECT_NE(string::npos, json.find("{\"name\": \"loss\", \"cat\": "
+      "\"backward\""));
+  EXPECT_EQ(string::npos, json.find("{\"name\": \"conv\", \"cat\": "
+      "\"backward\""));
+}
+
+}  // namespace caffe
@@ -0,0 +1,199 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/neuron_functions.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+class NeuronFunctionsTest : public ::testing::Test {
+ protected:
+  NeuronFunctionsTest()
+      : x_(vector<int>(1, kCount)), dy_(vector<int>(1, kCount)),
+        y_(vector<int>(1, kCount)), s_(vector<int>(1, kCount)) {}
+
+  virtual void SetUp() {
+    Caffe::set_random_seed(1701);
+    // Enough values to be split across threads, with a ragged end.
+    FillerParameter filler_param;
+    filler_param.set_min(-20);
+    filler_param.set_max(20);
+    UniformFiller<Dtype> filler(filler_param);
+    filler.Fill(&x_);
+    filler.Fill(&dy_);
+    const Dtype special[] = {0, -0., 1e-5, -1e-5, 0.3, -0.3, 0.625, -0.625,
+        50, -50, 87, -87, 88.5, -88.5, 100, -100};
+    std::copy(special, special + sizeof(special) / sizeof(Dtype),
+        x_.mutable_cpu_data());
+  }
+
+  // Checks that the values of y are those of the reference, as computed in
+  // double precision from x.
+  template <typename Reference>
+  void Check(const Blob<Dtype>& y, Reference reference) {
+    const Dtype* x = x_.cpu_data();
+    const Dtype* y_data = y.cpu_data();
+    for (int i = 0; i < kCount; ++i) {
+      const double expected = reference(x[i], i);
+      if (std::isinf(expected)) {
+        EXPECT_EQ(expected, y_data[i]) << "x = " << x[i];
+      } else {
+        EXPECT_NEAR(expected, y_data[i], kNeuronApproxTolerance *
+            std::max(1.0, std::fabs(expected))) << "x = " << x[i];
+      }
+    }
+  }
+
+  static const int kCount = 100003;
+  Blob<Dtype> x_;
+  Blob<Dtype> dy_;
+  Blob<Dtype> y_;
+  Blob<Dtype> s_;
+};
+
+TYPED_TEST_CASE(NeuronFunctionsTest, TestDtypes);
+
+static double Sigmoid(double x) { return 1. / (1. + exp(-x)); }
+
+struct ReLURef {
+  double operator()(double x, int i) const { return x > 0 ? x : 0.1 * x; }
+};
+
+TYPED_TEST(NeuronFunctionsTest, TestReLU) {
+  caffe_cpu_relu<TypeParam>(this->kCount, this->x_.cpu_data(), 0.1,
+      this->y_.mutable_cpu_data());
+  this->Check(this->y_, ReLURef());
+}
+
+template <typename Dtype>
+struct ReLUBackwardRef {
+  const Dtype* dy;
+  double operator()(double x, int i) const {
+    return dy[i] * (x > 0 ? 1 : 0.1);
+  }
+};
+
+TYPED_TEST(NeuronFunctionsTest, TestReLUBackward) {
+  caffe_cpu_relu_backward<TypeParam>(this->kCount, this->x_.cpu_data(),
+      this->dy_.cpu_data(), 0.1, this->y_.mutable_cpu_data());
+  ReLUBackwardRef<TypeParam> reference = {this->dy_.cpu_data()};
+  this->Check(this->y_, reference);
+}
+
+struct SigmoidRef {
+  double operator()(double x, int i) const { return Sigmoid(x); }
+};
+
+TYPED_TEST(NeuronFunctionsTest, TestSigmoid) {
+  caffe_cpu_sigmoid<TypeParam>(this->kCount, this->x_.cpu_data(),
+      this->y_.mutable_cpu_data());
+  this->Check(this->y_, SigmoidRef());
+}
+
+struct TanHRef {
+  double operator()(double x, int i) const { return tanh(x); }
+};
+
+TYPED_TEST(NeuronFunctionsTest, TestTanH) {
+  caffe_cpu_tanh<TypeParam>(this->kCount, this->x_.cpu_data(),
+      this->y_.mutable_cpu_data());
+  this->Check(this->y_, TanHRef());
+  // Small values keep their relative precision.
+  const TypeParam* y = this->y_.cpu_data();
+  EXPECT_NEAR(1e-5, y[2], 1e-5 * kNeuronApproxTolerance);
+  EXPECT_NEAR(-1e-5, y[3], 1e-5 * kNeuronApproxTolerance);
+}
+
+struct ELURef {
+  double operator()(double x, int i) const {
+    return x > 0 ? x : 0.5 * (exp(x) - 1);
+  }
+};
+
+TYPED_TEST(NeuronFunctionsTest, TestELU) {
+  caffe_cpu_elu<TypeParam>(this->kCount, this->x_.cpu_data(), 0.5,
+      this->y_.mutable_cpu_data());
+  this->Check(this->y_, ELURef());
+}
+
+struct SwishRef {
+  double operator()(double x, int i) const { return x * Sigmoid(1.5 * x); }
+};
+
+struct SwishSigmoidRef {
+  double operator()(double x, int i) const { return Sigmoid(1.5 * x); }
+};
+
+TYPED_TEST(NeuronFunctionsTest, TestSwish) {
+  caffe_cpu_swish<TypeParam>(this->kCount, this->x_.cpu_data(), 1.5,
+      this->s_.mutable_cpu_data(), this->y_.mutable_cpu_data());
+  this->Check(this->y_, SwishRef());
+  this->Check(this->s_, SwishSigmoidRef());
+}
+
+struct ScaledExpRef {
+  double operator()(double x, int i) const { return 2 * exp(0.5 * x); }
+};
+
+TYPED_TEST(NeuronFunctionsTest, TestScaledExp) {
+  caffe_cpu_scaled_exp<TypeParam>(this->kCount, this->x_.cpu_data(), 0.5, 2,
+      this->y_.mutable_cpu_data());
+  this->Check(this->y_, ScaledExpRef());
+}
+
+TYPED_TEST(NeuronFunctionsTest, TestExpRange) {
+  caffe_cpu_scaled_exp<TypeParam>(this->kCount, this->x_.cpu_data(), 1, 1,
+      this->y_.mutable_cpu_data());
+  const TypeParam* y = this->y_.cpu_data();
+  for (int i = 0; i < this->kCount; ++i) {
+    const double x = this->x_.cpu_data()[i];
+    if (x < -86.5) {
+      // Denormal results may be flushed to zero.
+      EXPECT_NEAR(0, y[i], 1e-37);
+    } else if (sizeof(TypeParam) == sizeof(float) && x > 88.7228) {
+      EXPECT_TRUE(std::isinf(y[i]));
+    } else {
+      EXPECT_NEAR(exp(x), y[i], kNeuronApproxTolerance * exp(x));
+    }
+  }
+}
+
+struct BNLLRef {
+  double operator()(double x, int i) const {
+    return x > 0 ? x + log(1. + exp(-x)) : log(1. + exp(x));
+  }
+};
+
+TYPED_TEST(NeuronFunctionsTest, TestBNLL) {
+  caffe_cpu_bnll<TypeParam>(this->kCount, this->x_.cpu_data(),
+      this->y_.mutable_cpu_data());
+  this->Check(this->y_, BNLLRef());
+}
+
+struct ThresholdRef {
+  double operator()(double x, int i) const { return x > 0.25 ? 1 : 0; }
+};
+
+TYPED_TEST(NeuronFunctionsTest, TestThreshold) {
+  caffe_cpu_threshold<TypeParam>(this->kCount, this->x_.cpu_data(), 0.25,
+      this->y_.mutable_cpu_data());
+  this->Check(this->y_, ThresholdRef());
+}
+
+TYPED_TEST(NeuronFunctionsTest, TestInPlace) {
+  caffe_copy(this->kCount, this->x_.cpu_data(), this->y_.mutable_cpu_data());
+  caffe_cpu_tanh<TypeParam>(this->kCount, this->y_.cpu_data(),
+      this->y_.mutable_cpu_data());
+  this->Check(this->y_, TanHRef());
+}
+
+}  // namespace caffe
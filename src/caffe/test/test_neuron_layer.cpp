@@ -1,4 +1,5 @@
 #include <algorithm>
+#include <limits>
 #include <vector>
 
 #include "google/protobuf/text_format.h"
@@ -7,6 +8,7 @@
 #include "caffe/blob.hpp"
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
+#include "caffe/layer_factory.hpp"
 
 #include "caffe/layers/absval_layer.hpp"
 #include "caffe/layers/bnll_layer.hpp"
@@ -319,6 +321,51 @@ TYPED_TEST(NeuronLayerTest, TestELUasReLUGradient) {
       this->blob_top_vec_);
 }
 
+TYPED_TEST(NeuronLayerTest, TestPropagateNaN) {
+  typedef typename TypeParam::Dtype Dtype;
+  // NaNs in the vectorized body and in the tail of the bottom.
+  Dtype* bottom_data = this->blob_bottom_->mutable_cpu_data();
+  const int count = this->blob_bottom_->count();
+  const int nan_indices[] = {0, 5, count - 1};
+  for (int j = 0; j < 3; ++j) {
+    bottom_data[nan_indices[j]] = std::numeric_limits<Dtype>::quiet_NaN();
+  }
+  // The gradients of ReLU only depend on the sign of the bottom, and stay
+  // finite.
+  const char* params[] = {
+      "type: 'ReLU' relu_param { negative_slope: 0 }",
+      "type: 'ReLU' relu_param { negative_slope: 0.01 }",
+      "type: 'ELU' elu_param { alpha: 0.5 }",
+      "type: 'Sigmoid'", "type: 'TanH'", "type: 'Exp'", "type: 'BNLL'",
+      "type: 'Swish'"};
+  const int kNumParams = sizeof(params) / sizeof(params[0]);
+  for (int p = 0; p < kNumParams; ++p) {
+    LayerParameter layer_param;
+    CHECK(google::protobuf::TextFormat::ParseFromString(params[p],
+        &layer_param));
+    shared_ptr<Layer<Dtype> > layer =
+        LayerRegistry<Dtype>::CreateLayer(layer_param);
+    layer->SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    layer->Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    const Dtype* top_data = this->blob_top_->cpu_data();
+    for (int j = 0; j < 3; ++j) {
+      EXPECT_TRUE(top_data[nan_indices[j]] != top_data[nan_indices[j]])
+          << params[p] << ": " << top_data[nan_indices[j]];
+    }
+    if (layer_param.type() == "ReLU") {
+      continue;
+    }
+    caffe_set(count, Dtype(1), this->blob_top_->mutable_cpu_diff());
+    layer->Backward(this->blob_top_vec_, vector<bool>(1, true),
+        this->blob_bottom_vec_);
+    const Dtype* bottom_diff = this->blob_bottom_->cpu_diff();
+    for (int j = 0; j < 3; ++j) {
+      EXPECT_TRUE(bottom_diff[nan_indices[j]] != bottom_diff[nan_indices[j]])
+          << params[p] << " backward: " << bottom_diff[nan_indices[j]];
+    }
+  }
+}
+
 TYPED_TEST(NeuronLayerTest, TestSigmoid) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter layer_param;
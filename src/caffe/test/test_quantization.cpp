@@ -0,0 +1,208 @@
+#include <stdint.h>
+#include <cmath>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/quantization.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+class QuantizationTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    Caffe::set_random_seed(1701);
+  }
+
+  // Checks the GEMM against int64 sums of random quantized matrices, with
+  // sizes that leave ragged tiles, panels and blocks.
+  void TestGemm(int M, int N, int K, bool trans_c) {
+    const int ld = caffe_int8_padded_dim(K);
+    vector<int8_t> a((trans_c ? caffe_int8_panel_rows(M) : M) * ld, 0);
+    vector<int32_t> a_sums(M, 0);
+    vector<uint8_t> b((trans_c ? N : caffe_int8_panel_rows(N)) * ld, 128);
+    vector<int> a_values(M * K);
+    vector<int> b_values(N * K);
+    for (int m = 0; m < M; ++m) {
+      for (int k = 0; k < K; ++k) {
+        a_values[m * K + k] = static_cast<int>(caffe_rng_rand() %
+            (2 * kInt8WeightMax + 1)) - kInt8WeightMax;
+        a[caffe_int8_offset(m, k, ld, trans_c)] = a_values[m * K + k];
+        a_sums[m] += a_values[m * K + k];
+      }
+    }
+    for (int n = 0; n < N; ++n) {
+      for (int k = 0; k < K; ++k) {
+        b_values[n * K + k] = 1 + caffe_rng_rand() % 255;
+        b[caffe_int8_offset(n, k, ld, !trans_c)] = b_values[n * K + k];
+      }
+    }
+    vector<Dtype> scales(M);
+    vector<Dtype> bias(M);
+    for (int m = 0; m < M; ++m) {
+      scales[m] = m % 2 ? 0.5 : 2;
+      bias[m] = m;
+    }
+    vector<Dtype> c(M * N);
+    caffe_cpu_gemm_int8(M, N, K, &a[0], &a_sums[0], &b[0], &scales[0],
+        &bias[0], trans_c, &c[0]);
+    for (int m = 0; m < M; ++m) {
+      for (int n = 0; n < N; ++n) {
+        int64_t sum = 0;
+        for (int k = 0; k < K; ++k) {
+          sum += a_values[m * K + k] * (b_values[n * K + k] - 128);
+        }
+        EXPECT_EQ(scales[m] * sum + bias[m],
+            c[trans_c ? n * M + m : m * N + n]) << m << ", " << n;
+      }
+    }
+  }
+};
+
+TYPED_TEST_CASE(QuantizationTest, TestDtypes);
+
+TYPED_TEST(QuantizationTest, TestGemm) {
+  this->TestGemm(13, 37, 301, false);
+}
+
+TYPED_TEST(QuantizationTest, TestGemmTransposed) {
+  this->TestGemm(10, 3, 62, true);
+}
+
+TYPED_TEST(QuantizationTest, TestGemmBlocks) {
+  // Several blocks of rows and panels, across threads.
+  this->TestGemm(70, 400, 2500, false);
+  this->TestGemm(400, 70, 2500, true);
+}
+
+TYPED_TEST(QuantizationTest, TestQuantizeWeights) {
+  const int rows = 5;
+  const int cols = 70;
+  const int ld = caffe_int8_padded_dim(cols);
+  vector<TypeParam> w(rows * cols);
+  caffe_rng_gaussian<TypeParam>(w.size(), 0, 1, &w[0]);
+  caffe_set<TypeParam>(cols, 0, &w[3 * cols]);
+  vector<TypeParam> w_t(rows * cols);
+  for (int r = 0; r < rows; ++r) {
+    for (int c = 0; c < cols; ++c) {
+      w_t[c * rows + r] = w[r * cols + c];
+    }
+  }
+  for (int t = 0; t < 4; ++t) {
+    const bool trans = t % 2;
+    const bool panels = t / 2;
+    const int padded_rows = panels ? caffe_int8_panel_rows(rows) : rows;
+    vector<int8_t> q(padded_rows * ld, 1);
+    vector<TypeParam> scales(rows);
+    vector<int32_t> sums(rows);
+    caffe_cpu_quantize_weights(rows, cols, trans ? &w_t[0] : &w[0], trans,
+        panels, &q[0], &scales[0], &sums[0]);
+    for (int r = 0; r < padded_rows; ++r) {
+      if (r >= rows) {
+        for (int c = 0; c < ld; ++c) {
+          EXPECT_EQ(0, q[caffe_int8_offset(r, c, ld, panels)]);
+        }
+        continue;
+      }
+      const TypeParam range = caffe_cpu_absmax(cols, &w[r * cols]);
+      EXPECT_NEAR(range / kInt8WeightMax, scales[r], 1e-6);
+      int32_t sum = 0;
+      for (int c = 0; c < cols; ++c) {
+        const int value = q[caffe_int8_offset(r, c, ld, panels)];
+        EXPECT_LE(std::abs(value), kInt8WeightMax);
+        EXPECT_NEAR(w[r * cols + c], value * scales[r],
+            scales[r] / 2 + 1e-6);
+        sum += value;
+      }
+      EXPECT_EQ(sum, sums[r]);
+      for (int c = cols; c < ld; ++c) {
+        EXPECT_EQ(0, q[caffe_int8_offset(r, c, ld, panels)]);
+      }
+    }
+  }
+}
+
+TYPED_TEST(QuantizationTest, TestQuantizeActivations) {
+  const int rows = 130;
+  const int cols = 70;
+  const int ld = caffe_int8_padded_dim(cols);
+  const TypeParam scale = 0.01;
+  vector<TypeParam> x(rows * cols);
+  vector<TypeParam> x_t(rows * cols);
+  caffe_rng_gaussian<TypeParam>(x.size(), 0, 1, &x[0]);
+  for (int r = 0; r < rows; ++r) {
+    for (int c = 0; c < cols; ++c) {
+      x_t[c * rows + r] = x[r * cols + c];
+    }
+  }
+  vector<uint8_t> q(rows * ld);
+  caffe_cpu_quantize_activations(rows, cols, &x[0], false, scale, false,
+      &q[0]);
+  for (int r = 0; r < rows; ++r) {
+    for (int c = 0; c < ld; ++c) {
+      const int value = q[r * ld + c] - 128;
+      if (c >= cols) {
+        EXPECT_EQ(0, value);
+      } else if (std::fabs(x[r * cols + c]) >= kInt8ActivationMax * scale) {
+        // Saturated.
+        EXPECT_EQ(x[r * cols + c] > 0 ? kInt8ActivationMax :
+            -kInt8ActivationMax, value);
+      } else {
+        EXPECT_NEAR(x[r * cols + c], value * scale, scale / 2 + 1e-6);
+      }
+    }
+  }
+  // The other layouts and sources hold the same values.
+  for (int t = 1; t < 4; ++t) {
+    const bool trans = t % 2;
+    const bool panels = t / 2;
+    const int padded_rows = panels ? caffe_int8_panel_rows(rows) : rows;
+    vector<uint8_t> q_other(padded_rows * ld);
+    caffe_cpu_quantize_activations(rows, cols, trans ? &x_t[0] : &x[0],
+        trans, scale, panels, &q_other[0]);
+    for (int r = 0; r < padded_rows; ++r) {
+      for (int c = 0; c < ld; ++c) {
+        EXPECT_EQ(r < rows ? q[r * ld + c] : 128,
+            q_other[caffe_int8_offset(r, c, ld, panels)]);
+      }
+    }
+  }
+}
+
+TYPED_TEST(QuantizationTest, TestGatherActivations) {
+  // Runs of consecutive values, then of every other value, which fill some
+  // panels and split others in two, and windows of 3 x 3 values in 3
+  // channels, as the columns of a convolution.
+  const int rows = 70;
+  const int cols = 9 * 3;
+  const int ld = caffe_int8_padded_dim(cols);
+  vector<int> row_offsets(rows);
+  for (int r = 0; r < rows; ++r) {
+    row_offsets[r] = r < 32 ? r + r / 20 * 3 : 2 * r + r / 50 * 5;
+  }
+  vector<int> col_offsets(cols);
+  for (int k = 0; k < cols; ++k) {
+    col_offsets[k] = k / 9 * 1000 + k % 9 / 3 * 100 + k % 3;
+  }
+  vector<uint8_t> x(3000);
+  for (int i = 0; i < x.size(); ++i) {
+    x[i] = i * 7 % 251;
+  }
+  const int padded_rows = caffe_int8_panel_rows(rows);
+  vector<uint8_t> q(padded_rows * ld);
+  caffe_cpu_gather_activations(rows, cols, &x[0], &row_offsets[0],
+      &col_offsets[0], &q[0]);
+  for (int r = 0; r < padded_rows; ++r) {
+    for (int k = 0; k < ld; ++k) {
+      EXPECT_EQ(r < rows && k < cols ? x[row_offsets[r] + col_offsets[k]] :
+          128, q[caffe_int8_offset(r, k, ld, true)]);
+    }
+  }
+}
+
+}  // namespace caffe
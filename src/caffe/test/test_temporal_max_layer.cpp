@@ -0,0 +1,106 @@
+#include <algorithm>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/layers/temporal_max_layer.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+#include "caffe/test/test_gradient_check_util.hpp"
+
+namespace caffe {
+
+template <typename TypeParam>
+class TemporalMaxLayerTest : public MultiDeviceTest<TypeParam> {
+  typedef typename TypeParam::Dtype Dtype;
+
+ protected:
+  TemporalMaxLayerTest()
+      : blob_bottom_(new Blob<Dtype>()),
+        blob_top_(new Blob<Dtype>()) {}
+  virtual void SetUp() {
+    Caffe::set_random_seed(1701);
+    vector<int> shape(5);
+    shape[0] = 3;
+    shape[1] = 2;
+    shape[2] = 2;
+    shape[3] = 3;
+    shape[4] = 2;
+    blob_bottom_->Reshape(shape);
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(this->blob_bottom_);
+    blob_bottom_vec_.push_back(blob_bottom_);
+    blob_top_vec_.push_back(blob_top_);
+  }
+  virtual ~TemporalMaxLayerTest() { delete blob_bottom_; delete blob_top_; }
+
+  void TestForward() {
+    LayerParameter layer_param;
+    TemporalMaxLayer<Dtype> layer(layer_param);
+    layer.SetUp(blob_bottom_vec_, blob_top_vec_);
+    layer.Forward(blob_bottom_vec_, blob_top_vec_);
+    const int num = blob_bottom_->shape(0);
+    const int count = blob_bottom_->count(1);
+    const Dtype* bottom_data = blob_bottom_->cpu_data();
+    const Dtype* top_data = blob_top_->cpu_data();
+    for (int i = 0; i < count; ++i) {
+      Dtype expected = bottom_data[i];
+      for (int n = 1; n < num; ++n) {
+        expected = std::max(expected, bottom_data[n * count + i]);
+      }
+      EXPECT_EQ(expected, top_data[i]);
+    }
+  }
+
+  Blob<Dtype>* const blob_bottom_;
+  Blob<Dtype>* const blob_top_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+};
+
+TYPED_TEST_CASE(TemporalMaxLayerTest, TestDtypesAndDevices);
+
+TYPED_TEST(TemporalMaxLayerTest, TestSetup) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  TemporalMaxLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  ASSERT_EQ(this->blob_top_->num_axes(), 2);
+  EXPECT_EQ(this->blob_top_->shape(0), 1);
+  EXPECT_EQ(this->blob_top_->shape(1), 2 * 2 * 3 * 2);
+}
+
+TYPED_TEST(TemporalMaxLayerTest, TestForward) {
+  this->TestForward();
+}
+
+TYPED_TEST(TemporalMaxLayerTest, TestForwardLarge) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Large enough for the CPU loops to be split across threads.
+  vector<int> shape(5);
+  shape[0] = 4;
+  shape[1] = 8;
+  shape[2] = 4;
+  shape[3] = 16;
+  shape[4] = 17;
+  this->blob_bottom_->Reshape(shape);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(this->blob_bottom_);
+  this->TestForward();
+}
+
+TYPED_TEST(TemporalMaxLayerTest, TestGradient) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  TemporalMaxLayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-4, 1e-2);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_);
+}
+
+}  // namespace caffe
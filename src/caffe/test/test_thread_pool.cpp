@@ -0,0 +1,71 @@
+#include <boost/bind.hpp>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/util/thread_pool.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class ThreadPoolTest : public ::testing::Test {};
+
+void Mark(vector<int>* hits, int i) { ++(*hits)[i]; }
+
+void RunNested(ThreadPool* pool, vector<vector<int> >* hits, int i) {
+  pool->Run((*hits)[i].size(), boost::bind(&Mark, &(*hits)[i], _1));
+}
+
+TEST_F(ThreadPoolTest, TestRunsEveryTaskOnce) {
+  ThreadPool pool(4);
+  EXPECT_EQ(4, pool.num_threads());
+  for (int num_tasks = 0; num_tasks < 20; ++num_tasks) {
+    vector<int> hits(num_tasks, 0);
+    pool.Run(num_tasks, boost::bind(&Mark, &hits, _1));
+    for (int i = 0; i < num_tasks; ++i) {
+      EXPECT_EQ(1, hits[i]);
+    }
+  }
+}
+
+TEST_F(ThreadPoolTest, TestNestedRun) {
+  ThreadPool pool(3);
+  vector<vector<int> > hits(7, vector<int>(5, 0));
+  pool.Run(hits.size(),
+      boost::bind(&RunNested, &pool, &hits, _1));
+  for (int i = 0; i < hits.size(); ++i) {
+    for (int j = 0; j < hits[i].size(); ++j) {
+      EXPECT_EQ(1, hits[i][j]);
+    }
+  }
+}
+
+void MarkRange(vector<int>* hits, int begin, int end) {
+  for (int i = begin; i < end; ++i) {
+    ++(*hits)[i];
+  }
+}
+
+TEST_F(ThreadPoolTest, TestRunRange) {
+  ThreadPool pool(3);
+  const int counts[] = {0, 1, 5, 17, 1000};
+  for (int c = 0; c < 5; ++c) {
+    for (int min_range = 1; min_range < 8; ++min_range) {
+      vector<int> hits(counts[c], 0);
+      pool.RunRange(counts[c], min_range,
+          boost::bind(&MarkRange, &hits, _1, _2));
+      for (int i = 0; i < counts[c]; ++i) {
+        EXPECT_EQ(1, hits[i]);
+      }
+    }
+  }
+}
+
+TEST_F(ThreadPoolTest, TestNumThreads) {
+  EXPECT_EQ(3, ThreadPool::NumThreads(3));
+  EXPECT_GE(ThreadPool::NumThreads(0), 1);
+  EXPECT_EQ(ThreadPool::NumThreads(0), ThreadPool::Global().num_threads());
+}
+
+}  // namespace caffe
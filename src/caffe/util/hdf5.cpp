@@ -103,6 +103,59 @@ void hdf5_load_nd_dataset<double>(hid_t file_id, const char* dataset_name_,
   CHECK_GE(status, 0) << "Failed to read double dataset " << dataset_name_;
 }
 
+// Reads a range of rows of a dataset of verified format into blob.
+template <typename Dtype>
+static void hdf5_load_rows(hid_t file_id, const char* dataset_name_,
+    hid_t mem_type, hsize_t row_begin, hsize_t num_rows, Blob<Dtype>* blob) {
+  hid_t dataset_id = H5Dopen2(file_id, dataset_name_, H5P_DEFAULT);
+  CHECK_GE(dataset_id, 0) << "Failed to open dataset " << dataset_name_;
+  hid_t file_space = H5Dget_space(dataset_id);
+  const int ndims = H5Sget_simple_extent_ndims(file_space);
+  std::vector<hsize_t> dims(ndims);
+  H5Sget_simple_extent_dims(file_space, dims.data(), NULL);
+  CHECK_LE(row_begin + num_rows, dims[0])
+      << "Rows out of range of dataset " << dataset_name_;
+  std::vector<hsize_t> start(ndims, 0);
+  start[0] = row_begin;
+  dims[0] = num_rows;
+  herr_t status = H5Sselect_hyperslab(file_space, H5S_SELECT_SET,
+      start.data(), NULL, dims.data(), NULL);
+  CHECK_GE(status, 0) << "Failed to select rows of " << dataset_name_;
+  hid_t mem_space = H5Screate_simple(ndims, dims.data(), NULL);
+  vector<int> blob_dims(dims.begin(), dims.end());
+  blob->Reshape(blob_dims);
+  status = H5Dread(dataset_id, mem_type, mem_space, file_space, H5P_DEFAULT,
+      blob->mutable_cpu_data());
+  CHECK_GE(status, 0) << "Failed to read rows of " << dataset_name_;
+  H5Sclose(mem_space);
+  H5Sclose(file_space);
+  H5Dclose(dataset_id);
+}
+
+template <>
+void hdf5_load_nd_dataset_rows<float>(hid_t file_id,
+    const char* dataset_name_, int min_dim, int max_dim, hsize_t row_begin,
+    hsize_t num_rows, Blob<float>* blob) {
+  // Reshaping blob to the whole dataset would size its memory for it.
+  Blob<float> dataset_shape;
+  hdf5_load_nd_dataset_helper(file_id, dataset_name_, min_dim, max_dim,
+                              &dataset_shape, true);
+  hdf5_load_rows(file_id, dataset_name_, H5T_NATIVE_FLOAT, row_begin,
+                 num_rows, blob);
+}
+
+template <>
+void hdf5_load_nd_dataset_rows<double>(hid_t file_id,
+    const char* dataset_name_, int min_dim, int max_dim, hsize_t row_begin,
+    hsize_t num_rows, Blob<double>* blob) {
+  // Reshaping blob to the whole dataset would size its memory for it.
+  Blob<double> dataset_shape;
+  hdf5_load_nd_dataset_helper(file_id, dataset_name_, min_dim, max_dim,
+                              &dataset_shape, true);
+  hdf5_load_rows(file_id, dataset_name_, H5T_NATIVE_DOUBLE, row_begin,
+                 num_rows, blob);
+}
+
 template <>
 void hdf5_save_nd_dataset<float>(
     const hid_t file_id, const string& dataset_name, const Blob<float>& blob,
@@ -2,6 +2,7 @@
 #include <google/protobuf/io/coded_stream.h>
 #include <google/protobuf/io/zero_copy_stream_impl.h>
 #include <google/protobuf/text_format.h>
+#include <google/protobuf/wire_format_lite.h>
 #ifdef USE_OPENCV
 #include <opencv2/core/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
@@ -30,6 +31,7 @@ using google::protobuf::io::CodedInputStream;
 using google::protobuf::io::ZeroCopyOutputStream;
 using google::protobuf::io::CodedOutputStream;
 using google::protobuf::Message;
+using google::protobuf::internal::WireFormatLite;
 
 bool ReadProtoFromTextFile(const char* filename, Message* proto) {
   int fd = open(filename, O_RDONLY);
@@ -162,32 +164,90 @@ bool ReadFileToDatum(const string& filename, const int label,
   }
 }
 
+bool ParseDatumWithoutData(const char* serialized, size_t size,
+    Datum* datum, const char** data, size_t* data_size) {
+  CodedInputStream input(reinterpret_cast<const uint8_t*>(serialized), size);
+  // The fields other than data are copied into a message of their own.
+  string fields;
+  *data = NULL;
+  *data_size = 0;
+  {
+    google::protobuf::io::StringOutputStream fields_stream(&fields);
+    CodedOutputStream fields_output(&fields_stream);
+    while (uint32_t tag = input.ReadTag()) {
+      if (tag != WireFormatLite::MakeTag(Datum::kDataFieldNumber,
+          WireFormatLite::WIRETYPE_LENGTH_DELIMITED)) {
+        if (!WireFormatLite::SkipField(&input, tag, &fields_output)) {
+          return false;
+        }
+        continue;
+      }
+      uint32_t length;
+      if (!input.ReadVarint32(&length)) {
+        return false;
+      }
+      const void* buffer = NULL;
+      int buffer_size = 0;
+      if (length > 0 && (!input.GetDirectBufferPointer(&buffer, &buffer_size)
+          || static_cast<uint32_t>(buffer_size) < length)) {
+        return false;
+      }
+      *data = static_cast<const char*>(buffer);
+      *data_size = length;
+      input.Skip(length);
+    }
+    if (!input.ConsumedEntireMessage()) {
+      return false;
+    }
+  }
+  return datum->ParseFromString(fields);
+}
+
 #ifdef USE_OPENCV
-cv::Mat DecodeDatumToCVMatNative(const Datum& datum) {
-  cv::Mat cv_img;
-  CHECK(datum.encoded()) << "Datum not encoded";
-  const string& data = datum.data();
-  std::vector<char> vec_data(data.c_str(), data.c_str() + data.size());
-  cv_img = cv::imdecode(vec_data, -1);
+cv::Mat DecodeBufferToCVMatNative(const char* data, size_t size) {
+  // Decode from a header over the buffer instead of a copy of it.
+  cv::Mat buffer(1, size, CV_8UC1, const_cast<char*>(data));
+  cv::Mat cv_img = cv::imdecode(buffer, -1);
   if (!cv_img.data) {
     LOG(ERROR) << "Could not decode datum ";
   }
   return cv_img;
 }
-cv::Mat DecodeDatumToCVMat(const Datum& datum, bool is_color) {
-  cv::Mat cv_img;
-  CHECK(datum.encoded()) << "Datum not encoded";
-  const string& data = datum.data();
-  std::vector<char> vec_data(data.c_str(), data.c_str() + data.size());
+cv::Mat DecodeBufferToCVMat(const char* data, size_t size, bool is_color) {
+  cv::Mat buffer(1, size, CV_8UC1, const_cast<char*>(data));
   int cv_read_flag = (is_color ? CV_LOAD_IMAGE_COLOR :
     CV_LOAD_IMAGE_GRAYSCALE);
-  cv_img = cv::imdecode(vec_data, cv_read_flag);
+  cv::Mat cv_img = cv::imdecode(buffer, cv_read_flag);
   if (!cv_img.data) {
     LOG(ERROR) << "Could not decode datum ";
   }
   return cv_img;
 }
 
+cv::Mat DecodeDatumToCVMatNative(const Datum& datum) {
+  CHECK(datum.encoded()) << "Datum not encoded";
+  const string& data = datum.data();
+  return DecodeBufferToCVMatNative(data.data(), data.size());
+}
+cv::Mat DecodeDatumToCVMat(const Datum& datum, bool is_color) {
+  CHECK(datum.encoded()) << "Datum not encoded";
+  const string& data = datum.data();
+  return DecodeBufferToCVMat(data.data(), data.size(), is_color);
+}
+
+cv::Mat DecodeDatumFrameToCVMatNative(const Datum& datum, int frame) {
+  CHECK(datum.encoded()) << "Datum not encoded";
+  CHECK_LT(frame, datum.frames_size()) << "Datum has no frame " << frame;
+  const string& data = datum.frames(frame);
+  return DecodeBufferToCVMatNative(data.data(), data.size());
+}
+cv::Mat DecodeDatumFrameToCVMat(const Datum& datum, int frame, bool is_color) {
+  CHECK(datum.encoded()) << "Datum not encoded";
+  CHECK_LT(frame, datum.frames_size()) << "Datum has no frame " << frame;
+  const string& data = datum.frames(frame);
+  return DecodeBufferToCVMat(data.data(), data.size(), is_color);
+}
+
 // If Datum is encoded will decoded using DecodeDatumToCVMat and CVMatToDatum
 // If Datum is not encoded will do nothing
 bool DecodeDatumNative(Datum* datum) {
@@ -0,0 +1,189 @@
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "caffe/util/mapped_weights.hpp"
+
+namespace caffe {
+
+static const char kMagic[8] = {'C', 'A', 'F', 'F', 'E', 'W', 'T', 'S'};
+static const uint32_t kVersion = 1;
+
+// The header, at the start of the file. The arrays follow it, and the index
+// follows them: for each array, the uint32 size and the characters of the
+// layer name, the int32 param id, the uint32 is_double flag, the uint32
+// number of axes and the int32 dimensions, and the uint64 file offset.
+struct MappedWeightsHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t num_tensors;
+  uint64_t index_offset;
+  uint64_t index_size;
+};
+
+// Copies the next size bytes of the index at *pos to value.
+static bool ReadIndex(const char** pos, const char* end, void* value,
+    size_t size) {
+  if (static_cast<size_t>(end - *pos) < size) { return false; }
+  memcpy(value, *pos, size);
+  *pos += size;
+  return true;
+}
+
+MappedWeights::MappedWeights(const string& filename)
+    : map_(MAP_FAILED), size_(0) {
+  int fd = open(filename.c_str(), O_RDONLY);
+  CHECK_NE(fd, -1) << "File not found: " << filename;
+  struct stat file_stat;
+  CHECK_EQ(fstat(fd, &file_stat), 0) << "Cannot stat " << filename;
+  size_ = file_stat.st_size;
+  CHECK_GE(size_, sizeof(MappedWeightsHeader))
+      << filename << " is not a mapped weights file";
+  // Writable so that params can be updated in place, copying their pages.
+  map_ = mmap(NULL, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  CHECK(map_ != MAP_FAILED) << "Cannot map " << filename;
+  const char* base = static_cast<const char*>(map_);
+  MappedWeightsHeader header;
+  memcpy(&header, base, sizeof(header));
+  CHECK(!memcmp(header.magic, kMagic, sizeof(kMagic)))
+      << filename << " is not a mapped weights file";
+  CHECK_EQ(header.version, kVersion)
+      << "Unsupported mapped weights version in " << filename;
+  CHECK(header.index_offset <= size_ &&
+      header.index_size <= size_ - header.index_offset)
+      << "Truncated mapped weights file " << filename;
+  const char* pos = base + header.index_offset;
+  const char* end = pos + header.index_size;
+  tensors_.resize(header.num_tensors);
+  for (int i = 0; i < tensors_.size(); ++i) {
+    MappedTensor& tensor = tensors_[i];
+    uint32_t name_size, is_double, num_axes;
+    int32_t param_id;
+    uint64_t offset;
+    bool valid = ReadIndex(&pos, end, &name_size, sizeof(name_size)) &&
+        name_size <= static_cast<size_t>(end - pos);
+    if (valid) {
+      tensor.layer_name.assign(pos, name_size);
+      pos += name_size;
+      valid = ReadIndex(&pos, end, &param_id, sizeof(param_id)) &&
+          ReadIndex(&pos, end, &is_double, sizeof(is_double)) &&
+          ReadIndex(&pos, end, &num_axes, sizeof(num_axes)) &&
+          num_axes <= kMaxBlobAxes;
+    }
+    tensor.shape.resize(valid ? num_axes : 0);
+    for (int j = 0; valid && j < tensor.shape.size(); ++j) {
+      valid = ReadIndex(&pos, end, &tensor.shape[j], sizeof(int32_t)) &&
+          tensor.shape[j] >= 0;
+    }
+    valid = valid && ReadIndex(&pos, end, &offset, sizeof(offset));
+    CHECK(valid) << "Corrupt index in mapped weights file " << filename;
+    tensor.param_id = param_id;
+    tensor.is_double = is_double;
+    const size_t bytes = static_cast<size_t>(tensor.count()) *
+        (is_double ? sizeof(double) : sizeof(float));
+    CHECK(offset <= header.index_offset &&
+        bytes <= header.index_offset - offset)
+        << "Truncated mapped weights file " << filename;
+    tensor.data = base + offset;
+  }
+}
+
+MappedWeights::~MappedWeights() {
+  if (map_ != MAP_FAILED) {
+    munmap(map_, size_);
+  }
+}
+
+bool MappedWeights::IsMappedWeightsFile(const string& filename) {
+  char magic[sizeof(kMagic)];
+  FILE* file = fopen(filename.c_str(), "rb");
+  if (!file) { return false; }
+  const bool is_mapped = fread(magic, 1, sizeof(magic), file) ==
+      sizeof(magic) && !memcmp(magic, kMagic, sizeof(kMagic));
+  fclose(file);
+  return is_mapped;
+}
+
+MappedWeightsWriter::MappedWeightsWriter(const string& filename)
+    : filename_(filename), offset_(0), num_tensors_(0) {
+  file_ = fopen(filename.c_str(), "wb");
+  CHECK(file_) << "Cannot create " << filename;
+  // The header is written by Close, once the index is known.
+  const char zeros[kMappedWeightsAlignment] = {0};
+  Write(zeros, kMappedWeightsAlignment);
+}
+
+MappedWeightsWriter::~MappedWeightsWriter() {
+  Close();
+}
+
+void MappedWeightsWriter::Write(const void* data, size_t size) {
+  CHECK_EQ(fwrite(data, 1, size, file_), size)
+      << "Cannot write to " << filename_;
+  offset_ += size;
+}
+
+void MappedWeightsWriter::Add(const string& layer_name, int param_id,
+    const vector<int>& shape, const float* data) {
+  AddTensor(layer_name, param_id, shape, false, data, sizeof(float));
+}
+
+void MappedWeightsWriter::Add(const string& layer_name, int param_id,
+    const vector<int>& shape, const double* data) {
+  AddTensor(layer_name, param_id, shape, true, data, sizeof(double));
+}
+
+void MappedWeightsWriter::AddTensor(const string& layer_name, int param_id,
+    const vector<int>& shape, bool is_double, const void* data,
+    size_t size) {
+  CHECK(file_) << "Cannot add to closed " << filename_;
+  CHECK_LE(shape.size(), kMaxBlobAxes);
+  size_t count = 1;
+  for (int i = 0; i < shape.size(); ++i) { count *= shape[i]; }
+  const char zeros[kMappedWeightsAlignment] = {0};
+  Write(zeros, (kMappedWeightsAlignment - offset_ % kMappedWeightsAlignment)
+      % kMappedWeightsAlignment);
+  const uint64_t offset = offset_;
+  Write(data, count * size);
+  const uint32_t name_size = layer_name.size();
+  const int32_t id = param_id;
+  const uint32_t flag = is_double;
+  const uint32_t num_axes = shape.size();
+  index_.append(reinterpret_cast<const char*>(&name_size), sizeof(name_size));
+  index_.append(layer_name);
+  index_.append(reinterpret_cast<const char*>(&id), sizeof(id));
+  index_.append(reinterpret_cast<const char*>(&flag), sizeof(flag));
+  index_.append(reinterpret_cast<const char*>(&num_axes), sizeof(num_axes));
+  for (int i = 0; i < shape.size(); ++i) {
+    const int32_t dim = shape[i];
+    index_.append(reinterpret_cast<const char*>(&dim), sizeof(dim));
+  }
+  index_.append(reinterpret_cast<const char*>(&offset), sizeof(offset));
+  ++num_tensors_;
+}
+
+void MappedWeightsWriter::Close() {
+  if (!file_) { return; }
+  MappedWeightsHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.num_tensors = num_tensors_;
+  header.index_offset = offset_;
+  header.index_size = index_.size();
+  Write(index_.data(), index_.size());
+  CHECK_EQ(fseek(file_, 0, SEEK_SET), 0) << "Cannot write to " << filename_;
+  CHECK_EQ(fwrite(&header, 1, sizeof(header), file_), sizeof(header))
+      << "Cannot write to " << filename_;
+  CHECK_EQ(fclose(file_), 0) << "Cannot write to " << filename_;
+  file_ = NULL;
+}
+
+}  // namespace caffe
@@ -1,11 +1,16 @@
+#include <boost/bind.hpp>
 #include <boost/math/special_functions/next.hpp>
 #include <boost/random.hpp>
 
+#include <algorithm>
+#include <functional>
 #include <limits>
+#include <numeric>
 
 #include "caffe/common.hpp"
 #include "caffe/util/math_functions.hpp"
 #include "caffe/util/rng.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
@@ -382,4 +387,240 @@ void caffe_cpu_scale<double>(const int n, const double alpha, const double *x,
   cblas_dscal(n, alpha, y, 1);
 }
 
+// Values below which splitting a strided copy across threads does not pay off.
+static const int kMinStridedCopyPerThread = 1 << 15;
+
+// Copies the rows [begin, end) of a strided copy, a row being all the values
+// of the last axis for an index of the others.
+template <typename Dtype>
+static void StridedCopyRows(const vector<int>& shape,
+    const vector<int>& src_strides, const Dtype* src,
+    const vector<int>& dst_strides, Dtype* dst, int begin, int end) {
+  const int inner = shape.size() - 1;
+  vector<int> index(inner);
+  int src_offset = 0;
+  int dst_offset = 0;
+  for (int a = inner - 1, row = begin; a >= 0; --a) {
+    index[a] = row % shape[a];
+    row /= shape[a];
+    src_offset += index[a] * src_strides[a];
+    dst_offset += index[a] * dst_strides[a];
+  }
+  const int n = shape[inner];
+  const int src_stride = src_strides[inner];
+  const int dst_stride = dst_strides[inner];
+  for (int row = begin; row < end; ++row) {
+    const Dtype* src_row = src + src_offset;
+    Dtype* dst_row = dst + dst_offset;
+    if (src_stride == 1 && dst_stride == 1) {
+      memcpy(dst_row, src_row, sizeof(Dtype) * n);  // NOLINT(caffe/alt_fn)
+    } else {
+      for (int i = 0; i < n; ++i) {
+        dst_row[i * dst_stride] = src_row[i * src_stride];
+      }
+    }
+    for (int a = inner - 1; a >= 0; --a) {
+      src_offset += src_strides[a];
+      dst_offset += dst_strides[a];
+      if (++index[a] < shape[a]) { break; }
+      src_offset -= shape[a] * src_strides[a];
+      dst_offset -= shape[a] * dst_strides[a];
+      index[a] = 0;
+    }
+  }
+}
+
+template <typename Dtype>
+void caffe_cpu_strided_copy(const vector<int>& shape,
+    const vector<int>& src_strides, const Dtype* src,
+    const vector<int>& dst_strides, Dtype* dst) {
+  CHECK_EQ(shape.size(), src_strides.size());
+  CHECK_EQ(shape.size(), dst_strides.size());
+  // Drop the axes of one value and merge those contiguous with the next.
+  vector<int> merged_shape;
+  vector<int> merged_src_strides;
+  vector<int> merged_dst_strides;
+  for (int a = 0; a < shape.size(); ++a) {
+    if (shape[a] == 0) { return; }
+    if (shape[a] == 1) { continue; }
+    if (!merged_shape.empty() &&
+        merged_src_strides.back() == shape[a] * src_strides[a] &&
+        merged_dst_strides.back() == shape[a] * dst_strides[a]) {
+      merged_shape.back() *= shape[a];
+      merged_src_strides.back() = src_strides[a];
+      merged_dst_strides.back() = dst_strides[a];
+    } else {
+      merged_shape.push_back(shape[a]);
+      merged_src_strides.push_back(src_strides[a]);
+      merged_dst_strides.push_back(dst_strides[a]);
+    }
+  }
+  if (merged_shape.empty()) {
+    *dst = *src;
+    return;
+  }
+  const int rows = std::accumulate(merged_shape.begin(),
+      merged_shape.end() - 1, 1, std::multiplies<int>());
+  const int min_rows =
+      std::max(1, kMinStridedCopyPerThread / merged_shape.back());
+  if (rows < 2 * min_rows) {
+    StridedCopyRows(merged_shape, merged_src_strides, src, merged_dst_strides,
+        dst, 0, rows);
+  } else {
+    ThreadPool::Global().RunRange(rows, min_rows,
+        boost::bind(&StridedCopyRows<Dtype>, boost::cref(merged_shape),
+                    boost::cref(merged_src_strides), src,
+                    boost::cref(merged_dst_strides), dst, _1, _2));
+  }
+}
+
+template void caffe_cpu_strided_copy<int>(const vector<int>& shape,
+    const vector<int>& src_strides, const int* src,
+    const vector<int>& dst_strides, int* dst);
+template void caffe_cpu_strided_copy<float>(const vector<int>& shape,
+    const vector<int>& src_strides, const float* src,
+    const vector<int>& dst_strides, float* dst);
+template void caffe_cpu_strided_copy<double>(const vector<int>& shape,
+    const vector<int>& src_strides, const double* src,
+    const vector<int>& dst_strides, double* dst);
+
+// The side of the square tiles of caffe_cpu_permute: 16 floats or 8 doubles
+// per read and written line on each side.
+static const int kPermuteTileBytes = 64;
+
+// The axes of a permutation, once merged: the shape and strides of the
+// outer axes in the order of dst, then the axis innermost in dst ("a") and
+// the axis innermost in src ("b").
+struct PermuteAxes {
+  vector<int> outer_shape;
+  vector<int> outer_src_strides;
+  vector<int> outer_dst_strides;
+  int a_size, a_src_stride;
+  int b_size, b_dst_stride;
+  int tiles_a;
+};
+
+// Transposes the tiles of a whole strip of b for the strips [begin, end) of
+// a, a strip being a tile row of a for an index of the outer axes.
+template <typename Dtype>
+static void PermuteStrips(const PermuteAxes& axes, const Dtype* src,
+    Dtype* dst, int begin, int end) {
+  const int tile = kPermuteTileBytes / sizeof(Dtype);
+  for (int strip = begin; strip < end; ++strip) {
+    int outer = strip / axes.tiles_a;
+    int src_offset = 0;
+    int dst_offset = 0;
+    for (int i = axes.outer_shape.size() - 1; i >= 0; --i) {
+      const int index = outer % axes.outer_shape[i];
+      outer /= axes.outer_shape[i];
+      src_offset += index * axes.outer_src_strides[i];
+      dst_offset += index * axes.outer_dst_strides[i];
+    }
+    const int a_begin = strip % axes.tiles_a * tile;
+    const int a_end = std::min(a_begin + tile, axes.a_size);
+    for (int b_begin = 0; b_begin < axes.b_size; b_begin += tile) {
+      const int b_end = std::min(b_begin + tile, axes.b_size);
+      const Dtype* src_tile = src + src_offset + a_begin * axes.a_src_stride;
+      Dtype* dst_tile = dst + dst_offset + b_begin * axes.b_dst_stride;
+      if (a_end - a_begin == tile && b_end - b_begin == tile) {
+        // Constant bounds, for the compiler to unroll and vectorize.
+        for (int b = 0; b < tile; ++b) {
+          for (int a = 0; a < tile; ++a) {
+            dst_tile[b * axes.b_dst_stride + a_begin + a] =
+                src_tile[a * axes.a_src_stride + b_begin + b];
+          }
+        }
+      } else {
+        for (int b = 0; b < b_end - b_begin; ++b) {
+          for (int a = 0; a < a_end - a_begin; ++a) {
+            dst_tile[b * axes.b_dst_stride + a_begin + a] =
+                src_tile[a * axes.a_src_stride + b_begin + b];
+          }
+        }
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+void caffe_cpu_permute(const vector<int>& shape, const vector<int>& order,
+    const Dtype* src, Dtype* dst) {
+  const int num_axes = shape.size();
+  CHECK_EQ(num_axes, order.size());
+  vector<int> src_strides(num_axes, 1);
+  for (int i = num_axes - 2; i >= 0; --i) {
+    src_strides[i] = src_strides[i + 1] * shape[i + 1];
+  }
+  // The stride in dst of each axis of src.
+  vector<int> dst_strides(num_axes, 0);
+  vector<bool> seen(num_axes, false);
+  for (int i = num_axes - 1, stride = 1; i >= 0; --i) {
+    CHECK(order[i] >= 0 && order[i] < num_axes && !seen[order[i]])
+        << "The order must be a permutation of the axes.";
+    seen[order[i]] = true;
+    dst_strides[order[i]] = stride;
+    stride *= shape[order[i]];
+  }
+  // Walk the values in the order of dst, for strided_copy to merge the axes
+  // that stay next to each other.
+  vector<int> dst_shape(num_axes);
+  vector<int> walk_src_strides(num_axes);
+  vector<int> walk_dst_strides(num_axes);
+  for (int i = 0; i < num_axes; ++i) {
+    dst_shape[i] = shape[order[i]];
+    walk_src_strides[i] = src_strides[order[i]];
+    walk_dst_strides[i] = dst_strides[order[i]];
+  }
+  // The axes innermost in src and in dst, skipping those of one value.
+  int a = -1;
+  int b = -1;
+  for (int i = 0; i < num_axes; ++i) {
+    if (shape[i] == 0) { return; }
+  }
+  for (int i = num_axes - 1; i >= 0 && a < 0; --i) {
+    if (shape[order[i]] > 1) { a = order[i]; }
+  }
+  for (int i = num_axes - 1; i >= 0 && b < 0; --i) {
+    if (shape[i] > 1) { b = i; }
+  }
+  const int tile = kPermuteTileBytes / sizeof(Dtype);
+  if (a == b || shape[a] < tile || shape[b] < tile) {
+    // The rows of dst are rows of src, or too short to tile.
+    caffe_cpu_strided_copy(dst_shape, walk_src_strides, src, walk_dst_strides,
+        dst);
+    return;
+  }
+  PermuteAxes axes;
+  for (int i = 0; i < num_axes; ++i) {
+    if (order[i] != a && order[i] != b && shape[order[i]] > 1) {
+      axes.outer_shape.push_back(shape[order[i]]);
+      axes.outer_src_strides.push_back(src_strides[order[i]]);
+      axes.outer_dst_strides.push_back(dst_strides[order[i]]);
+    }
+  }
+  axes.a_size = shape[a];
+  axes.a_src_stride = src_strides[a];
+  axes.b_size = shape[b];
+  axes.b_dst_stride = dst_strides[b];
+  axes.tiles_a = (shape[a] + tile - 1) / tile;
+  const int strips = std::accumulate(axes.outer_shape.begin(),
+      axes.outer_shape.end(), axes.tiles_a, std::multiplies<int>());
+  const int min_strips =
+      std::max(1, kMinStridedCopyPerThread / (tile * axes.b_size));
+  if (strips < 2 * min_strips) {
+    PermuteStrips(axes, src, dst, 0, strips);
+  } else {
+    ThreadPool::Global().RunRange(strips, min_strips,
+        boost::bind(&PermuteStrips<Dtype>, boost::cref(axes), src, dst,
+                    _1, _2));
+  }
+}
+
+template void caffe_cpu_permute<int>(const vector<int>& shape,
+    const vector<int>& order, const int* src, int* dst);
+template void caffe_cpu_permute<float>(const vector<int>& shape,
+    const vector<int>& order, const float* src, float* dst);
+template void caffe_cpu_permute<double>(const vector<int>& shape,
+    const vector<int>& order, const double* src, double* dst);
+
 }  // namespace caffe
@@ -0,0 +1,637 @@
+#include <boost/bind.hpp>
+#if defined(__AVX512F__) || (defined(__AVX2__) && defined(__FMA__))
+#include <immintrin.h>
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "caffe/util/neuron_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+namespace caffe {
+
+// Values below which splitting a kernel across threads does not pay off.
+static const int kMinValuesPerThread = 1 << 15;
+
+// The kernels are written once against a set of operations on packs of
+// kWidth values: ScalarOps for one value with the standard library, and the
+// SIMD ones below for floats, whose exp, log and tanh are the polynomial
+// approximations of Cephes built from their primitives.
+template <typename Dtype>
+struct ScalarOps {
+  typedef Dtype Pack;
+  static const int kWidth = 1;
+  static inline Pack load(const Dtype* p) { return *p; }
+  static inline void store(Dtype* p, Pack a) { *p = a; }
+  static inline Pack set(Dtype a) { return a; }
+  static inline Pack add(Pack a, Pack b) { return a + b; }
+  static inline Pack sub(Pack a, Pack b) { return a - b; }
+  static inline Pack mul(Pack a, Pack b) { return a * b; }
+  static inline Pack div(Pack a, Pack b) { return a / b; }
+  // b if either is NaN, as maxps and minps.
+  static inline Pack max(Pack a, Pack b) { return a > b ? a : b; }
+  static inline Pack min(Pack a, Pack b) { return a < b ? a : b; }
+  static inline Pack abs(Pack a) { return std::fabs(a); }
+  // a > b ? t : f
+  static inline Pack select_gt(Pack a, Pack b, Pack t, Pack f) {
+    return a > b ? t : f;
+  }
+  static inline Pack exp(Pack a) { return std::exp(a); }
+  static inline Pack log(Pack a) { return std::log(a); }
+  static inline Pack tanh(Pack a) { return std::tanh(a); }
+  static inline Pack sigmoid(Pack a) { return 0.5 * std::tanh(0.5 * a) + 0.5; }
+};
+
+// exp(x) = 2^n * exp(r), with n = round(x / ln 2) and |r| <= ln 2 / 2.
+template <typename Ops>
+static inline typename Ops::Pack exp_approx(typename Ops::Pack x) {
+  typedef typename Ops::Pack Pack;
+  // Below lo, the result would be denormal and is flushed to zero; above hi,
+  // it overflows. x is the second operand of the clamp, so that NaN stays.
+  const Pack lo = Ops::set(-86.5f);
+  const Pack hi = Ops::set(88.72283935546875f);
+  const Pack clamped = Ops::min(hi, Ops::max(lo, x));
+  const Pack n = Ops::floor(Ops::fmadd(clamped,
+      Ops::set(1.44269504088896341f), Ops::set(0.5f)));
+  // ln 2 in two parts, to keep r exact.
+  Pack r = Ops::fmadd(n, Ops::set(-0.693359375f), clamped);
+  r = Ops::fmadd(n, Ops::set(2.12194440e-4f), r);
+  Pack y = Ops::set(1.9875691500e-4f);
+  y = Ops::fmadd(y, r, Ops::set(1.3981999507e-3f));
+  y = Ops::fmadd(y, r, Ops::set(8.3334519073e-3f));
+  y = Ops::fmadd(y, r, Ops::set(4.1665795894e-2f));
+  y = Ops::fmadd(y, r, Ops::set(1.6666665459e-1f));
+  y = Ops::fmadd(y, r, Ops::set(5.0000001201e-1f));
+  y = Ops::fmadd(y, Ops::mul(r, r), Ops::add(r, Ops::set(1.0f)));
+  // By 2^(n - 1) then 2, as 2^n overflows for n = 128.
+  y = Ops::mul(Ops::mul(y, Ops::pow2n(Ops::sub(n, Ops::set(1.0f)))),
+      Ops::set(2.0f));
+  y = Ops::select_gt(lo, x, Ops::set(0.0f), y);
+  return Ops::select_gt(x, hi,
+      Ops::set(std::numeric_limits<float>::infinity()), y);
+}
+
+// log(x) = log(m) + e * ln 2, with m in [sqrt(1/2), sqrt(2)), for positive
+// normal x.
+template <typename Ops>
+static inline typename Ops::Pack log_approx(typename Ops::Pack x) {
+  typedef typename Ops::Pack Pack;
+  const Pack one = Ops::set(1.0f);
+  const Pack zero = Ops::set(0.0f);
+  const Pack sqrt_half = Ops::set(0.707106781186547524f);
+  Pack e;
+  Pack m = Ops::frexp(x, &e);
+  e = Ops::sub(e, Ops::select_gt(sqrt_half, m, one, zero));
+  m = Ops::sub(Ops::add(m, Ops::select_gt(sqrt_half, m, m, zero)), one);
+  const Pack z = Ops::mul(m, m);
+  Pack y = Ops::set(7.0376836292e-2f);
+  y = Ops::fmadd(y, m, Ops::set(-1.1514610310e-1f));
+  y = Ops::fmadd(y, m, Ops::set(1.1676998740e-1f));
+  y = Ops::fmadd(y, m, Ops::set(-1.2420140846e-1f));
+  y = Ops::fmadd(y, m, Ops::set(1.4249322787e-1f));
+  y = Ops::fmadd(y, m, Ops::set(-1.6668057665e-1f));
+  y = Ops::fmadd(y, m, Ops::set(2.0000714765e-1f));
+  y = Ops::fmadd(y, m, Ops::set(-2.4999993993e-1f));
+  y = Ops::fmadd(y, m, Ops::set(3.3333331174e-1f));
+  y = Ops::mul(Ops::mul(y, m), z);
+  y = Ops::fmadd(e, Ops::set(-2.12194440e-4f), y);
+  y = Ops::fmadd(z, Ops::set(-0.5f), y);
+  return Ops::fmadd(e, Ops::set(0.693359375f), Ops::add(m, y));
+}
+
+// tanh(x) is an odd polynomial near 0, and 1 - 2 / (exp(2|x|) + 1) with the
+// sign of x elsewhere.
+template <typename Ops>
+static inline typename Ops::Pack tanh_approx(typename Ops::Pack x) {
+  typedef typename Ops::Pack Pack;
+  const Pack one = Ops::set(1.0f);
+  const Pack a = Ops::abs(x);
+  const Pack z = Ops::mul(x, x);
+  Pack p = Ops::set(-5.70498872745e-3f);
+  p = Ops::fmadd(p, z, Ops::set(2.06390887954e-2f));
+  p = Ops::fmadd(p, z, Ops::set(-5.37397155531e-2f));
+  p = Ops::fmadd(p, z, Ops::set(1.33314422036e-1f));
+  p = Ops::fmadd(p, z, Ops::set(-3.33332819422e-1f));
+  const Pack small = Ops::fmadd(Ops::mul(p, z), x, x);
+  Pack large = Ops::sub(one, Ops::div(Ops::set(2.0f),
+      Ops::add(exp_approx<Ops>(Ops::add(a, a)), one)));
+  large = Ops::select_gt(Ops::set(0.0f), x,
+      Ops::sub(Ops::set(0.0f), large), large);
+  return Ops::select_gt(Ops::set(0.625f), a, small, large);
+}
+
+template <typename Ops>
+static inline typename Ops::Pack sigmoid_approx(typename Ops::Pack x) {
+  const typename Ops::Pack one = Ops::set(1.0f);
+  return Ops::div(one,
+      Ops::add(one, exp_approx<Ops>(Ops::sub(Ops::set(0.0f), x))));
+}
+
+#if defined(__AVX512F__)
+struct Avx512Ops {
+  typedef __m512 Pack;
+  static const int kWidth = 16;
+  static inline Pack load(const float* p) { return _mm512_loadu_ps(p); }
+  static inline void store(float* p, Pack a) { _mm512_storeu_ps(p, a); }
+  static inline Pack set(float a) { return _mm512_set1_ps(a); }
+  static inline Pack add(Pack a, Pack b) { return _mm512_add_ps(a, b); }
+  static inline Pack sub(Pack a, Pack b) { return _mm512_sub_ps(a, b); }
+  static inline Pack mul(Pack a, Pack b) { return _mm512_mul_ps(a, b); }
+  static inline Pack div(Pack a, Pack b) { return _mm512_div_ps(a, b); }
+  static inline Pack max(Pack a, Pack b) { return _mm512_max_ps(a, b); }
+  static inline Pack min(Pack a, Pack b) { return _mm512_min_ps(a, b); }
+  static inline Pack abs(Pack a) { return _mm512_abs_ps(a); }
+  static inline Pack select_gt(Pack a, Pack b, Pack t, Pack f) {
+    return _mm512_mask_blend_ps(_mm512_cmp_ps_mask(a, b, _CMP_GT_OQ), f, t);
+  }
+  static inline Pack fmadd(Pack a, Pack b, Pack c) {
+    return _mm512_fmadd_ps(a, b, c);
+  }
+  static inline Pack floor(Pack a) {
+    return _mm512_roundscale_ps(a, _MM_FROUND_TO_NEG_INF);
+  }
+  // 2^n for integral n in [-126, 127], from its exponent bits.
+  static inline Pack pow2n(Pack n) {
+    return _mm512_castsi512_ps(_mm512_slli_epi32(_mm512_add_epi32(
+        _mm512_cvtps_epi32(n), _mm512_set1_epi32(127)), 23));
+  }
+  // a = m * 2^e with m in [0.5, 1), for positive normal a.
+  static inline Pack frexp(Pack a, Pack* e) {
+    const __m512i bits = _mm512_castps_si512(a);
+    *e = _mm512_cvtepi32_ps(_mm512_sub_epi32(_mm512_srli_epi32(bits, 23),
+        _mm512_set1_epi32(126)));
+    return _mm512_castsi512_ps(_mm512_or_si512(_mm512_and_si512(bits,
+        _mm512_set1_epi32(0x807FFFFF)), _mm512_set1_epi32(0x3F000000)));
+  }
+  static inline Pack exp(Pack a) { return exp_approx<Avx512Ops>(a); }
+  static inline Pack log(Pack a) { return log_approx<Avx512Ops>(a); }
+  static inline Pack tanh(Pack a) { return tanh_approx<Avx512Ops>(a); }
+  static inline Pack sigmoid(Pack a) { return sigmoid_approx<Avx512Ops>(a); }
+};
+#elif defined(__AVX2__) && defined(__FMA__)
+struct Avx2Ops {
+  typedef __m256 Pack;
+  static const int kWidth = 8;
+  static inline Pack load(const float* p) { return _mm256_loadu_ps(p); }
+  static inline void store(float* p, Pack a) { _mm256_storeu_ps(p, a); }
+  static inline Pack set(float a) { return _mm256_set1_ps(a); }
+  static inline Pack add(Pack a, Pack b) { return _mm256_add_ps(a, b); }
+  static inline Pack sub(Pack a, Pack b) { return _mm256_sub_ps(a, b); }
+  static inline Pack mul(Pack a, Pack b) { return _mm256_mul_ps(a, b); }
+  static inline Pack div(Pack a, Pack b) { return _mm256_div_ps(a, b); }
+  static inline Pack max(Pack a, Pack b) { return _mm256_max_ps(a, b); }
+  static inline Pack min(Pack a, Pack b) { return _mm256_min_ps(a, b); }
+  static inline Pack abs(Pack a) {
+    return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a);
+  }
+  static inline Pack select_gt(Pack a, Pack b, Pack t, Pack f) {
+    return _mm256_blendv_ps(f, t, _mm256_cmp_ps(a, b, _CMP_GT_OQ));
+  }
+  static inline Pack fmadd(Pack a, Pack b, Pack c) {
+    return _mm256_fmadd_ps(a, b, c);
+  }
+  static inline Pack floor(Pack a) { return _mm256_floor_ps(a); }
+  // 2^n for integral n in [-126, 127], from its exponent bits.
+  static inline Pack pow2n(Pack n) {
+    return _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(
+        _mm256_cvtps_epi32(n), _mm256_set1_epi32(127)), 23));
+  }
+  // a = m * 2^e with m in [0.5, 1), for positive normal a.
+  static inline Pack frexp(Pack a, Pack* e) {
+    const __m256i bits = _mm256_castps_si256(a);
+    *e = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(bits, 23),
+        _mm256_set1_epi32(126)));
+    return _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(bits,
+        _mm256_set1_epi32(0x807FFFFF)), _mm256_set1_epi32(0x3F000000)));
+  }
+  static inline Pack exp(Pack a) { return exp_approx<Avx2Ops>(a); }
+  static inline Pack log(Pack a) { return log_approx<Avx2Ops>(a); }
+  static inline Pack tanh(Pack a) { return tanh_approx<Avx2Ops>(a); }
+  static inline Pack sigmoid(Pack a) { return sigmoid_approx<Avx2Ops>(a); }
+};
+#endif
+
+// The operations the kernels run on packs of Dtype.
+template <typename Dtype>
+struct SimdOps {
+  typedef ScalarOps<Dtype> type;
+};
+#if defined(__AVX512F__)
+template <>
+struct SimdOps<float> {
+  typedef Avx512Ops type;
+};
+#elif defined(__AVX2__) && defined(__FMA__)
+template <>
+struct SimdOps<float> {
+  typedef Avx2Ops type;
+};
+#endif
+
+bool caffe_cpu_neuron_simd() {
+  return SimdOps<float>::type::kWidth > 1;
+}
+
+// Runs kernel on the values [begin, end): by packs, then one by one.
+template <typename Dtype, typename Kernel>
+static void RunKernelRange(const Kernel& kernel, int begin, int end) {
+  typedef typename SimdOps<Dtype>::type Ops;
+  int i = begin;
+  for (; i + Ops::kWidth <= end; i += Ops::kWidth) {
+    kernel.template Run<Ops>(i);
+  }
+  for (; i < end; ++i) {
+    kernel.template Run<ScalarOps<Dtype> >(i);
+  }
+}
+
+template <typename Dtype, typename Kernel>
+static void RunKernel(const int n, const Kernel& kernel) {
+  if (n < 2 * kMinValuesPerThread) {
+    RunKernelRange<Dtype>(kernel, 0, n);
+  } else {
+    ThreadPool::Global().RunRange(n, kMinValuesPerThread,
+        boost::bind(&RunKernelRange<Dtype, Kernel>, boost::cref(kernel),
+                    _1, _2));
+  }
+}
+
+template <typename Dtype>
+struct ReLUKernel {
+  const Dtype* x;
+  Dtype negative_slope;
+  Dtype* y;
+  template <typename Ops>
+  inline void Run(int i) const {
+    const typename Ops::Pack xi = Ops::load(x + i);
+    const typename Ops::Pack zero = Ops::set(0);
+    // max(zero, xi) is NaN for a NaN xi, which propagates.
+    Ops::store(y + i, Ops::add(Ops::max(zero, xi),
+        Ops::mul(Ops::set(negative_slope), Ops::min(xi, zero))));
+  }
+};
+
+template <typename Dtype>
+void caffe_cpu_relu(const int n, const Dtype* x, const Dtype negative_slope,
+    Dtype* y) {
+  const ReLUKernel<Dtype> kernel = {x, negative_slope, y};
+  RunKernel<Dtype>(n, kernel);
+}
+
+template void caffe_cpu_relu<float>(const int n, const float* x,
+    const float negative_slope, float* y);
+template void caffe_cpu_relu<double>(const int n, const double* x,
+    const double negative_slope, double* y);
+
+template <typename Dtype>
+struct ReLUBackwardKernel {
+  const Dtype* x;
+  const Dtype* dy;
+  Dtype negative_slope;
+  Dtype* dx;
+  template <typename Ops>
+  inline void Run(int i) const {
+    Ops::store(dx + i, Ops::mul(Ops::load(dy + i),
+        Ops::select_gt(Ops::load(x + i), Ops::set(0), Ops::set(1),
+                       Ops::set(negative_slope))));
+  }
+};
+
+template <typename Dtype>
+void caffe_cpu_relu_backward(const int n, const Dtype* x, const Dtype* dy,
+    const Dtype negative_slope, Dtype* dx) {
+  const ReLUBackwardKernel<Dtype> kernel = {x, dy, negative_slope, dx};
+  RunKernel<Dtype>(n, kernel);
+}
+
+template void caffe_cpu_relu_backward<float>(const int n, const float* x,
+    const float* dy, const float negative_slope, float* dx);
+template void caffe_cpu_relu_backward<double>(const int n, const double* x,
+    const double* dy, const double negative_slope, double* dx);
+
+template <typename Dtype>
+struct SigmoidKernel {
+  const Dtype* x;
+  Dtype* y;
+  template <typename Ops>
+  inline void Run(int i) const {
+    Ops::store(y + i, Ops::sigmoid(Ops::load(x + i)));
+  }
+};
+
+template <typename Dtype>
+void caffe_cpu_sigmoid(const int n, const Dtype* x, Dtype* y) {
+  const SigmoidKernel<Dtype> kernel = {x, y};
+  RunKernel<Dtype>(n, kernel);
+}
+
+template void caffe_cpu_sigmoid<float>(const int n, const float* x,
+    float* y);
+template void caffe_cpu_sigmoid<double>(const int n, const double* x,
+    double* y);
+
+template <typename Dtype>
+struct SigmoidBackwardKernel {
+  const Dtype* y;
+  const Dtype* dy;
+  Dtype* dx;
+  template <typename Ops>
+  inline void Run(int i) const {
+    const typename Ops::Pack yi = Ops::load(y + i);
+    Ops::store(dx + i, Ops::mul(Ops::mul(Ops::load(dy + i), yi),
+        Ops::sub(Ops::set(1), yi)));
+  }
+};
+
+template <typename Dtype>
+void caffe_cpu_sigmoid_backward(const int n, const Dtype* y, const Dtype* dy,
+    Dtype* dx) {
+  const SigmoidBackwardKernel<Dtype> kernel = {y, dy, dx};
+  RunKernel<Dtype>(n, kernel);
+}
+
+template void caffe_cpu_sigmoid_backward<float>(const int n, const float* y,
+    const float* dy, float* dx);
+template void caffe_cpu_sigmoid_backward<double>(const int n,
+    const double* y, const double* dy, double* dx);
+
+template <typename Dtype>
+struct TanHKernel {
+  const Dtype* x;
+  Dtype* y;
+  template <typename Ops>
+  inline void Run(int i) const {
+    Ops::store(y + i, Ops::tanh(Ops::load(x + i)));
+  }
+};
+
+template <typename Dtype>
+void caffe_cpu_tanh(const int n, const Dtype* x, Dtype* y) {
+  const TanHKernel<Dtype> kernel = {x, y};
+  RunKernel<Dtype>(n, kernel);
+}
+
+template void caffe_cpu_tanh<float>(const int n, const float* x, float* y);
+template void caffe_cpu_tanh<double>(const int n, const double* x,
+    double* y);
+
+template <typename Dtype>
+struct TanHBackwardKernel {
+  const Dtype* y;
+  const Dtype* dy;
+  Dtype* dx;
+  template <typename Ops>
+  inline void Run(int i) const {
+    const typename Ops::Pack yi = Ops::load(y + i);
+    Ops::store(dx + i, Ops::mul(Ops::load(dy + i),
+        Ops::sub(Ops::set(1), Ops::mul(yi, yi))));
+  }
+};
+
+template <typename Dtype>
+void caffe_cpu_tanh_backward(const int n, const Dtype* y, const Dtype* dy,
+    Dtype* dx) {
+  const TanHBackwardKernel<Dtype> kernel = {y, dy, dx};
+  RunKernel<Dtype>(n, kernel);
+}
+
+template void caffe_cpu_tanh_backward<float>(const int n, const float* y,
+    const float* dy, float* dx);
+template void caffe_cpu_tanh_backward<double>(const int n, const double* y,
+    const double* dy, double* dx);
+
+template <typename Dtype>
+struct ELUKernel {
+  const Dtype* x;
+  Dtype alpha;
+  Dtype* y;
+  template <typename Ops>
+  inline void Run(int i) const {
+    const typename Ops::Pack xi = Ops::load(x + i);
+    const typename Ops::Pack zero = Ops::set(0);
+    Ops::store(y + i, Ops::add(Ops::max(zero, xi), Ops::mul(Ops::set(alpha),
+        Ops::sub(Ops::exp(Ops::min(xi, zero)), Ops::set(1)))));
+  }
+};
+
+template <typename Dtype>
+void caffe_cpu_elu(const int n, const Dtype* x, const Dtype alpha, Dtype* y) {
+  const ELUKernel<Dtype> kernel = {x, alpha, y};
+  RunKernel<Dtype>(n, kernel);
+}
+
+template void caffe_cpu_elu<float>(const int n, const float* x,
+    const float alpha, float* y);
+template void caffe_cpu_elu<double>(const int n, const double* x,
+    const double alpha, double* y);
+
+template <typename Dtype>
+struct ELUBackwardKernel {
+  const Dtype* x;
+  const Dtype* y;
+  const Dtype* dy;
+  Dtype alpha;
+  Dtype* dx;
+  template <typename Ops>
+  inline void Run(int i) const {
+    Ops::store(dx + i, Ops::mul(Ops::load(dy + i),
+        Ops::select_gt(Ops::load(x + i), Ops::set(0), Ops::set(1),
+                       Ops::add(Ops::set(alpha), Ops::load(y + i)))));
+  }
+};
+
+template <typename Dtype>
+void caffe_cpu_elu_backward(const int n, const Dtype* x, const Dtype* y,
+    const Dtype* dy, const Dtype alpha, Dtype* dx) {
+  const ELUBackwardKernel<Dtype> kernel = {x, y, dy, alpha, dx};
+  RunKernel<Dtype>(n, kernel);
+}
+
+template void caffe_cpu_elu_backward<float>(const int n, const float* x,
+    const float* y, const float* dy, const float alpha, float* dx);
+template void caffe_cpu_elu_backward<double>(const int n, const double* x,
+    const double* y, const double* dy, const double alpha, double* dx);
+
+template <typename Dtype>
+struct SwishKernel {
+  const Dtype* x;
+  Dtype beta;
+  Dtype* s;
+  Dtype* y;
+  template <typename Ops>
+  inline void Run(int i) const {
+    const typename Ops::Pack xi = Ops::load(x + i);
+    const typename Ops::Pack si = Ops::sigmoid(
+        Ops::mul(Ops::set(beta), xi));
+    Ops::store(s + i, si);
+    Ops::store(y + i, Ops::mul(xi, si));
+  }
+};
+
+template <typename Dtype>
+void caffe_cpu_swish(const int n, const Dtype* x, const Dtype beta, Dtype* s,
+    Dtype* y) {
+  const SwishKernel<Dtype> kernel = {x, beta, s, y};
+  RunKernel<Dtype>(n, kernel);
+}
+
+template void caffe_cpu_swish<float>(const int n, const float* x,
+    const float beta, float* s, float* y);
+template void caffe_cpu_swish<double>(const int n, const double* x,
+    const double beta, double* s, double* y);
+
+template <typename Dtype>
+struct SwishBackwardKernel {
+  const Dtype* y;
+  const Dtype* s;
+  const Dtype* dy;
+  Dtype beta;
+  Dtype* dx;
+  template <typename Ops>
+  inline void Run(int i) const {
+    const typename Ops::Pack beta_y = Ops::mul(Ops::set(beta),
+        Ops::load(y + i));
+    Ops::store(dx + i, Ops::mul(Ops::load(dy + i), Ops::add(beta_y,
+        Ops::mul(Ops::load(s + i), Ops::sub(Ops::set(1), beta_y)))));
+  }
+};
+
+template <typename Dtype>
+void caffe_cpu_swish_backward(const int n, const Dtype* y, const Dtype* s,
+    const Dtype* dy, const Dtype beta, Dtype* dx) {
+  const SwishBackwardKernel<Dtype> kernel = {y, s, dy, beta, dx};
+  RunKernel<Dtype>(n, kernel);
+}
+
+template void caffe_cpu_swish_backward<float>(const int n, const float* y,
+    const float* s, const float* dy, const float beta, float* dx);
+template void caffe_cpu_swish_backward<double>(const int n, const double* y,
+    const double* s, const double* dy, const double beta, double* dx);
+
+template <typename Dtype>
+struct ScaledExpKernel {
+  const Dtype* x;
+  Dtype inner_scale;
+  Dtype outer_scale;
+  Dtype* y;
+  template <typename Ops>
+  inline void Run(int i) const {
+    Ops::store(y + i, Ops::mul(Ops::set(outer_scale),
+        Ops::exp(Ops::mul(Ops::set(inner_scale), Ops::load(x + i)))));
+  }
+};
+
+template <typename Dtype>
+void caffe_cpu_scaled_exp(const int n, const Dtype* x,
+    const Dtype inner_scale, const Dtype outer_scale, Dtype* y) {
+  const ScaledExpKernel<Dtype> kernel = {x, inner_scale, outer_scale, y};
+  RunKernel<Dtype>(n, kernel);
+}
+
+template void caffe_cpu_scaled_exp<float>(const int n, const float* x,
+    const float inner_scale, const float outer_scale, float* y);
+template void caffe_cpu_scaled_exp<double>(const int n, const double* x,
+    const double inner_scale, const double outer_scale, double* y);
+
+template <typename Dtype>
+struct ScaledExpBackwardKernel {
+  const Dtype* y;
+  const Dtype* dy;
+  Dtype inner_scale;
+  Dtype* dx;
+  template <typename Ops>
+  inline void Run(int i) const {
+    Ops::store(dx + i, Ops::mul(Ops::set(inner_scale),
+        Ops::mul(Ops::load(y + i), Ops::load(dy + i))));
+  }
+};
+
+template <typename Dtype>
+void caffe_cpu_scaled_exp_backward(const int n, const Dtype* y,
+    const Dtype* dy, const Dtype inner_scale, Dtype* dx) {
+  const ScaledExpBackwardKernel<Dtype> kernel = {y, dy, inner_scale, dx};
+  RunKernel<Dtype>(n, kernel);
+}
+
+template void caffe_cpu_scaled_exp_backward<float>(const int n,
+    const float* y, const float* dy, const float inner_scale, float* dx);
+template void caffe_cpu_scaled_exp_backward<double>(const int n,
+    const double* y, const double* dy, const double inner_scale, double* dx);
+
+template <typename Dtype>
+struct BNLLKernel {
+  const Dtype* x;
+  Dtype* y;
+  template <typename Ops>
+  inline void Run(int i) const {
+    const typename Ops::Pack xi = Ops::load(x + i);
+    const typename Ops::Pack one = Ops::set(1);
+    Ops::store(y + i, Ops::add(Ops::max(Ops::set(0), xi), Ops::log(
+        Ops::add(one, Ops::exp(Ops::sub(Ops::set(0), Ops::abs(xi)))))));
+  }
+};
+
+template <typename Dtype>
+void caffe_cpu_bnll(const int n, const Dtype* x, Dtype* y) {
+  const BNLLKernel<Dtype> kernel = {x, y};
+  RunKernel<Dtype>(n, kernel);
+}
+
+template void caffe_cpu_bnll<float>(const int n, const float* x, float* y);
+template void caffe_cpu_bnll<double>(const int n, const double* x,
+    double* y);
+
+template <typename Dtype>
+struct BNLLBackwardKernel {
+  const Dtype* x;
+  const Dtype* dy;
+  Dtype threshold;
+  Dtype* dx;
+  template <typename Ops>
+  inline void Run(int i) const {
+    const typename Ops::Pack e = Ops::exp(
+        Ops::min(Ops::set(threshold), Ops::load(x + i)));
+    Ops::store(dx + i, Ops::div(Ops::mul(Ops::load(dy + i), e),
+        Ops::add(e, Ops::set(1))));
+  }
+};
+
+template <typename Dtype>
+void caffe_cpu_bnll_backward(const int n, const Dtype* x, const Dtype* dy,
+    const Dtype threshold, Dtype* dx) {
+  const BNLLBackwardKernel<Dtype> kernel = {x, dy, threshold, dx};
+  RunKernel<Dtype>(n, kernel);
+}
+
+template void caffe_cpu_bnll_backward<float>(const int n, const float* x,
+    const float* dy, const float threshold, float* dx);
+template void caffe_cpu_bnll_backward<double>(const int n, const double* x,
+    const double* dy, const double threshold, double* dx);
+
+template <typename Dtype>
+struct ThresholdKernel {
+  const Dtype* x;
+  Dtype threshold;
+  Dtype* y;
+  template <typename Ops>
+  inline void Run(int i) const {
+    Ops::store(y + i, Ops::select_gt(Ops::load(x + i), Ops::set(threshold),
+        Ops::set(1), Ops::set(0)));
+  }
+};
+
+template <typename Dtype>
+void caffe_cpu_threshold(const int n, const Dtype* x, const Dtype threshold,
+    Dtype* y) {
+  const ThresholdKernel<Dtype> kernel = {x, threshold, y};
+  RunKernel<Dtype>(n, kernel);
+}
+
+template void caffe_cpu_threshold<float>(const int n, const float* x,
+    const float threshold, float* y);
+template void caffe_cpu_threshold<double>(const int n, const double* x,
+    const double threshold, double* y);
+
+}  // namespace caffe
@@ -0,0 +1,719 @@
+#include <boost/bind.hpp>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "caffe/util/quantization.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+namespace caffe {
+
+// Values below which splitting a quantization across threads does not pay
+// off, and multiply-adds below which splitting a GEMM does not.
+static const int kMinValuesPerThread = 1 << 15;
+static const int kMinMacsPerThread = 1 << 20;
+// The bytes of each operand a block of the GEMM keeps in L2.
+static const int kGemmBlockBytes = 1 << 17;
+// The bytes of a panel for a group of four k.
+static const int kPanelStep = kInt8PanelRows * 4;
+
+template <typename Dtype>
+static inline int round_saturate(Dtype v, int max) {
+  v = std::min(std::max(v, Dtype(-max)), Dtype(max));
+  return static_cast<int>(v >= 0 ? v + Dtype(0.5) : v - Dtype(0.5));
+}
+
+// Returns 128 + round(v), with v saturated to the activation range. The
+// offset value is positive, so truncation rounds it without a branch.
+template <typename Dtype>
+static inline uint8_t offset_round_saturate(Dtype v) {
+  v = std::min(std::max(v, Dtype(-kInt8ActivationMax)),
+      Dtype(kInt8ActivationMax));
+  return static_cast<int>(v + Dtype(128.5));
+}
+
+template <typename Dtype>
+Dtype caffe_cpu_absmax(const int n, const Dtype* x) {
+  Dtype m = 0;
+  for (int i = 0; i < n; ++i) {
+    m = std::max(m, std::fabs(x[i]));
+  }
+  return m;
+}
+
+template float caffe_cpu_absmax<float>(const int n, const float* x);
+template double caffe_cpu_absmax<double>(const int n, const double* x);
+
+template <typename Dtype>
+void caffe_cpu_quantize_weights(const int rows, const int cols,
+    const Dtype* w, const bool trans_w, const bool panels, int8_t* q,
+    Dtype* scales, int32_t* sums) {
+  const int ld = caffe_int8_padded_dim(cols);
+  const int padded_rows = panels ? caffe_int8_panel_rows(rows) : rows;
+  std::fill(q, q + padded_rows * ld, 0);
+  for (int r = 0; r < rows; ++r) {
+    // Element c of row r.
+    const Dtype* row = trans_w ? w + r : w + r * cols;
+    const int stride = trans_w ? rows : 1;
+    Dtype range = 0;
+    for (int c = 0; c < cols; ++c) {
+      range = std::max(range, std::fabs(row[c * stride]));
+    }
+    scales[r] = range / kInt8WeightMax;
+    const Dtype inv_scale = range > 0 ? kInt8WeightMax / range : Dtype(0);
+    int32_t sum = 0;
+    for (int c = 0; c < cols; ++c) {
+      const int value = round_saturate(row[c * stride] * inv_scale,
+          kInt8WeightMax);
+      q[caffe_int8_offset(r, c, ld, panels)] = value;
+      sum += value;
+    }
+    sums[r] = sum;
+  }
+}
+
+template void caffe_cpu_quantize_weights<float>(const int rows,
+    const int cols, const float* w, const bool trans_w, const bool panels,
+    int8_t* q, float* scales, int32_t* sums);
+template void caffe_cpu_quantize_weights<double>(const int rows,
+    const int cols, const double* w, const bool trans_w, const bool panels,
+    int8_t* q, double* scales, int32_t* sums);
+
+// Quantizes the n values of x to q.
+template <typename Dtype>
+static inline void QuantizeRun(const int n, const Dtype* x,
+    const Dtype inv_scale, uint8_t* q) {
+  for (int i = 0; i < n; ++i) {
+    q[i] = offset_round_saturate(x[i] * inv_scale);
+  }
+}
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+static inline void QuantizeRun(const int n, const float* x,
+    const float inv_scale, uint8_t* q) {
+  int i = 0;
+#if defined(__AVX512F__)
+  const __m512 scale = _mm512_set1_ps(inv_scale);
+  const __m512 min = _mm512_set1_ps(-kInt8ActivationMax);
+  const __m512 max = _mm512_set1_ps(kInt8ActivationMax);
+  const __m512 offset = _mm512_set1_ps(128.5f);
+  for (; i + 16 <= n; i += 16) {
+    const __m512 v = _mm512_min_ps(_mm512_max_ps(
+        _mm512_mul_ps(_mm512_loadu_ps(x + i), scale), min), max);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(q + i), _mm512_cvtepi32_epi8(
+        _mm512_cvttps_epi32(_mm512_add_ps(v, offset))));
+  }
+#else
+  const __m256 scale = _mm256_set1_ps(inv_scale);
+  const __m256 min = _mm256_set1_ps(-kInt8ActivationMax);
+  const __m256 max = _mm256_set1_ps(kInt8ActivationMax);
+  const __m256 offset = _mm256_set1_ps(128.5f);
+  for (; i + 8 <= n; i += 8) {
+    const __m256 v = _mm256_min_ps(_mm256_max_ps(
+        _mm256_mul_ps(_mm256_loadu_ps(x + i), scale), min), max);
+    const __m256i values = _mm256_cvttps_epi32(_mm256_add_ps(v, offset));
+    const __m128i words = _mm_packs_epi32(_mm256_castsi256_si128(values),
+        _mm256_extracti128_si256(values, 1));
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(q + i),
+        _mm_packus_epi16(words, words));
+  }
+#endif
+  for (; i < n; ++i) {
+    q[i] = offset_round_saturate(x[i] * inv_scale);
+  }
+}
+#endif
+
+// Quantizes the rows [begin, end) of x, rows x cols, to q by rows.
+template <typename Dtype>
+static void QuantizeRows(const int rows, const int cols, const Dtype* x,
+    const Dtype inv_scale, uint8_t* q, int begin, int end) {
+  const int ld = caffe_int8_padded_dim(cols);
+  for (int r = begin; r < end; ++r) {
+    QuantizeRun(cols, x + r * cols, inv_scale, q + r * ld);
+  }
+}
+
+// Quantizes the kInt8PanelRows values of the four rows of x, rows apart,
+// to the 4 * kInt8PanelRows bytes of a panel for a group of k.
+template <typename Dtype>
+static inline void QuantizePanelGroup(const Dtype* x, const int rows,
+    const Dtype inv_scale, uint8_t* q) {
+  for (int r = 0; r < kInt8PanelRows; ++r) {
+    for (int j = 0; j < 4; ++j) {
+      q[4 * r + j] = offset_round_saturate(x[j * rows + r] * inv_scale);
+    }
+  }
+}
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+// The quantized values of a group fit in the int32 lanes of the panel rows.
+static inline void QuantizePanelGroup(const float* x, const int rows,
+    const float inv_scale, uint8_t* q) {
+#if defined(__AVX512F__)
+  const __m512 scale = _mm512_set1_ps(inv_scale);
+  const __m512 min = _mm512_set1_ps(-kInt8ActivationMax);
+  const __m512 max = _mm512_set1_ps(kInt8ActivationMax);
+  const __m512 offset = _mm512_set1_ps(128.5f);
+  __m512i packed = _mm512_setzero_si512();
+  for (int j = 0; j < 4; ++j) {
+    const __m512 v = _mm512_min_ps(_mm512_max_ps(
+        _mm512_mul_ps(_mm512_loadu_ps(x + j * rows), scale), min), max);
+    packed = _mm512_or_si512(packed, _mm512_slli_epi32(
+        _mm512_cvttps_epi32(_mm512_add_ps(v, offset)), 8 * j));
+  }
+  _mm512_storeu_si512(q, packed);
+#else
+  const __m256 scale = _mm256_set1_ps(inv_scale);
+  const __m256 min = _mm256_set1_ps(-kInt8ActivationMax);
+  const __m256 max = _mm256_set1_ps(kInt8ActivationMax);
+  const __m256 offset = _mm256_set1_ps(128.5f);
+  for (int half = 0; half < kInt8PanelRows; half += 8) {
+    __m256i packed = _mm256_setzero_si256();
+    for (int j = 0; j < 4; ++j) {
+      const __m256 v = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(
+          _mm256_loadu_ps(x + j * rows + half), scale), min), max);
+      packed = _mm256_or_si256(packed, _mm256_slli_epi32(
+          _mm256_cvttps_epi32(_mm256_add_ps(v, offset)), 8 * j));
+    }
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(q + 4 * half), packed);
+  }
+#endif
+}
+#endif
+
+// Quantizes the groups of four k [begin, end) of x, cols x rows, to q by
+// panels: the four rows of x of a group fill the panels one after the other.
+template <typename Dtype>
+static void QuantizeTransposedPanels(const int rows, const int cols,
+    const Dtype* x, const Dtype inv_scale, uint8_t* q, int begin, int end) {
+  const int ld = caffe_int8_padded_dim(cols);
+  for (int g = begin; g < end; ++g) {
+    const int k = 4 * g;
+    const int group = std::min(4, cols - k);
+    const Dtype* x_group = x + k * rows;
+    for (int r0 = 0; r0 < rows; r0 += kInt8PanelRows) {
+      const int r1 = std::min(r0 + kInt8PanelRows, rows);
+      uint8_t* q_panel = q + caffe_int8_offset(r0, k, ld, true) - 4 * r0;
+      if (group == 4 && r1 - r0 == kInt8PanelRows) {
+        QuantizePanelGroup(x_group + r0, rows, inv_scale, q_panel + 4 * r0);
+      } else {
+        for (int r = r0; r < r1; ++r) {
+          for (int j = 0; j < group; ++j) {
+            q_panel[4 * r + j] =
+                offset_round_saturate(x_group[j * rows + r] * inv_scale);
+          }
+        }
+      }
+    }
+  }
+}
+
+// Quantizes the rows [begin, end) of x as it is stored, rows x cols values
+// or cols x rows if trans_x, to either layout, one value at a time.
+template <typename Dtype>
+static void QuantizeValues(const int rows, const int cols, const Dtype* x,
+    const bool trans_x, const Dtype inv_scale, const bool panels, uint8_t* q,
+    int begin, int end) {
+  const int ld = caffe_int8_padded_dim(cols);
+  const int x_cols = trans_x ? rows : cols;
+  for (int i = begin; i < end; ++i) {
+    for (int j = 0; j < x_cols; ++j) {
+      q[trans_x ? caffe_int8_offset(j, i, ld, panels) :
+          caffe_int8_offset(i, j, ld, panels)] =
+          offset_round_saturate(x[i * x_cols + j] * inv_scale);
+    }
+  }
+}
+
+template <typename Dtype>
+void caffe_cpu_quantize_activations(const int rows, const int cols,
+    const Dtype* x, const bool trans_x, const Dtype scale, const bool panels,
+    uint8_t* q) {
+  const int ld = caffe_int8_padded_dim(cols);
+  const int padded_rows = panels ? caffe_int8_panel_rows(rows) : rows;
+  if (ld != cols || padded_rows != rows) {
+    std::fill(q, q + padded_rows * ld, 128);
+  }
+  const Dtype inv_scale = scale > 0 ? 1 / scale : Dtype(0);
+  // Split the layouts the engines use into their natural units, rows of q
+  // or groups of k, and the others into rows of x.
+  boost::function<void(int, int)> quantize;
+  int units, unit_values;
+  if (!trans_x && !panels) {
+    quantize = boost::bind(&QuantizeRows<Dtype>, rows, cols, x, inv_scale,
+        q, _1, _2);
+    units = rows;
+    unit_values = cols;
+  } else if (trans_x && panels) {
+    quantize = boost::bind(&QuantizeTransposedPanels<Dtype>, rows, cols, x,
+        inv_scale, q, _1, _2);
+    units = ld / 4;
+    unit_values = 4 * rows;
+  } else {
+    quantize = boost::bind(&QuantizeValues<Dtype>, rows, cols, x, trans_x,
+        inv_scale, panels, q, _1, _2);
+    units = trans_x ? cols : rows;
+    unit_values = trans_x ? rows : cols;
+  }
+  const int min_units = std::max(1,
+      kMinValuesPerThread / std::max(unit_values, 1));
+  if (units < 2 * min_units) {
+    quantize(0, units);
+  } else {
+    ThreadPool::Global().RunRange(units, min_units, quantize);
+  }
+}
+
+template void caffe_cpu_quantize_activations<float>(const int rows,
+    const int cols, const float* x, const bool trans_x, const float scale,
+    const bool panels, uint8_t* q);
+template void caffe_cpu_quantize_activations<double>(const int rows,
+    const int cols, const double* x, const bool trans_x, const double scale,
+    const bool panels, uint8_t* q);
+
+#if defined(__SSE2__)
+// The rows of a panel as runs of values of x step apart, 1 or 2: row r of
+// the panel is x[starts[i] + step * r] in the run i it belongs to, and the
+// runs start at nondecreasing offsets, so that the vectors of a group read
+// no value outside those the panel needs.
+struct PanelRuns {
+  static const int kMaxRuns = 4;
+  int step;
+  int count;
+  int starts[kMaxRuns];
+  // The rows of the run and of the following ones.
+  __m128i masks[kMaxRuns];
+};
+
+// Returns whether the rows of a panel, at row_offsets, fit in runs.
+static bool FindRuns(const int* row_offsets, PanelRuns* runs) {
+  runs->step = row_offsets[1] - row_offsets[0];
+  if (runs->step != 1 && runs->step != 2) {
+    return false;
+  }
+  const __m128i rows = _mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11,
+      12, 13, 14, 15);
+  runs->count = 1;
+  runs->starts[0] = row_offsets[0];
+  for (int r = 1; r < kInt8PanelRows; ++r) {
+    const int start = row_offsets[r] - runs->step * r;
+    const int last = runs->starts[runs->count - 1];
+    if (start == last) {
+      continue;
+    }
+    if (start < last || runs->count == PanelRuns::kMaxRuns) {
+      return false;
+    }
+    runs->starts[runs->count] = start;
+    runs->masks[runs->count] = _mm_cmpgt_epi8(rows, _mm_set1_epi8(r - 1));
+    ++runs->count;
+  }
+  return true;
+}
+
+// Loads the values x[step * r] of the rows of a panel.
+static inline __m128i LoadRows(const uint8_t* x, const int step) {
+  const __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(x));
+  if (step == 1) {
+    return low;
+  }
+  // The even bytes of x[0, 16) and the odd ones of x[15, 31).
+  const __m128i high =
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(x + 15));
+  return _mm_packus_epi16(_mm_and_si128(low, _mm_set1_epi16(0xff)),
+      _mm_srli_epi16(high, 8));
+}
+
+// Gathers the values of a panel from the four col_offsets to the
+// 4 * kInt8PanelRows bytes of a panel for a group of k.
+static inline void GatherPanelGroup(const uint8_t* x, const PanelRuns& runs,
+    const int* col_offsets, uint8_t* q) {
+  __m128i v[4];
+  for (int j = 0; j < 4; ++j) {
+    v[j] = LoadRows(x + runs.starts[0] + col_offsets[j], runs.step);
+    for (int i = 1; i < runs.count; ++i) {
+      v[j] = _mm_or_si128(_mm_andnot_si128(runs.masks[i], v[j]),
+          _mm_and_si128(runs.masks[i],
+              LoadRows(x + runs.starts[i] + col_offsets[j], runs.step)));
+    }
+  }
+  // Interleave the bytes of the four vectors of rows, then their pairs.
+  const __m128i lo01 = _mm_unpacklo_epi8(v[0], v[1]);
+  const __m128i hi01 = _mm_unpackhi_epi8(v[0], v[1]);
+  const __m128i lo23 = _mm_unpacklo_epi8(v[2], v[3]);
+  const __m128i hi23 = _mm_unpackhi_epi8(v[2], v[3]);
+  __m128i* out = reinterpret_cast<__m128i*>(q);
+  _mm_storeu_si128(out, _mm_unpacklo_epi16(lo01, lo23));
+  _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(lo01, lo23));
+  _mm_storeu_si128(out + 2, _mm_unpacklo_epi16(hi01, hi23));
+  _mm_storeu_si128(out + 3, _mm_unpackhi_epi16(hi01, hi23));
+}
+#endif
+
+// Gathers the panels [begin, end) of q. With SSE2, the full groups of k of
+// the full panels whose rows fit in PanelRuns are gathered a vector at a
+// time.
+static void GatherPanels(const int rows, const int cols, const uint8_t* x,
+    const int* row_offsets, const int* col_offsets, uint8_t* q, int begin,
+    int end) {
+  const int ld = caffe_int8_padded_dim(cols);
+  for (int p = begin; p < end; ++p) {
+    const int r0 = p * kInt8PanelRows;
+    const int r1 = std::min(r0 + kInt8PanelRows, rows);
+    uint8_t* q_panel = q + r0 * ld;
+    int k = 0;
+#if defined(__SSE2__)
+    PanelRuns runs;
+    if (r1 - r0 == kInt8PanelRows && FindRuns(row_offsets + r0, &runs)) {
+      for (; k + 4 <= cols; k += 4) {
+        GatherPanelGroup(x, runs, col_offsets + k,
+            q_panel + k * kInt8PanelRows);
+      }
+    }
+#endif
+    for (; k < cols; k += 4) {
+      const int group = std::min(4, cols - k);
+      uint8_t* q_group = q_panel + k * kInt8PanelRows;
+      for (int r = r0; r < r1; ++r) {
+        const uint8_t* x_row = x + row_offsets[r];
+        for (int j = 0; j < group; ++j) {
+          q_group[4 * (r - r0) + j] = x_row[col_offsets[k + j]];
+        }
+      }
+    }
+  }
+}
+
+void caffe_cpu_gather_activations(const int rows, const int cols,
+    const uint8_t* x, const int* row_offsets, const int* col_offsets,
+    uint8_t* q) {
+  const int ld = caffe_int8_padded_dim(cols);
+  const int panels = caffe_int8_panel_rows(rows) / kInt8PanelRows;
+  if (ld != cols || panels * kInt8PanelRows != rows) {
+    std::fill(q, q + panels * kInt8PanelRows * ld, 128);
+  }
+  const int min_panels = std::max(1,
+      kMinValuesPerThread / (kInt8PanelRows * std::max(ld, 1)));
+  if (panels < 2 * min_panels) {
+    GatherPanels(rows, cols, x, row_offsets, col_offsets, q, 0, panels);
+  } else {
+    ThreadPool::Global().RunRange(panels, min_panels,
+        boost::bind(&GatherPanels, rows, cols, x, row_offsets, col_offsets, q,
+            _1, _2));
+  }
+}
+
+// The GEMM multiplies the rows of one operand, stored by rows, with the
+// panels of the other, a vector of rows at a time: each accumulator holds
+// the sums of a row with kVecBytes / 4 rows of a panel, and gets the
+// products of the four values of a group of k of the row, broadcast, and of
+// those of the panel rows. It is written once against a set of operations
+// on these vectors: ScalarDotOps for plain C++, and the SIMD ones below. All
+// of them compute exact int32 sums; madd takes the unsigned operand first.
+struct ScalarDotOps {
+  typedef int32_t Acc;
+  typedef uint32_t Vec;
+  static const int kVecBytes = 4;
+  // The rows and panels of a tile.
+  static const int kRows = 1;
+  static const int kPanels = 1;
+  static inline const char* name() { return "scalar"; }
+  static inline Acc zero() { return 0; }
+  static inline Vec load(const uint8_t* p) {
+    Vec v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+  }
+  static inline Vec broadcast(const uint8_t* p) { return load(p); }
+  static inline Acc madd(Acc acc, Vec u, Vec s) {
+    for (int i = 0; i < 4; ++i) {
+      acc += static_cast<uint8_t>(u >> 8 * i) *
+          static_cast<int8_t>(s >> 8 * i);
+    }
+    return acc;
+  }
+  static inline void store(int32_t* p, Acc acc) { *p = acc; }
+};
+
+#if defined(__AVX512BW__)
+struct Avx512DotOps {
+  typedef __m512i Acc;
+  typedef __m512i Vec;
+  static const int kVecBytes = 64;
+  static const int kRows = 4;
+  static const int kPanels = 2;
+  static inline Acc zero() { return _mm512_setzero_si512(); }
+  static inline Vec load(const uint8_t* p) { return _mm512_loadu_si512(p); }
+  static inline Vec broadcast(const uint8_t* p) {
+    int32_t v;
+    memcpy(&v, p, sizeof(v));
+    return _mm512_set1_epi32(v);
+  }
+#if defined(__AVX512VNNI__)
+  static inline const char* name() { return "AVX-512 VNNI"; }
+  static inline Acc madd(Acc acc, Vec u, Vec s) {
+    return _mm512_dpbusd_epi32(acc, u, s);
+  }
+#else
+  static inline const char* name() { return "AVX-512"; }
+  static inline Acc madd(Acc acc, Vec u, Vec s) {
+    return _mm512_add_epi32(acc, _mm512_madd_epi16(
+        _mm512_maddubs_epi16(u, s), _mm512_set1_epi16(1)));
+  }
+#endif
+  static inline void store(int32_t* p, Acc acc) {
+    _mm512_storeu_si512(p, acc);
+  }
+};
+typedef Avx512DotOps SimdDotOps;
+#elif defined(__AVX2__)
+struct Avx2DotOps {
+  typedef __m256i Acc;
+  typedef __m256i Vec;
+  static const int kVecBytes = 32;
+  static const int kRows = 4;
+  static const int kPanels = 1;
+  static inline const char* name() { return "AVX2"; }
+  static inline Acc zero() { return _mm256_setzero_si256(); }
+  static inline Vec load(const uint8_t* p) {
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+  }
+  static inline Vec broadcast(const uint8_t* p) {
+    int32_t v;
+    memcpy(&v, p, sizeof(v));
+    return _mm256_set1_epi32(v);
+  }
+  static inline Acc madd(Acc acc, Vec u, Vec s) {
+    return _mm256_add_epi32(acc, _mm256_madd_epi16(
+        _mm256_maddubs_epi16(u, s), _mm256_set1_epi16(1)));
+  }
+  static inline void store(int32_t* p, Acc acc) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), acc);
+  }
+};
+typedef Avx2DotOps SimdDotOps;
+#else
+typedef ScalarDotOps SimdDotOps;
+#endif
+
+const char* caffe_cpu_int8_gemm_isa() { return SimdDotOps::name(); }
+
+// The kCount accumulators of a tile with kVecs vectors per row, unrolled by
+// recursion so that the compiler keeps them in registers. kSignedPanels
+// tells whether the panels hold the weights.
+template <typename Ops, bool kSignedPanels, int kVecs, int kCount>
+struct UnrolledTile {
+  typedef typename Ops::Acc Acc;
+  typedef UnrolledTile<Ops, kSignedPanels, kVecs, kCount - 1> Rest;
+  static const int kVecsPerPanel = kPanelStep / Ops::kVecBytes;
+  static const int kRow = (kCount - 1) / kVecs;
+  static const int kPanel = (kCount - 1) % kVecs / kVecsPerPanel;
+  static const int kVec = (kCount - 1) % kVecsPerPanel;
+  static inline void zero(Acc* acc) {
+    Rest::zero(acc);
+    acc[kCount - 1] = Ops::zero();
+  }
+  static inline void madd(Acc* acc, const uint8_t* rows, const int ld,
+      const uint8_t* panels, const int panel_bytes) {
+    Rest::madd(acc, rows, ld, panels, panel_bytes);
+    const typename Ops::Vec row = Ops::broadcast(rows + kRow * ld);
+    const typename Ops::Vec panel = Ops::load(panels + kPanel * panel_bytes +
+        kVec * Ops::kVecBytes);
+    acc[kCount - 1] = kSignedPanels ? Ops::madd(acc[kCount - 1], row, panel)
+        : Ops::madd(acc[kCount - 1], panel, row);
+  }
+  static inline void store(const Acc* acc, int32_t* sums) {
+    Rest::store(acc, sums);
+    Ops::store(sums + (kCount - 1) * Ops::kVecBytes / 4, acc[kCount - 1]);
+  }
+};
+
+template <typename Ops, bool kSignedPanels, int kVecs>
+struct UnrolledTile<Ops, kSignedPanels, kVecs, 0> {
+  typedef typename Ops::Acc Acc;
+  static inline void zero(Acc* acc) {}
+  static inline void madd(Acc* acc, const uint8_t* rows, const int ld,
+      const uint8_t* panels, const int panel_bytes) {}
+  static inline void store(const Acc* acc, int32_t* sums) {}
+};
+
+// Sets sums[(i * kPanels + j) * kInt8PanelRows + r] to the dot product of
+// row i of rows and row r of panel j of panels.
+template <typename Ops, bool kSignedPanels, int kRows, int kPanels>
+static inline void DotTile(const uint8_t* rows, const uint8_t* panels,
+    const int ld, int32_t* sums) {
+  const int kVecs = kPanels * kPanelStep / Ops::kVecBytes;
+  typedef UnrolledTile<Ops, kSignedPanels, kVecs, kRows * kVecs> Tile;
+  typename Ops::Acc acc[kRows * kVecs];
+  Tile::zero(acc);
+  const int panel_bytes = kInt8PanelRows * ld;
+  for (int k = 0; k < ld; k += 4) {
+    Tile::madd(acc, rows + k, ld, panels + k * kInt8PanelRows, panel_bytes);
+  }
+  Tile::store(acc, sums);
+}
+
+// The operands of the GEMM as rows and panels: c[p * V + v] is the product
+// of row p of rows with row v of panels, and m is p, or v if trans_c.
+template <typename Dtype>
+struct GemmInt8Args {
+  int P, V, ld;
+  const uint8_t* rows;
+  const uint8_t* panels;
+  const int32_t* a_sums;
+  const Dtype* scales;
+  const Dtype* bias;
+  bool trans_c;
+  Dtype* c;
+  // The rows and panel rows of a block, and the number of panel blocks.
+  int block_p, block_v, blocks_v;
+};
+
+template <typename Dtype>
+static inline void StoreInt8Values(const GemmInt8Args<Dtype>& args, int p,
+    int v, const int count, const int32_t* sums) {
+  Dtype* c = args.c + p * args.V + v;
+  if (!args.trans_c) {
+    const Dtype scale = args.scales[p];
+    const int32_t offset = 128 * args.a_sums[p];
+    const Dtype bias = args.bias ? args.bias[p] : Dtype(0);
+    for (int j = 0; j < count; ++j) {
+      c[j] = scale * (sums[j] - offset) + bias;
+    }
+  } else {
+    const Dtype* scales = args.scales + v;
+    const int32_t* a_sums = args.a_sums + v;
+    for (int j = 0; j < count; ++j) {
+      c[j] = scales[j] * (sums[j] - 128 * a_sums[j]);
+    }
+    if (args.bias) {
+      for (int j = 0; j < count; ++j) {
+        c[j] += args.bias[v + j];
+      }
+    }
+  }
+}
+
+// Stores the count values of c from row p and panel row v on. Whole panels
+// go through loops of constant length, which the compiler vectorizes.
+template <typename Dtype>
+static inline void StoreInt8(const GemmInt8Args<Dtype>& args, int p, int v,
+    int count, const int32_t* sums) {
+  if (count == kInt8PanelRows) {
+    StoreInt8Values(args, p, v, kInt8PanelRows, sums);
+  } else {
+    StoreInt8Values(args, p, v, count, sums);
+  }
+}
+
+// Computes the rows [p_begin, p_end) of c for the kPanels panels from panel
+// row v on, in tiles of Ops::kRows rows.
+template <typename Ops, bool kSignedPanels, int kPanels, typename Dtype>
+static inline void GemmInt8Panels(const GemmInt8Args<Dtype>& args,
+    int p_begin, int p_end, int v) {
+  const int kRows = Ops::kRows;
+  int32_t sums[kRows * kPanels * kInt8PanelRows];
+  const uint8_t* panels = args.panels + v * args.ld;
+  for (int p = p_begin; p < p_end; p += kRows) {
+    const int tile_rows = std::min(kRows, p_end - p);
+    if (tile_rows == kRows) {
+      DotTile<Ops, kSignedPanels, kRows, kPanels>(args.rows + p * args.ld,
+          panels, args.ld, sums);
+    } else {
+      for (int i = 0; i < tile_rows; ++i) {
+        DotTile<Ops, kSignedPanels, 1, kPanels>(
+            args.rows + (p + i) * args.ld, panels, args.ld,
+            sums + i * kPanels * kInt8PanelRows);
+      }
+    }
+    for (int i = 0; i < tile_rows; ++i) {
+      for (int j = 0; j < kPanels; ++j) {
+        const int panel_v = v + j * kInt8PanelRows;
+        StoreInt8(args, p + i, panel_v,
+            std::min(kInt8PanelRows, args.V - panel_v),
+            sums + (i * kPanels + j) * kInt8PanelRows);
+      }
+    }
+  }
+}
+
+// Computes the blocks [begin, end) of c, each of up to block_p x block_v
+// values.
+template <typename Ops, bool kSignedPanels, typename Dtype>
+static void GemmInt8Blocks(const GemmInt8Args<Dtype>& args, int begin,
+    int end) {
+  const int kPanelsRows = Ops::kPanels * kInt8PanelRows;
+  for (int block = begin; block < end; ++block) {
+    const int p_begin = block / args.blocks_v * args.block_p;
+    const int p_end = std::min(p_begin + args.block_p, args.P);
+    const int v_begin = block % args.blocks_v * args.block_v;
+    const int v_end = std::min(v_begin + args.block_v, args.V);
+    int v = v_begin;
+    for (; v + kPanelsRows - kInt8PanelRows < v_end; v += kPanelsRows) {
+      GemmInt8Panels<Ops, kSignedPanels, Ops::kPanels>(args, p_begin, p_end,
+          v);
+    }
+    for (; v < v_end; v += kInt8PanelRows) {
+      GemmInt8Panels<Ops, kSignedPanels, 1>(args, p_begin, p_end, v);
+    }
+  }
+}
+
+template <typename Dtype>
+void caffe_cpu_gemm_int8(const int M, const int N, const int K,
+    const int8_t* a, const int32_t* a_sums, const uint8_t* b,
+    const Dtype* scales, const Dtype* bias, const bool trans_c, Dtype* c) {
+  CHECK_LE(K, kInt8MaxDim) << "The int32 sums would overflow.";
+  typedef SimdDotOps Ops;
+  const uint8_t* a_bytes = reinterpret_cast<const uint8_t*>(a);
+  GemmInt8Args<Dtype> args;
+  args.P = trans_c ? N : M;
+  args.V = trans_c ? M : N;
+  args.ld = caffe_int8_padded_dim(K);
+  args.rows = trans_c ? b : a_bytes;
+  args.panels = trans_c ? a_bytes : b;
+  args.a_sums = a_sums;
+  args.scales = scales;
+  args.bias = bias;
+  args.trans_c = trans_c;
+  args.c = c;
+  // Blocks of both operands that fit in L2 together, by whole tiles.
+  const int block_rows = std::max(1, kGemmBlockBytes / args.ld);
+  const int tile_v = Ops::kPanels * kInt8PanelRows;
+  args.block_p = std::min(args.P, std::max(Ops::kRows,
+      block_rows / Ops::kRows * Ops::kRows));
+  args.block_v = std::min(caffe_int8_panel_rows(args.V), std::max(tile_v,
+      block_rows / tile_v * tile_v));
+  args.blocks_v = (args.V + args.block_v - 1) / args.block_v;
+  const int blocks = (args.P + args.block_p - 1) / args.block_p *
+      args.blocks_v;
+  const double block_macs = static_cast<double>(args.block_p) *
+      args.block_v * args.ld;
+  const int min_blocks = std::max(1,
+      static_cast<int>(kMinMacsPerThread / block_macs));
+  void (*gemm_blocks)(const GemmInt8Args<Dtype>&, int, int) = trans_c ?
+      &GemmInt8Blocks<Ops, true, Dtype> : &GemmInt8Blocks<Ops, false, Dtype>;
+  if (blocks < 2 * min_blocks) {
+    gemm_blocks(args, 0, blocks);
+  } else {
+    ThreadPool::Global().RunRange(blocks, min_blocks,
+        boost::bind(gemm_blocks, boost::cref(args), _1, _2));
+  }
+}
+
+template void caffe_cpu_gemm_int8<float>(const int M, const int N,
+    const int K, const int8_t* a, const int32_t* a_sums, const uint8_t* b,
+    const float* scales, const float* bias, const bool trans_c, float* c);
+template void caffe_cpu_gemm_int8<double>(const int M, const int N,
+    const int K, const int8_t* a, const int32_t* a_sums, const uint8_t* b,
+    const double* scales, const double* bias, const bool trans_c, double* c);
+
+}  // namespace caffe
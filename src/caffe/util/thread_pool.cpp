@@ -0,0 +1,149 @@
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include <algorithm>
+#include <deque>
+#include <exception>
+#include <vector>
+
+#include "caffe/util/thread_pool.hpp"
+
+namespace caffe {
+
+// Calls task on the index-th of num_ranges equal parts of [0, count).
+static void RunRangePart(const boost::function<void(int, int)>* task,
+    int count, int num_ranges, int index) {
+  const int64_t begin = static_cast<int64_t>(count) * index / num_ranges;
+  const int64_t end = static_cast<int64_t>(count) * (index + 1) / num_ranges;
+  (*task)(begin, end);
+}
+
+struct ThreadPool::Job {
+  Job(int num_tasks, const boost::function<void(int)>& task)
+      : task(task), num_tasks(num_tasks), next(0), done(0) {}
+  const boost::function<void(int)>& task;
+  const int num_tasks;
+  // Both counters are guarded by sync::mutex_.
+  int next;
+  int done;
+  boost::condition_variable finished;
+};
+
+class ThreadPool::sync {
+ public:
+  sync() : stop_(false) {}
+  boost::mutex mutex_;
+  boost::condition_variable work_ready_;
+  std::deque<Job*> jobs_;
+  std::vector<shared_ptr<boost::thread> > threads_;
+  bool stop_;
+
+  // Claims the next task of job, removing the job from the queue once all
+  // of its tasks are claimed. Must be called with mutex_ held.
+  int Claim(Job* job) {
+    const int index = job->next++;
+    if (job->next == job->num_tasks) {
+      jobs_.erase(std::find(jobs_.begin(), jobs_.end(), job));
+    }
+    return index;
+  }
+  // Runs task index of job with mutex_ released.
+  void Execute(Job* job, int index, boost::unique_lock<boost::mutex>* lock) {
+    lock->unlock();
+    job->task(index);
+    lock->lock();
+    if (++job->done == job->num_tasks) {
+      job->finished.notify_all();
+    }
+  }
+};
+
+ThreadPool::ThreadPool(int num_threads)
+    : num_threads_(std::max(num_threads, 1)), sync_(new sync()) {
+  try {
+    for (int i = 1; i < num_threads_; ++i) {
+      sync_->threads_.push_back(shared_ptr<boost::thread>(
+          new boost::thread(&ThreadPool::WorkerEntry, this)));
+    }
+  } catch (std::exception& e) {
+    LOG(FATAL) << "Thread exception: " << e.what();
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    boost::lock_guard<boost::mutex> lock(sync_->mutex_);
+    sync_->stop_ = true;
+  }
+  sync_->work_ready_.notify_all();
+  for (int i = 0; i < sync_->threads_.size(); ++i) {
+    sync_->threads_[i]->join();
+  }
+}
+
+void ThreadPool::WorkerEntry() {
+  boost::unique_lock<boost::mutex> lock(sync_->mutex_);
+  while (true) {
+    while (!sync_->stop_ && sync_->jobs_.empty()) {
+      sync_->work_ready_.wait(lock);
+    }
+    if (sync_->stop_) {
+      return;
+    }
+    Job* job = sync_->jobs_.front();
+    sync_->Execute(job, sync_->Claim(job), &lock);
+  }
+}
+
+void ThreadPool::Run(int num_tasks, const boost::function<void(int)>& task) {
+  if (num_tasks <= 0) {
+    return;
+  }
+  if (num_tasks == 1 || num_threads_ == 1) {
+    for (int i = 0; i < num_tasks; ++i) {
+      task(i);
+    }
+    return;
+  }
+  // The job lives on this stack, so an interrupted wait must not leave it
+  // to the workers still running its tasks.
+  boost::this_thread::disable_interruption no_interruption;
+  Job job(num_tasks, task);
+  boost::unique_lock<boost::mutex> lock(sync_->mutex_);
+  sync_->jobs_.push_back(&job);
+  sync_->work_ready_.notify_all();
+  // The calling thread works on its own job until every task is claimed,
+  // then waits for the workers still running the last ones.
+  while (job.next < job.num_tasks) {
+    sync_->Execute(&job, sync_->Claim(&job), &lock);
+  }
+  while (job.done < job.num_tasks) {
+    job.finished.wait(lock);
+  }
+}
+
+void ThreadPool::RunRange(int count, int min_range,
+    const boost::function<void(int, int)>& task) {
+  const int num_ranges = std::min(num_threads_,
+      count / std::max(min_range, 1));
+  if (num_ranges <= 1) {
+    if (count > 0) {
+      task(0, count);
+    }
+    return;
+  }
+  Run(num_ranges, boost::bind(&RunRangePart, &task, count, num_ranges, _1));
+}
+
+ThreadPool& ThreadPool::Global() {
+  static ThreadPool pool(NumThreads(0));
+  return pool;
+}
+
+int ThreadPool::NumThreads(int requested) {
+  if (requested > 0) {
+    return requested;
+  }
+  return std::max<int>(boost::thread::hardware_concurrency(), 1);
+}
+
+}  // namespace caffe
@@ -19,6 +19,7 @@ using caffe::Blob;
 using caffe::Caffe;
 using caffe::Net;
 using caffe::Layer;
+using caffe::NetProfiler;
 using caffe::Solver;
 using caffe::shared_ptr;
 using caffe::string;
@@ -30,6 +31,10 @@ DEFINE_string(gpu, "",
     "Optional; run in GPU mode on given device IDs separated by ','."
     "Use '-gpu all' to run on all available GPUs. The effective training "
     "batch size is multiplied by the number of devices.");
+DEFINE_int32(threads, 1,
+    "Optional; in CPU mode, train on this many threads, each running a "
+    "solver replica on its share of the data. The effective training batch "
+    "size is multiplied by the number of threads.");
 DEFINE_string(solver, "",
     "The solver definition protocol buffer text file.");
 DEFINE_string(model, "",
@@ -48,6 +53,10 @@ DEFINE_string(weights, "",
     "separated by ','. Cannot be set simultaneously with snapshot.");
 DEFINE_int32(iterations, 50,
     "The number of iterations to run.");
+DEFINE_string(profile, "",
+    "Optional; for train and test, record the time, memory traffic, FLOPs "
+    "and allocations of the layers of the nets, log a summary of them at "
+    "the end and write a Chrome trace of their passes to this file.");
 DEFINE_string(sigint_effect, "stop",
              "Optional; action to take when a SIGINT signal is received: "
               "snapshot, stop or none.");
@@ -196,6 +205,8 @@ int train() {
   if (gpus.size() == 0) {
     LOG(INFO) << "Use CPU.";
     Caffe::set_mode(Caffe::CPU);
+    CHECK_GT(FLAGS_threads, 0) << "Need at least one training thread.";
+    Caffe::set_solver_count(FLAGS_threads);
   } else {
     ostringstream s;
     for (int i = 0; i < gpus.size(); ++i) {
@@ -236,6 +247,15 @@ int train() {
     solver->Restore(FLAGS_snapshot.c_str());
   }
 
+  NetProfiler<float> profiler;
+  if (FLAGS_profile.size()) {
+    profiler.Attach(solver->net().get(), "train");
+    for (int i = 0; i < solver->test_nets().size(); ++i) {
+      profiler.Attach(solver->test_nets()[i].get(),
+          "test " + boost::lexical_cast<string>(i));
+    }
+  }
+
   LOG(INFO) << "Starting Optimization";
   if (gpus.size() > 1) {
 #ifdef USE_NCCL
@@ -244,10 +264,18 @@ int train() {
 #else
     LOG(FATAL) << "Multi-GPU execution not available - rebuild with USE_NCCL";
 #endif
+  } else if (gpus.size() == 0 && FLAGS_threads > 1) {
+    caffe::CPUParallel<float> parallel(solver);
+    parallel.Run(FLAGS_threads,
+                 FLAGS_snapshot.size() > 0 ? FLAGS_snapshot.c_str() : NULL);
   } else {
     solver->Solve();
   }
   LOG(INFO) << "Optimization Done.";
+  if (FLAGS_profile.size()) {
+    profiler.LogSummary();
+    profiler.WriteTrace(FLAGS_profile);
+  }
   return 0;
 }
 RegisterBrewFunction(train);
@@ -278,6 +306,10 @@ int test() {
   // Instantiate the caffe net.
   Net<float> caffe_net(FLAGS_model, caffe::TEST, FLAGS_level, &stages);
   caffe_net.CopyTrainedLayersFrom(FLAGS_weights);
+  NetProfiler<float> profiler;
+  if (FLAGS_profile.size()) {
+    profiler.Attach(&caffe_net, "test");
+  }
   LOG(INFO) << "Running for " << FLAGS_iterations << " iterations.";
 
   vector<int> test_score_output_id;
@@ -320,6 +352,10 @@ int test() {
     }
     LOG(INFO) << output_name << " = " << mean_score << loss_msg_stream.str();
   }
+  if (FLAGS_profile.size()) {
+    profiler.LogSummary();
+    profiler.WriteTrace(FLAGS_profile);
+  }
 
   return 0;
 }
@@ -0,0 +1,276 @@
+// This program calibrates a trained net for the INT8 engines: it runs the
+// TEST net over a few batches, records the input range of every Convolution
+// and InnerProduct layer, and writes a copy of the model that runs them with
+// engine INT8 and the recorded ranges. It then runs the float and quantized
+// nets on the same batches and reports their speed and how far the outputs
+// of the quantized net are from the float ones.
+// A deploy net, whose inputs are Input layers, takes its batches from the
+// data layers of the -calibration_model net.
+// Usage:
+//    calibrate_int8 [FLAGS] -model MODEL.prototxt -weights WEIGHTS
+//        -output MODEL_INT8.prototxt [-calibration_model DATA.prototxt]
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "boost/scoped_ptr.hpp"
+
+#include "caffe/caffe.hpp"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/quantization.hpp"
+#include "caffe/util/upgrade_proto.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+using boost::scoped_ptr;
+
+DEFINE_string(model, "",
+    "The model definition protocol buffer text file.");
+DEFINE_string(weights, "",
+    "The trained weights.");
+DEFINE_string(output, "",
+    "Where to write the quantized model definition.");
+DEFINE_string(calibration_model, "",
+    "A net definition whose data layers read the calibration batches, for "
+    "a model with net inputs: each input is copied from the blob of the "
+    "same name of its TEST net.");
+DEFINE_bool(gaussian_inputs, false,
+    "Fill the net inputs with Gaussian noise instead of a calibration model. "
+    "The ranges and errors then say nothing about real data.");
+DEFINE_int32(iterations, 50,
+    "The number of batches to calibrate with, and then to compare the float "
+    "and quantized nets on.");
+
+static bool Quantizable(const string& type) {
+  return type == "Convolution" || type == "InnerProduct";
+}
+
+// Records the largest absolute value of the first bottom of the quantizable
+// layers over the forward passes.
+class RangeRecorder : public Net<float>::Callback {
+ public:
+  explicit RangeRecorder(const Net<float>& net)
+      : net_(net), ranges_(net.layers().size(), 0) {}
+  const vector<float>& ranges() const { return ranges_; }
+
+ protected:
+  virtual void run(int layer) {
+    if (!Quantizable(net_.layers()[layer]->type())) {
+      return;
+    }
+    const Blob<float>* bottom = net_.bottom_vecs()[layer][0];
+    ranges_[layer] = std::max(ranges_[layer],
+        caffe_cpu_absmax(bottom->count(), bottom->cpu_data()));
+  }
+
+  const Net<float>& net_;
+  vector<float> ranges_;
+};
+
+// Returns the index of the first layer with bottoms: the leading layers,
+// which read the data, are only run by the float net.
+static int FirstComputeLayer(const Net<float>& net) {
+  int start = 0;
+  while (start < net.layers().size() && net.bottom_vecs()[start].empty()) {
+    ++start;
+  }
+  CHECK_LT(start, net.layers().size()) << "The net computes nothing.";
+  return start;
+}
+
+// Fills the net inputs with the next batch of the calibration net, or with
+// Gaussian noise without one.
+static void FillInputs(const Net<float>& net, Net<float>* calibration_net) {
+  if (calibration_net) {
+    calibration_net->Forward();
+  }
+  FillerParameter filler_param;
+  GaussianFiller<float> filler(filler_param);
+  for (int i = 0; i < net.input_blobs().size(); ++i) {
+    Blob<float>* input = net.input_blobs()[i];
+    if (!calibration_net) {
+      filler.Fill(input);
+      continue;
+    }
+    const string& name = net.blob_names()[net.input_blob_indices()[i]];
+    CHECK(calibration_net->has_blob(name)) << "The calibration net has no "
+        "blob " << name;
+    input->CopyFrom(*calibration_net->blob_by_name(name), false, true);
+  }
+}
+
+// Copies the net inputs and the tops of the data layers of net to the
+// matching blobs of other.
+static void CopyInputs(const Net<float>& net, int start, Net<float>* other) {
+  for (int i = 0; i < net.input_blobs().size(); ++i) {
+    other->input_blobs()[i]->CopyFrom(*net.input_blobs()[i], false, true);
+  }
+  for (int l = 0; l < start; ++l) {
+    for (int j = 0; j < net.top_vecs()[l].size(); ++j) {
+      other->top_vecs()[l][j]->CopyFrom(*net.top_vecs()[l][j], false, true);
+    }
+  }
+}
+
+// Returns whether blob is the top of one of the data layers.
+static bool IsInput(const Net<float>& net, int start,
+    const Blob<float>* blob) {
+  for (int l = 0; l < start; ++l) {
+    const vector<Blob<float>*>& top = net.top_vecs()[l];
+    if (std::find(top.begin(), top.end(), blob) != top.end()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Returns the index of the largest of the n values of x.
+static int ArgMax(int n, const float* x) {
+  return std::max_element(x, x + n) - x;
+}
+
+int main(int argc, char** argv) {
+  FLAGS_alsologtostderr = 1;  // Print output to stderr (while still logging)
+  ::google::InitGoogleLogging(argv[0]);
+
+#ifndef GFLAGS_GFLAGS_H_
+  namespace gflags = google;
+#endif
+
+  gflags::SetUsageMessage("Calibrate a trained net for the INT8 engines.\n"
+      "Usage:\n"
+      "    calibrate_int8 [FLAGS] -model MODEL.prototxt -weights WEIGHTS\n"
+      "        -output MODEL_INT8.prototxt\n");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  if (FLAGS_model.empty() || FLAGS_weights.empty() || FLAGS_output.empty()) {
+    gflags::ShowUsageWithFlagsRestrict(argv[0], "tools/calibrate_int8");
+    return 1;
+  }
+  CHECK_GT(FLAGS_iterations, 0);
+  Caffe::set_mode(Caffe::CPU);
+
+  // Calibrate.
+  Net<float> net(FLAGS_model, TEST);
+  net.CopyTrainedLayersFrom(FLAGS_weights);
+  scoped_ptr<Net<float> > calibration_net;
+  if (!FLAGS_calibration_model.empty()) {
+    CHECK(!net.input_blobs().empty()) << "The model has no net inputs to "
+        "take from a calibration model; its data layers read the batches.";
+    calibration_net.reset(new Net<float>(FLAGS_calibration_model, TEST));
+  } else if (!net.input_blobs().empty()) {
+    CHECK(FLAGS_gaussian_inputs) << "The model has net inputs: give a "
+        "-calibration_model to read them, or -gaussian_inputs to calibrate "
+        "on noise.";
+    LOG(WARNING) << "Calibrating on Gaussian noise inputs.";
+  }
+  const int start = FirstComputeLayer(net);
+  RangeRecorder recorder(net);
+  net.add_before_forward(&recorder);
+  for (int i = 0; i < FLAGS_iterations; ++i) {
+    FillInputs(net, calibration_net.get());
+    net.Forward();
+  }
+  std::map<string, float> ranges;
+  for (int l = 0; l < net.layers().size(); ++l) {
+    if (Quantizable(net.layers()[l]->type())) {
+      ranges[net.layer_names()[l]] = recorder.ranges()[l];
+      LOG(INFO) << "Layer " << net.layer_names()[l] << ": input range "
+          << recorder.ranges()[l];
+    }
+  }
+  CHECK(!ranges.empty()) << "The net has no Convolution or InnerProduct "
+      "layer to quantize.";
+
+  // Write the quantized model.
+  NetParameter param;
+  ReadNetParamsFromTextFileOrDie(FLAGS_model, &param);
+  for (int l = 0; l < param.layer_size(); ++l) {
+    LayerParameter* layer_param = param.mutable_layer(l);
+    std::map<string, float>::const_iterator range =
+        ranges.find(layer_param->name());
+    if (range == ranges.end() || !Quantizable(layer_param->type())) {
+      continue;
+    }
+    if (layer_param->type() == "Convolution") {
+      layer_param->mutable_convolution_param()->set_engine(
+          ConvolutionParameter_Engine_INT8);
+    } else {
+      layer_param->mutable_inner_product_param()->set_engine(
+          InnerProductParameter_Engine_INT8);
+    }
+    layer_param->mutable_quantization_param()->set_input_range(range->second);
+  }
+  WriteProtoToTextFile(param, FLAGS_output);
+  LOG(INFO) << "Wrote " << ranges.size() << " quantized layers to "
+      << FLAGS_output;
+
+  // Compare the float and quantized nets on the following batches.
+  Net<float> int8_net(FLAGS_output, TEST);
+  int8_net.CopyTrainedLayersFrom(FLAGS_weights);
+  const int num_outputs = net.num_outputs();
+  vector<double> float_sums(num_outputs, 0), int8_sums(num_outputs, 0);
+  vector<double> error_sumsqs(num_outputs, 0), float_sumsqs(num_outputs, 0);
+  vector<int> agreements(num_outputs, 0), items(num_outputs, 0);
+  double float_ms = 0, int8_ms = 0;
+  CPUTimer timer;
+  for (int i = 0; i < FLAGS_iterations; ++i) {
+    FillInputs(net, calibration_net.get());
+    if (start > 0) {
+      net.ForwardTo(start - 1);
+    }
+    timer.Start();
+    net.ForwardFrom(start);
+    float_ms += timer.MilliSeconds();
+    CopyInputs(net, start, &int8_net);
+    timer.Start();
+    int8_net.ForwardFrom(start);
+    int8_ms += timer.MilliSeconds();
+    for (int j = 0; j < num_outputs; ++j) {
+      const Blob<float>& expected = *net.output_blobs()[j];
+      const Blob<float>& actual = *int8_net.output_blobs()[j];
+      if (expected.count() == 1) {
+        float_sums[j] += expected.cpu_data()[0];
+        int8_sums[j] += actual.cpu_data()[0];
+        continue;
+      }
+      for (int k = 0; k < expected.count(); ++k) {
+        const double error = actual.cpu_data()[k] - expected.cpu_data()[k];
+        error_sumsqs[j] += error * error;
+      }
+      float_sumsqs[j] += expected.sumsq_data();
+      const int num = expected.shape(0);
+      const int dim = expected.count() / num;
+      for (int n = 0; n < num; ++n) {
+        agreements[j] += ArgMax(dim, expected.cpu_data() + n * dim) ==
+            ArgMax(dim, actual.cpu_data() + n * dim);
+      }
+      items[j] += num;
+    }
+  }
+
+  LOG(INFO) << "Forward: float " << float_ms / FLAGS_iterations
+      << " ms, int8 (" << caffe_cpu_int8_gemm_isa() << ") "
+      << int8_ms / FLAGS_iterations << " ms (" << float_ms / int8_ms << "x)";
+  for (int j = 0; j < num_outputs; ++j) {
+    const string& name = net.blob_names()[net.output_blob_indices()[j]];
+    if (IsInput(net, start, net.output_blobs()[j])) {
+      continue;
+    }
+    if (net.output_blobs()[j]->count() == 1) {
+      LOG(INFO) << "Output " << name << ": float "
+          << float_sums[j] / FLAGS_iterations << ", int8 "
+          << int8_sums[j] / FLAGS_iterations;
+    } else {
+      LOG(INFO) << "Output " << name << ": relative error "
+          << std::sqrt(error_sumsqs[j] / float_sumsqs[j])
+          << ", top-1 agreement "
+          << static_cast<float>(agreements[j]) / items[j];
+    }
+  }
+  return 0;
+}
@@ -1,16 +1,24 @@
+#ifdef USE_OPENCV
+#include <opencv2/core/core.hpp>
+#endif  // USE_OPENCV
 #include <stdint.h>
 #include <algorithm>
+#include <cmath>
+#include <sstream>
 #include <string>
 #include <utility>
 #include <vector>
 
+#include "boost/bind.hpp"
 #include "boost/scoped_ptr.hpp"
+#include "boost/thread.hpp"
 #include "gflags/gflags.h"
 #include "glog/logging.h"
 
 #include "caffe/proto/caffe.pb.h"
 #include "caffe/util/db.hpp"
 #include "caffe/util/io.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 using namespace caffe;  // NOLINT(build/namespaces)
 
@@ -20,6 +28,176 @@ using boost::scoped_ptr;
 
 DEFINE_string(backend, "lmdb",
         "The backend {leveldb, lmdb} containing the images");
+DEFINE_int32(threads, 0,
+    "The number of threads adding up the records, which one cursor reads; "
+    "0 for all the hardware threads.");
+DEFINE_string(channel_mean_file, "",
+    "Also write the mean of each channel to this file, as a 1-D BlobProto "
+    "that the mean_file of a transform_param accepts in place of a mean "
+    "image. Its diff holds the standard deviations of the channels.");
+DEFINE_int32(histogram_bins, 16,
+    "The number of bins of the histograms of the values of each channel "
+    "over [0, 256).");
+
+#ifdef USE_OPENCV
+// The shape of the records: channels x length x height x width, with a
+// length of 0 for images.
+struct RecordShape {
+  int channels;
+  int length;
+  int height;
+  int width;
+
+  int frames() const { return max(length, 1); }
+  int count() const { return channels * frames() * height * width; }
+};
+
+// The sums over the records a thread has read, in doubles so that tens of
+// millions of them add up exactly.
+struct Stats {
+  Stats(const RecordShape& shape, int bins)
+      : count(0), bins(bins), sum(shape.count()),
+        channel_sum(shape.channels), channel_squares(shape.channels),
+        histogram(shape.channels * bins) {}
+
+  // Adds the value v of channel c at index i of the mean clip.
+  inline void Add(int c, int i, double v) {
+    sum[i] += v;
+    channel_sum[c] += v;
+    channel_squares[c] += v * v;
+    const int bin = static_cast<int>(std::floor(v * bins / 256));
+    ++histogram[c * bins + std::min(std::max(bin, 0), bins - 1)];
+  }
+
+  void Merge(const Stats& other) {
+    count += other.count;
+    for (int i = 0; i < sum.size(); ++i) {
+      sum[i] += other.sum[i];
+    }
+    for (int c = 0; c < channel_sum.size(); ++c) {
+      channel_sum[c] += other.channel_sum[c];
+      channel_squares[c] += other.channel_squares[c];
+    }
+    for (int i = 0; i < histogram.size(); ++i) {
+      histogram[i] += other.histogram[i];
+    }
+  }
+
+  int64_t count;
+  int bins;
+  vector<double> sum;
+  vector<double> channel_sum;
+  vector<double> channel_squares;
+  vector<int64_t> histogram;
+};
+
+// The number of frames of a record, 0 for an image. Encoded clips may only
+// give their frames.
+static int LengthOf(const Datum& datum) {
+  return datum.encoded() && datum.frames_size() ? datum.frames_size() :
+      datum.length();
+}
+
+// The shape of a record, decoding its first frame if it is encoded.
+static RecordShape ShapeOf(const Datum& datum, const char* data,
+    size_t data_size) {
+  RecordShape shape;
+  shape.length = LengthOf(datum);
+  if (datum.encoded()) {
+    const cv::Mat cv_img = datum.frames_size() ?
+        DecodeDatumFrameToCVMatNative(datum, 0) :
+        DecodeBufferToCVMatNative(data, data_size);
+    CHECK(cv_img.data) << "Could not decode the first record";
+    shape.channels = cv_img.channels();
+    shape.height = cv_img.rows;
+    shape.width = cv_img.cols;
+  } else {
+    shape.channels = datum.channels();
+    shape.height = datum.height();
+    shape.width = datum.width();
+  }
+  return shape;
+}
+
+// Adds the values of frame of a decoded record, interleaved by channel.
+static void AddFrame(const cv::Mat& cv_img, const RecordShape& shape,
+    int frame, Stats* stats) {
+  CHECK(cv_img.depth() == CV_8U) << "Image data type must be unsigned byte";
+  CHECK_EQ(cv_img.channels(), shape.channels);
+  CHECK_EQ(cv_img.rows, shape.height);
+  CHECK_EQ(cv_img.cols, shape.width);
+  for (int h = 0; h < shape.height; ++h) {
+    const uint8_t* ptr = cv_img.ptr<uint8_t>(h);
+    for (int w = 0; w < shape.width; ++w) {
+      for (int c = 0; c < shape.channels; ++c, ++ptr) {
+        const int i = ((c * shape.frames() + frame) * shape.height + h) *
+            shape.width + w;
+        stats->Add(c, i, *ptr);
+      }
+    }
+  }
+}
+
+// Adds a record whose data field is at data.
+static void AddRecord(const Datum& datum, const char* data, size_t data_size,
+    const RecordShape& shape, Stats* stats) {
+  CHECK_EQ(LengthOf(datum), shape.length) << "Incorrect clip length";
+  if (datum.encoded()) {
+    if (shape.length) {
+      for (int f = 0; f < shape.length; ++f) {
+        AddFrame(DecodeDatumFrameToCVMatNative(datum, f), shape, f, stats);
+      }
+    } else {
+      AddFrame(DecodeBufferToCVMatNative(data, data_size), shape, 0, stats);
+    }
+  } else {
+    const int size_in_datum = max<int>(data_size, datum.float_data_size());
+    CHECK_EQ(size_in_datum, shape.count()) << "Incorrect data field size " <<
+        size_in_datum;
+    const int channel_count = shape.count() / shape.channels;
+    for (int c = 0; c < shape.channels; ++c) {
+      for (int i = c * channel_count; i < (c + 1) * channel_count; ++i) {
+        stats->Add(c, i, data_size ? static_cast<uint8_t>(data[i]) :
+            datum.float_data(i));
+      }
+    }
+  }
+  ++stats->count;
+}
+
+// The records read and added up together.
+const int kChunkSize = 1000;
+
+// Serialized records, the first being record begin of the DB.
+struct Chunk {
+  int64_t begin;
+  vector<string> values;
+};
+
+// Reads the next records of cursor into chunk, none at the end of the DB.
+static void ReadChunk(db::Cursor* cursor, int64_t begin, Chunk* chunk) {
+  chunk->begin = begin;
+  chunk->values.clear();
+  for (; cursor->valid() && chunk->values.size() < kChunkSize;
+       cursor->Next()) {
+    chunk->values.push_back(cursor->value());
+  }
+}
+
+// Adds the records i % stats->size() == t of chunk into stats[t].
+static void AddChunkShard(const Chunk* chunk, const RecordShape& shape,
+    const vector<shared_ptr<Stats> >* stats, int t) {
+  Datum datum;
+  for (int i = t; i < chunk->values.size(); i += stats->size()) {
+    const string& value = chunk->values[i];
+    const char* data;
+    size_t data_size;
+    CHECK(ParseDatumWithoutData(value.data(), value.size(), &datum, &data,
+        &data_size)) << "Could not parse record " << chunk->begin + i;
+    AddRecord(datum, data, data_size, shape, (*stats)[t].get());
+  }
+}
+#endif  // USE_OPENCV
 
 int main(int argc, char** argv) {
 #ifdef USE_OPENCV
@@ -32,7 +210,8 @@ int main(int argc, char** argv) {
 #endif
 
   gflags::SetUsageMessage("Compute the mean_image of a set of images given by"
-        " a leveldb/lmdb\n"
+        " a leveldb/lmdb, or the mean clip of a set of clips, with the mean,"
+        " standard deviation and histogram of each channel\n"
         "Usage:\n"
         "    compute_image_mean [FLAGS] INPUT_DB [OUTPUT_FILE]\n");
 
@@ -42,81 +221,103 @@ int main(int argc, char** argv) {
     gflags::ShowUsageWithFlagsRestrict(argv[0], "tools/compute_image_mean");
     return 1;
   }
+  CHECK_GT(FLAGS_histogram_bins, 0);
 
   scoped_ptr<db::DB> db(db::GetDB(FLAGS_backend));
   db->Open(argv[1], db::READ);
-  scoped_ptr<db::Cursor> cursor(db->NewCursor());
-
-  BlobProto sum_blob;
-  int count = 0;
-  // load first datum
-  Datum datum;
-  datum.ParseFromString(cursor->value());
 
-  if (DecodeDatumNative(&datum)) {
-    LOG(INFO) << "Decoding Datum";
+  // The shape of the first record is that of all of them.
+  RecordShape shape;
+  {
+    scoped_ptr<db::Cursor> cursor(db->NewCursor());
+    CHECK(cursor->valid()) << "The DB is empty";
+    const string value = cursor->value();
+    Datum datum;
+    const char* data;
+    size_t data_size;
+    CHECK(ParseDatumWithoutData(value.data(), value.size(), &datum, &data,
+        &data_size));
+    if (datum.encoded()) {
+      LOG(INFO) << "Decoding Datum";
+    }
+    shape = ShapeOf(datum, data, data_size);
   }
 
-  sum_blob.set_num(1);
-  sum_blob.set_channels(datum.channels());
-  sum_blob.set_height(datum.height());
-  sum_blob.set_width(datum.width());
-  const int data_size = datum.channels() * datum.height() * datum.width();
-  int size_in_datum = std::max<int>(datum.data().size(),
-                                    datum.float_data_size());
-  for (int i = 0; i < size_in_datum; ++i) {
-    sum_blob.add_data(0.);
+  // A single cursor reads chunk k + 1 while the threads add up chunk k.
+  ThreadPool pool(ThreadPool::NumThreads(FLAGS_threads));
+  LOG(INFO) << "Starting iteration on " << pool.num_threads() << " threads";
+  vector<shared_ptr<Stats> > stats;
+  for (int t = 0; t < pool.num_threads(); ++t) {
+    stats.push_back(shared_ptr<Stats>(
+        new Stats(shape, FLAGS_histogram_bins)));
   }
-  LOG(INFO) << "Starting iteration";
-  while (cursor->valid()) {
-    Datum datum;
-    datum.ParseFromString(cursor->value());
-    DecodeDatumNative(&datum);
-
-    const std::string& data = datum.data();
-    size_in_datum = std::max<int>(datum.data().size(),
-        datum.float_data_size());
-    CHECK_EQ(size_in_datum, data_size) << "Incorrect data field size " <<
-        size_in_datum;
-    if (data.size() != 0) {
-      CHECK_EQ(data.size(), size_in_datum);
-      for (int i = 0; i < size_in_datum; ++i) {
-        sum_blob.set_data(i, sum_blob.data(i) + (uint8_t)data[i]);
-      }
-    } else {
-      CHECK_EQ(datum.float_data_size(), size_in_datum);
-      for (int i = 0; i < size_in_datum; ++i) {
-        sum_blob.set_data(i, sum_blob.data(i) +
-            static_cast<float>(datum.float_data(i)));
-      }
-    }
-    ++count;
-    if (count % 10000 == 0) {
-      LOG(INFO) << "Processed " << count << " files.";
+  scoped_ptr<db::Cursor> cursor(db->NewCursor());
+  Chunk chunks[2];
+  ReadChunk(cursor.get(), 0, &chunks[0]);
+  for (int k = 0; !chunks[k % 2].values.empty(); ++k) {
+    const Chunk& chunk = chunks[k % 2];
+    const int64_t end = chunk.begin + chunk.values.size();
+    boost::thread reader(&ReadChunk, cursor.get(), end, &chunks[(k + 1) % 2]);
+    pool.Run(pool.num_threads(), boost::bind(&AddChunkShard, &chunk, shape,
+        &stats, _1));
+    reader.join();
+    if (end / 10000 != chunk.begin / 10000) {
+      LOG(INFO) << "Processed " << end / 10000 * 10000 << " files.";
     }
-    cursor->Next();
   }
+  for (int t = 1; t < stats.size(); ++t) {
+    stats[0]->Merge(*stats[t]);
+  }
+  const Stats& total = *stats[0];
+  const int64_t count = total.count;
+  LOG(INFO) << "Processed " << count << " files.";
 
-  if (count % 10000 != 0) {
-    LOG(INFO) << "Processed " << count << " files.";
+  BlobProto sum_blob;
+  if (shape.length) {
+    // A 1 x channels x length x height x width mean clip.
+    BlobShape* blob_shape = sum_blob.mutable_shape();
+    blob_shape->add_dim(1);
+    blob_shape->add_dim(shape.channels);
+    blob_shape->add_dim(shape.length);
+    blob_shape->add_dim(shape.height);
+    blob_shape->add_dim(shape.width);
+  } else {
+    sum_blob.set_num(1);
+    sum_blob.set_channels(shape.channels);
+    sum_blob.set_height(shape.height);
+    sum_blob.set_width(shape.width);
   }
-  for (int i = 0; i < sum_blob.data_size(); ++i) {
-    sum_blob.set_data(i, sum_blob.data(i) / count);
+  for (int i = 0; i < total.sum.size(); ++i) {
+    sum_blob.add_data(total.sum[i] / count);
   }
   // Write to disk
   if (argc == 3) {
     LOG(INFO) << "Write to " << argv[2];
     WriteProtoToBinaryFile(sum_blob, argv[2]);
   }
-  const int channels = sum_blob.channels();
-  const int dim = sum_blob.height() * sum_blob.width();
-  std::vector<float> mean_values(channels, 0.0);
+  const int channels = shape.channels;
+  const double dim = static_cast<double>(shape.count() / channels) * count;
+  BlobProto channel_blob;
+  channel_blob.mutable_shape()->add_dim(channels);
   LOG(INFO) << "Number of channels: " << channels;
   for (int c = 0; c < channels; ++c) {
-    for (int i = 0; i < dim; ++i) {
-      mean_values[c] += sum_blob.data(dim * c + i);
+    const double mean = total.channel_sum[c] / dim;
+    const double std = std::sqrt(std::max(
+        total.channel_squares[c] / dim - mean * mean, 0.));
+    channel_blob.add_data(mean);
+    channel_blob.add_diff(std);
+    LOG(INFO) << "mean_value channel [" << c << "]: " << mean;
+    LOG(INFO) << "std channel [" << c << "]: " << std;
+    std::ostringstream histogram;
+    for (int b = 0; b < total.bins; ++b) {
+      histogram << (b ? " " : "")
+          << total.histogram[c * total.bins + b] / dim;
     }
-    LOG(INFO) << "mean_value channel [" << c << "]: " << mean_values[c] / dim;
+    LOG(INFO) << "histogram channel [" << c << "]: " << histogram.str();
+  }
+  if (!FLAGS_channel_mean_file.empty()) {
+    LOG(INFO) << "Write channel means to " << FLAGS_channel_mean_file;
+    WriteProtoToBinaryFile(channel_blob, FLAGS_channel_mean_file);
   }
 #else
   LOG(FATAL) << "This tool requires OpenCV; compile with USE_OPENCV.";
@@ -7,6 +7,13 @@
 // should be a list of files as well as their labels, in the format as
 //   subfolder1/file1.JPEG 7
 //   ....
+//
+// The images are read and resized by -threads threads, while the records
+// read before them are written. With -clip_length L, every L consecutive
+// lines are the frames of a video clip, stored as one record with the label
+// of its first frame. With -shards N, the records are spread over the DBs
+// DB_NAME_0 to DB_NAME_<N-1>, record i going to shard i % N, each written
+// by a thread of its own.
 
 #include <algorithm>
 #include <fstream>  // NOLINT(readability/streams)
@@ -14,15 +21,19 @@
 #include <utility>
 #include <vector>
 
+#include "boost/bind.hpp"
 #include "boost/scoped_ptr.hpp"
+#include "boost/thread.hpp"
 #include "gflags/gflags.h"
 #include "glog/logging.h"
 
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/benchmark.hpp"
 #include "caffe/util/db.hpp"
 #include "caffe/util/format.hpp"
 #include "caffe/util/io.hpp"
 #include "caffe/util/rng.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 using namespace caffe;  // NOLINT(build/namespaces)
 using std::pair;
@@ -42,6 +53,129 @@ DEFINE_bool(encoded, false,
     "When this option is on, the encoded image will be save in datum");
 DEFINE_string(encode_type, "",
     "Optional: What type should we encode the image as ('png','jpg',...).");
+DEFINE_int32(threads, 0,
+    "The number of threads reading the images; 0 for all the hardware "
+    "threads.");
+DEFINE_int32(shards, 1,
+    "The number of DBs the records are spread over, DB_NAME_0 to "
+    "DB_NAME_<shards-1> when more than one.");
+DEFINE_int32(clip_length, 0,
+    "When positive, pack this many consecutive images of the list into "
+    "each record, as the frames of a video clip.");
+
+#ifdef USE_OPENCV
+// The images read and written together, in one transaction per shard: a
+// chunk holds kChunkSize / clip_length clips.
+const int kChunkSize = 1000;
+
+// The records of a chunk, empty if their images could not be read, and
+// the sizes of their data, -1 if encoded.
+struct Chunk {
+  vector<int> indices;
+  vector<string> keys;
+  vector<string> values;
+  vector<int> data_sizes;
+};
+
+// Reads the records of a list of images.
+struct RecordReader {
+  string root_folder;
+  vector<pair<string, int> > lines;
+  // The first line of each record.
+  vector<int> firsts;
+  int clip_length;
+  bool is_color;
+  bool encoded;
+  string encode_type;
+
+  bool Read(int first, Datum* datum) const;
+  void ReadChunkRecord(Chunk* chunk, int i) const;
+};
+
+// Reads the frames lines[first, first + max(clip_length, 1)) into datum:
+// an image if clip_length is 0, a clip otherwise, raw with its values
+// ordered by channel then frame, or with each frame encoded.
+bool RecordReader::Read(int first, Datum* datum) const {
+  const int resize_height = std::max<int>(0, FLAGS_resize_height);
+  const int resize_width = std::max<int>(0, FLAGS_resize_width);
+  Datum frame;
+  for (int t = 0; t < std::max(clip_length, 1); ++t) {
+    const string& fn = lines[first + t].first;
+    string enc = encode_type;
+    if (encoded && !enc.size()) {
+      // Guess the encoding type from the file name
+      size_t p = fn.rfind('.');
+      if ( p == fn.npos )
+        LOG(WARNING) << "Failed to guess the encoding of '" << fn << "'";
+      enc = fn.substr(p+1);
+      std::transform(enc.begin(), enc.end(), enc.begin(), ::tolower);
+    }
+    if (!ReadImageToDatum(root_folder + fn, lines[first].second,
+        resize_height, resize_width, is_color, enc,
+        clip_length ? &frame : datum)) {
+      return false;
+    }
+    if (!clip_length) {
+      return true;
+    }
+    if (t == 0) {
+      datum->Clear();
+      datum->set_label(lines[first].second);
+      datum->set_length(clip_length);
+      datum->set_encoded(frame.encoded());
+      if (!frame.encoded()) {
+        datum->set_channels(frame.channels());
+        datum->set_height(frame.height());
+        datum->set_width(frame.width());
+        datum->mutable_data()->resize(frame.data().size() * clip_length);
+      }
+    }
+    if (frame.encoded()) {
+      datum->add_frames(frame.data());
+      continue;
+    }
+    CHECK(frame.channels() == datum->channels() &&
+        frame.height() == datum->height() && frame.width() == datum->width())
+        << "The frames of a clip must have the same size: " << fn;
+    // Frame t of each channel.
+    const int plane = frame.height() * frame.width();
+    for (int c = 0; c < frame.channels(); ++c) {
+      std::copy(frame.data().begin() + c * plane,
+          frame.data().begin() + (c + 1) * plane,
+          datum->mutable_data()->begin() + (c * clip_length + t) * plane);
+    }
+  }
+  return true;
+}
+
+// Reads record i of chunk, leaving its value empty if it fails.
+void RecordReader::ReadChunkRecord(Chunk* chunk, int i) const {
+  const int index = chunk->indices[i];
+  const int first = firsts[index];
+  Datum datum;
+  chunk->values[i].clear();
+  if (!Read(first, &datum)) {
+    return;
+  }
+  // sequential
+  chunk->keys[i] = caffe::format_int(index, 8) + "_" + lines[first].first;
+  chunk->data_sizes[i] = datum.encoded() ? -1 : datum.data().size();
+  CHECK(datum.SerializeToString(&chunk->values[i]));
+}
+
+// Writes the records of chunk that belong to shard to db.
+static void WriteShard(db::DB* db, const Chunk* chunk, int shard,
+    int num_shards) {
+  scoped_ptr<db::Transaction> txn(db->NewTransaction());
+  for (int i = 0; i < chunk->indices.size(); ++i) {
+    if (chunk->indices[i] % num_shards == shard &&
+        !chunk->values[i].empty()) {
+      txn->Put(chunk->keys[i], chunk->values[i]);
+    }
+  }
+  txn->Commit();
+}
+#endif  // USE_OPENCV
 
 int main(int argc, char** argv) {
 #ifdef USE_OPENCV
@@ -65,93 +199,132 @@ int main(int argc, char** argv) {
     gflags::ShowUsageWithFlagsRestrict(argv[0], "tools/convert_imageset");
     return 1;
   }
+  CHECK_GT(FLAGS_shards, 0);
+  CHECK_GE(FLAGS_clip_length, 0);
 
-  const bool is_color = !FLAGS_gray;
+  RecordReader reader;
+  reader.root_folder = argv[1];
+  reader.clip_length = FLAGS_clip_length;
+  reader.is_color = !FLAGS_gray;
+  reader.encoded = FLAGS_encoded;
+  reader.encode_type = FLAGS_encode_type;
   const bool check_size = FLAGS_check_size;
-  const bool encoded = FLAGS_encoded;
-  const string encode_type = FLAGS_encode_type;
 
   std::ifstream infile(argv[2]);
-  std::vector<std::pair<std::string, int> > lines;
   std::string line;
   size_t pos;
   int label;
   while (std::getline(infile, line)) {
     pos = line.find_last_of(' ');
     label = atoi(line.substr(pos + 1).c_str());
-    lines.push_back(std::make_pair(line.substr(0, pos), label));
+    reader.lines.push_back(std::make_pair(line.substr(0, pos), label));
   }
+  const int num_lines = reader.lines.size();
+  const int frames = std::max(reader.clip_length, 1);
+  if (num_lines % frames) {
+    LOG(WARNING) << "Ignoring the last " << num_lines % frames
+        << " images, short of a clip.";
+  }
+  for (int first = 0; first + frames <= num_lines; first += frames) {
+    reader.firsts.push_back(first);
+  }
+  const int num_records = reader.firsts.size();
   if (FLAGS_shuffle) {
-    // randomly shuffle data
+    // randomly shuffle data, keeping the frames of clips together
     LOG(INFO) << "Shuffling data";
-    shuffle(lines.begin(), lines.end());
+    shuffle(reader.firsts.begin(), reader.firsts.end());
+  }
+  if (reader.clip_length) {
+    LOG(INFO) << "A total of " << num_records << " clips of "
+        << reader.clip_length << " images.";
+  } else {
+    LOG(INFO) << "A total of " << num_lines << " images.";
   }
-  LOG(INFO) << "A total of " << lines.size() << " images.";
 
-  if (encode_type.size() && !encoded)
+  if (reader.encode_type.size() && !reader.encoded)
     LOG(INFO) << "encode_type specified, assuming encoded=true.";
 
-  int resize_height = std::max<int>(0, FLAGS_resize_height);
-  int resize_width = std::max<int>(0, FLAGS_resize_width);
-
-  // Create new DB
-  scoped_ptr<db::DB> db(db::GetDB(FLAGS_backend));
-  db->Open(argv[3], db::NEW);
-  scoped_ptr<db::Transaction> txn(db->NewTransaction());
+  // Create new DBs
+  vector<shared_ptr<db::DB> > dbs;
+  for (int s = 0; s < FLAGS_shards; ++s) {
+    dbs.push_back(shared_ptr<db::DB>(db::GetDB(FLAGS_backend)));
+    dbs[s]->Open(FLAGS_shards == 1 ? string(argv[3]) :
+        string(argv[3]) + "_" + caffe::format_int(s), db::NEW);
+  }
 
-  // Storing to db
-  std::string root_folder(argv[1]);
-  Datum datum;
+  // Storing to db: chunk k is read while chunk k - 1 is written.
+  const int chunk_size = std::max(kChunkSize / frames, 1);
+  const char* unit = reader.clip_length ? "clips" : "files";
+  ThreadPool pool(ThreadPool::NumThreads(FLAGS_threads));
+  LOG(INFO) << "Reading on " << pool.num_threads() << " threads, writing to "
+      << FLAGS_shards << " DBs";
+  Chunk chunks[2];
+  vector<shared_ptr<boost::thread> > writers;
   int count = 0;
+  double bytes = 0;
   int data_size = 0;
   bool data_size_initialized = false;
-
-  for (int line_id = 0; line_id < lines.size(); ++line_id) {
-    bool status;
-    std::string enc = encode_type;
-    if (encoded && !enc.size()) {
-      // Guess the encoding type from the file name
-      string fn = lines[line_id].first;
-      size_t p = fn.rfind('.');
-      if ( p == fn.npos )
-        LOG(WARNING) << "Failed to guess the encoding of '" << fn << "'";
-      enc = fn.substr(p+1);
-      std::transform(enc.begin(), enc.end(), enc.begin(), ::tolower);
+  CPUTimer timer;
+  timer.Start();
+  for (int begin = 0; begin < num_records; begin += chunk_size) {
+    Chunk& chunk = chunks[begin / chunk_size % 2];
+    const int size = std::min(chunk_size, num_records - begin);
+    chunk.indices.resize(size);
+    chunk.keys.resize(size);
+    chunk.values.resize(size);
+    chunk.data_sizes.resize(size);
+    for (int i = 0; i < size; ++i) {
+      chunk.indices[i] = begin + i;
     }
-    status = ReadImageToDatum(root_folder + lines[line_id].first,
-        lines[line_id].second, resize_height, resize_width, is_color,
-        enc, &datum);
-    if (status == false) continue;
-    if (check_size) {
-      if (!data_size_initialized) {
-        data_size = datum.channels() * datum.height() * datum.width();
-        data_size_initialized = true;
-      } else {
-        const std::string& data = datum.data();
-        CHECK_EQ(data.size(), data_size) << "Incorrect data field size "
-            << data.size();
+    pool.Run(size, boost::bind(&RecordReader::ReadChunkRecord, &reader,
+        &chunk, _1));
+    int read = 0;
+    double read_bytes = 0;
+    for (int i = 0; i < size; ++i) {
+      if (chunk.values[i].empty()) {
+        continue;
+      }
+      if (check_size && chunk.data_sizes[i] >= 0) {
+        if (!data_size_initialized) {
+          data_size = chunk.data_sizes[i];
+          data_size_initialized = true;
+        } else {
+          CHECK_EQ(chunk.data_sizes[i], data_size)
+              << "Incorrect data field size " << chunk.data_sizes[i];
+        }
       }
+      ++read;
+      read_bytes += chunk.values[i].size();
     }
-    // sequential
-    string key_str = caffe::format_int(line_id, 8) + "_" + lines[line_id].first;
-
-    // Put in db
-    string out;
-    CHECK(datum.SerializeToString(&out));
-    txn->Put(key_str, out);
-
-    if (++count % 1000 == 0) {
-      // Commit db
-      txn->Commit();
-      txn.reset(db->NewTransaction());
-      LOG(INFO) << "Processed " << count << " files.";
+    // The previous chunk is written.
+    for (int s = 0; s < writers.size(); ++s) {
+      writers[s]->join();
     }
+    writers.clear();
+    if (count) {
+      const double seconds = timer.MilliSeconds() / 1000;
+      LOG(INFO) << "Processed " << count << " " << unit << ", "
+          << count / seconds << " " << unit << "/s, "
+          << bytes / seconds / 1e6 << " MB/s.";
+    }
+    for (int s = 0; s < FLAGS_shards; ++s) {
+      writers.push_back(shared_ptr<boost::thread>(new boost::thread(
+          &WriteShard, dbs[s].get(), &chunk, s, FLAGS_shards)));
+    }
+    count += read;
+    bytes += read_bytes;
   }
   // write the last batch
-  if (count % 1000 != 0) {
-    txn->Commit();
-    LOG(INFO) << "Processed " << count << " files.";
+  for (int s = 0; s < writers.size(); ++s) {
+    writers[s]->join();
+  }
+  for (int s = 0; s < FLAGS_shards; ++s) {
+    dbs[s]->Close();
   }
+  const double seconds = timer.MilliSeconds() / 1000;
+  LOG(INFO) << "Processed " << count << " " << unit << " in " << seconds
+      << " s, " << count / seconds << " " << unit << "/s, "
+      << bytes / seconds / 1e6 << " MB/s.";
 #else
   LOG(FATAL) << "This tool requires OpenCV; compile with USE_OPENCV.";
 #endif  // USE_OPENCV
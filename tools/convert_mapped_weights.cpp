@@ -0,0 +1,105 @@
+// This program converts trained weights, a binary NetParameter (.caffemodel)
+// or a Net HDF5 file (.h5), to the mapped weights format, which
+// Net::CopyTrainedLayersFrom maps into memory instead of reading.
+// Usage:
+//    convert_mapped_weights weights_in weights_out
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "hdf5.h"
+
+#include "caffe/caffe.hpp"
+#include "caffe/util/hdf5.hpp"
+#include "caffe/util/mapped_weights.hpp"
+#include "caffe/util/upgrade_proto.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+
+// Writes the params of a binary NetParameter, in the type they are saved in.
+static int ConvertBinaryProto(const string& filename,
+    MappedWeightsWriter* writer) {
+  NetParameter param;
+  ReadNetParamsFromBinaryFileOrDie(filename, &param);
+  int num_params = 0;
+  for (int i = 0; i < param.layer_size(); ++i) {
+    const LayerParameter& layer = param.layer(i);
+    for (int j = 0; j < layer.blobs_size(); ++j) {
+      const BlobProto& proto = layer.blobs(j);
+      vector<int> shape;
+      if (proto.has_num() || proto.has_channels() ||
+          proto.has_height() || proto.has_width()) {
+        // Using deprecated 4D Blob dimensions.
+        shape.push_back(proto.num());
+        shape.push_back(proto.channels());
+        shape.push_back(proto.height());
+        shape.push_back(proto.width());
+      } else {
+        shape.assign(proto.shape().dim().begin(), proto.shape().dim().end());
+      }
+      int count = 1;
+      for (int k = 0; k < shape.size(); ++k) {
+        count *= shape[k];
+      }
+      const int data_size = proto.double_data_size() > 0 ?
+          proto.double_data_size() : proto.data_size();
+      CHECK_EQ(count, data_size) << "Incorrect data size of param " << j
+          << " of layer " << layer.name();
+      if (proto.double_data_size() > 0) {
+        writer->Add(layer.name(), j, shape, proto.double_data().data());
+      } else {
+        writer->Add(layer.name(), j, shape, proto.data().data());
+      }
+      ++num_params;
+    }
+  }
+  return num_params;
+}
+
+// Writes the params of a Net HDF5 file as float.
+static int ConvertHDF5(const string& filename, MappedWeightsWriter* writer) {
+  hid_t file_hid = H5Fopen(filename.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+  CHECK_GE(file_hid, 0) << "Couldn't open " << filename;
+  hid_t data_hid = H5Gopen2(file_hid, "data", H5P_DEFAULT);
+  CHECK_GE(data_hid, 0) << "Error reading weights from " << filename;
+  int num_params = 0;
+  const int num_layers = hdf5_get_num_links(data_hid);
+  for (int i = 0; i < num_layers; ++i) {
+    const string layer_name = hdf5_get_name_by_idx(data_hid, i);
+    hid_t layer_hid = H5Gopen2(data_hid, layer_name.c_str(), H5P_DEFAULT);
+    CHECK_GE(layer_hid, 0) << "Error reading weights from " << filename;
+    const int num_layer_params = hdf5_get_num_links(layer_hid);
+    for (int j = 0; j < num_layer_params; ++j) {
+      // Params are named by their index, and those shared are left out.
+      const string dataset_name = hdf5_get_name_by_idx(layer_hid, j);
+      Blob<float> blob;
+      hdf5_load_nd_dataset(layer_hid, dataset_name.c_str(), 0, kMaxBlobAxes,
+          &blob, true);
+      writer->Add(layer_name, atoi(dataset_name.c_str()), blob);
+      ++num_params;
+    }
+    H5Gclose(layer_hid);
+  }
+  H5Gclose(data_hid);
+  H5Fclose(file_hid);
+  return num_params;
+}
+
+int main(int argc, char** argv) {
+  FLAGS_alsologtostderr = 1;  // Print output to stderr (while still logging)
+  ::google::InitGoogleLogging(argv[0]);
+  if (argc != 3) {
+    LOG(ERROR) << "Usage: "
+        << "convert_mapped_weights weights_in weights_out";
+    return 1;
+  }
+  const string input_filename(argv[1]);
+  MappedWeightsWriter writer(argv[2]);
+  const int num_params = H5Fis_hdf5(input_filename.c_str()) > 0 ?
+      ConvertHDF5(input_filename, &writer) :
+      ConvertBinaryProto(input_filename, &writer);
+  writer.Close();
+  LOG(INFO) << "Wrote " << num_params << " params to " << argv[2];
+  return 0;
+}
@@ -0,0 +1,116 @@
+// This program serves a net with an InferenceEngine and drives it with
+// concurrent clients, reporting the latency of their requests and the
+// throughput and batching of the engine.
+// Usage:
+//    inference_load [FLAGS] -model MODEL.prototxt [-weights WEIGHTS]
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "boost/thread.hpp"
+#include "caffe/caffe.hpp"
+#include "caffe/util/benchmark.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+
+DEFINE_string(model, "",
+    "The model definition protocol buffer text file; its input blob gives "
+    "the shape of an item.");
+DEFINE_string(weights, "",
+    "Optional; the trained weights to serve.");
+DEFINE_int32(contexts, 2,
+    "The number of execution contexts of the engine.");
+DEFINE_int32(max_batch, 16,
+    "The largest batch, in items, run by a context.");
+DEFINE_int32(max_delay_us, 1000,
+    "How long, in microseconds, a request may wait for others to batch with.");
+DEFINE_int32(clients, 8,
+    "The number of client threads.");
+DEFINE_int32(requests, 100,
+    "The number of requests sent by each client.");
+DEFINE_int32(items, 1,
+    "The number of items in a request.");
+
+// Sends FLAGS_requests requests one after the other, timing each.
+static void Client(InferenceEngine<float>* engine, const vector<int>& shape,
+    vector<float>* latencies_ms) {
+  Blob<float> input(shape);
+  FillerParameter filler_param;
+  GaussianFiller<float> filler(filler_param);
+  filler.Fill(&input);
+  vector<shared_ptr<Blob<float> > > outputs;
+  CPUTimer timer;
+  for (int i = 0; i < FLAGS_requests; ++i) {
+    timer.Start();
+    engine->Infer(input, &outputs);
+    latencies_ms->push_back(timer.MicroSeconds() / 1000);
+  }
+}
+
+int main(int argc, char** argv) {
+  FLAGS_alsologtostderr = 1;  // Print output to stderr (while still logging)
+  ::google::InitGoogleLogging(argv[0]);
+
+#ifndef GFLAGS_GFLAGS_H_
+  namespace gflags = google;
+#endif
+
+  gflags::SetUsageMessage("Measure the latency and throughput of a net served\n"
+      "with dynamic batching.\n"
+      "Usage:\n"
+      "    inference_load [FLAGS] -model MODEL.prototxt\n");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  if (FLAGS_model.empty()) {
+    gflags::ShowUsageWithFlagsRestrict(argv[0], "tools/inference_load");
+    return 1;
+  }
+  CHECK_GT(FLAGS_clients, 0);
+  CHECK_GT(FLAGS_requests, 0);
+  CHECK_GT(FLAGS_items, 0);
+
+  Caffe::set_mode(Caffe::CPU);
+  NetParameter param;
+  ReadNetParamsFromTextFileOrDie(FLAGS_model, &param);
+  param.mutable_state()->set_phase(TEST);
+  InferenceEngine<float> engine(param, FLAGS_weights, FLAGS_contexts,
+      FLAGS_max_batch, FLAGS_max_delay_us);
+  vector<int> shape = engine.net().input_blobs()[0]->shape();
+  shape[0] = FLAGS_items;
+
+  vector<vector<float> > latencies_ms(FLAGS_clients);
+  vector<shared_ptr<boost::thread> > clients;
+  CPUTimer timer;
+  timer.Start();
+  for (int c = 0; c < FLAGS_clients; ++c) {
+    clients.push_back(shared_ptr<boost::thread>(new boost::thread(
+        &Client, &engine, shape, &latencies_ms[c])));
+  }
+  for (int c = 0; c < FLAGS_clients; ++c) {
+    clients[c]->join();
+  }
+  const float elapsed_ms = timer.MicroSeconds() / 1000;
+
+  vector<float> latencies;
+  for (int c = 0; c < FLAGS_clients; ++c) {
+    latencies.insert(latencies.end(), latencies_ms[c].begin(),
+        latencies_ms[c].end());
+  }
+  std::sort(latencies.begin(), latencies.end());
+  const int p50 = latencies.size() / 2;
+  const int p99 = std::min<int>(latencies.size() * 99 / 100,
+      latencies.size() - 1);
+  LOG(INFO) << "Requests: " << latencies.size() << " of " << FLAGS_items
+      << " items from " << FLAGS_clients << " clients";
+  LOG(INFO) << "Latency: p50 " << latencies[p50] << " ms, p99 "
+      << latencies[p99] << " ms, max " << latencies.back() << " ms";
+  LOG(INFO) << "Throughput: " << engine.num_items() / elapsed_ms * 1000
+      << " items/s";
+  LOG(INFO) << "Batches: " << engine.num_batches() << ", average size "
+      << static_cast<float>(engine.num_items()) / engine.num_batches()
+      << " items";
+  return 0;
+}
@@ -0,0 +1,606 @@
+// This program runs parameterized micro-benchmarks of the CPU kernels that
+// dominate 3-D convolutional nets: caffe_cpu_gemm on the products of the
+// C3D convolutions, im2col_nd_cpu and col2im_nd_cpu on their inputs, the
+// pooling layers, caffe_copy and caffe_axpy, and the DataTransformer paths.
+// The results are written as JSON in the format of Google Benchmark, so that
+// runs on different commits can be compared with its tools/compare.py.
+// Usage:
+//    micro_benchmarks [-filter SUBSTRING] [-min_time SECONDS]
+//        [-repetitions N] [-output FILE] [-label TEXT]
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <ctime>
+#include <fstream>  // NOLINT(readability/streams)
+#include <iomanip>
+#include <iostream>  // NOLINT(readability/streams)
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "boost/date_time/posix_time/posix_time.hpp"
+#include "boost/thread.hpp"
+#include "caffe/caffe.hpp"
+#include "caffe/data_transformer.hpp"
+#include "caffe/layers/pooling_layer.hpp"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/im2col.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+
+DEFINE_string(filter, "",
+    "Only run the benchmarks whose name contains this.");
+DEFINE_double(min_time, 0.5,
+    "The minimum number of seconds timed for each benchmark.");
+DEFINE_int32(repetitions, 1,
+    "The number of times each benchmark is timed; with more than one, "
+    "their mean, median and standard deviation are reported too.");
+DEFINE_string(output, "",
+    "The file to write the JSON results to, instead of stdout.");
+DEFINE_string(label, "",
+    "A label for the run in the JSON context, e.g. the commit benchmarked.");
+
+// A micro-benchmark. It only keeps its parameters until SetUp(), which
+// allocates and fills its data; Run() is one timed iteration, which
+// processes items() items (FLOPs or values) and moves bytes() bytes.
+class MicroBenchmark {
+ public:
+  explicit MicroBenchmark(const string& name)
+      : name_(name), items_(0), bytes_(0) {}
+  virtual ~MicroBenchmark() {}
+
+  const string& name() const { return name_; }
+  double items() const { return items_; }
+  double bytes() const { return bytes_; }
+
+  virtual void SetUp() = 0;
+  virtual void Run() = 0;
+
+ protected:
+  string name_;
+  double items_;
+  double bytes_;
+};
+
+static void Fill(Blob<float>* blob) {
+  FillerParameter filler_param;
+  filler_param.set_min(-1);
+  UniformFiller<float> filler(filler_param);
+  filler.Fill(blob);
+}
+
+// A convolution of C3D on one 16 x 112 x 112 clip, with 3 x 3 x 3 kernels,
+// a padding of 1 and strides of 1.
+struct ConvShape {
+  const char* name;
+  int channels;
+  int num_output;
+  int depth;
+  int size;
+};
+
+static const ConvShape kC3DConvs[] = {
+  {"c3d_conv1a", 3, 64, 16, 112},
+  {"c3d_conv2a", 64, 128, 16, 56},
+  {"c3d_conv3a", 128, 256, 8, 28},
+  {"c3d_conv4a", 256, 512, 4, 14},
+  {"c3d_conv5a", 512, 512, 2, 7},
+};
+
+static string ShapeName(const vector<int>& shape) {
+  std::ostringstream name;
+  for (int i = 0; i < shape.size(); ++i) {
+    name << (i ? "x" : "") << shape[i];
+  }
+  return name.str();
+}
+
+// C = A * B of M x K by K x N matrices, either of them transposed.
+class GemmBenchmark : public MicroBenchmark {
+ public:
+  GemmBenchmark(const string& layer, const string& pass,
+      CBLAS_TRANSPOSE trans_a, CBLAS_TRANSPOSE trans_b, int M, int N, int K)
+      : MicroBenchmark(""), trans_a_(trans_a), trans_b_(trans_b),
+        M_(M), N_(N), K_(K) {
+    std::ostringstream name;
+    name << "gemm/" << layer << "/" << pass << "/M:" << M << "/N:" << N
+        << "/K:" << K;
+    name_ = name.str();
+    items_ = 2. * M * N * K;
+    bytes_ = (1. * M * K + 1. * K * N + 1. * M * N) * sizeof(float);
+  }
+  virtual void SetUp() {
+    a_.Reshape(vector<int>(1, M_ * K_));
+    b_.Reshape(vector<int>(1, K_ * N_));
+    c_.Reshape(vector<int>(1, M_ * N_));
+    Fill(&a_);
+    Fill(&b_);
+  }
+  virtual void Run() {
+    caffe_cpu_gemm<float>(trans_a_, trans_b_, M_, N_, K_, 1., a_.cpu_data(),
+        b_.cpu_data(), 0., c_.mutable_cpu_data());
+  }
+
+ private:
+  CBLAS_TRANSPOSE trans_a_, trans_b_;
+  int M_, N_, K_;
+  Blob<float> a_, b_, c_;
+};
+
+// im2col_nd_cpu, or col2im_nd_cpu, of the input of a convolution.
+class Im2colBenchmark : public MicroBenchmark {
+ public:
+  Im2colBenchmark(const ConvShape& conv, bool col2im)
+      : MicroBenchmark(""), col2im_(col2im) {
+    im_shape_.push_back(conv.channels);
+    im_shape_.push_back(conv.depth);
+    im_shape_.push_back(conv.size);
+    im_shape_.push_back(conv.size);
+    col_shape_ = im_shape_;
+    col_shape_[0] *= 27;
+    name_ = string(col2im ? "col2im_nd" : "im2col_nd") + "/" + conv.name +
+        "/" + ShapeName(im_shape_);
+    const double col_count = 27. * conv.channels * conv.depth * conv.size *
+        conv.size;
+    items_ = col_count;
+    bytes_ = (col_count + col_count / 27) * sizeof(float);
+  }
+  virtual void SetUp() {
+    im_.Reshape(im_shape_);
+    col_.Reshape(col_shape_);
+    Fill(col2im_ ? &col_ : &im_);
+  }
+  virtual void Run() {
+    const int kernel[] = {3, 3, 3}, pad[] = {1, 1, 1}, stride[] = {1, 1, 1},
+        dilation[] = {1, 1, 1};
+    if (col2im_) {
+      col2im_nd_cpu(col_.cpu_data(), 3, &im_shape_[0], &col_shape_[0], kernel,
+          pad, stride, dilation, im_.mutable_cpu_data());
+    } else {
+      im2col_nd_cpu(im_.cpu_data(), 3, &im_shape_[0], &col_shape_[0], kernel,
+          pad, stride, dilation, col_.mutable_cpu_data());
+    }
+  }
+
+ private:
+  bool col2im_;
+  vector<int> im_shape_, col_shape_;
+  Blob<float> im_, col_;
+};
+
+// The forward or backward pass of a PoolingLayer.
+class PoolingBenchmark : public MicroBenchmark {
+ public:
+  PoolingBenchmark(const string& layer, const vector<int>& shape,
+      const vector<int>& kernel, const vector<int>& stride,
+      PoolingParameter_PoolMethod method, bool backward)
+      : MicroBenchmark(""), shape_(shape), backward_(backward) {
+    PoolingParameter* pool_param = layer_param_.mutable_pooling_param();
+    pool_param->set_pool(method);
+    for (int i = 0; i < kernel.size(); ++i) {
+      pool_param->add_kernel_size(kernel[i]);
+      pool_param->add_stride(stride[i]);
+    }
+    name_ = string("pooling/") + layer + "/" +
+        (method == PoolingParameter_PoolMethod_MAX ? "max" : "ave") + "/" +
+        (backward ? "backward" : "forward") + "/" + ShapeName(shape);
+  }
+  virtual void SetUp() {
+    bottom_.Reshape(shape_);
+    Fill(&bottom_);
+    bottom_vec_.assign(1, &bottom_);
+    top_vec_.assign(1, &top_);
+    layer_.reset(new PoolingLayer<float>(layer_param_));
+    layer_->SetUp(bottom_vec_, top_vec_);
+    if (backward_) {
+      layer_->Forward(bottom_vec_, top_vec_);
+      caffe_rng_uniform<float>(top_.count(), -1, 1, top_.mutable_cpu_diff());
+    }
+    items_ = bottom_.count();
+    bytes_ = (bottom_.count() + top_.count()) * sizeof(float);
+  }
+  virtual void Run() {
+    if (backward_) {
+      layer_->Backward(top_vec_, vector<bool>(1, true), bottom_vec_);
+    } else {
+      layer_->Forward(bottom_vec_, top_vec_);
+    }
+  }
+
+ private:
+  LayerParameter layer_param_;
+  vector<int> shape_;
+  bool backward_;
+  Blob<float> bottom_, top_;
+  vector<Blob<float>*> bottom_vec_, top_vec_;
+  shared_ptr<PoolingLayer<float> > layer_;
+};
+
+// caffe_copy or caffe_axpy of n values.
+class VectorBenchmark : public MicroBenchmark {
+ public:
+  VectorBenchmark(bool axpy, int n) : MicroBenchmark(""), axpy_(axpy), n_(n) {
+    std::ostringstream name;
+    name << (axpy ? "axpy" : "copy") << "/n:" << n;
+    name_ = name.str();
+    items_ = n;
+    bytes_ = (axpy ? 3. : 2.) * n * sizeof(float);
+  }
+  virtual void SetUp() {
+    x_.Reshape(vector<int>(1, n_));
+    y_.Reshape(vector<int>(1, n_));
+    Fill(&x_);
+    Fill(&y_);
+  }
+  virtual void Run() {
+    if (axpy_) {
+      caffe_axpy<float>(n_, 0.5, x_.cpu_data(), y_.mutable_cpu_data());
+    } else {
+      caffe_copy(n_, x_.cpu_data(), y_.mutable_cpu_data());
+    }
+  }
+
+ private:
+  bool axpy_;
+  int n_;
+  Blob<float> x_, y_;
+};
+
+// DataTransformer::Transform, training-time, of a batch of a blob or of a
+// Datum of bytes, either an image or a clip (length > 0), with a random crop,
+// mirroring and mean values.
+class TransformBenchmark : public MicroBenchmark {
+ public:
+  TransformBenchmark(const string& source, int num, int channels, int length,
+      int size, int crop_size, int crop_length)
+      : MicroBenchmark(""), source_(source), num_(num), channels_(channels),
+        length_(length), size_(size) {
+    param_.set_crop_size(crop_size);
+    param_.set_crop_length(crop_length);
+    param_.set_mirror(true);
+    param_.set_scale(1. / 255);
+    for (int c = 0; c < channels; ++c) {
+      param_.add_mean_value(100 + c);
+    }
+    vector<int> shape(1, num);
+    shape.push_back(channels);
+    if (length) {
+      shape.push_back(length);
+    }
+    shape.push_back(size);
+    shape.push_back(size);
+    name_ = "transform/" + source + "/" + ShapeName(shape);
+    const double frames = std::max(crop_length ? crop_length : length, 1);
+    items_ = 1. * num * channels * frames * crop_size * crop_size;
+    bytes_ = items_ * sizeof(float) + 1. * num * channels *
+        std::max(length, 1) * size * size *
+        (source == "blob" ? sizeof(float) : 1);
+  }
+  virtual void SetUp() {
+    transformer_.reset(new DataTransformer<float>(param_, TRAIN));
+    transformer_->InitRand();
+    if (source_ == "blob") {
+      input_.Reshape(num_, channels_, size_, size_);
+      caffe_rng_uniform<float>(input_.count(), 0, 255,
+          input_.mutable_cpu_data());
+      return;
+    }
+    datum_.set_channels(channels_);
+    datum_.set_height(size_);
+    datum_.set_width(size_);
+    datum_.set_length(length_);
+    string data(channels_ * std::max(length_, 1) * size_ * size_, 0);
+    for (int i = 0; i < data.size(); ++i) {
+      data[i] = static_cast<char>(i * 7919 % 251);
+    }
+    datum_.set_data(data);
+    output_.Reshape(transformer_->InferBlobShape(datum_));
+  }
+  virtual void Run() {
+    if (source_ == "blob") {
+      transformer_->Transform(&input_, &output_);
+      return;
+    }
+    for (int i = 0; i < num_; ++i) {
+      transformer_->Transform(datum_, &output_);
+    }
+  }
+
+ private:
+  string source_;
+  int num_, channels_, length_, size_;
+  TransformationParameter param_;
+  shared_ptr<DataTransformer<float> > transformer_;
+  Datum datum_;
+  Blob<float> input_, output_;
+};
+
+static void RegisterBenchmarks(vector<shared_ptr<MicroBenchmark> >* all) {
+  // The three products of each convolution, per clip: the forward pass,
+  // the gradients of the weights, and those of the columns.
+  for (int i = 0; i < sizeof(kC3DConvs) / sizeof(kC3DConvs[0]); ++i) {
+    const ConvShape& conv = kC3DConvs[i];
+    const int spatial = conv.depth * conv.size * conv.size;
+    const int kernel_dim = conv.channels * 27;
+    all->push_back(shared_ptr<MicroBenchmark>(new GemmBenchmark(conv.name,
+        "forward", CblasNoTrans, CblasNoTrans, conv.num_output, spatial,
+        kernel_dim)));
+    all->push_back(shared_ptr<MicroBenchmark>(new GemmBenchmark(conv.name,
+        "weight_diff", CblasNoTrans, CblasTrans, conv.num_output, kernel_dim,
+        spatial)));
+    all->push_back(shared_ptr<MicroBenchmark>(new GemmBenchmark(conv.name,
+        "col_diff", CblasTrans, CblasNoTrans, kernel_dim, spatial,
+        conv.num_output)));
+  }
+  // The columns of conv2a take 350 MB; the others are enough.
+  for (int i = 0; i < sizeof(kC3DConvs) / sizeof(kC3DConvs[0]); ++i) {
+    if (i == 1) {
+      continue;
+    }
+    for (int col2im = 0; col2im < 2; ++col2im) {
+      all->push_back(shared_ptr<MicroBenchmark>(
+          new Im2colBenchmark(kC3DConvs[i], col2im)));
+    }
+  }
+  // The pooling of C3D, of AlexNet for comparison.
+  const int pool1_shape[] = {1, 64, 16, 112, 112}, pool1_kernel[] = {1, 2, 2};
+  const int pool2_shape[] = {1, 128, 16, 56, 56}, pool2_kernel[] = {2, 2, 2};
+  const int alexnet_shape[] = {10, 96, 55, 55}, alexnet_kernel[] = {3, 3},
+      alexnet_stride[] = {2, 2};
+  const PoolingParameter_PoolMethod methods[] = {
+      PoolingParameter_PoolMethod_MAX, PoolingParameter_PoolMethod_AVE};
+  for (int m = 0; m < 2; ++m) {
+    for (int backward = 0; backward < 2; ++backward) {
+      all->push_back(shared_ptr<MicroBenchmark>(new PoolingBenchmark(
+          "c3d_pool1", vector<int>(pool1_shape, pool1_shape + 5),
+          vector<int>(pool1_kernel, pool1_kernel + 3),
+          vector<int>(pool1_kernel, pool1_kernel + 3), methods[m],
+          backward)));
+      all->push_back(shared_ptr<MicroBenchmark>(new PoolingBenchmark(
+          "c3d_pool2", vector<int>(pool2_shape, pool2_shape + 5),
+          vector<int>(pool2_kernel, pool2_kernel + 3),
+          vector<int>(pool2_kernel, pool2_kernel + 3), methods[m],
+          backward)));
+      all->push_back(shared_ptr<MicroBenchmark>(new PoolingBenchmark(
+          "alexnet_pool1", vector<int>(alexnet_shape, alexnet_shape + 4),
+          vector<int>(alexnet_kernel, alexnet_kernel + 2),
+          vector<int>(alexnet_stride, alexnet_stride + 2), methods[m],
+          backward)));
+    }
+  }
+  // Vectors in the L1 and L2 caches, and in memory.
+  const int sizes[] = {4096, 65536, 16777216};
+  for (int axpy = 0; axpy < 2; ++axpy) {
+    for (int i = 0; i < 3; ++i) {
+      all->push_back(shared_ptr<MicroBenchmark>(
+          new VectorBenchmark(axpy, sizes[i])));
+    }
+  }
+  all->push_back(shared_ptr<MicroBenchmark>(
+      new TransformBenchmark("blob", 10, 3, 0, 256, 227, 0)));
+  all->push_back(shared_ptr<MicroBenchmark>(
+      new TransformBenchmark("datum_image", 10, 3, 0, 256, 227, 0)));
+  all->push_back(shared_ptr<MicroBenchmark>(
+      new TransformBenchmark("datum_clip", 1, 3, 16, 128, 112, 16)));
+}
+
+// The timing of the iterations of a benchmark, in milliseconds each.
+struct Timing {
+  string name;
+  string aggregate;
+  int repetition;
+  int64_t iterations;
+  double real_time;
+  double cpu_time;
+};
+
+// Times b, running it as many times as it takes to reach min_time seconds.
+static Timing Measure(MicroBenchmark* b, double min_time) {
+  Timing run;
+  run.name = b->name();
+  run.iterations = 1;
+  for (;;) {
+    CPUTimer timer;
+    const std::clock_t cpu_start = std::clock();
+    timer.Start();
+    for (int64_t i = 0; i < run.iterations; ++i) {
+      b->Run();
+    }
+    const double seconds = timer.MicroSeconds() / 1e6;
+    const double cpu_seconds =
+        static_cast<double>(std::clock() - cpu_start) / CLOCKS_PER_SEC;
+    if (seconds >= min_time || run.iterations >= 1000000000) {
+      run.real_time = seconds * 1e3 / run.iterations;
+      run.cpu_time = cpu_seconds * 1e3 / run.iterations;
+      return run;
+    }
+    // Aim past min_time, growing by 10 at most.
+    const double scale = seconds > 0 ? 1.4 * min_time / seconds : 10;
+    run.iterations = std::max(run.iterations + 1, static_cast<int64_t>(
+        run.iterations * std::min(scale, 10.)));
+  }
+}
+
+// The mean, median and standard deviation of runs of a benchmark.
+static vector<Timing> Aggregate(const vector<Timing>& runs) {
+  const int n = runs.size();
+  vector<double> real(n), cpu(n);
+  Timing mean = runs[0];
+  mean.aggregate = "mean";
+  mean.real_time = mean.cpu_time = 0;
+  for (int i = 0; i < n; ++i) {
+    real[i] = runs[i].real_time;
+    cpu[i] = runs[i].cpu_time;
+    mean.real_time += real[i] / n;
+    mean.cpu_time += cpu[i] / n;
+  }
+  Timing median = mean, stddev = mean;
+  median.aggregate = "median";
+  stddev.aggregate = "stddev";
+  std::sort(real.begin(), real.end());
+  std::sort(cpu.begin(), cpu.end());
+  median.real_time = (real[(n - 1) / 2] + real[n / 2]) / 2;
+  median.cpu_time = (cpu[(n - 1) / 2] + cpu[n / 2]) / 2;
+  stddev.real_time = stddev.cpu_time = 0;
+  for (int i = 0; i < n; ++i) {
+    stddev.real_time += (real[i] - mean.real_time) *
+        (real[i] - mean.real_time) / std::max(n - 1, 1);
+    stddev.cpu_time += (cpu[i] - mean.cpu_time) *
+        (cpu[i] - mean.cpu_time) / std::max(n - 1, 1);
+  }
+  stddev.real_time = std::sqrt(stddev.real_time);
+  stddev.cpu_time = std::sqrt(stddev.cpu_time);
+  vector<Timing> aggregates;
+  aggregates.push_back(mean);
+  aggregates.push_back(median);
+  aggregates.push_back(stddev);
+  return aggregates;
+}
+
+// Returns s quoted as a JSON string.
+static string JsonString(const string& s) {
+  std::ostringstream json;
+  json << '"';
+  for (int i = 0; i < s.size(); ++i) {
+    const unsigned char c = s[i];
+    if (c == '"' || c == '\\') {
+      json << '\\' << c;
+    } else if (c < 0x20) {
+      json << "\\u" << std::hex << std::setw(4) << std::setfill('0')
+          << static_cast<int>(c) << std::dec;
+    } else {
+      json << c;
+    }
+  }
+  json << '"';
+  return json.str();
+}
+
+static void WriteJson(std::ostream& out, const char* executable,
+    const vector<Timing>& runs, const vector<double>& items,
+    const vector<double>& bytes) {
+  char host[256] = "";
+  gethostname(host, sizeof(host) - 1);
+  const string date = boost::posix_time::to_iso_extended_string(
+      boost::posix_time::second_clock::local_time());
+  out << "{\n  \"context\": {\n"
+      << "    \"date\": " << JsonString(date) << ",\n"
+      << "    \"host_name\": " << JsonString(host) << ",\n"
+      << "    \"executable\": " << JsonString(executable) << ",\n"
+      << "    \"num_cpus\": " << boost::thread::hardware_concurrency() << ",\n"
+      << "    \"caffe_threads\": " << ThreadPool::Global().num_threads()
+      << ",\n"
+#ifdef NDEBUG
+      << "    \"library_build_type\": \"release\",\n"
+#else
+      << "    \"library_build_type\": \"debug\",\n"
+#endif
+      << "    \"label\": " << JsonString(FLAGS_label) << "\n"
+      << "  },\n  \"benchmarks\": [";
+  out << std::setprecision(10);
+  for (int i = 0; i < runs.size(); ++i) {
+    const Timing& run = runs[i];
+    const bool aggregate = !run.aggregate.empty();
+    out << (i ? ",\n" : "\n") << "    {\n"
+        << "      \"name\": " << JsonString(aggregate ?
+            run.name + "_" + run.aggregate : run.name) << ",\n"
+        << "      \"run_name\": " << JsonString(run.name) << ",\n"
+        << "      \"run_type\": \""
+        << (aggregate ? "aggregate" : "iteration") << "\",\n"
+        << "      \"repetitions\": " << FLAGS_repetitions << ",\n";
+    if (aggregate) {
+      out << "      \"aggregate_name\": \"" << run.aggregate << "\",\n";
+    } else {
+      out << "      \"repetition_index\": " << run.repetition << ",\n";
+    }
+    out << "      \"iterations\": " << run.iterations << ",\n"
+        << "      \"real_time\": " << run.real_time << ",\n"
+        << "      \"cpu_time\": " << run.cpu_time << ",\n"
+        << "      \"time_unit\": \"ms\"";
+    if (run.aggregate != "stddev") {
+      out << ",\n      \"bytes_per_second\": "
+          << bytes[i] / run.real_time * 1e3 << ",\n"
+          << "      \"items_per_second\": "
+          << items[i] / run.real_time * 1e3;
+    }
+    out << "\n    }";
+  }
+  out << "\n  ]\n}\n";
+}
+
+int main(int argc, char** argv) {
+  FLAGS_alsologtostderr = 1;  // Print output to stderr (while still logging)
+  ::google::InitGoogleLogging(argv[0]);
+
+#ifndef GFLAGS_GFLAGS_H_
+  namespace gflags = google;
+#endif
+
+  gflags::SetUsageMessage("Run micro-benchmarks of the CPU kernels and write "
+      "their results as JSON.\n"
+      "Usage:\n"
+      "    micro_benchmarks [FLAGS]\n");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  CHECK_GT(FLAGS_min_time, 0);
+  CHECK_GT(FLAGS_repetitions, 0);
+  Caffe::set_random_seed(1701);
+
+  vector<shared_ptr<MicroBenchmark> > benchmarks;
+  RegisterBenchmarks(&benchmarks);
+  vector<Timing> runs;
+  // The items and bytes of each run.
+  vector<double> items, bytes;
+  LOG(INFO) << "Running on " << ThreadPool::Global().num_threads()
+      << " threads: ms, GB/s, G items/s (FLOPs for gemm, values otherwise)";
+  for (int i = 0; i < benchmarks.size(); ++i) {
+    if (benchmarks[i]->name().find(FLAGS_filter) == string::npos) {
+      continue;
+    }
+    MicroBenchmark* b = benchmarks[i].get();
+    b->SetUp();
+    // The first run touches the memory, and sets up what the kernels cache.
+    b->Run();
+    vector<Timing> repetitions;
+    for (int r = 0; r < FLAGS_repetitions; ++r) {
+      repetitions.push_back(Measure(b, FLAGS_min_time));
+      repetitions.back().repetition = r;
+    }
+    if (FLAGS_repetitions > 1) {
+      const vector<Timing> aggregates = Aggregate(repetitions);
+      repetitions.insert(repetitions.end(), aggregates.begin(),
+          aggregates.end());
+    }
+    for (int r = 0; r < repetitions.size(); ++r) {
+      const Timing& run = repetitions[r];
+      runs.push_back(run);
+      items.push_back(b->items());
+      bytes.push_back(b->bytes());
+      if (run.aggregate == "stddev") {
+        continue;
+      }
+      LOG(INFO) << std::left << std::setw(56) << (run.aggregate.empty() ?
+          run.name : run.name + "_" + run.aggregate) << std::right
+          << std::fixed << std::setprecision(3)
+          << std::setw(10) << run.real_time
+          << std::setw(10) << b->bytes() / run.real_time / 1e6
+          << std::setw(10) << b->items() / run.real_time / 1e6;
+    }
+    // Free the data before the next benchmark.
+    benchmarks[i].reset();
+  }
+  if (FLAGS_output.empty()) {
+    WriteJson(std::cout, argv[0], runs, items, bytes);
+  } else {
+    std::ofstream out(FLAGS_output.c_str());
+    CHECK(out) << "Failed to open " << FLAGS_output;
+    WriteJson(out, argv[0], runs, items, bytes);
+    CHECK(out) << "Failed to write " << FLAGS_output;
+  }
+  return 0;
+}
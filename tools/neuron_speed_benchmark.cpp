@@ -0,0 +1,141 @@
+// This program times the forward pass of the neuron layer activations on the
+// CPU, comparing the kernels of neuron_functions.hpp with the plain loops
+// they replaced, and reports the memory bandwidth they reach.
+// Usage:
+//    neuron_speed_benchmark [-count N] [-iterations N]
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "caffe/caffe.hpp"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/neuron_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+
+DEFINE_int32(count, 1 << 24,
+    "The number of values of the blobs.");
+DEFINE_int32(iterations, 10,
+    "The number of passes timed for each activation.");
+
+// The loops of the layers, one value at a time on one thread.
+static void LoopReLU(int n, const float* x, float* y) {
+  for (int i = 0; i < n; ++i) {
+    y[i] = std::max(x[i], 0.f) + 0.f * std::min(x[i], 0.f);
+  }
+}
+
+static void LoopSigmoid(int n, const float* x, float* y) {
+  for (int i = 0; i < n; ++i) {
+    y[i] = 0.5 * tanh(0.5 * x[i]) + 0.5;
+  }
+}
+
+static void LoopTanH(int n, const float* x, float* y) {
+  for (int i = 0; i < n; ++i) {
+    y[i] = tanh(x[i]);
+  }
+}
+
+static void LoopELU(int n, const float* x, float* y) {
+  for (int i = 0; i < n; ++i) {
+    y[i] = std::max(x[i], 0.f) + (exp(std::min(x[i], 0.f)) - 1.f);
+  }
+}
+
+static void LoopExp(int n, const float* x, float* y) {
+  caffe_exp(n, x, y);
+}
+
+static void LoopBNLL(int n, const float* x, float* y) {
+  for (int i = 0; i < n; ++i) {
+    y[i] = x[i] > 0 ? x[i] + log(1. + exp(-x[i])) : log(1. + exp(x[i]));
+  }
+}
+
+static void EngineReLU(int n, const float* x, float* y) {
+  caffe_cpu_relu(n, x, 0.f, y);
+}
+
+static void EngineSigmoid(int n, const float* x, float* y) {
+  caffe_cpu_sigmoid(n, x, y);
+}
+
+static void EngineTanH(int n, const float* x, float* y) {
+  caffe_cpu_tanh(n, x, y);
+}
+
+static void EngineELU(int n, const float* x, float* y) {
+  caffe_cpu_elu(n, x, 1.f, y);
+}
+
+static void EngineExp(int n, const float* x, float* y) {
+  caffe_cpu_scaled_exp(n, x, 1.f, 1.f, y);
+}
+
+static void EngineBNLL(int n, const float* x, float* y) {
+  caffe_cpu_bnll(n, x, y);
+}
+
+typedef void (*Activation)(int n, const float* x, float* y);
+
+// Returns the bandwidth of activation in GB/s, counting a read and a write
+// of each value.
+static double Bandwidth(Activation activation, const Blob<float>& x,
+    Blob<float>* y) {
+  const int n = x.count();
+  activation(n, x.cpu_data(), y->mutable_cpu_data());  // Warm up.
+  CPUTimer timer;
+  timer.Start();
+  for (int i = 0; i < FLAGS_iterations; ++i) {
+    activation(n, x.cpu_data(), y->mutable_cpu_data());
+  }
+  const double seconds = timer.MicroSeconds() / 1e6;
+  return 2. * n * sizeof(float) * FLAGS_iterations / seconds / 1e9;
+}
+
+int main(int argc, char** argv) {
+  FLAGS_alsologtostderr = 1;  // Print output to stderr (while still logging)
+  ::google::InitGoogleLogging(argv[0]);
+
+#ifndef GFLAGS_GFLAGS_H_
+  namespace gflags = google;
+#endif
+
+  gflags::SetUsageMessage("Time the neuron layer activations on the CPU.\n"
+      "Usage:\n"
+      "    neuron_speed_benchmark [FLAGS]\n");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  CHECK_GT(FLAGS_count, 0);
+  CHECK_GT(FLAGS_iterations, 0);
+
+  Blob<float> x(vector<int>(1, FLAGS_count));
+  Blob<float> y(vector<int>(1, FLAGS_count));
+  FillerParameter filler_param;
+  filler_param.set_min(-8);
+  filler_param.set_max(8);
+  UniformFiller<float> filler(filler_param);
+  filler.Fill(&x);
+
+  const char* names[] = {"ReLU", "Sigmoid", "TanH", "ELU", "Exp", "BNLL"};
+  const Activation loops[] = {LoopReLU, LoopSigmoid, LoopTanH, LoopELU,
+      LoopExp, LoopBNLL};
+  const Activation engines[] = {EngineReLU, EngineSigmoid, EngineTanH,
+      EngineELU, EngineExp, EngineBNLL};
+  LOG(INFO) << FLAGS_count << " floats, " << (caffe_cpu_neuron_simd() ?
+      "SIMD" : "scalar") << " kernels on "
+      << ThreadPool::Global().num_threads() << " threads";
+  for (int a = 0; a < sizeof(names) / sizeof(names[0]); ++a) {
+    const double loop = Bandwidth(loops[a], x, &y);
+    const double engine = Bandwidth(engines[a], x, &y);
+    LOG(INFO) << names[a] << ": loop " << loop << " GB/s, kernel "
+        << engine << " GB/s (" << engine / loop << "x)";
+  }
+  return 0;
+}
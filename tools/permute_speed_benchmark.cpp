@@ -0,0 +1,102 @@
+// This program times caffe_cpu_permute on the permutations of 5-D clip blobs
+// common in video nets, comparing it with a loop decoding the index of each
+// value, and reports the memory bandwidth they reach.
+// Usage:
+//    permute_speed_benchmark [-shape N,C,D,H,W] [-iterations N]
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include <string>
+#include <vector>
+
+#include "boost/algorithm/string.hpp"
+#include "caffe/caffe.hpp"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+
+DEFINE_string(shape, "8,64,16,56,56",
+    "The N,C,D,H,W shape of the permuted blob.");
+DEFINE_int32(iterations, 10,
+    "The number of passes timed for each permutation.");
+
+// Permutes src into dst one value at a time.
+static void LoopPermute(const vector<int>& shape, const vector<int>& order,
+    const float* src, float* dst) {
+  const int num_axes = shape.size();
+  vector<int> src_strides(num_axes, 1);
+  for (int i = num_axes - 2; i >= 0; --i) {
+    src_strides[i] = src_strides[i + 1] * shape[i + 1];
+  }
+  int count = 1;
+  for (int i = 0; i < num_axes; ++i) {
+    count *= shape[i];
+  }
+  for (int index = 0; index < count; ++index) {
+    int src_index = 0;
+    for (int i = num_axes - 1, rest = index; i >= 0; --i) {
+      src_index += rest % shape[order[i]] * src_strides[order[i]];
+      rest /= shape[order[i]];
+    }
+    dst[index] = src[src_index];
+  }
+}
+
+int main(int argc, char** argv) {
+  FLAGS_alsologtostderr = 1;  // Print output to stderr (while still logging)
+  ::google::InitGoogleLogging(argv[0]);
+
+#ifndef GFLAGS_GFLAGS_H_
+  namespace gflags = google;
+#endif
+
+  gflags::SetUsageMessage("Time caffe_cpu_permute on 5-D blobs.\n"
+      "Usage:\n"
+      "    permute_speed_benchmark [FLAGS]\n");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  CHECK_GT(FLAGS_iterations, 0);
+  vector<string> dims;
+  boost::split(dims, FLAGS_shape, boost::is_any_of(","));
+  CHECK_EQ(dims.size(), 5) << "The shape must be N,C,D,H,W.";
+  vector<int> shape;
+  for (int i = 0; i < dims.size(); ++i) {
+    shape.push_back(atoi(dims[i].c_str()));
+    CHECK_GT(shape.back(), 0);
+  }
+
+  Blob<float> src(shape);
+  Blob<float> dst(shape);
+  FillerParameter filler_param;
+  UniformFiller<float> filler(filler_param);
+  filler.Fill(&src);
+
+  const char* names[] = {"NCDHW -> NDCHW", "NCDHW -> NDHWC", "NDHWC -> NCDHW",
+      "NCDHW -> NCDWH"};
+  const int orders[][5] = {{0, 2, 1, 3, 4}, {0, 2, 3, 4, 1}, {0, 4, 1, 2, 3},
+      {0, 1, 2, 4, 3}};
+  const double bytes = 2. * src.count() * sizeof(float) * FLAGS_iterations;
+  LOG(INFO) << "Permuting " << src.shape_string() << " on "
+      << ThreadPool::Global().num_threads() << " threads";
+  for (int p = 0; p < sizeof(names) / sizeof(names[0]); ++p) {
+    const vector<int> order(orders[p], orders[p] + 5);
+    CPUTimer timer;
+    LoopPermute(shape, order, src.cpu_data(), dst.mutable_cpu_data());
+    timer.Start();
+    for (int i = 0; i < FLAGS_iterations; ++i) {
+      LoopPermute(shape, order, src.cpu_data(), dst.mutable_cpu_data());
+    }
+    const double loop = bytes / timer.MicroSeconds() / 1e3;
+    caffe_cpu_permute(shape, order, src.cpu_data(), dst.mutable_cpu_data());
+    timer.Start();
+    for (int i = 0; i < FLAGS_iterations; ++i) {
+      caffe_cpu_permute(shape, order, src.cpu_data(), dst.mutable_cpu_data());
+    }
+    const double kernel = bytes / timer.MicroSeconds() / 1e3;
+    LOG(INFO) << names[p] << ": loop " << loop << " GB/s, kernel " << kernel
+        << " GB/s (" << kernel / loop << "x)";
+  }
+  return 0;
+}
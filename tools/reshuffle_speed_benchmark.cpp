@@ -0,0 +1,176 @@
+// This program times the forward pass of the layers that only move values
+// around (Transform2D, DeconvTrans and Duplicate) on the CPU, comparing them
+// with the per-value index loops they used before, and reports the memory
+// bandwidth they reach.
+// Usage:
+//    reshuffle_speed_benchmark [-num N] [-channels N] [-size N] [-iterations N]
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include <string>
+#include <vector>
+
+#include "caffe/caffe.hpp"
+#include "caffe/layers/deconv_trans_layer.hpp"
+#include "caffe/layers/duplicate_layer.hpp"
+#include "caffe/layers/transform2d_layer.hpp"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+
+DEFINE_int32(num, 8,
+    "The batch size of the bottoms.");
+DEFINE_int32(channels, 64,
+    "The channels of the bottoms.");
+DEFINE_int32(size, 56,
+    "The height and width of the bottoms, and 8 times their depth.");
+DEFINE_int32(iterations, 10,
+    "The number of passes timed for each layer.");
+
+// The loops of the layers, decoding the index of each value.
+static void LoopTransform2D(const Blob<float>& bottom, Blob<float>* top) {
+  const float* bottom_data = bottom.cpu_data();
+  float* top_data = top->mutable_cpu_data();
+  for (int index = 0; index < bottom.count(); ++index) {
+    int num = index;
+    const int w = num % bottom.shape(3);
+    num = num / bottom.shape(3);
+    const int h = num % bottom.shape(2);
+    num = num / bottom.shape(2);
+    const int c = num % bottom.shape(1);
+    num = num / bottom.shape(1);
+    const int out_c = c + (h % 2 * 2 + w % 2) * bottom.shape(1);
+    top_data[num * top->count(1) + out_c * top->count(2)
+        + h / 2 * top->count(3) + w / 2] = bottom_data[index];
+  }
+}
+
+static void LoopDeconvTrans(const Blob<float>& bottom, Blob<float>* top) {
+  // Strides of 2 along each axis.
+  const float* bottom_data = bottom.cpu_data();
+  float* top_data = top->mutable_cpu_data();
+  for (int index = 0; index < bottom.count(); ++index) {
+    int num = index;
+    const int w = num % bottom.shape(4);
+    num = num / bottom.shape(4);
+    const int h = num % bottom.shape(3);
+    num = num / bottom.shape(3);
+    const int d = num % bottom.shape(2);
+    num = num / bottom.shape(2);
+    const int c = num % bottom.shape(1);
+    num = num / bottom.shape(1);
+    const int i = c % 2;
+    const int j = c / 2 % 2;
+    const int k = c / 4 % 2;
+    top_data[num * top->count(1) + c / 8 * top->count(2)
+        + (d * 2 + k) * top->count(3) + (h * 2 + j) * top->count(4)
+        + w * 2 + i] = bottom_data[index];
+  }
+}
+
+static void LoopDuplicate(const Blob<float>& bottom, Blob<float>* top) {
+  // 2 duplicates.
+  const float* bottom_data = bottom.cpu_data();
+  float* top_data = top->mutable_cpu_data();
+  for (int index = 0; index < bottom.count(); ++index) {
+    int num = index;
+    const int w = num % bottom.shape(3);
+    num = num / bottom.shape(3);
+    const int h = num % bottom.shape(2);
+    num = num / bottom.shape(2);
+    const int c = num % bottom.shape(1);
+    num = num / bottom.shape(1);
+    for (int i = 0; i < 2; ++i) {
+      top_data[(num * 2 + i) * top->count(1) + c * top->count(2)
+          + h * top->count(3) + w] = bottom_data[index];
+    }
+  }
+}
+
+typedef void (*Loop)(const Blob<float>& bottom, Blob<float>* top);
+
+// Returns the bandwidth of the loop and of the layer in GB/s, counting the
+// reads of the bottom and the writes of the top.
+static void Bandwidth(Loop loop, Layer<float>* layer, Blob<float>* bottom,
+    double* loop_bandwidth, double* layer_bandwidth) {
+  Blob<float> top;
+  vector<Blob<float>*> bottom_vec(1, bottom);
+  vector<Blob<float>*> top_vec(1, &top);
+  layer->SetUp(bottom_vec, top_vec);
+  const double bytes = (bottom->count() + top.count()) * sizeof(float) *
+      static_cast<double>(FLAGS_iterations);
+  CPUTimer timer;
+  loop(*bottom, &top);  // Warm up.
+  timer.Start();
+  for (int i = 0; i < FLAGS_iterations; ++i) {
+    loop(*bottom, &top);
+  }
+  *loop_bandwidth = bytes / timer.MicroSeconds() / 1e3;
+  layer->Forward(bottom_vec, top_vec);
+  timer.Start();
+  for (int i = 0; i < FLAGS_iterations; ++i) {
+    layer->Forward(bottom_vec, top_vec);
+  }
+  *layer_bandwidth = bytes / timer.MicroSeconds() / 1e3;
+}
+
+int main(int argc, char** argv) {
+  FLAGS_alsologtostderr = 1;  // Print output to stderr (while still logging)
+  ::google::InitGoogleLogging(argv[0]);
+
+#ifndef GFLAGS_GFLAGS_H_
+  namespace gflags = google;
+#endif
+
+  gflags::SetUsageMessage("Time the reshuffling layers on the CPU.\n"
+      "Usage:\n"
+      "    reshuffle_speed_benchmark [FLAGS]\n");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  CHECK_GT(FLAGS_num, 0);
+  CHECK_GT(FLAGS_channels, 0);
+  CHECK_EQ(FLAGS_channels % 8, 0) << "DeconvTrans takes 8 channels a value.";
+  CHECK_GE(FLAGS_size, 8);
+  CHECK_EQ(FLAGS_size % 8, 0);
+  CHECK_GT(FLAGS_iterations, 0);
+
+  Blob<float> image(FLAGS_num, FLAGS_channels, FLAGS_size, FLAGS_size);
+  vector<int> clip_shape(5);
+  clip_shape[0] = FLAGS_num;
+  clip_shape[1] = FLAGS_channels;
+  clip_shape[2] = FLAGS_size / 8;
+  clip_shape[3] = FLAGS_size / 2;
+  clip_shape[4] = FLAGS_size / 2;
+  Blob<float> clip(clip_shape);
+  FillerParameter filler_param;
+  UniformFiller<float> filler(filler_param);
+  filler.Fill(&image);
+  filler.Fill(&clip);
+
+  LayerParameter transform2d_param;
+  LayerParameter deconv_trans_param;
+  for (int i = 0; i < 3; ++i) {
+    deconv_trans_param.mutable_deconv_trans_param()->add_stride(2);
+  }
+  LayerParameter duplicate_param;
+  duplicate_param.mutable_duplicate_param()->set_duplicates(2);
+  Transform2DLayer<float> transform2d(transform2d_param);
+  DeconvTransLayer<float> deconv_trans(deconv_trans_param);
+  DuplicateLayer<float> duplicate(duplicate_param);
+
+  const char* names[] = {"Transform2D", "DeconvTrans", "Duplicate"};
+  const Loop loops[] = {LoopTransform2D, LoopDeconvTrans, LoopDuplicate};
+  Layer<float>* layers[] = {&transform2d, &deconv_trans, &duplicate};
+  Blob<float>* bottoms[] = {&image, &clip, &image};
+  LOG(INFO) << "Running on " << ThreadPool::Global().num_threads()
+      << " threads";
+  for (int l = 0; l < sizeof(names) / sizeof(names[0]); ++l) {
+    double loop, layer;
+    Bandwidth(loops[l], layers[l], bottoms[l], &loop, &layer);
+    LOG(INFO) << names[l] << " " << bottoms[l]->shape_string() << ": loop "
+        << loop << " GB/s, layer " << layer << " GB/s (" << layer / loop
+        << "x)";
+  }
+  return 0;
+}